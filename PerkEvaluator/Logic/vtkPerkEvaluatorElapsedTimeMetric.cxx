@@ -0,0 +1,46 @@
+
+#include "vtkPerkEvaluatorElapsedTimeMetric.h"
+
+vtkStandardNewMacro( vtkPerkEvaluatorElapsedTimeMetric );
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkPerkEvaluatorElapsedTimeMetric
+::vtkPerkEvaluatorElapsedTimeMetric()
+{
+  this->HasTimestamps = false;
+  this->FirstTime = 0.0;
+  this->LastTime = 0.0;
+}
+
+
+vtkPerkEvaluatorElapsedTimeMetric
+::~vtkPerkEvaluatorElapsedTimeMetric()
+{
+}
+
+
+// Computation ---------------------------------------------------------------------------------------
+
+void vtkPerkEvaluatorElapsedTimeMetric
+::ProcessTimestamps( int numberOfTimestamps, const double* times, const double* vtkNotUsed( matrices ), std::string vtkNotUsed( role ) )
+{
+  if ( ! this->HasTimestamps )
+  {
+    this->FirstTime = times[ 0 ];
+    this->HasTimestamps = true;
+  }
+  this->LastTime = times[ numberOfTimestamps - 1 ];
+}
+
+
+double vtkPerkEvaluatorElapsedTimeMetric
+::GetMetric()
+{
+  if ( ! this->HasTimestamps )
+  {
+    return 0.0;
+  }
+  return this->LastTime - this->FirstTime;
+}
@@ -0,0 +1,57 @@
+#ifndef __vtkPerkEvaluatorElapsedTimeMetric_h
+#define __vtkPerkEvaluatorElapsedTimeMetric_h
+
+// Standard includes
+#include <string>
+#include <vector>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+
+// PerkEvaluator includes
+#include "vtkSlicerPerkEvaluatorModuleLogicExport.h"
+#include "vtkPerkEvaluatorMetric.h"
+
+
+// Time from the first to the last timestamp
+class VTK_SLICER_PERKEVALUATOR_MODULE_LOGIC_EXPORT
+vtkPerkEvaluatorElapsedTimeMetric : public vtkPerkEvaluatorMetric
+{
+public:
+  vtkTypeMacro( vtkPerkEvaluatorElapsedTimeMetric, vtkPerkEvaluatorMetric );
+
+  // Standard VTK methods
+  static vtkPerkEvaluatorElapsedTimeMetric* New();
+
+protected:
+
+  // Constructor/destructor
+  vtkPerkEvaluatorElapsedTimeMetric();
+  virtual ~vtkPerkEvaluatorElapsedTimeMetric();
+
+public:
+
+  std::string GetMetricName() override { return "Elapsed Time"; };
+  std::string GetMetricUnit() override { return "s"; };
+  bool IsPervasive() override { return true; };
+  bool IsShared() override { return true; };
+
+  double GetMetric() override;
+
+protected:
+
+  void ProcessTimestamps( int numberOfTimestamps, const double* times, const double* matrices, std::string role ) override;
+
+  bool HasTimestamps;
+  double FirstTime;
+  double LastTime;
+
+private:
+  vtkPerkEvaluatorElapsedTimeMetric( const vtkPerkEvaluatorElapsedTimeMetric& ); // Not implemented
+  void operator=( const vtkPerkEvaluatorElapsedTimeMetric& ); // Not implemented
+
+};
+
+#endif
@@ -0,0 +1,98 @@
+
+#include "vtkPerkEvaluatorMetric.h"
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkPerkEvaluatorMetric
+::vtkPerkEvaluatorMetric()
+{
+  this->NeedleOrientation[ 0 ] = 0.0;
+  this->NeedleOrientation[ 1 ] = 0.0;
+  this->NeedleOrientation[ 2 ] = 0.0;
+}
+
+
+vtkPerkEvaluatorMetric
+::~vtkPerkEvaluatorMetric()
+{
+}
+
+
+// Roles ---------------------------------------------------------------------------------------------
+
+// Same default as the Python metrics
+std::vector< std::string > vtkPerkEvaluatorMetric
+::GetTransformRoles()
+{
+  std::vector< std::string > transformRoles;
+  transformRoles.push_back( "Any" );
+  return transformRoles;
+}
+
+
+std::vector< std::string > vtkPerkEvaluatorMetric
+::GetAnatomyRoles()
+{
+  return std::vector< std::string >();
+}
+
+
+std::string vtkPerkEvaluatorMetric
+::GetAnatomyRoleClassName( std::string vtkNotUsed( role ) )
+{
+  return "";
+}
+
+
+bool vtkPerkEvaluatorMetric
+::SetAnatomy( std::string vtkNotUsed( role ), vtkMRMLNode* vtkNotUsed( node ) )
+{
+  return false;
+}
+
+
+// Timestamps ---------------------------------------------------------------------------------------
+
+void vtkPerkEvaluatorMetric
+::AddTimestamps( int numberOfTimestamps, const double* times, const double* matrices, std::string role )
+{
+  if ( numberOfTimestamps <= 0 || times == NULL || matrices == NULL )
+  {
+    return;
+  }
+
+  this->ProcessTimestamps( numberOfTimestamps, times, matrices, role );
+}
+
+
+void vtkPerkEvaluatorMetric
+::AddTimestamps( vtkDoubleArray* times, vtkDoubleArray* matrices, std::string role, int first, int last )
+{
+  if ( times == NULL || matrices == NULL || matrices->GetNumberOfComponents() != 16 )
+  {
+    return;
+  }
+  first = std::max( first, 0 );
+  last = std::min( last, int( std::min( times->GetNumberOfTuples(), matrices->GetNumberOfTuples() ) ) );
+  if ( first >= last )
+  {
+    return;
+  }
+
+  this->AddTimestamps( last - first, times->GetPointer( first ), matrices->GetPointer( 16 * first ), role );
+}
+
+
+void vtkPerkEvaluatorMetric
+::AddTimestamp( double time, vtkMatrix4x4* matrix, std::string role )
+{
+  if ( matrix == NULL )
+  {
+    return;
+  }
+
+  double elements[ 16 ];
+  vtkMatrix4x4::DeepCopy( elements, matrix );
+  this->AddTimestamps( 1, &time, elements, role );
+}
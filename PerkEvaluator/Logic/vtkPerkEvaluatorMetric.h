@@ -0,0 +1,79 @@
+#ifndef __vtkPerkEvaluatorMetric_h
+#define __vtkPerkEvaluatorMetric_h
+
+// Standard includes
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+#include "vtkDoubleArray.h"
+#include "vtkMatrix4x4.h"
+
+// MRML includes
+#include "vtkMRMLNode.h"
+
+// PerkEvaluator includes
+#include "vtkSlicerPerkEvaluatorModuleLogicExport.h"
+
+
+// This is the native (C++) counterpart of the PerkEvaluatorMetric Python class
+// The timestamps come in batches (times, and row-major 4x4 to-world matrices), so a whole recording can be fed in one call
+// Each batch is for one transform role, in time order; for a metric with several transform roles, the logic merges the roles' batches by timestamp
+class VTK_SLICER_PERKEVALUATOR_MODULE_LOGIC_EXPORT
+vtkPerkEvaluatorMetric : public vtkObject
+{
+public:
+  vtkTypeMacro( vtkPerkEvaluatorMetric, vtkObject );
+
+protected:
+
+  // Constructor/destructor
+  vtkPerkEvaluatorMetric();
+  virtual ~vtkPerkEvaluatorMetric();
+
+public:
+
+  // Description of the metric (the same for every instance)
+  virtual std::string GetMetricName() = 0;
+  virtual std::string GetMetricUnit() = 0;
+  virtual bool IsPervasive() { return false; };
+  virtual bool IsShared() { return false; };
+  virtual bool IsHidden() { return false; };
+  virtual std::vector< std::string > GetTransformRoles();
+  virtual std::vector< std::string > GetAnatomyRoles(); // The anatomy role names
+  virtual std::string GetAnatomyRoleClassName( std::string role ); // The node class each anatomy role accepts
+
+  // Returns whether the anatomy was accepted
+  virtual bool SetAnatomy( std::string role, vtkMRMLNode* node );
+
+  vtkGetVector3Macro( NeedleOrientation, double );
+  vtkSetVector3Macro( NeedleOrientation, double );
+
+#ifndef __VTK_WRAP__
+  // The matrices have 16 values per timestamp
+  void AddTimestamps( int numberOfTimestamps, const double* times, const double* matrices, std::string role );
+#endif
+  // The frames from first up to (not including) last, where the matrices array has 16 components
+  void AddTimestamps( vtkDoubleArray* times, vtkDoubleArray* matrices, std::string role, int first, int last );
+  void AddTimestamp( double time, vtkMatrix4x4* matrix, std::string role );
+
+  virtual double GetMetric() = 0;
+
+protected:
+
+  // Subclasses do their computation here (every way of adding timestamps ends up here)
+  virtual void ProcessTimestamps( int numberOfTimestamps, const double* times, const double* matrices, std::string role ) = 0;
+
+  double NeedleOrientation[ 3 ];
+
+private:
+  vtkPerkEvaluatorMetric( const vtkPerkEvaluatorMetric& ); // Not implemented
+  void operator=( const vtkPerkEvaluatorMetric& ); // Not implemented
+
+};
+
+#endif
@@ -0,0 +1,139 @@
+
+#include "vtkPerkEvaluatorMetricFactory.h"
+
+// Core metrics
+#include "vtkPerkEvaluatorElapsedTimeMetric.h"
+#include "vtkPerkEvaluatorPathLengthMetric.h"
+#include "vtkPerkEvaluatorTissueInsideTimeMetric.h"
+#include "vtkPerkEvaluatorVelocityMetric.h"
+
+vtkStandardNewMacro( vtkPerkEvaluatorMetricFactory );
+
+
+// Core metric creation functions -----------------------------------------------------------------
+
+static vtkPerkEvaluatorMetric* CreateElapsedTimeMetric()
+{
+  return vtkPerkEvaluatorElapsedTimeMetric::New();
+}
+
+
+static vtkPerkEvaluatorMetric* CreatePathLengthMetric()
+{
+  return vtkPerkEvaluatorPathLengthMetric::New();
+}
+
+
+static vtkPerkEvaluatorMetric* CreateTissueInsideTimeMetric()
+{
+  return vtkPerkEvaluatorTissueInsideTimeMetric::New();
+}
+
+
+static vtkPerkEvaluatorMetric* CreateAverageVelocityMetric()
+{
+  vtkPerkEvaluatorVelocityMetric* metric = vtkPerkEvaluatorVelocityMetric::New();
+  metric->SetStatistic( vtkPerkEvaluatorVelocityMetric::AVERAGE_VELOCITY );
+  return metric;
+}
+
+
+static vtkPerkEvaluatorMetric* CreateMaximumVelocityMetric()
+{
+  vtkPerkEvaluatorVelocityMetric* metric = vtkPerkEvaluatorVelocityMetric::New();
+  metric->SetStatistic( vtkPerkEvaluatorVelocityMetric::MAXIMUM_VELOCITY );
+  return metric;
+}
+
+
+static vtkPerkEvaluatorMetric* CreateVelocityStandardDeviationMetric()
+{
+  vtkPerkEvaluatorVelocityMetric* metric = vtkPerkEvaluatorVelocityMetric::New();
+  metric->SetStatistic( vtkPerkEvaluatorVelocityMetric::VELOCITY_STANDARD_DEVIATION );
+  return metric;
+}
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkPerkEvaluatorMetricFactory
+::vtkPerkEvaluatorMetricFactory()
+{
+}
+
+
+vtkPerkEvaluatorMetricFactory
+::~vtkPerkEvaluatorMetricFactory()
+{
+}
+
+
+// Registry ------------------------------------------------------------------------------------------
+
+// The core metrics, which every registry starts with
+static std::map< std::string, vtkPerkEvaluatorMetricFactory::CreateFunction > CreateCoreRegistry()
+{
+  std::map< std::string, vtkPerkEvaluatorMetricFactory::CreateFunction > registry;
+  registry[ "Elapsed Time" ] = CreateElapsedTimeMetric;
+  registry[ "Path Length" ] = CreatePathLengthMetric;
+  registry[ "Tissue Inside Time" ] = CreateTissueInsideTimeMetric;
+  registry[ "Average Velocity" ] = CreateAverageVelocityMetric;
+  registry[ "Maximum Velocity" ] = CreateMaximumVelocityMetric;
+  registry[ "Velocity Standard Deviation" ] = CreateVelocityStandardDeviationMetric;
+  return registry;
+}
+
+
+// Constructed on first use, so registration from other libraries' static initializers is safe
+// The core metrics are seeded exactly once, when the registry is constructed, so other registrations always go in after them
+std::map< std::string, vtkPerkEvaluatorMetricFactory::CreateFunction >& vtkPerkEvaluatorMetricFactory
+::GetRegistry()
+{
+  static std::map< std::string, CreateFunction > registry = CreateCoreRegistry();
+  return registry;
+}
+
+
+void vtkPerkEvaluatorMetricFactory
+::RegisterMetric( std::string name, CreateFunction createFunction )
+{
+  if ( createFunction == NULL )
+  {
+    return;
+  }
+  vtkPerkEvaluatorMetricFactory::GetRegistry()[ name ] = createFunction;
+}
+
+
+vtkPerkEvaluatorMetric* vtkPerkEvaluatorMetricFactory
+::CreateMetric( std::string name )
+{
+  std::map< std::string, CreateFunction >& registry = vtkPerkEvaluatorMetricFactory::GetRegistry();
+  std::map< std::string, CreateFunction >::iterator itr = registry.find( name );
+  if ( itr == registry.end() )
+  {
+    return NULL;
+  }
+  return ( itr->second )();
+}
+
+
+bool vtkPerkEvaluatorMetricFactory
+::IsMetricRegistered( std::string name )
+{
+  std::map< std::string, CreateFunction >& registry = vtkPerkEvaluatorMetricFactory::GetRegistry();
+  return registry.find( name ) != registry.end();
+}
+
+
+std::vector< std::string > vtkPerkEvaluatorMetricFactory
+::GetRegisteredMetricNames()
+{
+  std::vector< std::string > names;
+  std::map< std::string, CreateFunction >& registry = vtkPerkEvaluatorMetricFactory::GetRegistry();
+  for ( std::map< std::string, CreateFunction >::iterator itr = registry.begin(); itr != registry.end(); itr++ )
+  {
+    names.push_back( itr->first );
+  }
+  return names;
+}
@@ -0,0 +1,63 @@
+#ifndef __vtkPerkEvaluatorMetricFactory_h
+#define __vtkPerkEvaluatorMetricFactory_h
+
+// Standard includes
+#include <map>
+#include <string>
+#include <vector>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+
+// PerkEvaluator includes
+#include "vtkSlicerPerkEvaluatorModuleLogicExport.h"
+#include "vtkPerkEvaluatorMetric.h"
+
+
+// Creates native metrics by name
+// The core metrics are always registered; other libraries can register their own metrics at load time
+class VTK_SLICER_PERKEVALUATOR_MODULE_LOGIC_EXPORT
+vtkPerkEvaluatorMetricFactory : public vtkObject
+{
+public:
+  vtkTypeMacro( vtkPerkEvaluatorMetricFactory, vtkObject );
+
+  // Standard VTK methods
+  static vtkPerkEvaluatorMetricFactory* New();
+
+protected:
+
+  // Constructor/destructor
+  vtkPerkEvaluatorMetricFactory();
+  virtual ~vtkPerkEvaluatorMetricFactory();
+
+public:
+
+#ifndef __VTK_WRAP__
+  typedef vtkPerkEvaluatorMetric* ( *CreateFunction )();
+
+  // Registering a name again replaces the earlier metric
+  static void RegisterMetric( std::string name, CreateFunction createFunction );
+#endif
+
+  // The caller is responsible for deleting the metric (returns NULL if the name is not registered)
+  VTK_NEWINSTANCE
+  static vtkPerkEvaluatorMetric* CreateMetric( std::string name );
+  static bool IsMetricRegistered( std::string name );
+  static std::vector< std::string > GetRegisteredMetricNames();
+
+protected:
+
+#ifndef __VTK_WRAP__
+  static std::map< std::string, CreateFunction >& GetRegistry();
+#endif
+
+private:
+  vtkPerkEvaluatorMetricFactory( const vtkPerkEvaluatorMetricFactory& ); // Not implemented
+  void operator=( const vtkPerkEvaluatorMetricFactory& ); // Not implemented
+
+};
+
+#endif
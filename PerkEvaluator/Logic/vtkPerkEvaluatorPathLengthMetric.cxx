@@ -0,0 +1,57 @@
+
+#include "vtkPerkEvaluatorPathLengthMetric.h"
+
+// VTK includes
+#include "vtkMath.h"
+
+vtkStandardNewMacro( vtkPerkEvaluatorPathLengthMetric );
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkPerkEvaluatorPathLengthMetric
+::vtkPerkEvaluatorPathLengthMetric()
+{
+  this->HasPreviousPoint = false;
+  this->PreviousPoint[ 0 ] = 0.0;
+  this->PreviousPoint[ 1 ] = 0.0;
+  this->PreviousPoint[ 2 ] = 0.0;
+  this->PathLength = 0.0;
+}
+
+
+vtkPerkEvaluatorPathLengthMetric
+::~vtkPerkEvaluatorPathLengthMetric()
+{
+}
+
+
+// Computation ---------------------------------------------------------------------------------------
+
+void vtkPerkEvaluatorPathLengthMetric
+::ProcessTimestamps( int numberOfTimestamps, const double* vtkNotUsed( times ), const double* matrices, std::string vtkNotUsed( role ) )
+{
+  for ( int i = 0; i < numberOfTimestamps; i++ )
+  {
+    // The origin is the translation column of the row-major matrix
+    const double* matrix = matrices + 16 * i;
+    double point[ 3 ] = { matrix[ 3 ], matrix[ 7 ], matrix[ 11 ] };
+
+    if ( this->HasPreviousPoint )
+    {
+      this->PathLength += std::sqrt( vtkMath::Distance2BetweenPoints( point, this->PreviousPoint ) );
+    }
+
+    this->PreviousPoint[ 0 ] = point[ 0 ];
+    this->PreviousPoint[ 1 ] = point[ 1 ];
+    this->PreviousPoint[ 2 ] = point[ 2 ];
+    this->HasPreviousPoint = true;
+  }
+}
+
+
+double vtkPerkEvaluatorPathLengthMetric
+::GetMetric()
+{
+  return this->PathLength;
+}
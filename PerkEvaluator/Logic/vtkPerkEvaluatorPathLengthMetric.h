@@ -0,0 +1,58 @@
+#ifndef __vtkPerkEvaluatorPathLengthMetric_h
+#define __vtkPerkEvaluatorPathLengthMetric_h
+
+// Standard includes
+#include <cmath>
+#include <string>
+#include <vector>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+
+// PerkEvaluator includes
+#include "vtkSlicerPerkEvaluatorModuleLogicExport.h"
+#include "vtkPerkEvaluatorMetric.h"
+
+
+// Total distance travelled by the transform's origin
+class VTK_SLICER_PERKEVALUATOR_MODULE_LOGIC_EXPORT
+vtkPerkEvaluatorPathLengthMetric : public vtkPerkEvaluatorMetric
+{
+public:
+  vtkTypeMacro( vtkPerkEvaluatorPathLengthMetric, vtkPerkEvaluatorMetric );
+
+  // Standard VTK methods
+  static vtkPerkEvaluatorPathLengthMetric* New();
+
+protected:
+
+  // Constructor/destructor
+  vtkPerkEvaluatorPathLengthMetric();
+  virtual ~vtkPerkEvaluatorPathLengthMetric();
+
+public:
+
+  std::string GetMetricName() override { return "Path Length"; };
+  std::string GetMetricUnit() override { return "mm"; };
+  bool IsPervasive() override { return true; };
+  bool IsShared() override { return true; };
+
+  double GetMetric() override;
+
+protected:
+
+  void ProcessTimestamps( int numberOfTimestamps, const double* times, const double* matrices, std::string role ) override;
+
+  bool HasPreviousPoint;
+  double PreviousPoint[ 3 ];
+  double PathLength;
+
+private:
+  vtkPerkEvaluatorPathLengthMetric( const vtkPerkEvaluatorPathLengthMetric& ); // Not implemented
+  void operator=( const vtkPerkEvaluatorPathLengthMetric& ); // Not implemented
+
+};
+
+#endif
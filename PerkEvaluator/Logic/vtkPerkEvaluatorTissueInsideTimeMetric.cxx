@@ -0,0 +1,119 @@
+
+#include "vtkPerkEvaluatorTissueInsideTimeMetric.h"
+
+// MRML includes
+#include "vtkMRMLModelNode.h"
+
+vtkStandardNewMacro( vtkPerkEvaluatorTissueInsideTimeMetric );
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkPerkEvaluatorTissueInsideTimeMetric
+::vtkPerkEvaluatorTissueInsideTimeMetric()
+{
+  this->TissuePolyData = NULL;
+  this->TissueEnclosedPoints = NULL;
+
+  this->HasPreviousTime = false;
+  this->PreviousTime = 0.0;
+  this->InsideTime = 0.0;
+}
+
+
+vtkPerkEvaluatorTissueInsideTimeMetric
+::~vtkPerkEvaluatorTissueInsideTimeMetric()
+{
+  if ( this->TissueEnclosedPoints != NULL )
+  {
+    this->TissueEnclosedPoints->Complete();
+  }
+}
+
+
+// Roles ---------------------------------------------------------------------------------------------
+
+std::vector< std::string > vtkPerkEvaluatorTissueInsideTimeMetric
+::GetTransformRoles()
+{
+  std::vector< std::string > transformRoles;
+  transformRoles.push_back( "Needle" );
+  return transformRoles;
+}
+
+
+std::vector< std::string > vtkPerkEvaluatorTissueInsideTimeMetric
+::GetAnatomyRoles()
+{
+  std::vector< std::string > anatomyRoles;
+  anatomyRoles.push_back( "Tissue" );
+  return anatomyRoles;
+}
+
+
+std::string vtkPerkEvaluatorTissueInsideTimeMetric
+::GetAnatomyRoleClassName( std::string role )
+{
+  if ( role.compare( "Tissue" ) == 0 )
+  {
+    return "vtkMRMLModelNode";
+  }
+  return "";
+}
+
+
+bool vtkPerkEvaluatorTissueInsideTimeMetric
+::SetAnatomy( std::string role, vtkMRMLNode* node )
+{
+  vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast( node );
+  if ( role.compare( "Tissue" ) != 0 || modelNode == NULL || modelNode->GetPolyData() == NULL )
+  {
+    return false;
+  }
+
+  // Keep a private copy of the surface, so the scene can change while the metric is computed
+  this->TissuePolyData = vtkSmartPointer< vtkPolyData >::New();
+  this->TissuePolyData->DeepCopy( modelNode->GetPolyData() );
+
+  if ( this->TissueEnclosedPoints != NULL )
+  {
+    this->TissueEnclosedPoints->Complete();
+  }
+  this->TissueEnclosedPoints = vtkSmartPointer< vtkSelectEnclosedPoints >::New();
+  this->TissueEnclosedPoints->Initialize( this->TissuePolyData );
+
+  return true;
+}
+
+
+// Computation ---------------------------------------------------------------------------------------
+
+void vtkPerkEvaluatorTissueInsideTimeMetric
+::ProcessTimestamps( int numberOfTimestamps, const double* times, const double* matrices, std::string vtkNotUsed( role ) )
+{
+  if ( this->TissueEnclosedPoints == NULL )
+  {
+    return;
+  }
+
+  for ( int i = 0; i < numberOfTimestamps; i++ )
+  {
+    const double* matrix = matrices + 16 * i;
+    double point[ 3 ] = { matrix[ 3 ], matrix[ 7 ], matrix[ 11 ] };
+
+    if ( this->HasPreviousTime && this->TissueEnclosedPoints->IsInsideSurface( point ) )
+    {
+      this->InsideTime += times[ i ] - this->PreviousTime;
+    }
+
+    this->PreviousTime = times[ i ];
+    this->HasPreviousTime = true;
+  }
+}
+
+
+double vtkPerkEvaluatorTissueInsideTimeMetric
+::GetMetric()
+{
+  return this->InsideTime;
+}
@@ -0,0 +1,69 @@
+#ifndef __vtkPerkEvaluatorTissueInsideTimeMetric_h
+#define __vtkPerkEvaluatorTissueInsideTimeMetric_h
+
+// Standard includes
+#include <string>
+#include <vector>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+#include "vtkPolyData.h"
+#include "vtkSelectEnclosedPoints.h"
+#include "vtkSmartPointer.h"
+
+// PerkEvaluator includes
+#include "vtkSlicerPerkEvaluatorModuleLogicExport.h"
+#include "vtkPerkEvaluatorMetric.h"
+
+
+// Time the needle spends inside the tissue model
+// The time between two timestamps counts if the needle is inside at the later one
+class VTK_SLICER_PERKEVALUATOR_MODULE_LOGIC_EXPORT
+vtkPerkEvaluatorTissueInsideTimeMetric : public vtkPerkEvaluatorMetric
+{
+public:
+  vtkTypeMacro( vtkPerkEvaluatorTissueInsideTimeMetric, vtkPerkEvaluatorMetric );
+
+  // Standard VTK methods
+  static vtkPerkEvaluatorTissueInsideTimeMetric* New();
+
+protected:
+
+  // Constructor/destructor
+  vtkPerkEvaluatorTissueInsideTimeMetric();
+  virtual ~vtkPerkEvaluatorTissueInsideTimeMetric();
+
+public:
+
+  std::string GetMetricName() override { return "Tissue Inside Time"; };
+  std::string GetMetricUnit() override { return "s"; };
+  bool IsShared() override { return true; };
+  std::vector< std::string > GetTransformRoles() override;
+  std::vector< std::string > GetAnatomyRoles() override;
+  std::string GetAnatomyRoleClassName( std::string role ) override;
+
+  // The tissue surface is copied, so metrics can be computed on different threads
+  bool SetAnatomy( std::string role, vtkMRMLNode* node ) override;
+
+  double GetMetric() override;
+
+protected:
+
+  void ProcessTimestamps( int numberOfTimestamps, const double* times, const double* matrices, std::string role ) override;
+
+  vtkSmartPointer< vtkPolyData > TissuePolyData;
+  vtkSmartPointer< vtkSelectEnclosedPoints > TissueEnclosedPoints;
+
+  bool HasPreviousTime;
+  double PreviousTime;
+  double InsideTime;
+
+private:
+  vtkPerkEvaluatorTissueInsideTimeMetric( const vtkPerkEvaluatorTissueInsideTimeMetric& ); // Not implemented
+  void operator=( const vtkPerkEvaluatorTissueInsideTimeMetric& ); // Not implemented
+
+};
+
+#endif
@@ -0,0 +1,106 @@
+
+#include "vtkPerkEvaluatorVelocityMetric.h"
+
+// VTK includes
+#include "vtkMath.h"
+
+vtkStandardNewMacro( vtkPerkEvaluatorVelocityMetric );
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkPerkEvaluatorVelocityMetric
+::vtkPerkEvaluatorVelocityMetric()
+{
+  this->Statistic = vtkPerkEvaluatorVelocityMetric::AVERAGE_VELOCITY;
+
+  this->HasPreviousTimestamp = false;
+  this->PreviousTime = 0.0;
+  this->PreviousPoint[ 0 ] = 0.0;
+  this->PreviousPoint[ 1 ] = 0.0;
+  this->PreviousPoint[ 2 ] = 0.0;
+
+  this->NumberOfVelocities = 0;
+  this->MeanVelocity = 0.0;
+  this->SumSquaredDeviations = 0.0;
+  this->MaximumVelocity = 0.0;
+}
+
+
+vtkPerkEvaluatorVelocityMetric
+::~vtkPerkEvaluatorVelocityMetric()
+{
+}
+
+
+// Description ---------------------------------------------------------------------------------------
+
+std::string vtkPerkEvaluatorVelocityMetric
+::GetMetricName()
+{
+  if ( this->Statistic == vtkPerkEvaluatorVelocityMetric::MAXIMUM_VELOCITY )
+  {
+    return "Maximum Velocity";
+  }
+  if ( this->Statistic == vtkPerkEvaluatorVelocityMetric::VELOCITY_STANDARD_DEVIATION )
+  {
+    return "Velocity Standard Deviation";
+  }
+  return "Average Velocity";
+}
+
+
+// Computation ---------------------------------------------------------------------------------------
+
+void vtkPerkEvaluatorVelocityMetric
+::ProcessTimestamps( int numberOfTimestamps, const double* times, const double* matrices, std::string vtkNotUsed( role ) )
+{
+  for ( int i = 0; i < numberOfTimestamps; i++ )
+  {
+    const double* matrix = matrices + 16 * i;
+    double point[ 3 ] = { matrix[ 3 ], matrix[ 7 ], matrix[ 11 ] };
+
+    double elapsedTime = times[ i ] - this->PreviousTime;
+    if ( this->HasPreviousTimestamp && elapsedTime <= 0 )
+    {
+      continue; // Keep the earlier timestamp, so its displacement is not lost
+    }
+
+    if ( this->HasPreviousTimestamp )
+    {
+      double velocity = std::sqrt( vtkMath::Distance2BetweenPoints( point, this->PreviousPoint ) ) / elapsedTime;
+
+      this->NumberOfVelocities++;
+      double deviation = velocity - this->MeanVelocity;
+      this->MeanVelocity += deviation / this->NumberOfVelocities;
+      this->SumSquaredDeviations += deviation * ( velocity - this->MeanVelocity );
+      this->MaximumVelocity = std::max( this->MaximumVelocity, velocity );
+    }
+
+    this->PreviousTime = times[ i ];
+    this->PreviousPoint[ 0 ] = point[ 0 ];
+    this->PreviousPoint[ 1 ] = point[ 1 ];
+    this->PreviousPoint[ 2 ] = point[ 2 ];
+    this->HasPreviousTimestamp = true;
+  }
+}
+
+
+double vtkPerkEvaluatorVelocityMetric
+::GetMetric()
+{
+  if ( this->NumberOfVelocities == 0 )
+  {
+    return 0.0;
+  }
+
+  if ( this->Statistic == vtkPerkEvaluatorVelocityMetric::MAXIMUM_VELOCITY )
+  {
+    return this->MaximumVelocity;
+  }
+  if ( this->Statistic == vtkPerkEvaluatorVelocityMetric::VELOCITY_STANDARD_DEVIATION )
+  {
+    return std::sqrt( this->SumSquaredDeviations / this->NumberOfVelocities );
+  }
+  return this->MeanVelocity;
+}
@@ -0,0 +1,75 @@
+#ifndef __vtkPerkEvaluatorVelocityMetric_h
+#define __vtkPerkEvaluatorVelocityMetric_h
+
+// Standard includes
+#include <cmath>
+#include <string>
+#include <vector>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+
+// PerkEvaluator includes
+#include "vtkSlicerPerkEvaluatorModuleLogicExport.h"
+#include "vtkPerkEvaluatorMetric.h"
+
+
+// Statistics of the speed of the transform's origin between consecutive timestamps
+// Timestamps with no time elapsed since the previous one are skipped
+class VTK_SLICER_PERKEVALUATOR_MODULE_LOGIC_EXPORT
+vtkPerkEvaluatorVelocityMetric : public vtkPerkEvaluatorMetric
+{
+public:
+  vtkTypeMacro( vtkPerkEvaluatorVelocityMetric, vtkPerkEvaluatorMetric );
+
+  // Standard VTK methods
+  static vtkPerkEvaluatorVelocityMetric* New();
+
+protected:
+
+  // Constructor/destructor
+  vtkPerkEvaluatorVelocityMetric();
+  virtual ~vtkPerkEvaluatorVelocityMetric();
+
+public:
+
+  enum VelocityStatistic
+  {
+    AVERAGE_VELOCITY,
+    MAXIMUM_VELOCITY,
+    VELOCITY_STANDARD_DEVIATION,
+  };
+  vtkGetMacro( Statistic, int );
+  vtkSetMacro( Statistic, int );
+
+  std::string GetMetricName() override;
+  std::string GetMetricUnit() override { return "mm/s"; };
+  bool IsShared() override { return true; };
+
+  double GetMetric() override;
+
+protected:
+
+  void ProcessTimestamps( int numberOfTimestamps, const double* times, const double* matrices, std::string role ) override;
+
+  int Statistic;
+
+  bool HasPreviousTimestamp;
+  double PreviousTime;
+  double PreviousPoint[ 3 ];
+
+  // Running statistics of the speeds (Welford's method)
+  int NumberOfVelocities;
+  double MeanVelocity;
+  double SumSquaredDeviations;
+  double MaximumVelocity;
+
+private:
+  vtkPerkEvaluatorVelocityMetric( const vtkPerkEvaluatorVelocityMetric& ); // Not implemented
+  void operator=( const vtkPerkEvaluatorVelocityMetric& ); // Not implemented
+
+};
+
+#endif
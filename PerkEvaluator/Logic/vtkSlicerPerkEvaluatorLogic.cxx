@@ -1,6 +1,7 @@
 
 // PerkEvaluator Logic includes
 #include "vtkSlicerPerkEvaluatorLogic.h"
+#include "vtkPerkEvaluatorMetric.h"
 
 // MRML includes
 #include "vtkMRMLLinearTransformNode.h"
@@ -19,16 +20,20 @@
 #include <vtkPolyData.h>
 #include <vtkSelectEnclosedPoints.h>
 #include <vtkSmartPointer.h>
+#include <vtkSMPTools.h>
 #include <vtkTable.h>
 #include <vtkCollection.h>
 #include <vtkCollectionIterator.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <ctime>
 #include <iostream>
 #include <limits>
 #include <sstream>
+#include <vector>
 
 
 
@@ -57,11 +62,81 @@ std::vector< std::string > QVariantToVector( QVariant variant )
 }
 
 
+// Helper for computing native metrics in parallel
+// Each metric only gets its own jobs, so the metrics do not share anything
+class vtkPerkEvaluatorNativeMetricsFunctor
+{
+public:
+  std::vector< vtkPerkEvaluatorMetric* >* Metrics;
+  std::vector< std::vector< int > >* MetricJobs;
+  vtkStringArray* Roles;
+  vtkCollection* ToWorldMatrices;
+  vtkIntArray* Ranges;
+  vtkDoubleArray* Times;
+
+  void operator()( vtkIdType begin, vtkIdType end )
+  {
+    for ( vtkIdType i = begin; i < end; i++ )
+    {
+      this->AddMergedTimestamps( this->Metrics->at( i ), this->MetricJobs->at( i ) );
+    }
+  }
+
+  // Merge the metric's jobs by timestamp, so a metric with several transforms gets their frames interleaved (like replaying the frames one by one)
+  // All of the jobs index into the same (increasing) times, so this merges on the index; at the same index, the jobs go in order
+  // Each job gets its frames in runs, up to where another job's next frame must go first
+  void AddMergedTimestamps( vtkPerkEvaluatorMetric* metric, const std::vector< int >& jobs )
+  {
+    std::vector< vtkDoubleArray* > jobMatrices( jobs.size(), NULL );
+    std::vector< int > nextFrames( jobs.size(), 0 );
+    std::vector< int > lastFrames( jobs.size(), 0 );
+    for ( int j = 0; j < jobs.size(); j++ )
+    {
+      jobMatrices[ j ] = vtkDoubleArray::SafeDownCast( this->ToWorldMatrices->GetItemAsObject( jobs.at( j ) ) );
+      nextFrames[ j ] = std::max( int( this->Ranges->GetComponent( jobs.at( j ), 0 ) ), 0 );
+      lastFrames[ j ] = std::min( int( this->Ranges->GetComponent( jobs.at( j ), 1 ) ), int( std::min( this->Times->GetNumberOfTuples(), jobMatrices[ j ]->GetNumberOfTuples() ) ) );
+    }
+
+    while ( true )
+    {
+      int currJob = -1;
+      for ( int j = 0; j < jobs.size(); j++ )
+      {
+        if ( nextFrames[ j ] < lastFrames[ j ] && ( currJob < 0 || nextFrames[ j ] < nextFrames[ currJob ] ) )
+        {
+          currJob = j;
+        }
+      }
+      if ( currJob < 0 )
+      {
+        break;
+      }
+
+      // Earlier jobs go first at their next frame, later jobs go after
+      int runEnd = lastFrames[ currJob ];
+      for ( int j = 0; j < jobs.size(); j++ )
+      {
+        if ( j == currJob || nextFrames[ j ] >= lastFrames[ j ] )
+        {
+          continue;
+        }
+        runEnd = std::min( runEnd, ( j < currJob ) ? nextFrames[ j ] : nextFrames[ j ] + 1 );
+      }
+
+      metric->AddTimestamps( this->Times, jobMatrices[ currJob ], this->Roles->GetValue( jobs.at( currJob ) ), nextFrames[ currJob ], runEnd );
+      nextFrames[ currJob ] = runEnd;
+    }
+  }
+};
+
+
 // Constructors and Desctructors ----------------------------------------------
 
 vtkSlicerPerkEvaluatorLogic
 ::vtkSlicerPerkEvaluatorLogic()
 {
+  this->RelevantTransformNodes = vtkSmartPointer< vtkCollection >::New();
+  this->RelevantTransformNodesValid = false;
 }
 
 
@@ -88,6 +163,7 @@ void vtkSlicerPerkEvaluatorLogic
 void vtkSlicerPerkEvaluatorLogic
 ::OnMRMLSceneEndClose()
 {
+  this->RelevantTransformNodesValid = false;
 }
 
 
@@ -170,6 +246,9 @@ void vtkSlicerPerkEvaluatorLogic
     return;
   }
 
+  // Find the relevant transforms afresh for each analysis
+  this->RelevantTransformNodesValid = false;
+
   // Use the python metrics calculator module
   this->PythonManager->executeString( QString( "PythonMetricsCalculator.PythonMetricsCalculatorLogic.CalculateAllMetrics( '%1' )" ).arg( peNode->GetID() ) );
 
@@ -222,6 +301,9 @@ void vtkSlicerPerkEvaluatorLogic
     return;
   }
 
+  // Find the relevant transforms afresh for each real-time session
+  this->RelevantTransformNodesValid = false;
+
   // Use the python metrics calculator module
   this->PythonManager->executeString( "PythonMetricsCalculatorLogicRealTimeInstance = PythonMetricsCalculator.PythonMetricsCalculatorLogic()" );
   this->PythonManager->executeString( QString( "PythonMetricsCalculatorLogicRealTimeInstance.SetupRealTimeMetricComputation( '%1' )" ).arg( peNode->GetID() ) );
@@ -489,6 +571,30 @@ void vtkSlicerPerkEvaluatorLogic
     return;
   }
 
+  // Use the cached transforms if the hierarchy has not changed since they were found
+  std::vector< vtkMRMLNode* > currProxyNodes;
+  for ( int i = 0; i < proxyNodes->GetNumberOfItems(); i++ )
+  {
+    currProxyNodes.push_back( vtkMRMLNode::SafeDownCast( proxyNodes->GetItemAsObject( i ) ) );
+  }
+  if ( ! this->RelevantTransformNodesValid || currProxyNodes != this->RelevantTransformProxyNodes )
+  {
+    this->RelevantTransformNodes->RemoveAllItems();
+    this->FindProxyRelevantTransformNodes( proxyNodes, this->RelevantTransformNodes );
+    this->RelevantTransformProxyNodes = currProxyNodes;
+    this->RelevantTransformNodesValid = true;
+  }
+
+  for ( int i = 0; i < this->RelevantTransformNodes->GetNumberOfItems(); i++ )
+  {
+    relevantTransformNodes->AddItem( this->RelevantTransformNodes->GetItemAsObject( i ) );
+  }
+}
+
+
+void vtkSlicerPerkEvaluatorLogic
+::FindProxyRelevantTransformNodes( vtkCollection* proxyNodes, vtkCollection* relevantTransformNodes )
+{
   // Get all transform nodes which are a proxy node or a child of a proxy node
   vtkSmartPointer< vtkCollection > sceneTransformNodes = vtkSmartPointer<vtkCollection>::Take(this->GetMRMLScene()->GetNodesByClass( "vtkMRMLLinearTransformNode" ));
   vtkNew< vtkCollectionIterator > sceneTransformNodesIt;
@@ -522,6 +628,235 @@ void vtkSlicerPerkEvaluatorLogic
 }
 
 
+// The transforms from a relevant transform up to world
+// Recorded transforms are read from their sequence at each frame; any other transform is fixed for the whole replay
+struct vtkPerkEvaluatorReplayLink
+{
+  int RecordedIndex; // Index into the recorded sequences (-1 if not recorded)
+  double FixedMatrix[ 16 ];
+};
+
+
+// This reads the data nodes the same way the sequence browser would (closest index value), but never sets the selected item
+void vtkSlicerPerkEvaluatorLogic
+::ReplayTransformsToWorld( vtkMRMLSequenceBrowserNode* sequenceBrowser, double beginTime, double endTime, vtkDoubleArray* times, vtkCollection* relevantTransformNodes, vtkCollection* toWorldMatrices )
+{
+  if ( sequenceBrowser == NULL || times == NULL || relevantTransformNodes == NULL || toWorldMatrices == NULL )
+  {
+    return;
+  }
+  times->Initialize();
+  times->SetNumberOfComponents( 1 );
+  relevantTransformNodes->RemoveAllItems();
+  toWorldMatrices->RemoveAllItems();
+
+  vtkMRMLSequenceNode* masterSequenceNode = sequenceBrowser->GetMasterSequenceNode();
+  if ( masterSequenceNode == NULL )
+  {
+    return;
+  }
+
+  this->GetProxyRelevantTransformNodes( sequenceBrowser, relevantTransformNodes );
+
+  // Work out the chain for each relevant transform once (the hierarchy does not change during the replay)
+  std::vector< vtkMRMLSequenceNode* > recordedSequenceNodes;
+  std::vector< std::vector< vtkPerkEvaluatorReplayLink > > chains( relevantTransformNodes->GetNumberOfItems() );
+  vtkNew< vtkMatrix4x4 > matrix;
+  for ( int i = 0; i < relevantTransformNodes->GetNumberOfItems(); i++ )
+  {
+    vtkMRMLTransformNode* currTransformNode = vtkMRMLTransformNode::SafeDownCast( relevantTransformNodes->GetItemAsObject( i ) );
+    while ( currTransformNode != NULL )
+    {
+      vtkPerkEvaluatorReplayLink currLink;
+      currLink.RecordedIndex = -1;
+      matrix->Identity();
+      currTransformNode->GetMatrixTransformToParent( matrix.GetPointer() );
+      vtkMatrix4x4::DeepCopy( currLink.FixedMatrix, matrix.GetPointer() );
+
+      vtkMRMLSequenceNode* currSequenceNode = sequenceBrowser->GetSequenceNode( currTransformNode );
+      if ( currSequenceNode != NULL && sequenceBrowser->GetPlayback( currSequenceNode ) )
+      {
+        currLink.RecordedIndex = std::find( recordedSequenceNodes.begin(), recordedSequenceNodes.end(), currSequenceNode ) - recordedSequenceNodes.begin();
+        if ( currLink.RecordedIndex == recordedSequenceNodes.size() )
+        {
+          recordedSequenceNodes.push_back( currSequenceNode );
+        }
+      }
+
+      chains.at( i ).push_back( currLink );
+      currTransformNode = currTransformNode->GetParentTransformNode();
+    }
+
+    vtkSmartPointer< vtkDoubleArray > currToWorldMatrices = vtkSmartPointer< vtkDoubleArray >::New();
+    currToWorldMatrices->SetNumberOfComponents( 16 );
+    toWorldMatrices->AddItem( currToWorldMatrices );
+  }
+
+  // Matrices to parent of the recorded transforms at the current frame
+  std::vector< double > recordedMatrices( 16 * recordedSequenceNodes.size(), 0.0 );
+  double toWorldMatrix[ 16 ];
+  for ( int i = 0; i < masterSequenceNode->GetNumberOfDataNodes(); i++ )
+  {
+    std::string indexValue = masterSequenceNode->GetNthIndexValue( i );
+    std::stringstream timeStream( indexValue );
+    double time = 0.0;
+    if ( ! ( timeStream >> time ) )
+    {
+      vtkWarningMacro( "vtkSlicerPerkEvaluatorLogic::ReplayTransformsToWorld: Index " << i << " has non-numeric index value." );
+      continue;
+    }
+    if ( time < beginTime || time > endTime )
+    {
+      continue;
+    }
+    times->InsertNextValue( time );
+
+    for ( int j = 0; j < recordedSequenceNodes.size(); j++ )
+    {
+      vtkMRMLSequenceNode* currSequenceNode = recordedSequenceNodes.at( j );
+      int itemNumber = ( currSequenceNode == masterSequenceNode ) ? i : currSequenceNode->GetItemNumberFromIndexValue( indexValue, false ); // Accept the closest numerical value
+      vtkMRMLTransformNode* currDataNode = ( itemNumber < 0 ) ? NULL : vtkMRMLTransformNode::SafeDownCast( currSequenceNode->GetNthDataNode( itemNumber ) );
+      matrix->Identity();
+      if ( currDataNode != NULL )
+      {
+        currDataNode->GetMatrixTransformToParent( matrix.GetPointer() );
+      }
+      vtkMatrix4x4::DeepCopy( &recordedMatrices[ 16 * j ], matrix.GetPointer() );
+    }
+
+    // Compose up the chain (each parent is applied after its child)
+    for ( int j = 0; j < chains.size(); j++ )
+    {
+      vtkMatrix4x4::Identity( toWorldMatrix );
+      for ( int k = 0; k < chains.at( j ).size(); k++ )
+      {
+        const vtkPerkEvaluatorReplayLink& currLink = chains.at( j ).at( k );
+        const double* currMatrix = ( currLink.RecordedIndex < 0 ) ? currLink.FixedMatrix : &recordedMatrices[ 16 * currLink.RecordedIndex ];
+        vtkMatrix4x4::Multiply4x4( currMatrix, toWorldMatrix, toWorldMatrix );
+      }
+      vtkDoubleArray::SafeDownCast( toWorldMatrices->GetItemAsObject( j ) )->InsertNextTuple( toWorldMatrix );
+    }
+  }
+}
+
+
+// The message sequence is only found once, and the times are walked with one cursor through the messages
+void vtkSlicerPerkEvaluatorLogic
+::GetTaskIntervals( vtkMRMLSequenceBrowserNode* sequenceBrowser, vtkDoubleArray* times, vtkStringArray* taskNames, vtkIntArray* taskIntervals )
+{
+  if ( sequenceBrowser == NULL || times == NULL || taskNames == NULL || taskIntervals == NULL )
+  {
+    return;
+  }
+  taskNames->Initialize();
+  taskIntervals->Initialize();
+  taskIntervals->SetNumberOfComponents( 2 );
+
+  vtkSlicerTransformRecorderLogic* trLogic = vtkSlicerTransformRecorderLogic::SafeDownCast( vtkSlicerTransformRecorderLogic::GetSlicerModuleLogic( "TransformRecorder" ) );
+  if ( trLogic == NULL )
+  {
+    return;
+  }
+  vtkMRMLSequenceNode* messageSequenceNode = trLogic->GetMessageSequenceNode( sequenceBrowser );
+  if ( messageSequenceNode == NULL || messageSequenceNode->GetNumberOfDataNodes() == 0 )
+  {
+    return;
+  }
+
+  std::vector< double > messageTimes( messageSequenceNode->GetNumberOfDataNodes(), 0.0 );
+  for ( int i = 0; i < messageSequenceNode->GetNumberOfDataNodes(); i++ )
+  {
+    messageTimes.at( i ) = atof( messageSequenceNode->GetNthIndexValue( i ).c_str() );
+  }
+
+  // Like the prior message, each time goes with the closest message (the earlier one if it is a tie)
+  int currMessage = -1;
+  int currInterval[ 2 ] = { 0, 0 };
+  for ( int i = 0; i < times->GetNumberOfTuples(); i++ )
+  {
+    double time = times->GetValue( i );
+    int nextMessage = ( time < messageTimes.at( 0 ) ) ? -1 : std::max( currMessage, 0 );
+    while ( nextMessage >= 0 && nextMessage + 1 < messageTimes.size()
+      && std::abs( time - messageTimes.at( nextMessage + 1 ) ) < std::abs( time - messageTimes.at( nextMessage ) ) )
+    {
+      nextMessage++;
+    }
+
+    if ( nextMessage != currMessage )
+    {
+      if ( currMessage >= 0 )
+      {
+        currInterval[ 1 ] = i;
+        taskIntervals->InsertNextTypedTuple( currInterval );
+      }
+      currMessage = nextMessage;
+      if ( currMessage >= 0 )
+      {
+        vtkMRMLNode* messageNode = messageSequenceNode->GetNthDataNode( currMessage );
+        const char* messageString = ( messageNode != NULL ) ? messageNode->GetAttribute( "Message" ) : NULL;
+        taskNames->InsertNextValue( ( messageString != NULL ) ? messageString : "" );
+        currInterval[ 0 ] = i;
+      }
+    }
+  }
+  if ( currMessage >= 0 )
+  {
+    currInterval[ 1 ] = times->GetNumberOfTuples();
+    taskIntervals->InsertNextTypedTuple( currInterval );
+  }
+}
+
+
+void vtkSlicerPerkEvaluatorLogic
+::ComputeNativeMetrics( vtkCollection* metrics, vtkStringArray* roles, vtkCollection* toWorldMatrices, vtkIntArray* ranges, vtkDoubleArray* times )
+{
+  if ( metrics == NULL || roles == NULL || toWorldMatrices == NULL || ranges == NULL || times == NULL )
+  {
+    return;
+  }
+  int numberOfJobs = metrics->GetNumberOfItems();
+  if ( roles->GetNumberOfValues() < numberOfJobs || toWorldMatrices->GetNumberOfItems() < numberOfJobs
+    || ranges->GetNumberOfComponents() != 2 || ranges->GetNumberOfTuples() < numberOfJobs )
+  {
+    vtkWarningMacro( "vtkSlicerPerkEvaluatorLogic::ComputeNativeMetrics: Every metric needs a role, matrices, and a range." );
+    return;
+  }
+
+  // Group the jobs by metric (keeping their order), so no metric is used by two threads
+  std::vector< vtkPerkEvaluatorMetric* > distinctMetrics;
+  std::vector< std::vector< int > > metricJobs;
+  for ( int i = 0; i < numberOfJobs; i++ )
+  {
+    vtkPerkEvaluatorMetric* currMetric = vtkPerkEvaluatorMetric::SafeDownCast( metrics->GetItemAsObject( i ) );
+    if ( currMetric == NULL || vtkDoubleArray::SafeDownCast( toWorldMatrices->GetItemAsObject( i ) ) == NULL )
+    {
+      continue;
+    }
+
+    std::vector< vtkPerkEvaluatorMetric* >::iterator metricItr = std::find( distinctMetrics.begin(), distinctMetrics.end(), currMetric );
+    if ( metricItr == distinctMetrics.end() )
+    {
+      distinctMetrics.push_back( currMetric );
+      metricJobs.push_back( std::vector< int >() );
+      metricJobs.back().push_back( i );
+    }
+    else
+    {
+      metricJobs.at( metricItr - distinctMetrics.begin() ).push_back( i );
+    }
+  }
+
+  vtkPerkEvaluatorNativeMetricsFunctor nativeMetricsFunctor;
+  nativeMetricsFunctor.Metrics = &distinctMetrics;
+  nativeMetricsFunctor.MetricJobs = &metricJobs;
+  nativeMetricsFunctor.Roles = roles;
+  nativeMetricsFunctor.ToWorldMatrices = toWorldMatrices;
+  nativeMetricsFunctor.Ranges = ranges;
+  nativeMetricsFunctor.Times = times;
+  vtkSMPTools::For( 0, distinctMetrics.size(), 1, nativeMetricsFunctor );
+}
+
+
 std::string vtkSlicerPerkEvaluatorLogic
 ::GetMetricName( std::string msNodeID )
 {
@@ -638,6 +973,14 @@ void vtkSlicerPerkEvaluatorLogic
 }
 
 
+void vtkSlicerPerkEvaluatorLogic
+::AddNativeMetrics()
+{
+  // The native metrics are created by name from the metric factory, and are wrapped in metric scripts by the python metrics calculator
+  this->PythonManager->executeString( QString( "PythonMetricsCalculator.PythonMetricsCalculatorLogic.AddNativeMetricsToScene()" ) );
+}
+
+
 void vtkSlicerPerkEvaluatorLogic
 ::UpdateSceneToPlaybackTime( vtkMRMLPerkEvaluatorNode* peNode, double playbackTime )
 {
@@ -701,6 +1044,13 @@ void vtkSlicerPerkEvaluatorLogic
     this->SetupRealTimeProcessing( peNode );
   }
 
+  // The transform hierarchy may have changed
+  if ( vtkMRMLTransformNode::SafeDownCast( caller ) != NULL
+    && ( event == vtkMRMLNode::ReferenceAddedEvent || event == vtkMRMLNode::ReferenceModifiedEvent || event == vtkMRMLNode::ReferenceRemovedEvent ) )
+  {
+    this->RelevantTransformNodesValid = false;
+  }
+
   // Handle an event in the real-time processing
   if ( peNode != NULL && peNode->GetRealTimeProcessing() && event == vtkMRMLPerkEvaluatorNode::TransformRealTimeAddedEvent )
   {
@@ -737,6 +1087,20 @@ void vtkSlicerPerkEvaluatorLogic
     peNode->AddObserver( vtkMRMLPerkEvaluatorNode::RealTimeProcessingStartedEvent, ( vtkCommand* ) this->GetMRMLNodesCallbackCommand() );
   }
 
+  // Any change to the scene might change which transforms are relevant
+  if ( event == vtkMRMLScene::NodeAddedEvent || event == vtkMRMLScene::NodeRemovedEvent )
+  {
+    this->RelevantTransformNodesValid = false;
+  }
+  // Observe if a transform is reparented
+  vtkMRMLTransformNode* addedTransformNode = vtkMRMLTransformNode::SafeDownCast( addedNode );
+  if ( event == vtkMRMLScene::NodeAddedEvent && addedTransformNode != NULL )
+  {
+    addedTransformNode->AddObserver( vtkMRMLNode::ReferenceAddedEvent, ( vtkCommand* ) this->GetMRMLNodesCallbackCommand() );
+    addedTransformNode->AddObserver( vtkMRMLNode::ReferenceModifiedEvent, ( vtkCommand* ) this->GetMRMLNodesCallbackCommand() );
+    addedTransformNode->AddObserver( vtkMRMLNode::ReferenceRemovedEvent, ( vtkCommand* ) this->GetMRMLNodesCallbackCommand() );
+  }
+
   // If a scene is being imported, ignore everything below (because the references should already be set in the scene)
   if ( this->GetMRMLScene() != NULL && this->GetMRMLScene()->IsImporting() )
   {
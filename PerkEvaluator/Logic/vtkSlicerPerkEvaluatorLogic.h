@@ -32,6 +32,8 @@
 #include "vtkSmartPointer.h"
 #include "vtkXMLDataParser.h"
 #include "vtkDoubleArray.h"
+#include "vtkIntArray.h"
+#include "vtkStringArray.h"
 
 #include "vtkSlicerPerkEvaluatorModuleLogicExport.h"
 #include "vtkSlicerTransformRecorderLogic.h"
@@ -63,6 +65,15 @@ protected:
 
   qSlicerPythonManager* PythonManager;
 
+  // Scan the scene for the transforms which are a proxy node or a child of a proxy node
+  void FindProxyRelevantTransformNodes( vtkCollection* proxyNodes, vtkCollection* relevantTransformNodes );
+
+  // The relevant transforms only change with the transform hierarchy, so they are cached for the proxy nodes they were found for
+  // The cache is cleared whenever a node is added to or removed from the scene, or a transform's references change (eg. reparenting)
+  std::vector< vtkMRMLNode* > RelevantTransformProxyNodes;
+  vtkSmartPointer< vtkCollection > RelevantTransformNodes;
+  bool RelevantTransformNodesValid;
+
 public:
 
   std::string GetMetricName( std::string msNodeID );
@@ -75,9 +86,21 @@ public:
 
   void DownloadAdditionalMetrics();
   void RestoreDefaultMetrics();
+  void AddNativeMetrics(); // The native (C++) versions of the core metrics, which are computed in parallel
 
   void GetProxyRelevantTransformNodes( vtkMRMLSequenceBrowserNode* sequenceBrowser, vtkCollection* relevantTransformNodes );
-  void GetProxyRelevantTransformNodes( vtkCollection* proxyNodes, vtkCollection* relevantTransformNodes );
+  void GetProxyRelevantTransformNodes( vtkCollection* proxyNodes, vtkCollection* relevantTransformNodes ); // Cached, so this is cheap to call every frame
+
+  // Replay the tracked sequence without touching the scene (the proxy nodes are never updated)
+  // For each relevant transform, the to-world matrices at each frame between the begin and end times go in one 16-component (row-major) array
+  void ReplayTransformsToWorld( vtkMRMLSequenceBrowserNode* sequenceBrowser, double beginTime, double endTime, vtkDoubleArray* times, vtkCollection* relevantTransformNodes, vtkCollection* toWorldMatrices );
+  // Partition the replayed times into task intervals, once up front (each time belongs to the same message as the transform recorder's prior message)
+  // Each interval has a task name and a 2-component [ first, last ) range of indices into the times; times before the first message are in no interval
+  void GetTaskIntervals( vtkMRMLSequenceBrowserNode* sequenceBrowser, vtkDoubleArray* times, vtkStringArray* taskNames, vtkIntArray* taskIntervals );
+  // Feed the replayed timestamps to native metrics, with the metrics computed in parallel
+  // Each job is a metric (vtkPerkEvaluatorMetric), its transform role, the to-world matrices and a 2-component [ first, last ) range into the times
+  // A metric may appear in several jobs; it gets them on one thread, merged by timestamp (at the same timestamp, in job order)
+  void ComputeNativeMetrics( vtkCollection* metrics, vtkStringArray* roles, vtkCollection* toWorldMatrices, vtkIntArray* ranges, vtkDoubleArray* times );
 
   void UpdateSceneToPlaybackTime( vtkMRMLPerkEvaluatorNode* peNode, double playbackTime );
 
@@ -388,6 +388,16 @@ qSlicerPerkEvaluatorModuleWidget
 }
 
 
+void
+qSlicerPerkEvaluatorModuleWidget
+::OnAddNativeMetricsClicked()
+{
+  Q_D( qSlicerPerkEvaluatorModuleWidget );
+
+  d->logic()->AddNativeMetrics();
+}
+
+
 void qSlicerPerkEvaluatorModuleWidget
 ::OnMetricInstanceNodesChanged()
 {
@@ -576,6 +586,7 @@ qSlicerPerkEvaluatorModuleWidget
   connect( d->IgnoreIrrelevantTransformsCheckBox, SIGNAL( toggled( bool ) ), this, SLOT( OnIgnoreIrrelevantTransformsToggled() ) );
   connect( d->DownloadAdditionalMetricsButton, SIGNAL( clicked() ), this, SLOT( OnDownloadAdditionalMetricsClicked() ) );
   connect( d->RestoreDefaultMetricsButton, SIGNAL( clicked() ), this, SLOT( OnRestoreDefaultMetricsClicked() ) );
+  connect( d->AddNativeMetricsButton, SIGNAL( clicked() ), this, SLOT( OnAddNativeMetricsClicked() ) );
 
   this->updateWidgetFromMRMLNode();
 }
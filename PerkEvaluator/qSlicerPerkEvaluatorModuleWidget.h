@@ -54,6 +54,7 @@ public slots:
 
   void OnDownloadAdditionalMetricsClicked();
   void OnRestoreDefaultMetricsClicked();
+  void OnAddNativeMetricsClicked();
 
   void onTissueModelChanged( vtkMRMLNode* node );
   void onNeedleTransformChanged( vtkMRMLNode* node );
@@ -7,6 +7,7 @@ except ImportError:
 import unittest
 import logging
 import collections
+import inspect
 import vtk, qt, ctk, slicer
 from slicer.ScriptedLoadableModule import *
 
@@ -77,6 +78,7 @@ class PythonMetricsCalculatorLogic( ScriptedLoadableModuleLogic ):
    
   def __init__( self ):    
     self.realTimeMetrics = dict()
+    self.realTimeDispatchTable = dict()
     self.realTimeMetricsTable = None
     self.realTimeProxyNodeCollection = vtk.vtkCollection()
     
@@ -98,6 +100,29 @@ class PythonMetricsCalculatorLogic( ScriptedLoadableModuleLogic ):
     PythonMetricsCalculatorLogic.AddMetricsFromDirectoryToScene( coreMetricScriptDirectory )
 
       
+  # Native metrics are not added with the core metrics, since the core metric scripts already compute the same values
+  # They are added on request instead (see vtkSlicerPerkEvaluatorLogic::AddNativeMetrics)
+  @staticmethod
+  def AddNativeMetricsToScene():
+    if ( PythonMetricsCalculatorLogic.GetMRMLScene() == None ):
+      return
+
+    for nativeMetricName in slicer.vtkPerkEvaluatorMetricFactory.GetRegisteredMetricNames():
+      metricScriptNode = slicer.vtkMRMLMetricScriptNode()
+      metricScriptNode.SetName( nativeMetricName )
+      metricScriptNode.SetPythonSourceCode( PythonMetricsCalculatorLogic.GetNativeMetricSourceCode( nativeMetricName ) )
+      PythonMetricsCalculatorLogic.GetMRMLScene().AddNode( metricScriptNode )
+
+
+  # The script for a native metric just names the metric, so it is loaded like any other metric script
+  @staticmethod
+  def GetNativeMetricSourceCode( nativeMetricName ):
+    return ( "from PythonMetricsCalculator import NativePerkEvaluatorMetric\n"
+      + "\n"
+      + "class " + nativeMetricName.replace( " ", "" ) + "( NativePerkEvaluatorMetric ):\n"
+      + "  NativeMetricName = " + repr( nativeMetricName ) + "\n" )
+
+      
   @staticmethod
   def DownloadAdditionalMetrics():
     metricsDownloadDirectory = slicer.mrmlScene.GetCacheManager().GetRemoteCacheDirectory()
@@ -488,9 +513,6 @@ class PythonMetricsCalculatorLogic( ScriptedLoadableModuleLogic ):
     if ( masterSequenceNode.GetNumberOfDataNodes() == 0 ):
       return
       
-    proxyNodes = vtk.vtkCollection()
-    peNode.GetTrackedSequenceBrowserNode().GetAllProxyNodes( proxyNodes )
-
     # Overall metrics
     allMetrics = collections.OrderedDict()
     allMetrics[ PythonMetricsCalculatorLogic.METRIC_VALUE ] = PythonMetricsCalculatorLogic.GetFreshMetrics( peNodeID )
@@ -507,38 +529,73 @@ class PythonMetricsCalculatorLogic( ScriptedLoadableModuleLogic ):
         allMetrics[ messageString ] = PythonMetricsCalculatorLogic.GetFreshMetrics( peNodeID )
 
 
-    # Start at the beginning (but remember where we were)
-    originalItemNumber = peNode.GetTrackedSequenceBrowserNode().GetSelectedItemNumber()
-    
-    peNode.GetTrackedSequenceBrowserNode().SetSelectedItemNumber( 0 )
-    peNode.GetTrackedSequenceBrowserNode().Modified() # Force update the proxy nodes
+    # Replay all of the relevant transforms up front, without updating the proxy nodes (so the scene is never touched)
+    times = vtk.vtkDoubleArray()
+    relevantTransformNodes = vtk.vtkCollection()
+    toWorldMatrices = vtk.vtkCollection()
+    PythonMetricsCalculatorLogic.GetPerkEvaluatorLogic().ReplayTransformsToWorld( peNode.GetTrackedSequenceBrowserNode(), peNode.GetMarkBegin(), peNode.GetMarkEnd(), times, relevantTransformNodes, toWorldMatrices )
+
+    # Work out which metrics (and roles) each transform feeds once, rather than matching roles on every frame
+    allDispatchTables = collections.OrderedDict()
+    for taskName, taskMetrics in allMetrics.items():
+      dispatchTable = PythonMetricsCalculatorLogic.GetMetricsDispatchTable( taskMetrics )
+      allDispatchTables[ taskName ] = [ dispatchTable.get( relevantTransformNodes.GetItemAsObject( j ).GetID(), [] ) for j in range( relevantTransformNodes.GetNumberOfItems() ) ]
+
+    # Partition the timeline into task intervals up front, so the task of each frame does not need to be looked up
+    taskNames = vtk.vtkStringArray()
+    taskIntervals = vtk.vtkIntArray()
+    if ( peNode.GetComputeTaskSpecificMetrics() ):
+      PythonMetricsCalculatorLogic.GetPerkEvaluatorLogic().GetTaskIntervals( peNode.GetTrackedSequenceBrowserNode(), times, taskNames, taskIntervals )
+    currentInterval = 0
+
+    # Native metrics take all of their timestamps in batches, computed in parallel, so they are taken out of the per-frame dispatch
+    nativeMetrics = vtk.vtkCollection()
+    nativeRoles = vtk.vtkStringArray()
+    nativeMatrices = vtk.vtkCollection()
+    nativeRanges = vtk.vtkIntArray()
+    nativeRanges.SetNumberOfComponents( 2 )
+    for taskName, dispatchTable in allDispatchTables.items():
+      if ( taskName == PythonMetricsCalculatorLogic.METRIC_VALUE ):
+        taskRanges = [ ( 0, times.GetNumberOfTuples() ) ]
+      else:
+        taskRanges = [ ( int( taskIntervals.GetComponent( k, 0 ) ), int( taskIntervals.GetComponent( k, 1 ) ) ) for k in range( taskIntervals.GetNumberOfTuples() ) if taskNames.GetValue( k ) == taskName ]
+
+      for taskRange in taskRanges: # Each metric gets its batches in time order
+        for j in range( relevantTransformNodes.GetNumberOfItems() ):
+          for metric, role, acceptsRole in dispatchTable[ j ]:
+            if ( isinstance( metric, NativePerkEvaluatorMetric ) ):
+              nativeMetrics.AddItem( metric.NativeMetric )
+              nativeRoles.InsertNextValue( role )
+              nativeMatrices.AddItem( toWorldMatrices.GetItemAsObject( j ) )
+              nativeRanges.InsertNextTuple2( taskRange[ 0 ], taskRange[ 1 ] )
+
+      for j in range( relevantTransformNodes.GetNumberOfItems() ):
+        dispatchTable[ j ] = [ dispatchItem for dispatchItem in dispatchTable[ j ] if not isinstance( dispatchItem[ 0 ], NativePerkEvaluatorMetric ) ]
+
+    PythonMetricsCalculatorLogic.GetPerkEvaluatorLogic().ComputeNativeMetrics( nativeMetrics, nativeRoles, nativeMatrices, nativeRanges, times )
+
     peNode.SetAnalysisState( 0 )
   
-    for i in range( masterSequenceNode.GetNumberOfDataNodes() ):    
-      try:
-        time = float( masterSequenceNode.GetNthIndexValue( i ) )
-      except:
-        logging.warning( "PythonMetricsCalculatorLogic::CalculateAllMetrics: Index" + i + "has non-numeric index type." )
-        continue
-        
-      if ( time < peNode.GetMarkBegin() or time > peNode.GetMarkEnd() ):
-        continue
-        
-      # Update the scene so that all proxy nodes are at the appropriate frame
-      peNode.GetTrackedSequenceBrowserNode().SetSelectedItemNumber( i )
-      
-      # Overall metrics
-      PythonMetricsCalculatorLogic.UpdateProxyNodeMetrics( allMetrics[ PythonMetricsCalculatorLogic.METRIC_VALUE ], proxyNodes, time )
-      
+    # Feed the overall metrics and each interval's task metrics in one pass
+    for i in range( times.GetNumberOfTuples() ):
+      time = times.GetValue( i )
+
       # Task-specific metrics
-      # TODO
-      if ( peNode.GetComputeTaskSpecificMetrics() ):
-        if ( trLogic is not None ):
-          messageString = trLogic.GetPriorMessageString( peNode.GetTrackedSequenceBrowserNode(), str( time ) )
-          if ( messageString != "" ):
-            PythonMetricsCalculatorLogic.UpdateProxyNodeMetrics( allMetrics[ messageString ], proxyNodes, time )
-        else:
-          logging.warning( "PythonMetricsCalculatorLogic::CalculateAllMetrics: Cannot determine task at index value " + str( time ) + "." )
+      while ( currentInterval < taskIntervals.GetNumberOfTuples() and int( taskIntervals.GetComponent( currentInterval, 1 ) ) <= i ):
+        currentInterval += 1
+      taskDispatchTable = None
+      if ( currentInterval < taskIntervals.GetNumberOfTuples() and int( taskIntervals.GetComponent( currentInterval, 0 ) ) <= i ):
+        messageString = taskNames.GetValue( currentInterval )
+        if ( messageString != "" and messageString in allDispatchTables ):
+          taskDispatchTable = allDispatchTables[ messageString ]
+
+      for j in range( relevantTransformNodes.GetNumberOfItems() ):
+        matrix = vtk.vtkMatrix4x4()
+        matrix.DeepCopy( toWorldMatrices.GetItemAsObject( j ).GetTuple( i ) )
+      
+        PythonMetricsCalculatorLogic.DispatchTimestamp( allDispatchTables[ PythonMetricsCalculatorLogic.METRIC_VALUE ][ j ], matrix, time )
+        if ( taskDispatchTable is not None ):
+          PythonMetricsCalculatorLogic.DispatchTimestamp( taskDispatchTable[ j ], matrix, time )
       
       # Update the progress
       progressPercent = 100 * ( time - peNode.GetMarkBegin() ) / ( peNode.GetMarkEnd() - peNode.GetMarkBegin() )
@@ -551,12 +608,11 @@ class PythonMetricsCalculatorLogic( ScriptedLoadableModuleLogic ):
     if ( peNode.GetAnalysisState() >= 0 ): # If the user has not hit cancel
       PythonMetricsCalculatorLogic.OutputAllMetricsToMetricsTable( peNode.GetMetricsTableNode(), allMetrics )
       
-    peNode.GetTrackedSequenceBrowserNode().SetSelectedItemNumber( originalItemNumber ) # Scene automatically updated
     peNode.SetAnalysisState( 0 )
 
   
   @staticmethod  
-  def UpdateProxyNodeMetrics( taskMetrics, proxyNodes, time ):
+  def UpdateProxyNodeMetrics( dispatchTable, proxyNodes, time ):
     if ( PythonMetricsCalculatorLogic.GetMRMLScene() == None or PythonMetricsCalculatorLogic.GetPerkEvaluatorLogic() == None ):
       return
     
@@ -567,30 +623,66 @@ class PythonMetricsCalculatorLogic( ScriptedLoadableModuleLogic ):
     # Update all metrics associated with children of the recorded transform
     for j in range( relevantTransformNodes.GetNumberOfItems() ):
       currentTransformNode = relevantTransformNodes.GetItemAsObject( j )
-      PythonMetricsCalculatorLogic.UpdateMetrics( taskMetrics, currentTransformNode, time )
+      PythonMetricsCalculatorLogic.UpdateMetrics( dispatchTable, currentTransformNode, time )
 
   
   @staticmethod  
-  def UpdateMetrics( taskMetrics, transformNode, time ):
-    if ( PythonMetricsCalculatorLogic.GetMRMLScene() == None ):
+  def UpdateMetrics( dispatchTable, transformNode, time ):
+    if ( transformNode.GetID() not in dispatchTable ):
       return
       
     # The assumption is that the scene is already appropriately updated
     matrix = vtk.vtkMatrix4x4()
     matrix.Identity()
     transformNode.GetMatrixTransformToWorld( matrix )
-    point = [ matrix.GetElement( 0, 3 ), matrix.GetElement( 1, 3 ), matrix.GetElement( 2, 3 ), matrix.GetElement( 3, 3 ) ]
-    
+    PythonMetricsCalculatorLogic.DispatchTimestamp( dispatchTable[ transformNode.GetID() ], matrix, time )
+
+
+  # Note: We are returning a dictionary from transform ID to the list of ( metric, role, accepts role ) that the transform feeds
+  @staticmethod
+  def GetMetricsDispatchTable( taskMetrics ):
+    if ( PythonMetricsCalculatorLogic.GetMRMLScene() == None ):
+      return dict()
+
+    dispatchTable = dict()
     for metricInstanceID in taskMetrics:
       metric = taskMetrics[ metricInstanceID ]
       metricInstanceNode = PythonMetricsCalculatorLogic.GetMRMLScene().GetNodeByID( metricInstanceID )
+      if ( metricInstanceNode is None ):
+        continue
       
+      acceptsRole = PythonMetricsCalculatorLogic.AddTimestampAcceptsRole( metric )
       for role in PythonMetricsCalculatorLogic.GetTransformRoles( metric ):
-        if ( metricInstanceNode.GetRoleID( role, metricInstanceNode.TransformRole ) == transformNode.GetID() ):
-          try:
-            metric.AddTimestamp( time, matrix, point, role )
-          except TypeError: # Only look if there is an issue with the number of arguments
-            metric.AddTimestamp( time, matrix, point ) # TODO: Keep this for backwards compatibility with Python Metrics?
+        transformID = metricInstanceNode.GetRoleID( role, metricInstanceNode.TransformRole )
+        if ( transformID not in dispatchTable ):
+          dispatchTable[ transformID ] = []
+        dispatchTable[ transformID ].append( ( metric, role, acceptsRole ) )
+        
+    return dispatchTable
+    
+    
+  @staticmethod
+  def AddTimestampAcceptsRole( metric ): # TODO: Keep this for backwards compatibility with Python Metrics?
+    try:
+      try:
+        argSpec = inspect.getfullargspec( metric.AddTimestamp )
+      except AttributeError: # Python 2
+        argSpec = inspect.getargspec( metric.AddTimestamp )
+    except TypeError: # If it cannot be inspected, assume it is up to date
+      return True
+    return ( argSpec.varargs is not None or len( argSpec.args ) >= 5 ) # self, time, matrix, point, role
+    
+  
+  # Feed one timestamp to every ( metric, role, accepts role ) in the dispatch list
+  @staticmethod
+  def DispatchTimestamp( dispatchList, matrix, time ):
+    point = [ matrix.GetElement( 0, 3 ), matrix.GetElement( 1, 3 ), matrix.GetElement( 2, 3 ), matrix.GetElement( 3, 3 ) ]
+    
+    for metric, role, acceptsRole in dispatchList:
+      if ( acceptsRole ):
+        metric.AddTimestamp( time, matrix, point, role )
+      else:
+        metric.AddTimestamp( time, matrix, point )
       
       
   # Instance methods for real-time metric computation
@@ -604,12 +696,13 @@ class PythonMetricsCalculatorLogic( ScriptedLoadableModuleLogic ):
       
     self.realTimeMetrics = collections.OrderedDict()
     self.realTimeMetrics[ PythonMetricsCalculatorLogic.METRIC_VALUE ] = PythonMetricsCalculatorLogic.GetFreshMetrics( peNodeID ) # Cannot tompute task-specific metrics in real-time
+    self.realTimeDispatchTable = PythonMetricsCalculatorLogic.GetMetricsDispatchTable( self.realTimeMetrics[ PythonMetricsCalculatorLogic.METRIC_VALUE ] )
     self.realTimeMetricsTable = peNode.GetMetricsTableNode()
     peNode.GetTrackedSequenceBrowserNode().GetAllProxyNodes( self.realTimeProxyNodeCollection )
     
     
   def UpdateRealTimeMetrics( self, time ):
-    PythonMetricsCalculatorLogic.UpdateProxyNodeMetrics( self.realTimeMetrics[ PythonMetricsCalculatorLogic.METRIC_VALUE ], self.realTimeProxyNodeCollection, time )
+    PythonMetricsCalculatorLogic.UpdateProxyNodeMetrics( self.realTimeDispatchTable, self.realTimeProxyNodeCollection, time )
     
     if ( self.realTimeMetricsTable is not None ):
       PythonMetricsCalculatorLogic.OutputAllMetricsToMetricsTable( self.realTimeMetricsTable, self.realTimeMetrics )
@@ -643,6 +736,11 @@ class PythonMetricsCalculatorTest( ScriptedLoadableModuleTest ):
       self.test_PythonMetricsCalculatorInPlane()
     except Exception as e:
       self.delayDisplay( "In-plane test caused exception!\n" + str(e) )
+
+    try:
+      self.test_PythonMetricsCalculatorNativeMetrics()
+    except Exception as e:
+      self.delayDisplay( "Native metrics test caused exception!\n" + str(e) )
       
       
   def compareMetricsTables( self, trueMetricsTableNode, testMetricsTableNode ):
@@ -848,6 +946,224 @@ class PythonMetricsCalculatorTest( ScriptedLoadableModuleTest ):
     logging.debug( "In-plane test completed." )
     self.assertTrue( metricsMatch )
 
+
+  # Python versions of the velocity metrics (there are no core scripts for these), computed from every velocity at the end
+  REFERENCE_VELOCITY_METRIC_SOURCE = ( "import math\n"
+    + "from PythonMetricsCalculator import PerkEvaluatorMetric\n"
+    + "\n"
+    + "class ReferenceVelocity( PerkEvaluatorMetric ):\n"
+    + "  @staticmethod\n"
+    + "  def GetMetricName():\n"
+    + "    return {metricName}\n"
+    + "  @staticmethod\n"
+    + "  def GetMetricUnit():\n"
+    + "    return 'mm/s'\n"
+    + "  @staticmethod\n"
+    + "  def IsShared():\n"
+    + "    return True\n"
+    + "  def __init__( self ):\n"
+    + "    PerkEvaluatorMetric.__init__( self )\n"
+    + "    self.previousTime = None\n"
+    + "    self.previousPoint = None\n"
+    + "    self.velocities = []\n"
+    + "  def AddTimestamp( self, time, matrix, point, role ):\n"
+    + "    if ( self.previousTime is not None and time <= self.previousTime ):\n"
+    + "      return\n"
+    + "    if ( self.previousTime is not None ):\n"
+    + "      distance = math.sqrt( sum( ( point[ i ] - self.previousPoint[ i ] ) ** 2 for i in range( 3 ) ) )\n"
+    + "      self.velocities.append( distance / ( time - self.previousTime ) )\n"
+    + "    self.previousTime = time\n"
+    + "    self.previousPoint = point[:]\n"
+    + "  def GetMetric( self ):\n"
+    + "    if ( len( self.velocities ) == 0 ):\n"
+    + "      return 0\n"
+    + "    mean = sum( self.velocities ) / len( self.velocities )\n"
+    + "    return {statistic}\n" )
+
+  REFERENCE_VELOCITY_STATISTICS = {
+    "Average Velocity": "mean",
+    "Maximum Velocity": "max( self.velocities )",
+    "Velocity Standard Deviation": "math.sqrt( sum( ( v - mean ) ** 2 for v in self.velocities ) / len( self.velocities ) )"
+  }
+
+  # The Python metric that each native metric should agree with
+  NATIVE_METRIC_PYTHON_COUNTERPARTS = {
+    "Elapsed Time": "Elapsed Time",
+    "Path Length": "Path Length",
+    "Tissue Inside Time": "Time in Tissue",
+    "Average Velocity": "Average Velocity",
+    "Maximum Velocity": "Maximum Velocity",
+    "Velocity Standard Deviation": "Velocity Standard Deviation"
+  }
+
+
+  def getMetricsTableValues( self, metricsTableNode ):
+    # The metric value for each ( metric name, roles )
+    metricsTableValues = dict()
+    table = metricsTableNode.GetTable()
+    for i in range( table.GetNumberOfRows() ):
+      metricKey = ( table.GetValueByName( i, "MetricName" ).ToString(), table.GetValueByName( i, "MetricRoles" ).ToString() )
+      metricsTableValues[ metricKey ] = table.GetValueByName( i, PythonMetricsCalculatorLogic.METRIC_VALUE ).ToDouble()
+    return metricsTableValues
+
+
+  def setVelocityMetricRoles( self, activeScene, perkEvaluatorNode, transformNodeID ):
+    # The velocity metrics are not pervasive, so their only transform role must be set (without touching the pervasive metrics' roles)
+    for i in range( perkEvaluatorNode.GetNumberOfNodeReferences( "MetricInstance" ) ):
+      metricInstanceNode = perkEvaluatorNode.GetNthNodeReference( "MetricInstance", i )
+      metricScriptNode = activeScene.GetNodeByID( metricInstanceNode.GetAssociatedMetricScriptID() )
+      if ( metricScriptNode is not None and metricScriptNode.GetName() in PythonMetricsCalculatorTest.REFERENCE_VELOCITY_STATISTICS ):
+        metricInstanceNode.SetRoleID( transformNodeID, "Any", slicer.vtkMRMLMetricInstanceNode.TransformRole )
+
+
+  def checkTwoTransformNativeMetrics( self, peLogic, trackedSequenceBrowserNode, beginTime, endTime ):
+    # A native metric fed by two transforms must get their frames merged by timestamp, the same as replaying the frames one by one
+    times = vtk.vtkDoubleArray()
+    relevantTransformNodes = vtk.vtkCollection()
+    toWorldMatrices = vtk.vtkCollection()
+    peLogic.ReplayTransformsToWorld( trackedSequenceBrowserNode, beginTime, endTime, times, relevantTransformNodes, toWorldMatrices )
+    if ( toWorldMatrices.GetNumberOfItems() < 2 ):
+      logging.warning( "The in-plane recording does not have two transforms." )
+      return False
+
+    # The second transform's job starts part way through (like a later task interval), so the jobs only partly overlap
+    numberOfFrames = times.GetNumberOfTuples()
+    jobRanges = [ ( 0, numberOfFrames ), ( numberOfFrames // 3, numberOfFrames ) ]
+
+    metricsMatch = True
+    for metricName in [ "Path Length", "Average Velocity" ]:
+      nativeMetric = slicer.vtkPerkEvaluatorMetricFactory.CreateMetric( metricName )
+      nativeMetrics = vtk.vtkCollection()
+      nativeRoles = vtk.vtkStringArray()
+      nativeMatrices = vtk.vtkCollection()
+      nativeRanges = vtk.vtkIntArray()
+      nativeRanges.SetNumberOfComponents( 2 )
+      for j in range( 2 ):
+        nativeMetrics.AddItem( nativeMetric )
+        nativeRoles.InsertNextValue( "Any" )
+        nativeMatrices.AddItem( toWorldMatrices.GetItemAsObject( j ) )
+        nativeRanges.InsertNextTuple2( jobRanges[ j ][ 0 ], jobRanges[ j ][ 1 ] )
+      peLogic.ComputeNativeMetrics( nativeMetrics, nativeRoles, nativeMatrices, nativeRanges, times )
+
+      referenceMetric = slicer.vtkPerkEvaluatorMetricFactory.CreateMetric( metricName )
+      for i in range( numberOfFrames ):
+        for j in range( 2 ):
+          if ( i < jobRanges[ j ][ 0 ] or i >= jobRanges[ j ][ 1 ] ):
+            continue
+          matrix = vtk.vtkMatrix4x4()
+          matrix.DeepCopy( toWorldMatrices.GetItemAsObject( j ).GetTuple( i ) )
+          referenceMetric.AddTimestamp( times.GetValue( i ), matrix, "Any" )
+
+      nativeValue = nativeMetric.GetMetric()
+      referenceValue = referenceMetric.GetMetric()
+      if ( abs( nativeValue - referenceValue ) > 1e-6 * max( 1.0, abs( referenceValue ) ) ):
+        logging.warning( "Native metric " + metricName + " with two transforms is " + str( nativeValue ) + ", but replaying the frames one by one gives " + str( referenceValue ) + "." )
+        metricsMatch = False
+
+    return metricsMatch
+
+
+  def test_PythonMetricsCalculatorNativeMetrics( self ):
+    """ Compute the metrics on the in-plane recording twice: first with the Python metrics,
+    then with the native metrics (added the same way as the user option), and check that each
+    native metric agrees with its Python counterpart.
+    """
+    print( "CTEST_FULL_OUTPUT" )
+
+    # These are the IDs of the relevant nodes
+    trackedSequenceBrowserID = "vtkMRMLSequenceBrowserNode1"
+    tissueModelID = "vtkMRMLModelNode4"
+    needleTransformID = "vtkMRMLLinearTransformNode4"
+
+    # Load the scene
+    sceneFile = os.path.join( os.path.dirname(  __file__  ), "Data", "InPlane", "Scene_InPlane.mrml" )
+    activeScene = slicer.mrmlScene
+    activeScene.Clear( 0 )
+    activeScene.SetURL( sceneFile )
+    if ( activeScene.Import() != 1 ):
+      raise Exception( "Scene import failed. Scene file: " + sceneFile )
+
+    trackedSequenceBrowserNode = activeScene.GetNodeByID( trackedSequenceBrowserID )
+    tissueModelNode = activeScene.GetNodeByID( tissueModelID )
+    needleTransformNode = activeScene.GetNodeByID( needleTransformID )
+    if ( trackedSequenceBrowserNode is None or tissueModelNode is None or needleTransformNode is None ):
+      raise Exception( "Bad in-plane scene." )
+
+    # Setup the analysis with the Python metrics (the core metrics, plus the reference velocity metrics)
+    peLogic = slicer.modules.perkevaluator.logic()
+    PythonMetricsCalculatorLogic.Initialize()
+    for metricName, statistic in PythonMetricsCalculatorTest.REFERENCE_VELOCITY_STATISTICS.items():
+      metricScriptNode = slicer.vtkMRMLMetricScriptNode()
+      metricScriptNode.SetName( metricName )
+      metricScriptNode.SetPythonSourceCode( PythonMetricsCalculatorTest.REFERENCE_VELOCITY_METRIC_SOURCE.format( metricName = repr( metricName ), statistic = statistic ) )
+      activeScene.AddNode( metricScriptNode )
+
+    perkEvaluatorNode = activeScene.CreateNodeByClass( "vtkMRMLPerkEvaluatorNode" )
+    perkEvaluatorNode.SetScene( activeScene )
+    activeScene.AddNode( perkEvaluatorNode )
+
+    metricsTableNode = activeScene.CreateNodeByClass( "vtkMRMLTableNode" )
+    metricsTableNode.SetScene( activeScene )
+    activeScene.AddNode( metricsTableNode )
+
+    perkEvaluatorNode.SetTrackedSequenceBrowserNodeID( trackedSequenceBrowserNode.GetID() )
+    perkEvaluatorNode.SetMetricsTableID( metricsTableNode.GetID() )
+
+    peLogic.SetMetricInstancesRolesToID( perkEvaluatorNode, needleTransformNode.GetID(), "Needle", slicer.vtkMRMLMetricInstanceNode.TransformRole )
+    peLogic.SetMetricInstancesRolesToID( perkEvaluatorNode, tissueModelNode.GetID(), "Tissue", slicer.vtkMRMLMetricInstanceNode.AnatomyRole )
+    self.setVelocityMetricRoles( activeScene, perkEvaluatorNode, needleTransformNode.GetID() )
+    perkEvaluatorNode.UpdateMeasurementRange()
+
+    PythonMetricsCalculatorLogic.CalculateAllMetrics( perkEvaluatorNode.GetID() )
+    pythonMetricsValues = self.getMetricsTableValues( metricsTableNode )
+
+    # Replace the Python metrics with the native metrics (the metric instances go first, so none is left without its script)
+    for nodeClass in [ "vtkMRMLMetricInstanceNode", "vtkMRMLMetricScriptNode" ]:
+      metricNodes = activeScene.GetNodesByClass( nodeClass )
+      metricNodes.UnRegister( activeScene )
+      for i in range( metricNodes.GetNumberOfItems() ):
+        activeScene.RemoveNode( metricNodes.GetItemAsObject( i ) )
+    peLogic.AddNativeMetrics()
+
+    peLogic.SetMetricInstancesRolesToID( perkEvaluatorNode, needleTransformNode.GetID(), "Needle", slicer.vtkMRMLMetricInstanceNode.TransformRole )
+    peLogic.SetMetricInstancesRolesToID( perkEvaluatorNode, tissueModelNode.GetID(), "Tissue", slicer.vtkMRMLMetricInstanceNode.AnatomyRole )
+    self.setVelocityMetricRoles( activeScene, perkEvaluatorNode, needleTransformNode.GetID() )
+
+    PythonMetricsCalculatorLogic.CalculateAllMetrics( perkEvaluatorNode.GetID() )
+    nativeMetricsValues = self.getMetricsTableValues( metricsTableNode )
+
+    # Every native metric must be computed, and match its Python counterpart under the same roles
+    metricsMatch = True
+    for nativeMetricName, pythonMetricName in PythonMetricsCalculatorTest.NATIVE_METRIC_PYTHON_COUNTERPARTS.items():
+      nativeMetricKeys = [ metricKey for metricKey in nativeMetricsValues if metricKey[ 0 ] == nativeMetricName ]
+      if ( len( nativeMetricKeys ) == 0 ):
+        logging.warning( "Native metric " + nativeMetricName + " was not computed." )
+        metricsMatch = False
+
+      for metricKey in nativeMetricKeys:
+        pythonMetricKey = ( pythonMetricName, metricKey[ 1 ] )
+        if ( pythonMetricKey not in pythonMetricsValues ):
+          logging.warning( "No Python metric " + pythonMetricName + " for roles " + metricKey[ 1 ] + "." )
+          metricsMatch = False
+          continue
+
+        nativeValue = nativeMetricsValues[ metricKey ]
+        pythonValue = pythonMetricsValues[ pythonMetricKey ]
+        if ( abs( nativeValue - pythonValue ) > 1e-6 * max( 1.0, abs( pythonValue ) ) ):
+          logging.warning( "Native metric " + nativeMetricName + " (" + metricKey[ 1 ] + ") is " + str( nativeValue ) + ", but the Python metric is " + str( pythonValue ) + "." )
+          metricsMatch = False
+
+    if ( not self.checkTwoTransformNativeMetrics( peLogic, trackedSequenceBrowserNode, perkEvaluatorNode.GetMarkBegin(), perkEvaluatorNode.GetMarkEnd() ) ):
+      metricsMatch = False
+
+    if ( not metricsMatch ):
+      self.delayDisplay( "Test failed! Native metrics were not consistent with the Python metrics." )
+    else:
+      self.delayDisplay( "Test passed! Native metrics match the Python metrics!" )
+
+    logging.debug( "Native metrics test completed." )
+    self.assertTrue( metricsMatch )
+
     
     
     
@@ -907,3 +1223,71 @@ class PerkEvaluatorMetric:
     
   def GetMetric( self ):
     return 0      
+
+
+#
+# NativePerkEvaluatorMetric
+#
+
+# Adapts a native (C++) metric from the vtkPerkEvaluatorMetricFactory to the PerkEvaluatorMetric interface
+# Subclasses only need to set the name the native metric is registered under
+class NativePerkEvaluatorMetric( PerkEvaluatorMetric ):
+
+  NativeMetricName = ""
+
+  # Static methods (the native metric describes itself, so ask a temporary instance)
+  @classmethod
+  def CreateNativeMetric( cls ):
+    return slicer.vtkPerkEvaluatorMetricFactory.CreateMetric( cls.NativeMetricName )
+
+  @classmethod
+  def GetMetricName( cls ):
+    return cls.CreateNativeMetric().GetMetricName()
+
+  @classmethod
+  def GetMetricUnit( cls ):
+    return cls.CreateNativeMetric().GetMetricUnit()
+
+  @classmethod
+  def IsPervasive( cls ):
+    return cls.CreateNativeMetric().IsPervasive()
+
+  @classmethod
+  def IsShared( cls ):
+    return cls.CreateNativeMetric().IsShared()
+
+  @classmethod
+  def IsHidden( cls ):
+    return cls.CreateNativeMetric().IsHidden()
+
+  @classmethod
+  def GetTransformRoles( cls ):
+    return list( cls.CreateNativeMetric().GetTransformRoles() )
+
+  @classmethod
+  def GetAnatomyRoles( cls ):
+    nativeMetric = cls.CreateNativeMetric()
+    return { role: nativeMetric.GetAnatomyRoleClassName( role ) for role in nativeMetric.GetAnatomyRoles() }
+
+
+  # Instance methods
+  def __init__( self ):
+    PerkEvaluatorMetric.__init__( self )
+    self.NativeMetric = self.CreateNativeMetric()
+
+  def SetNeedleOrientation( self, orientation ):
+    PerkEvaluatorMetric.SetNeedleOrientation( self, orientation )
+    self.NativeMetric.SetNeedleOrientation( orientation[ 0 ], orientation[ 1 ], orientation[ 2 ] )
+
+  def SetAnatomy( self, role, node ):
+    return self.NativeMetric.SetAnatomy( role, node )
+
+  def AddTimestamp( self, time, matrix, point, role ):
+    self.NativeMetric.AddTimestamp( time, matrix, role )
+
+  # The frames from first up to (not including) last, where the matrices are 16-component (row-major) to-world matrices
+  def AddTimestamps( self, times, matrices, role, first, last ):
+    self.NativeMetric.AddTimestamps( times, matrices, role, first, last )
+
+  def GetMetric( self ):
+    return self.NativeMetric.GetMetric()
@@ -25,6 +25,7 @@
 // VTK includes
 #include <vtkNew.h>
 #include <vtkCollectionIterator.h>
+#include <vtkSMPTools.h>
 
 // STD includes
 #include <cassert>
@@ -32,10 +33,29 @@
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerWorkflowSegmentationLogic);
 
+
+// Helper for training the tools in parallel
+// Each tool only works on its own prepared snapshot, so the tools do not share anything
+class vtkWorkflowTrainToolsFunctor
+{
+public:
+  std::vector< vtkMRMLWorkflowToolNode* >* ToolNodes;
+  std::vector< int >* Trained;
+
+  void operator()( vtkIdType begin, vtkIdType end )
+  {
+    for ( vtkIdType i = begin; i < end; i++ )
+    {
+      this->Trained->at( i ) = this->ToolNodes->at( i )->ComputeTraining( true );
+    }
+  }
+};
+
 //----------------------------------------------------------------------------
 vtkSlicerWorkflowSegmentationLogic
 ::vtkSlicerWorkflowSegmentationLogic()
 {
+  this->ParallelTraining = true;
 }
 
 //----------------------------------------------------------------------------
@@ -182,7 +202,7 @@ void vtkSlicerWorkflowSegmentationLogic
 
 
 void vtkSlicerWorkflowSegmentationLogic
-::TrainAllTools( vtkMRMLWorkflowSegmentationNode* workflowNode, vtkCollection* trainingTrackedSequenceBrowserNodes )
+::TrainAllTools( vtkMRMLWorkflowSegmentationNode* workflowNode, vtkCollection* trainingTrackedSequenceBrowserNodes, vtkCollection* unlabelledTrackedSequenceBrowserNodes )
 {
   if ( workflowNode == NULL )
   {
@@ -191,6 +211,7 @@ void vtkSlicerWorkflowSegmentationLogic
   
   // Iterate over all tools
   std::vector< std::string > toolIDs = workflowNode->GetToolIDs();
+  std::vector< vtkMRMLWorkflowToolNode* > preparedToolNodes;
   
   for ( int i = 0; i < toolIDs.size(); i++ )
   {
@@ -200,8 +221,8 @@ void vtkSlicerWorkflowSegmentationLogic
       continue;
     }
     
-    // Add each recorded tracked sequence
-    vtkNew< vtkCollection > trainingWorkflowSequences;
+    // Add each recorded tracked sequence (streamed straight into a feature matrix, so no workflow sequence nodes are needed)
+    std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > > trainingMatrices;
     vtkNew< vtkCollectionIterator > trainingTrackedSequenceBrowserNodesIt;
     trainingTrackedSequenceBrowserNodesIt->SetCollection( trainingTrackedSequenceBrowserNodes );
     
@@ -222,14 +243,65 @@ void vtkSlicerWorkflowSegmentationLogic
         continue;
       }
       
-      vtkNew< vtkMRMLWorkflowSequenceNode > currWorkflowSequence;
-      currWorkflowSequence->FromTrackedSequenceBrowserNode( currTrainingTrackedSequenceBrowserNode, toolNode->GetToolTransformID(), messageProxyNode->GetID(), toolNode->GetWorkflowProcedureNode()->GetAllTaskNames() );
-      trainingWorkflowSequences->AddItem( currWorkflowSequence.GetPointer() );
+      vtkSmartPointer< vtkWorkflowFeatureMatrix > currWorkflowMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+      vtkMRMLWorkflowSequenceNode::TrackedSequenceBrowserNodeToFeatureMatrix( currTrainingTrackedSequenceBrowserNode, toolNode->GetToolTransformID(), messageProxyNode->GetID(), toolNode->GetWorkflowProcedureNode()->GetAllTaskNames(), currWorkflowMatrix );
+      if ( currWorkflowMatrix->GetNumberOfFrames() > 0 )
+      {
+        trainingMatrices.push_back( currWorkflowMatrix );
+      }
+    }
+
+    // Add each unlabelled tracked sequence (all of the tool's frames are kept with no task, so they can only refine the Markov model)
+    // These are kept apart from the labelled procedures, so they never change the principal components or the centroids
+    std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > > unlabelledMatrices;
+    if ( unlabelledTrackedSequenceBrowserNodes != NULL && toolNode->GetWorkflowInputNode()->GetMarkovBaumWelchIterations() > 0 )
+    {
+      vtkNew< vtkCollectionIterator > unlabelledTrackedSequenceBrowserNodesIt;
+      unlabelledTrackedSequenceBrowserNodesIt->SetCollection( unlabelledTrackedSequenceBrowserNodes );
+
+      for ( unlabelledTrackedSequenceBrowserNodesIt->InitTraversal(); ! unlabelledTrackedSequenceBrowserNodesIt->IsDoneWithTraversal(); unlabelledTrackedSequenceBrowserNodesIt->GoToNextItem() )
+      {
+        vtkMRMLSequenceBrowserNode* currUnlabelledTrackedSequenceBrowserNode = vtkMRMLSequenceBrowserNode::SafeDownCast( unlabelledTrackedSequenceBrowserNodesIt->GetCurrentObject() );
+        if ( currUnlabelledTrackedSequenceBrowserNode == NULL )
+        {
+          continue;
+        }
+
+        vtkSmartPointer< vtkWorkflowFeatureMatrix > currWorkflowMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+        vtkMRMLWorkflowSequenceNode::TrackedSequenceBrowserNodeToFeatureMatrix( currUnlabelledTrackedSequenceBrowserNode, toolNode->GetToolTransformID(), "", std::vector< std::string >(), currWorkflowMatrix, true );
+        if ( currWorkflowMatrix->GetNumberOfFrames() > 0 )
+        {
+          unlabelledMatrices.push_back( currWorkflowMatrix );
+        }
+      }
+    }
+
+    if ( ! this->ParallelTraining )
+    {
+      toolNode->Train( trainingMatrices, unlabelledMatrices );
+      continue;
     }
-    
-    
 
-    toolNode->Train( trainingWorkflowSequences.GetPointer() );
+    // Otherwise, just take the snapshot for now (it needs the scene)
+    if ( toolNode->PrepareTraining( trainingMatrices, unlabelledMatrices ) )
+    {
+      preparedToolNodes.push_back( toolNode );
+    }
+  }
+
+  // Train the tools in parallel, then write the results from the main thread
+  std::vector< int > trained( preparedToolNodes.size(), 0 );
+  vtkWorkflowTrainToolsFunctor trainToolsFunctor;
+  trainToolsFunctor.ToolNodes = &preparedToolNodes;
+  trainToolsFunctor.Trained = &trained;
+  vtkSMPTools::For( 0, preparedToolNodes.size(), 1, trainToolsFunctor );
+
+  for ( int i = 0; i < preparedToolNodes.size(); i++ )
+  {
+    if ( trained.at( i ) )
+    {
+      preparedToolNodes.at( i )->CommitTraining();
+    }
   }
   
   workflowNode->Modified();
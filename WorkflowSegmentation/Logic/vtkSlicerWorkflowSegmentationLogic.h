@@ -83,7 +83,14 @@ public:
   vtkMRMLWorkflowToolNode* GetToolByProxyNodeID( vtkMRMLWorkflowSegmentationNode* workflowNode, std::string proxyNodeID );
  
   void ResetAllToolSequences( vtkMRMLWorkflowSegmentationNode* workflowNode );
-  void TrainAllTools( vtkMRMLWorkflowSegmentationNode* workflowNode, vtkCollection* trainingTrackedSequenceBrowserNodes );
+  // The unlabelled tracked sequences are optional (they have no task messages, so they are only used to refine the Markov model by Baum-Welch)
+  void TrainAllTools( vtkMRMLWorkflowSegmentationNode* workflowNode, vtkCollection* trainingTrackedSequenceBrowserNodes, vtkCollection* unlabelledTrackedSequenceBrowserNodes = NULL );
+
+  // Train the tools (and each tool's procedures) on a thread pool (on by default)
+  // The results are still written to the training nodes on the main thread
+  vtkGetMacro( ParallelTraining, bool );
+  vtkSetMacro( ParallelTraining, bool );
+  vtkBooleanMacro( ParallelTraining, bool );
  
   static bool GetAllToolsInputted( vtkMRMLWorkflowSegmentationNode* workflowNode );
   static bool GetAllToolsTrained( vtkMRMLWorkflowSegmentationNode* workflowNode );
@@ -99,6 +106,8 @@ public:
 
 protected:
 
+  bool ParallelTraining;
+
 };
 
 #endif
@@ -43,9 +43,13 @@ void vtkMRMLWorkflowInputNode
   this->SetDerivative( node->GetDerivative() );
   this->SetNumCentroids( node->GetNumCentroids() );
   this->SetNumPrinComps( node->GetNumPrinComps() );
+  this->SetTruncatedPrinComps( node->GetTruncatedPrinComps() );
   this->SetMarkovPseudoScalePi( node->GetMarkovPseudoScalePi() );
   this->SetMarkovPseudoScaleA( node->GetMarkovPseudoScaleA() );
   this->SetMarkovPseudoScaleB( node->GetMarkovPseudoScaleB() );
+  this->SetMarkovBaumWelchIterations( node->GetMarkovBaumWelchIterations() );
+  this->SetMarkovBaumWelchTolerance( node->GetMarkovBaumWelchTolerance() );
+  this->SetMarkovFixedLag( node->GetMarkovFixedLag() );
   this->SetCompletionTime( node->GetCompletionTime() );
   this->SetEqualization( node->GetEqualization() );
 
@@ -68,9 +72,13 @@ vtkMRMLWorkflowInputNode
   this->Derivative = 1;
   this->NumCentroids = 70;
   this->NumPrinComps = 6;
+  this->TruncatedPrinComps = false;
   this->MarkovPseudoScalePi = 0.2;
   this->MarkovPseudoScaleA = 0.2;
   this->MarkovPseudoScaleB = 0.2;
+  this->MarkovBaumWelchIterations = 0;
+  this->MarkovBaumWelchTolerance = 1e-4;
+  this->MarkovFixedLag = 0;
   this->CompletionTime = 0.8;
   this->Equalization = 2.0;
 }
@@ -94,9 +102,13 @@ std::string vtkMRMLWorkflowInputNode
   xmlstring << indent.GetNextIndent() << "<Parameter Type=\"Derivative\" Value=\"" << this->Derivative << "\" />" << std::endl;
   xmlstring << indent.GetNextIndent() << "<Parameter Type=\"NumCentroids\" Value=\"" << this->NumCentroids << "\" />" << std::endl;
   xmlstring << indent.GetNextIndent() << "<Parameter Type=\"NumPrinComps\" Value=\"" << this->NumPrinComps << "\" />" << std::endl;
+  xmlstring << indent.GetNextIndent() << "<Parameter Type=\"TruncatedPrinComps\" Value=\"" << this->TruncatedPrinComps << "\" />" << std::endl;
   xmlstring << indent.GetNextIndent() << "<Parameter Type=\"MarkovPseudoScalePi\" Value=\"" << this->MarkovPseudoScalePi << "\" />" << std::endl;
   xmlstring << indent.GetNextIndent() << "<Parameter Type=\"MarkovPseudoScaleA\" Value=\"" << this->MarkovPseudoScaleA << "\" />" << std::endl;
   xmlstring << indent.GetNextIndent() << "<Parameter Type=\"MarkovPseudoScaleB\" Value=\"" << this->MarkovPseudoScaleB << "\" />" << std::endl;
+  xmlstring << indent.GetNextIndent() << "<Parameter Type=\"MarkovBaumWelchIterations\" Value=\"" << this->MarkovBaumWelchIterations << "\" />" << std::endl;
+  xmlstring << indent.GetNextIndent() << "<Parameter Type=\"MarkovBaumWelchTolerance\" Value=\"" << this->MarkovBaumWelchTolerance << "\" />" << std::endl;
+  xmlstring << indent.GetNextIndent() << "<Parameter Type=\"MarkovFixedLag\" Value=\"" << this->MarkovFixedLag << "\" />" << std::endl;
   xmlstring << indent.GetNextIndent() << "<Parameter Type=\"CompletionTime\" Value=\"" << this->CompletionTime << "\" />" << std::endl;
   xmlstring << indent.GetNextIndent() << "<Parameter Type=\"Equalization\" Value=\"" << this->Equalization << "\" />" << std::endl;
   xmlstring << indent << "</WorkflowInput>" << std::endl;
@@ -151,6 +163,10 @@ void vtkMRMLWorkflowInputNode
 	  if ( strcmp( elementType, "NumPrinComps" ) == 0 )
     {
 	    this->SetNumPrinComps( value );
+    }
+	  if ( strcmp( elementType, "TruncatedPrinComps" ) == 0 )
+    {
+	    this->SetTruncatedPrinComps( value != 0 );
     }
     if ( strcmp( elementType, "NumCentroids" ) == 0 )
     {
@@ -167,6 +183,18 @@ void vtkMRMLWorkflowInputNode
 	  if ( strcmp( elementType, "MarkovPseudoScaleB" ) == 0 )
     {
 	    this->SetMarkovPseudoScaleB( value );
+    }
+	  if ( strcmp( elementType, "MarkovBaumWelchIterations" ) == 0 )
+    {
+	    this->SetMarkovBaumWelchIterations( value );
+    }
+	  if ( strcmp( elementType, "MarkovBaumWelchTolerance" ) == 0 )
+    {
+	    this->SetMarkovBaumWelchTolerance( value );
+    }
+	  if ( strcmp( elementType, "MarkovFixedLag" ) == 0 )
+    {
+	    this->SetMarkovFixedLag( value );
     }
 	  if ( strcmp( elementType, "CompletionTime" ) == 0 )
     {
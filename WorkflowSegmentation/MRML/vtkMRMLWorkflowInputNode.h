@@ -72,6 +72,9 @@ public:
   vtkGetMacro( NumPrinComps, int );
   vtkSetMacro( NumPrinComps, int );
 
+  vtkGetMacro( TruncatedPrinComps, bool );
+  vtkSetMacro( TruncatedPrinComps, bool );
+
   vtkGetMacro( MarkovPseudoScalePi, double );
   vtkSetMacro( MarkovPseudoScalePi, double );
 
@@ -81,6 +84,15 @@ public:
   vtkGetMacro( MarkovPseudoScaleB, double );
   vtkSetMacro( MarkovPseudoScaleB, double );
 
+  vtkGetMacro( MarkovBaumWelchIterations, int );
+  vtkSetMacro( MarkovBaumWelchIterations, int );
+
+  vtkGetMacro( MarkovBaumWelchTolerance, double );
+  vtkSetMacro( MarkovBaumWelchTolerance, double );
+
+  vtkGetMacro( MarkovFixedLag, int );
+  vtkSetMacro( MarkovFixedLag, int );
+
   vtkGetMacro( CompletionTime, double );
   vtkSetMacro( CompletionTime, double );
 
@@ -100,9 +112,13 @@ protected:
   int Derivative;
   int NumCentroids;
   int NumPrinComps;
+  bool TruncatedPrinComps; // Only find the top eigenvectors when calculating principal components
   double MarkovPseudoScalePi;
   double MarkovPseudoScaleA;
   double MarkovPseudoScaleB;
+  int MarkovBaumWelchIterations; // Use the unlabelled procedures to refine the Markov model (zero for labelled procedures only)
+  double MarkovBaumWelchTolerance; // Stop refining when the log-likelihood improves by less than this
+  int MarkovFixedLag; // Number of frames to wait before deciding the task online (smoother, but later)
   double CompletionTime;
   double Equalization;
 
@@ -3,10 +3,6 @@
 #include "vtkMRMLWorkflowSequenceNode.h"
 
 
-// Constants ---------------------------------------------------------------------------------------
-
-const double vtkMRMLWorkflowSequenceNode::STDEV_CUTOFF = 5.0;
-
 // Standard MRML Node Methods ------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLWorkflowSequenceNode);
 
@@ -58,6 +54,8 @@ void vtkMRMLWorkflowSequenceNode
 vtkMRMLWorkflowSequenceNode
 ::vtkMRMLWorkflowSequenceNode()
 {
+  this->IndexValuesAsDoubleTime = 0;
+  this->NearestNeighboursTime = 0;
 }
 
 
@@ -72,13 +70,73 @@ vtkMRMLWorkflowSequenceNode
 double vtkMRMLWorkflowSequenceNode
 ::GetNthIndexValueAsDouble( int itemNumber )
 {
-  if ( this->GetIndexType() != this->NumericIndex )
+  const std::vector< double >& indexValues = this->GetIndexValuesAsDouble();
+  if ( itemNumber < 0 || itemNumber >= indexValues.size() )
   {
     return 0;
   }
 
-  std::string indexValue = this->GetNthIndexValue( itemNumber );
+  return indexValues[ itemNumber ];
+}
+
+
+// The parsed index values are cached, and only re-parsed when the sequence has been modified
+const std::vector< double >& vtkMRMLWorkflowSequenceNode
+::GetIndexValuesAsDouble()
+{
+  if ( this->GetMTime() > this->IndexValuesAsDoubleTime
+    || this->IndexValuesAsDouble.size() != this->GetNumberOfDataNodes() )
+  {
+    this->UpdateIndexValuesAsDouble();
+  }
+
+  return this->IndexValuesAsDouble;
+}
+
+
+void vtkMRMLWorkflowSequenceNode
+::UpdateIndexValuesAsDouble()
+{
+  int numberOfDataNodes = this->GetNumberOfDataNodes();
+  if ( this->GetIndexType() != this->NumericIndex )
+  {
+    this->IndexValuesAsDouble.assign( numberOfDataNodes, 0.0 );
+    this->IndexValuesAsDoubleTime = this->GetMTime();
+    return;
+  }
+
+  // Any modification could have changed any of the index values, so parse them all
+  // (appending through AppendDataNode keeps the parsed values, so this is not needed after an append)
+  this->IndexValuesAsDouble.resize( numberOfDataNodes );
+  for ( int i = 0; i < numberOfDataNodes; i++ )
+  {
+    this->IndexValuesAsDouble[ i ] = vtkMRMLWorkflowSequenceNode::IndexValueToDouble( this->GetNthIndexValue( i ) );
+  }
+  this->IndexValuesAsDoubleTime = this->GetMTime();
+}
+
+
+// Only a true append keeps the previously parsed index values: they were up to date before, and the new item ended up last
+void vtkMRMLWorkflowSequenceNode
+::AppendDataNode( vtkMRMLNode* dataNode, std::string indexValue )
+{
+  bool indexValuesCurrent = ( this->GetMTime() <= this->IndexValuesAsDoubleTime && this->IndexValuesAsDouble.size() == this->GetNumberOfDataNodes() );
+  this->SetDataNodeAtValue( dataNode, indexValue ); // Automatically deep copies
+
+  if ( ! indexValuesCurrent || this->GetIndexType() != this->NumericIndex
+    || this->GetNumberOfDataNodes() != this->IndexValuesAsDouble.size() + 1
+    || this->GetNthIndexValue( this->GetNumberOfDataNodes() - 1 ) != indexValue )
+  {
+    return; // Everything is parsed again on the next access
+  }
+  this->IndexValuesAsDouble.push_back( vtkMRMLWorkflowSequenceNode::IndexValueToDouble( indexValue ) );
+  this->IndexValuesAsDoubleTime = this->GetMTime();
+}
 
+
+double vtkMRMLWorkflowSequenceNode
+::IndexValueToDouble( std::string indexValue )
+{
   char* end;
   double val = std::strtod( indexValue.c_str(), &end );
   if (*end != 0) // Parsing failed due to non-numeric character
@@ -114,97 +172,223 @@ vtkDoubleArray* vtkMRMLWorkflowSequenceNode
   return doubleArrayNode->GetArray();
 }
 
+
+// Conversion to/from feature matrix ----------------------------------------------------------------
+
+// Note: Any data node that is not a double array of the right size will be treated as zeros
+void vtkMRMLWorkflowSequenceNode
+::ToFeatureMatrix( vtkWorkflowFeatureMatrix* featureMatrix )
+{
+  if ( featureMatrix == NULL )
+  {
+    return;
+  }
+
+  int numberOfComponents = this->GetNthNumberOfComponents( 0 );
+  featureMatrix->Initialize( this->GetNumberOfDataNodes(), numberOfComponents );
+  featureMatrix->GetTimes() = this->GetIndexValuesAsDouble();
+  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
+  {
+    vtkMRMLNode* currDataNode = this->GetNthDataNode( i );
+    if ( currDataNode != NULL && currDataNode->GetAttribute( "Message" ) != NULL )
+    {
+      featureMatrix->SetLabel( i, currDataNode->GetAttribute( "Message" ) );
+    }
+
+    vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( i );
+    if ( currDoubleArray == NULL || currDoubleArray->GetNumberOfComponents() != numberOfComponents || currDoubleArray->GetNumberOfTuples() < 1 )
+    {
+      continue;
+    }
+    std::copy( currDoubleArray->GetPointer( 0 ), currDoubleArray->GetPointer( 0 ) + numberOfComponents, featureMatrix->GetFrame( i ) );
+  }
+}
+
+
+// Note: If the frames line up with the current data nodes, then the values are updated in place
+// Otherwise, the data nodes are recreated from the matrix
+void vtkMRMLWorkflowSequenceNode
+::FromFeatureMatrix( vtkWorkflowFeatureMatrix* featureMatrix )
+{
+  if ( featureMatrix == NULL )
+  {
+    return;
+  }
+
+  const std::vector< double >& indexValues = this->GetIndexValuesAsDouble();
+  bool framesMatch = ( featureMatrix->GetNumberOfFrames() == indexValues.size() );
+  for ( int i = 0; framesMatch && i < indexValues.size(); i++ )
+  {
+    framesMatch = ( this->GetNthDoubleArray( i ) != NULL && indexValues[ i ] == featureMatrix->GetTime( i ) );
+  }
+
+  if ( framesMatch )
+  {
+    for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
+    {
+      vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( i );
+      featureMatrix->GetFrameAsDoubleArray( i, currDoubleArray );
+      vtkMRMLWorkflowSequenceNode::SetMessageAttribute( this->GetNthDataNode( i ), featureMatrix->GetLabel( i ) );
+    }
+    this->Modified();
+    this->IndexValuesAsDoubleTime = this->GetMTime(); // The index values have not changed
+    return;
+  }
+
+  this->RemoveAllDataNodes();
+  vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode > doubleArrayNode = vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode >::New();
+  for ( int i = 0; i < featureMatrix->GetNumberOfFrames(); i++ )
+  {
+    featureMatrix->GetFrameAsDoubleArray( i, doubleArrayNode->GetArray() );
+    vtkMRMLWorkflowSequenceNode::SetMessageAttribute( doubleArrayNode, featureMatrix->GetLabel( i ) );
+
+    std::stringstream timeStream;
+    timeStream.precision( 15 );
+    timeStream << featureMatrix->GetTime( i );
+    this->SetDataNodeAtValue( doubleArrayNode, timeStream.str() ); // Automatically deep copies
+  }
+}
+
+
+void vtkMRMLWorkflowSequenceNode
+::SetMessageAttribute( vtkMRMLNode* dataNode, std::string message )
+{
+  if ( dataNode == NULL )
+  {
+    return;
+  }
+
+  if ( message.empty() )
+  {
+    dataNode->RemoveAttribute( "Message" );
+  }
+  else
+  {
+    dataNode->SetAttribute( "Message", message.c_str() );
+  }
+}
+
 // Conversion from sequence browser -----------------------------------------------------------------
+
+// Helper for sorting messages by time
+class vtkWorkflowMessageTimeCompare
+{
+public:
+  bool operator()( const std::pair< double, int >& message1, const std::pair< double, int >& message2 ) const { return message1.first < message2.first; };
+};
+
 // TODO: Do we need conversion to sequence browser? Probably not...
 
 // Only use transforms with the correct transform name
-// Only keep the transforms who have associated messages that are relevant for this tool
+// Only keep the transforms who have associated messages that are relevant for this tool (unless the unlabelled transforms are requested too)
 void vtkMRMLWorkflowSequenceNode
-::FromTrackedSequenceBrowserNode( vtkMRMLSequenceBrowserNode* newTrackedSequenceBrowserNode, std::string proxyNodeID, std::string messagesProxyNodeID, std::vector< std::string > relevantMessages )
+::FromTrackedSequenceBrowserNode( vtkMRMLSequenceBrowserNode* newTrackedSequenceBrowserNode, std::string proxyNodeID, std::string messagesProxyNodeID, std::vector< std::string > relevantMessages, bool includeUnlabelled )
 {
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  vtkMRMLWorkflowSequenceNode::TrackedSequenceBrowserNodeToFeatureMatrix( newTrackedSequenceBrowserNode, proxyNodeID, messagesProxyNodeID, relevantMessages, featureMatrix, includeUnlabelled );
   this->RemoveAllDataNodes();
-  
+  this->FromFeatureMatrix( featureMatrix );
+}
+
+
+// Each transform is labelled by the most recent message (it is relevant if it is one of the relevant messages or a finishing message)
+// The transforms and the messages are both in time order, so they are merged with one cursor through the messages
+// Only transforms labelled with one of the relevant messages are kept, and they go straight into the matrix without any intermediate data nodes
+// If unlabelled transforms are included, all other transforms are kept with an empty label (and the messages are optional)
+void vtkMRMLWorkflowSequenceNode
+::TrackedSequenceBrowserNodeToFeatureMatrix( vtkMRMLSequenceBrowserNode* trackedSequenceBrowserNode, std::string proxyNodeID, std::string messagesProxyNodeID, std::vector< std::string > relevantMessages, vtkWorkflowFeatureMatrix* featureMatrix, bool includeUnlabelled )
+{
+  if ( featureMatrix == NULL )
+  {
+    return;
+  }
+  featureMatrix->Initialize( 0, QUATERNION_ARRAY ); // Use quaternions
+  if ( trackedSequenceBrowserNode == NULL || trackedSequenceBrowserNode->GetScene() == NULL )
+  {
+    return;
+  }
+
   // Populate the list of finishing messages
   std::vector< std::string > finishingMessages;
   finishingMessages.push_back( "Done" );
   finishingMessages.push_back( "End" );
   finishingMessages.push_back( "Finished" );
 
-  vtkMRMLLinearTransformNode* proxyNode = vtkMRMLLinearTransformNode::SafeDownCast( newTrackedSequenceBrowserNode->GetScene()->GetNodeByID( proxyNodeID ) );
+  vtkMRMLLinearTransformNode* proxyNode = vtkMRMLLinearTransformNode::SafeDownCast( trackedSequenceBrowserNode->GetScene()->GetNodeByID( proxyNodeID ) );
   if ( proxyNode == NULL )
   {
     return;
   }
 
-  vtkMRMLSequenceNode* sequenceNode = newTrackedSequenceBrowserNode->GetSequenceNode( proxyNode );
+  vtkMRMLSequenceNode* sequenceNode = trackedSequenceBrowserNode->GetSequenceNode( proxyNode );
   if ( sequenceNode == NULL )
   {
     return;
   }
 
-  vtkMRMLNode* messagesProxyNode = newTrackedSequenceBrowserNode->GetScene()->GetNodeByID( messagesProxyNodeID );
-  vtkMRMLSequenceNode* messagesSequenceNode = newTrackedSequenceBrowserNode->GetSequenceNode( messagesProxyNode );
-  if ( messagesSequenceNode == NULL )
+  vtkMRMLNode* messagesProxyNode = trackedSequenceBrowserNode->GetScene()->GetNodeByID( messagesProxyNodeID );
+  vtkMRMLSequenceNode* messagesSequenceNode = NULL;
+  if ( messagesProxyNode != NULL )
   {
-    return;
+    messagesSequenceNode = trackedSequenceBrowserNode->GetSequenceNode( messagesProxyNode );
   }
-
-  // Add the transform nodes to this workflow sequence as double array nodes
-  vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode > doubleArrayNode = vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode >::New();
-  for ( int i = 0; i < sequenceNode->GetNumberOfDataNodes(); i++ )
-  {    
-    this->LinearTransformToDoubleArray( vtkMRMLLinearTransformNode::SafeDownCast( sequenceNode->GetNthDataNode( i ) ), doubleArrayNode, QUATERNION_ARRAY ); // Use quaternions
-    this->SetDataNodeAtValue( doubleArrayNode, sequenceNode->GetNthIndexValue( i ) );
+  if ( messagesSequenceNode == NULL && ! includeUnlabelled )
+  {
+    return;
   }
 
-  // We need to convert the transforms into vtkDoubleArrays
-  // This is a NumTransforms by NumMessages order algorithm anyway...
-  // This will work because the messages are sorted by increased time
-  for ( int i = 0; i < messagesSequenceNode->GetNumberOfDataNodes(); i++ )
+  // Times of the relevant messages, with the index of the relevant message (-1 for finishing messages)
+  std::vector< std::pair< double, int > > messages;
+  for ( int i = 0; messagesSequenceNode != NULL && i < messagesSequenceNode->GetNumberOfDataNodes(); i++ )
   {
-    // Only accept if message is relevant
-    bool relevant = false;
-    std::string messageValue = messagesSequenceNode->GetNthDataNode( i )->GetAttribute( "Message" );
-    for ( int j = 0; j < relevantMessages.size(); j++ )
-	  {
-      if ( messageValue.compare( relevantMessages.at( j ) ) == 0 )
-	    {
-        relevant = true;
-	    }
-	  }
-    for ( int j = 0; j < finishingMessages.size(); j++ )
+    vtkMRMLNode* currMessageNode = messagesSequenceNode->GetNthDataNode( i );
+    if ( currMessageNode == NULL || currMessageNode->GetAttribute( "Message" ) == NULL )
     {
-      if ( messageValue.compare( finishingMessages.at( j ) ) == 0 )
-	    {
-        relevant = true;
-	    }
+      continue;
     }
+    std::string messageValue = currMessageNode->GetAttribute( "Message" );
 
-	  // Skip if the message is not relevant 
-    if ( ! relevant )
+    int relevantIndex = std::find( relevantMessages.begin(), relevantMessages.end(), messageValue ) - relevantMessages.begin();
+    if ( relevantIndex == relevantMessages.size() )
     {
-      continue;
+      relevantIndex = -1;
+      if ( std::find( finishingMessages.begin(), finishingMessages.end(), messageValue ) == finishingMessages.end() )
+      {
+        continue; // Skip if the message is not relevant
+      }
     }
 
-    std::stringstream messageTimeStream( messagesSequenceNode->GetNthIndexValue( i ) ); // Does not have subclass method
-    double messageTime; messageTimeStream >> messageTime;
-    
-	  for ( int j = 0; j < this->GetNumberOfDataNodes(); j++ )
-	  {
-      double doubleArrayTime = this->GetNthIndexValueAsDouble( j );
+    messages.push_back( std::make_pair( vtkMRMLWorkflowSequenceNode::IndexValueToDouble( messagesSequenceNode->GetNthIndexValue( i ) ), relevantIndex ) );
+  }
+  // The messages should already be in time order, but make sure (later messages still win when the times are equal)
+  std::stable_sort( messages.begin(), messages.end(), vtkWorkflowMessageTimeCompare() );
 
-      if ( doubleArrayTime >= messageTime )
-	    {
-        this->GetNthDataNode( j )->SetAttribute( "Message", messageValue.c_str() );
-	    }
-	  }
+  featureMatrix->Reserve( sequenceNode->GetNumberOfDataNodes() );
+  vtkNew< vtkMatrix4x4 > transformMatrix;
+  double values[ QUATERNION_ARRAY ];
+  int currMessage = -1;
+  for ( int i = 0; i < sequenceNode->GetNumberOfDataNodes(); i++ )
+  {
+    double currTime = vtkMRMLWorkflowSequenceNode::IndexValueToDouble( sequenceNode->GetNthIndexValue( i ) );
+    while ( currMessage + 1 < messages.size() && messages.at( currMessage + 1 ).first <= currTime )
+    {
+      currMessage++;
+    }
+    int relevantIndex = ( currMessage < 0 ) ? -1 : messages.at( currMessage ).second;
+    if ( relevantIndex < 0 && ! includeUnlabelled )
+    {
+      continue;
+    }
 
+    vtkMRMLLinearTransformNode* currTransformNode = vtkMRMLLinearTransformNode::SafeDownCast( sequenceNode->GetNthDataNode( i ) );
+    if ( currTransformNode == NULL )
+    {
+      continue;
+    }
+    currTransformNode->GetMatrixTransformToParent( transformMatrix.GetPointer() );
+    vtkMRMLWorkflowSequenceNode::LinearTransformToValues( transformMatrix.GetPointer(), values, QUATERNION_ARRAY );
+    featureMatrix->AppendFrame( currTime, values, ( relevantIndex < 0 ) ? "" : relevantMessages.at( relevantIndex ) );
   }
-
-  // Only get the subsequence that actually has relevant messages
-  vtkNew< vtkMRMLWorkflowSequenceNode > relevantSubsequence;
-  this->GetLabelledSubsequence( relevantMessages, relevantSubsequence.GetPointer() );
-  this->Copy( relevantSubsequence.GetPointer() );
 }
 
 
@@ -215,97 +399,125 @@ void vtkMRMLWorkflowSequenceNode
 void vtkMRMLWorkflowSequenceNode
 ::GetSubsequence( int startItemNumber, int endItemNumber, vtkMRMLWorkflowSequenceNode* subsequence )
 {
-  subsequence->RemoveAllDataNodes();
-  // Iterate over all tracking records in the current procedure, and add to new
-  for ( int i = startItemNumber; i <= endItemNumber; i++ )
-  {
-    subsequence->SetDataNodeAtValue( this->GetNthDataNode( i ), this->GetNthIndexValue( i ) ); // OK because the data node is always deep copied
-  }
+  this->GetSubsequenceView( startItemNumber, endItemNumber ).Materialize( subsequence );
 }
 
 
 void vtkMRMLWorkflowSequenceNode
 ::GetLabelledSubsequence( std::vector< std::string > labels, vtkMRMLWorkflowSequenceNode* subsequence )
 {
-  subsequence->RemoveAllDataNodes();
-  // Iterate over all item in the sequence
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
-  {
-    vtkMRMLNode* currentDataNode = this->GetNthDataNode( i );
-    if ( currentDataNode == NULL
-      || currentDataNode->GetAttribute( "Message" ) == NULL
-      || strcmp( currentDataNode->GetAttribute( "Message" ), "" ) == 0 )
-    {
-      continue;
-    }
-    
-    // Check if the current record satisfies one of the labels
-    for ( int j = 0; j < labels.size(); j++ )
-	  {
-      if ( labels.at( j ).compare( currentDataNode->GetAttribute( "Message" ) ) == 0 )
-	    {        
-        subsequence->SetDataNodeAtValue( currentDataNode, this->GetNthIndexValue( i ) ); // OK because the data node is always deep copied
-	    }
-	  }
-    
-  }
+  this->GetLabelledSubsequenceView( labels ).Materialize( subsequence );
+}
+
 
+vtkWorkflowSequenceView vtkMRMLWorkflowSequenceNode
+::GetSubsequenceView( int startItemNumber, int endItemNumber )
+{
+  vtkWorkflowSequenceView subsequenceView( this );
+  subsequenceView.SetRange( startItemNumber, endItemNumber );
+  return subsequenceView;
 }
 
 
+vtkWorkflowSequenceView vtkMRMLWorkflowSequenceNode
+::GetLabelledSubsequenceView( std::vector< std::string > labels )
+{
+  vtkWorkflowSequenceView subsequenceView( this );
+  subsequenceView.SetLabelledFrames( labels );
+  return subsequenceView;
+}
+
 
 void vtkMRMLWorkflowSequenceNode
 ::Concatenate( vtkMRMLWorkflowSequenceNode* sequence, bool enforceUniqueIndexValues /* = false */ )
 {
-  // Note: If there are identical indices in the two sequences, there will only be one instance of it in the resulting concatenated sequence.
-  // It will be the other sequence's node at that index
-  // Handle some edge cases, ensuring that both sequences have at least one item
-  if ( sequence->GetNumberOfDataNodes() == 0 )
+  vtkNew< vtkCollection > sequences;
+  sequences->AddItem( sequence );
+  this->Concatenate( sequences.GetPointer(), enforceUniqueIndexValues );
+}
+
+
+// This appends the other sequences' data nodes in place, so each data node is only copied once
+// Note: If there are identical indices in the sequences, there will only be one instance of it in the resulting concatenated sequence.
+// It will be the later sequence's node at that index
+void vtkMRMLWorkflowSequenceNode
+::Concatenate( vtkCollection* sequences, bool enforceUniqueIndexValues /* = false */ )
+{
+  if ( sequences == NULL )
   {
     return;
   }
-  if ( this->GetNumberOfDataNodes() == 0 )
+
+  vtkNew< vtkCollectionIterator > sequencesIt; sequencesIt->SetCollection( sequences );
+  for ( sequencesIt->InitTraversal(); ! sequencesIt->IsDoneWithTraversal(); sequencesIt->GoToNextItem() )
   {
-    this->Copy( sequence );
-    return;
+    vtkMRMLWorkflowSequenceNode* currSequence = vtkMRMLWorkflowSequenceNode::SafeDownCast( sequencesIt->GetCurrentObject() );
+    // Handle some edge cases, ensuring that both sequences have at least one item
+    if ( currSequence == NULL || currSequence->GetNumberOfDataNodes() == 0 )
+    {
+      continue;
+    }
+    if ( this->GetNumberOfDataNodes() == 0 )
+    {
+      this->Copy( currSequence );
+      continue;
+    }
+
+    // Need to check that the size of the double array nodes are the same...
+    if ( this->GetNthNumberOfComponents() != currSequence->GetNthNumberOfComponents() )
+    {
+      vtkWarningMacro("vtkMRMLWorkflowSequenceNode::Concatenate: Sequences are incompatible, could not concatenate.");
+      continue;
+    }
+
+    if ( ! enforceUniqueIndexValues )
+    {
+      for ( int i = 0; i < currSequence->GetNumberOfDataNodes(); i++ )
+      {
+        this->SetDataNodeAtValue( currSequence->GetNthDataNode( i ), currSequence->GetNthIndexValue( i ) ); // OK because the data node is always deep copied
+      }
+      continue;
+    }
+
+    // Renumber the current items only if they are not already numbered (i.e. the first time)
+    this->RenumberIndexValues();
+    int uniqueIndexInt = this->GetNumberOfDataNodes();
+    for ( int i = 0; i < currSequence->GetNumberOfDataNodes(); i++ )
+    {
+      this->AppendDataNode( currSequence->GetNthDataNode( i ), std::to_string( uniqueIndexInt ) ); // OK because the data node is always deep copied
+      uniqueIndexInt++;
+    }
   }
+}
 
-  // Need to check that the size of the double array nodes are the same...
-  if ( this->GetNthNumberOfComponents() != sequence->GetNthNumberOfComponents() )
+
+// Number the items 0, 1, 2, ... (in their current order)
+void vtkMRMLWorkflowSequenceNode
+::RenumberIndexValues()
+{
+  const std::vector< double >& indexValues = this->GetIndexValuesAsDouble();
+  bool numbered = true;
+  for ( int i = 0; numbered && i < indexValues.size(); i++ )
+  {
+    numbered = ( indexValues[ i ] == i );
+  }
+  if ( numbered )
   {
-    vtkWarningMacro("vtkMRMLWorkflowSequenceNode::Concatenate: Sequences are incompatible, could not concatenate.");
     return;
   }
 
-  // Create a copy for grabbing indices from
-  vtkNew< vtkMRMLWorkflowSequenceNode > tempConcatenatedSequence;
-
-  // Note: This works if the index is numeric or text
-  int uniqueIndexInt = 0;
+  // Hold on to the data nodes while they are re-added
+  std::vector< vtkSmartPointer< vtkMRMLNode > > dataNodes;
   for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
   {
-    std::string indexValue = this->GetNthIndexValue( i );
-    if ( enforceUniqueIndexValues )
-    {
-      std::stringstream uniqueIndexStream; uniqueIndexStream << uniqueIndexInt;
-      indexValue = uniqueIndexStream.str();
-      uniqueIndexInt++;
-    }
-    tempConcatenatedSequence->SetDataNodeAtValue( this->GetNthDataNode( i ), indexValue ); // OK because the data node is always deep copied
+    dataNodes.push_back( this->GetNthDataNode( i ) );
   }
-  for ( int i = 0; i < sequence->GetNumberOfDataNodes(); i++ )
+
+  this->RemoveAllDataNodes();
+  for ( int i = 0; i < dataNodes.size(); i++ )
   {
-    std::string indexValue = sequence->GetNthIndexValue( i );
-    if ( enforceUniqueIndexValues )
-    {
-      std::stringstream uniqueIndexStream; uniqueIndexStream << uniqueIndexInt;
-      indexValue = uniqueIndexStream.str();
-      uniqueIndexInt++;
-    }
-    tempConcatenatedSequence->SetDataNodeAtValue( sequence->GetNthDataNode( i ), indexValue ); // OK because the data node is always deep copied
+    this->SetDataNodeAtValue( dataNodes.at( i ), std::to_string( i ) ); // OK because the data node is always deep copied
   }
-
-  this->Copy( tempConcatenatedSequence.GetPointer() );
 }
 
 
@@ -333,7 +545,10 @@ void vtkMRMLWorkflowSequenceNode
 
     thisDoubleArray->DeepCopy( concatenatedDoubleArray );
   }
-  
+
+  // The values were changed in place (so nothing else marks the sequence as modified)
+  this->Modified();
+  this->IndexValuesAsDoubleTime = this->GetMTime(); // The index values have not changed
 }
 
 
@@ -373,6 +588,8 @@ void vtkMRMLWorkflowSequenceNode
     thisDoubleArray->DeepCopy( concatenatedDoubleArray );
   }
 
+  this->Modified();
+  this->IndexValuesAsDoubleTime = this->GetMTime(); // The index values have not changed
 }
 
 
@@ -412,38 +629,9 @@ void vtkMRMLWorkflowSequenceNode
 void vtkMRMLWorkflowSequenceNode
 ::Mean( vtkDoubleArray* meanArray )
 {
-  if ( meanArray == NULL )
-  {
-    return;
-  }
-
-  meanArray->SetNumberOfComponents( this->GetNthNumberOfComponents( 0 ) );
-  meanArray->SetNumberOfTuples( 1 );
-  this->FillDoubleArray( meanArray, 0 );
-
-  // For each time
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
-  {
-    vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( i );
-    if ( currDoubleArray == NULL || currDoubleArray->GetNumberOfComponents() != meanArray->GetNumberOfComponents() )
-    {
-      continue;
-    }
-
-	  // Iterate over all dimensions
-	  for ( int d = 0; d < meanArray->GetNumberOfComponents(); d++ )
-	  {
-      meanArray->SetComponent( 0, d, meanArray->GetComponent( 0, d ) + currDoubleArray->GetComponent( 0, d ) );
-	  }
-
-  }
-
-  // Divide by the number of records
-  for ( int d = 0; d < meanArray->GetNumberOfComponents(); d++ )
-  {
-    meanArray->SetComponent( 0, d, meanArray->GetComponent( 0, d ) / this->GetNumberOfDataNodes() );
-  }
-
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->Mean( meanArray );
 }
 
 
@@ -451,812 +639,205 @@ void vtkMRMLWorkflowSequenceNode
 ::Distances( vtkMRMLWorkflowSequenceNode* sequence, vtkDoubleArray* distances )
 {
   // Put the other sequence into a double array
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > sequenceMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  sequence->ToFeatureMatrix( sequenceMatrix );
+
   vtkSmartPointer< vtkDoubleArray > doubleArray = vtkSmartPointer< vtkDoubleArray >::New();
-  doubleArray->SetNumberOfComponents( sequence->GetNthNumberOfComponents() );
-  doubleArray->SetNumberOfTuples( sequence->GetNumberOfDataNodes() );  
-    
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
+  doubleArray->SetNumberOfComponents( sequenceMatrix->GetNumberOfComponents() );
+  doubleArray->SetNumberOfTuples( sequenceMatrix->GetNumberOfFrames() );
+  for ( int i = 0; i < sequenceMatrix->GetNumberOfFrames(); i++ )
   {
-    vtkDoubleArray* doubleArray = this->GetNthDoubleArray( i );
-    if ( doubleArray == NULL )
-    {
-      continue;
-    }
-    
-    doubleArray->SetTuple( i, 0, doubleArray );
+    doubleArray->SetTypedTuple( i, sequenceMatrix->GetFrame( i ) );
   }
   
   this->Distances( doubleArray, distances );
 }
 
 
-
 void vtkMRMLWorkflowSequenceNode
 ::Distances( vtkDoubleArray* testPoints, vtkDoubleArray* distances )
 {
-  // Create a vector of vectors
-  distances->SetNumberOfComponents( testPoints->GetNumberOfTuples() );
-  distances->SetNumberOfTuples( this->GetNumberOfDataNodes() );
-  
-
-  // Otherwise, calculate the vectors based on distances from this's records
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
-  {
-    for ( int j = 0; j < testPoints->GetNumberOfTuples(); j++ )
-	  {      
-      // First, ensure that the records are the same size
-      vtkDoubleArray* currThisDoubleArray = this->GetNthDoubleArray( i );
-      if ( currThisDoubleArray == NULL || testPoints->GetNumberOfComponents() != currThisDoubleArray->GetNumberOfComponents() )
-      {
-        continue;
-      }
-      
-      // Initialize the sum to zero
-	    double currSum = 0;
-      for ( int d = 0; d < currThisDoubleArray->GetNumberOfComponents(); d++ )
-	    {
-        double currDiff = currThisDoubleArray->GetComponent( 0, d ) - testPoints->GetComponent( j, d );
-        currSum += currDiff * currDiff;
-	    }
-	    
-      // Add to the current order record
-	    distances->SetComponent( i, j, sqrt( currSum ) );
-	  }
-  }
-
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->Distances( testPoints, distances );
 }
 
 
-// Calculate the record in the buffer that is closest to a particular point
+// Use this if only the ordering of the distances matters
 void vtkMRMLWorkflowSequenceNode
-::ClosestRecords( vtkDoubleArray* testPoints, vtkDoubleArray* closest )
+::SquaredDistances( vtkDoubleArray* testPoints, vtkDoubleArray* distances )
 {
-  // Initialize the output
-  closest->SetNumberOfComponents( testPoints->GetNumberOfComponents() );
-  closest->SetNumberOfTuples( testPoints->GetNumberOfTuples() );
-
-  if ( this->GetNthNumberOfComponents() != testPoints->GetNumberOfComponents() )
-  {
-    return;
-  }
-
-  // Calculate the distance to this point
-  vtkNew< vtkDoubleArray > distances;
-  this->Distances( testPoints, distances.GetPointer() );
-
-  // Now find the closest point
-  
-  for ( int i = 0; i < testPoints->GetNumberOfTuples(); i++ )
-  {
-    for ( int j = 0; j < this->GetNumberOfDataNodes(); j++ )
-    {
-      double minimumDistance = std::numeric_limits< double >::max(); 
-      if ( distances->GetComponent( j, i ) < minimumDistance )
-	    {
-        minimumDistance = distances->GetComponent( j, i );
-        closest->SetTuple( i, 0, this->GetNthDoubleArray( j ) );
-	    }
-    }
-  }
-
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->SquaredDistances( testPoints, distances );
 }
 
 
-
-
-void vtkMRMLWorkflowSequenceNode
-::Differentiate( int order )
+// The index is rebuilt only when the sequence has been modified, so repeated queries are cheap
+// Note: Anything that changes the values in place must call Modified()
+vtkWorkflowNearestNeighbours* vtkMRMLWorkflowSequenceNode
+::GetNearestNeighbours()
 {
-  // If a derivative of order zero is required, then return a copy of this
-  if ( this->GetNumberOfDataNodes() < 2 || order == 0 )
+  if ( this->NearestNeighbours == NULL || this->GetMTime() > this->NearestNeighboursTime
+    || this->NearestNeighbours->GetNumberOfPoints() != this->GetNumberOfDataNodes()
+    || this->NearestNeighbours->GetNumberOfComponents() != this->GetNthNumberOfComponents() )
   {
-    return;
-  }
-
-  // Otherwize calculate the derivative  
-  vtkSmartPointer< vtkMRMLWorkflowSequenceNode > derivativeSequenceNode = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-  derivativeSequenceNode->Copy( this );
-
-  // Use a centred difference formula (except at the endpoints, use a forward/backwar difference formula)
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
-  {
-    int lowerItemNumber = std::max( i - 1, 0 );
-    int middleItemNumber = i;
-    int upperItemNumber = std::min( i + 1, this->GetNumberOfDataNodes() - 1 );
+    vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+    this->ToFeatureMatrix( featureMatrix );
 
-    vtkDoubleArray* lowerDoubleArray = this->GetNthDoubleArray( lowerItemNumber );
-    vtkDoubleArray* upperDoubleArray = this->GetNthDoubleArray( upperItemNumber );
-    if ( lowerDoubleArray == NULL || upperDoubleArray == NULL || lowerDoubleArray->GetNumberOfComponents() != upperDoubleArray->GetNumberOfComponents() )
-    {
-      vtkWarningMacro( "vtkMRMLWorkflowSequenceNode::Differentiate: Cannot perform computation - sequence data nodes are incompatible.");
-      continue;
-    }
-
-    vtkSmartPointer< vtkDoubleArray > tempDerivativeDoubleArray = vtkSmartPointer< vtkDoubleArray >::New();
-    tempDerivativeDoubleArray->SetNumberOfComponents( lowerDoubleArray->GetNumberOfComponents() );
-    tempDerivativeDoubleArray->SetNumberOfTuples( 1 );
-
-    double deltaTime = this->GetNthIndexValueAsDouble( upperItemNumber ) - this->GetNthIndexValueAsDouble( lowerItemNumber );
-    for( int d = 0; d < lowerDoubleArray->GetNumberOfComponents(); d++ )
-    {
-      tempDerivativeDoubleArray->SetComponent( 0, d, ( upperDoubleArray->GetComponent( 0, d ) - lowerDoubleArray->GetComponent( 0, d ) ) / deltaTime );
-    }
-
-    vtkDoubleArray* derivativeDoubleArray = derivativeSequenceNode->GetNthDoubleArray( i );
-    if ( derivativeDoubleArray == NULL )
-    {
-      continue; 
-    }
-    derivativeDoubleArray->DeepCopy( tempDerivativeDoubleArray );
-  }
-  
-  // Set this to be the differentiated buffer
-  this->Copy( derivativeSequenceNode );
-  this->Differentiate( order - 1 );
-}
-
-
-
-void vtkMRMLWorkflowSequenceNode
-::Integrate( vtkDoubleArray* integration )
-{
-  // Initialize the output
-  integration->SetNumberOfComponents( this->GetNthNumberOfComponents( 0 ) );
-  integration->SetNumberOfTuples( 1 );
-  this->FillDoubleArray( integration, 0 );
-
-  // Use the trapezoidal rule
-  for ( int i = 1; i < this->GetNumberOfDataNodes(); i++ )
-  {
-	  // Find the time difference
-    vtkDoubleArray* lowerDoubleArray = this->GetNthDoubleArray( i - 1 );
-    vtkDoubleArray* upperDoubleArray = this->GetNthDoubleArray( i );
-    if ( lowerDoubleArray == NULL || upperDoubleArray == NULL || lowerDoubleArray->GetNumberOfComponents() != upperDoubleArray->GetNumberOfComponents() )
-    {
-      vtkWarningMacro("vtkMRMLWorkflowSequenceNode::Differentiate: Cannot perform computation - sequence data nodes are incompatible.");
-    }
-
-    double deltaTime = this->GetNthIndexValueAsDouble( i ) - this->GetNthIndexValueAsDouble( i - 1 );
-	  for ( int d = 0; d < lowerDoubleArray->GetNumberOfComponents(); d++ )
-	  {
-	    integration->SetComponent( 0, d, integration->GetComponent( 0, d ) + deltaTime * ( lowerDoubleArray->GetComponent( 0, d ) + upperDoubleArray->GetComponent( 0, d ) ) / 2 );
-	  }
+    this->NearestNeighbours = vtkSmartPointer< vtkWorkflowNearestNeighbours >::New();
+    this->NearestNeighbours->SetPoints( featureMatrix->GetValues(), featureMatrix->GetNumberOfFrames(), featureMatrix->GetNumberOfComponents() );
+    this->NearestNeighboursTime = this->GetMTime();
   }
 
+  return this->NearestNeighbours;
 }
 
 
+// The item number of the closest record to each test point (and its squared distance)
 void vtkMRMLWorkflowSequenceNode
-::LegendreTransformation( int order, vtkDoubleArray* legendreCoefficients )
+::FindClosestRecords( vtkDoubleArray* testPoints, std::vector< int >& closestRecords, std::vector< double >& squaredDistances )
 {
-  legendreCoefficients->SetNumberOfComponents( this->GetNthNumberOfComponents( 0 ) );
-  legendreCoefficients->SetNumberOfTuples( order + 1 );
-
-  // Calculate the time adjustment (need range -1 to 1)
-  double startTime = this->GetNthIndexValueAsDouble( 0 );
-  double endTime = this->GetNthIndexValueAsDouble( this->GetNumberOfDataNodes() - 1 );
-  double timeRange = endTime - startTime;
-  if ( timeRange <= 0 )
-  {
-    vtkWarningMacro( "vtkMRMLWorkflowSequenceNode::LegendreTransformation: Improper time range." );
-    return;
-  }
-
-  // Populate the coefficient matrix
-  for ( int o = 0; o <= order; o++ )
-  {
-	  vtkSmartPointer< vtkMRMLWorkflowSequenceNode > unintegratedSequenceNode = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-
-    // Multiply the values by the Legendre polynomials
-    for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
-    {
-      double adjustedTime = 2 * ( this->GetNthIndexValueAsDouble( i ) - startTime ) / timeRange - 1;
-      double legendrePolynomial = this->LegendrePolynomial( adjustedTime, o );
-
-	    vtkSmartPointer< vtkDoubleArray > tempUnintegratedDoubleArray = vtkSmartPointer< vtkDoubleArray >::New();
-      tempUnintegratedDoubleArray->SetNumberOfComponents( this->GetNthNumberOfComponents( i ) );
-      tempUnintegratedDoubleArray->SetNumberOfTuples( 1 );
-
-      vtkDoubleArray* currentDoubleArray = this->GetNthDoubleArray( i );
-      for ( int d = 0; d < this->GetNthNumberOfComponents( i ); d++ )
-	    {	    
-        tempUnintegratedDoubleArray->SetComponent( 0, d, currentDoubleArray->GetComponent( 0, d ) * legendrePolynomial );
-	    }
-
-      vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode > unintegratedDataNode = vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode >::New();
-      vtkDoubleArray* unintegratedDoubleArray = unintegratedDataNode->GetArray();
-      if ( unintegratedDoubleArray == NULL )
-      {
-        continue;
-      }
-      unintegratedDoubleArray->DeepCopy( tempUnintegratedDoubleArray );
-
-      std::stringstream adjustedTimeString; adjustedTimeString << adjustedTime;
-      unintegratedSequenceNode->SetDataNodeAtValue( unintegratedDataNode, adjustedTimeString.str() );
-    }
-
-	  // Integrate to get the Legendre coefficients for the particular order
-    vtkSmartPointer< vtkDoubleArray > integration = vtkSmartPointer< vtkDoubleArray >::New();
-    unintegratedSequenceNode->Integrate( integration );
-    legendreCoefficients->SetTuple( o, 0, integration );
-  }
-
+  this->GetNearestNeighbours()->FindClosestPoints( testPoints, closestRecords, squaredDistances );
 }
 
 
-
-double vtkMRMLWorkflowSequenceNode
-::LegendrePolynomial( double time, int order )
-{
-  if ( order == 0 )
-  {
-    return 1;
-  }
-  if ( order == 1 )
-  {
-    return time;
-  }
-  if ( order == 2 )
-  {
-    return 3.0 / 2.0 * pow( time, 2.0 ) - 1.0 / 2.0;
-  }
-  if ( order == 3 )
-  {
-    return 5.0 / 2.0 * pow( time, 3.0 ) - 3.0 / 2.0 * time;
-  }
-  if ( order == 4 )
-  {
-    return 35.0 / 8.0 * pow( time, 4.0 ) - 15.0 / 4.0 * pow( time, 2.0 ) + 3.0 / 8.0;
-  }
-  if ( order == 5 )
-  {
-    return 63.0 / 8.0 * pow( time, 5.0 ) - 35.0 / 4.0 * pow( time, 3.0 ) + 15.0 / 8.0 * time;
-  }
-  if ( order == 6 )
-  {
-    return 231.0 / 16.0 * pow( time, 6.0 ) - 315.0 / 16.0 * pow( time, 4.0 ) + 105.0 / 16.0 * pow( time, 2.0 ) - 5.0 / 16.0;
-  }
-
-  return 0.0;
-}
-
-
-
+// Calculate the record in the buffer that is closest to a particular point
 void vtkMRMLWorkflowSequenceNode
-::GaussianFilter( double width )
+::ClosestRecords( vtkDoubleArray* testPoints, vtkDoubleArray* closest )
 {
-  // Assume a Gaussian filter
-  vtkSmartPointer< vtkMRMLWorkflowSequenceNode > gaussSequenceNode = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-  gaussSequenceNode->Copy( this );
+  // Initialize the output (test points with no closest record get zeros)
+  closest->SetNumberOfComponents( testPoints->GetNumberOfComponents() );
+  closest->SetNumberOfTuples( testPoints->GetNumberOfTuples() );
+  vtkMRMLWorkflowSequenceNode::FillDoubleArray( closest, 0.0 );
 
-  // For each record
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
+  if ( this->GetNumberOfDataNodes() == 0 || this->GetNthNumberOfComponents() != testPoints->GetNumberOfComponents() )
   {
-    // Get the current record
-    vtkSmartPointer< vtkDoubleArray > tempGaussDoubleArray = vtkSmartPointer< vtkDoubleArray >::New();
-    tempGaussDoubleArray->SetNumberOfComponents( this->GetNthNumberOfComponents( i ) );
-    tempGaussDoubleArray->SetNumberOfTuples( 1 );
-
-    // Iterate over all dimensions
-	  for ( int d = 0; d < this->GetNthNumberOfComponents( i ); d++ )
-	  {
-      double weightSum = 0.0;
-      double normSum = 0.0;
-
-      // Iterate over all records nearby to the left
-	    int j = i;
-	    while ( j >= 0 ) // Iterate backward
-      {
-        // Get the current double array
-        vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( j );
-        if ( currDoubleArray == NULL )
-        {
-          break;
-        }
-
-	      // If too far from "peak" of distribution, the stop - we're just wasting time
-	      double normalizedDistance = ( this->GetNthIndexValueAsDouble( j ) - this->GetNthIndexValueAsDouble( i ) ) / width;
-		    if ( abs( normalizedDistance ) > STDEV_CUTOFF )
-		    {
-		      break;
-		    }
-        
-        // Calculate the values of the Gaussian distribution at this time
-        double gaussianWeight = exp( - normalizedDistance * normalizedDistance / 2 );		    
-        weightSum = weightSum + currDoubleArray->GetComponent( 0, d ) * gaussianWeight; // Add the product with the values to function sum		    
-		    normSum = normSum + gaussianWeight; // Add the values to normSum
-
-		    j--;
-      }
-
-	    // Iterate over all records nearby to the right
-	    j = i + 1;
-	    while ( j < this->GetNumberOfDataNodes() ) // Iterate forward
-      {
-        // Get the current double array
-        vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( j );
-        if ( currDoubleArray == NULL )
-        {
-          break;
-        }
-
-	      // If too far from "peak" of distribution, the stop - we're just wasting time
-	      double normalizedDistance = ( this->GetNthIndexValueAsDouble( j ) - this->GetNthIndexValueAsDouble( i ) ) / width;
-		    if ( abs( normalizedDistance ) > STDEV_CUTOFF )
-		    {
-		      break;
-		    }
-        
-        // Calculate the values of the Gaussian distribution at this time
-        double gaussianWeight = exp( - normalizedDistance * normalizedDistance / 2 );		    
-        weightSum = weightSum + currDoubleArray->GetComponent( 0, d ) * gaussianWeight; // Add the product with the values to function sum		    
-		    normSum = normSum + gaussianWeight; // Add the values to normSum
-
-		    j++;
-      }
-
-	    // Add to the new values
-	    tempGaussDoubleArray->SetComponent( 0, d, weightSum / normSum );
-	  }
-
-	  // Add the new record vector to the record log
-    vtkDoubleArray* gaussDoubleArray = gaussSequenceNode->GetNthDoubleArray( i );
-    if ( gaussDoubleArray == NULL )
-    {
-      continue; 
-    }
-    gaussDoubleArray->DeepCopy( tempGaussDoubleArray );
+    return;
   }
 
-  this->Copy( gaussSequenceNode );
-}
-
-
-
-void vtkMRMLWorkflowSequenceNode
-::OrthogonalTransformation( int window, int order )
-{
-  // Pad the sequence with values at the beginning
-  vtkSmartPointer< vtkMRMLWorkflowSequenceNode > paddedSequenceNode = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-  paddedSequenceNode->Copy( this );
-  paddedSequenceNode->PadStart( window );
-
-  // Create a new record log with the orthogonally transformed data
-  vtkSmartPointer< vtkMRMLWorkflowSequenceNode > orthogonalSequenceNode = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-  orthogonalSequenceNode->Copy( this );
+  // Now find the closest point
+  std::vector< int > closestRecords;
+  std::vector< double > squaredDistances;
+  this->FindClosestRecords( testPoints, closestRecords, squaredDistances );
 
-  // Iterate over all data, and calculate Legendre expansion coefficients
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
+  for ( int i = 0; i < closestRecords.size() && i < closest->GetNumberOfTuples(); i++ )
   {
-    // Get a subsequence of the padded sequence
-    vtkSmartPointer< vtkMRMLWorkflowSequenceNode > subsequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-    paddedSequenceNode->GetSubsequence( i, i + window, subsequence );
-	  
-    vtkSmartPointer< vtkDoubleArray > legendreCoefficients = vtkSmartPointer< vtkDoubleArray >::New();
-    subsequence->LegendreTransformation( order, legendreCoefficients );
-
-    vtkSmartPointer< vtkDoubleArray > currLegendreDoubleArray = vtkSmartPointer< vtkDoubleArray >::New(); // To be passed to double array node
-    currLegendreDoubleArray->SetNumberOfComponents( legendreCoefficients->GetNumberOfTuples() * legendreCoefficients->GetNumberOfComponents() );
-    currLegendreDoubleArray->SetNumberOfTuples( 1 );
-
-	  // Calculate the Legendre coefficients: 2D -> 1D
-	  int count = 0;
-	  for ( int o = 0; o < legendreCoefficients->GetNumberOfTuples(); o++ )
+    if ( closestRecords.at( i ) < 0 )
     {
-      for ( int d = 0; d < legendreCoefficients->GetNumberOfComponents(); d++ )
-	    {
-        currLegendreDoubleArray->SetComponent( 0, count, legendreCoefficients->GetComponent( o, d ) );
-		    count++;
-	    }
+      continue;
     }
-
-	  // Add the computed values to the sequence
-    vtkDoubleArray* orthogonalDoubleArray = orthogonalSequenceNode->GetNthDoubleArray( i );
-    if ( orthogonalDoubleArray == NULL )
+    vtkDoubleArray* closestDoubleArray = this->GetNthDoubleArray( closestRecords.at( i ) );
+    if ( closestDoubleArray != NULL && closestDoubleArray->GetNumberOfComponents() == closest->GetNumberOfComponents() )
     {
-      continue; 
+      closest->SetTuple( i, 0, closestDoubleArray );
     }
-    orthogonalDoubleArray->DeepCopy( currLegendreDoubleArray );
   }
 
-  this->Copy( orthogonalSequenceNode );
 }
 
 
-vnl_matrix< double >* vtkMRMLWorkflowSequenceNode
-::CovarianceMatrix()
-{
-  // Copy the current record log
-  vtkSmartPointer< vtkMRMLWorkflowSequenceNode > zeroMeanSequenceNode = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-  zeroMeanSequenceNode->Copy( this );
-
-  // Construct a recordSize by recordSize vnl matrix
-  vnl_matrix< double >* covariance = new vnl_matrix< double >( this->GetNthNumberOfComponents( 0 ), this->GetNthNumberOfComponents( 0 ) );
-  covariance->fill( 0.0 );
-
-  // Determine the mean, subtract the mean from each record
-  vtkSmartPointer< vtkDoubleArray > meanArray = vtkSmartPointer< vtkDoubleArray >::New();
-  this->Mean( meanArray );
-
-  // Iterate over all times
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
-	{
-    vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( i );
-    if ( currDoubleArray == NULL )
-    {
-      continue;
-    }
-
-    // Pick two dimensions, and find their covariance
-    for ( int d1 = 0; d1 < currDoubleArray->GetNumberOfComponents(); d1++ )
-    {
-      for ( int d2 = 0; d2 < currDoubleArray->GetNumberOfComponents(); d2++ )
-	    {                
-        double meanSubtractedDimension1 = currDoubleArray->GetComponent( 0, d1 ) - meanArray->GetComponent( 0, d1 );
-        double meanSubtractedDimension2 = currDoubleArray->GetComponent( 0, d2 ) - meanArray->GetComponent( 0, d2 );
-	      covariance->put( d1, d2, covariance->get( d1, d2 ) + meanSubtractedDimension1 * meanSubtractedDimension2 );
-	    }
-	  }
-  }
-
-  // Divide by the number of data nodes
-  for ( int d1 = 0; d1 < covariance->rows(); d1++ )
-  {
-    for ( int d2 = 0; d2 < covariance->columns(); d2++ )
-	  {                
-	    covariance->put( d1, d2, covariance->get( d1, d2 ) / this->GetNumberOfDataNodes() );
-	  }
-	}
-
-
-  return covariance;
-}
-
-
-
 void vtkMRMLWorkflowSequenceNode
-::CalculatePrincipalComponents( int numComp, vtkDoubleArray* prinComps )
+::Differentiate( int order )
 {
-  // Calculate the covariance matrix
-  vnl_matrix< double >* covariance = this->CovarianceMatrix();
-
-  prinComps->SetNumberOfComponents( covariance->rows() );
-  prinComps->SetNumberOfTuples( numComp );
-
-  //Calculate the eigenvectors of the covariance matrix
-  vnl_matrix<double> eigenvectors( covariance->rows(), covariance->cols(), 0.0 );
-  vnl_vector<double> eigenvalues( covariance->rows(), 0.0 );
-  vnl_symmetric_eigensystem_compute( *covariance, eigenvectors, eigenvalues );
-  // Note: eigenvectors are ordered in increasing eigenvalue ( 0 = smallest, end = biggest )
-
-  // Prevent more prinicipal components than original dimensions
-  if ( numComp > eigenvectors.cols() )
-  {
-    numComp = eigenvectors.cols();
-  }
-
-  for ( int i = eigenvectors.cols() - 1; i > eigenvectors.cols() - 1 - numComp; i-- )
+  if ( this->GetNumberOfDataNodes() < 2 || order == 0 )
   {
-    for ( int d = 0; d < eigenvectors.rows(); d++ )
-	  {
-	    prinComps->SetComponent( eigenvectors.cols() - 1 - i, d, eigenvectors.get( d, i ) );
-	  }
+    return;
   }
 
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->Differentiate( order );
+  this->FromFeatureMatrix( featureMatrix );
 }
 
 
-
 void vtkMRMLWorkflowSequenceNode
-::TransformByPrincipalComponents( vtkDoubleArray* prinComps, vtkDoubleArray* meanArray )
+::Integrate( vtkDoubleArray* integration )
 {
-  // Iterate over all time stamps
-  for( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
-  {
-    vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( i );
-    if ( currDoubleArray == NULL )
-    {
-      return;
-    }
-
-    vtkSmartPointer< vtkDoubleArray > tempTransformedDoubleArray = vtkSmartPointer< vtkDoubleArray >::New();
-    tempTransformedDoubleArray->SetNumberOfComponents( prinComps->GetNumberOfTuples() );
-    tempTransformedDoubleArray->SetNumberOfTuples( 1 );
-    this->FillDoubleArray( tempTransformedDoubleArray, 0 );
-    
-    // Initialize the components of the transformed time record to be zero
-	  for ( int o = 0; o < prinComps->GetNumberOfTuples(); o++ )
-	  {
-	    // Iterate over all dimensions, and perform the transformation (i.e. vector multiplication)
-      for ( int d = 0; d < currDoubleArray->GetNumberOfComponents(); d++ )
-	    {
-        tempTransformedDoubleArray->SetComponent( 0, o, tempTransformedDoubleArray->GetComponent( 0, o ) + ( currDoubleArray->GetComponent( 0, d ) - meanArray->GetComponent( 0, d ) ) * prinComps->GetComponent( o, d ) );
-	    }
-	  }
-
-	  // Add the computed values to the sequence
-    vtkDoubleArray* transformedDoubleArray = this->GetNthDoubleArray( i );
-    if ( transformedDoubleArray == NULL )
-    {
-      continue; 
-    }
-    transformedDoubleArray->DeepCopy( tempTransformedDoubleArray );
-  }
-
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->Integrate( integration );
 }
 
 
-
 void vtkMRMLWorkflowSequenceNode
-::fwdkmeans( int numClusters, vtkDoubleArray* centroids )
+::LegendreTransformation( int order, vtkDoubleArray* legendreCoefficients )
 {
-  centroids->SetNumberOfComponents( this->GetNthNumberOfComponents( 0 ) );
-  centroids->SetNumberOfTuples( 0 );
-  
-
-  // A vector of cluster memberships
-  std::vector< int > membership( this->GetNumberOfDataNodes(), 0 );
-
-  // Iterate until all of the clusters have been added
-  for ( int k = 0; k < numClusters; k++ )
-  {
-
-	  // Use closest point to the mean of all points for the first centroid
-    if ( k == 0 )
-	  {
-      vtkSmartPointer< vtkDoubleArray > initialCentroid = vtkSmartPointer< vtkDoubleArray >::New();
-      this->Mean( initialCentroid );
-      centroids->InsertNextTuple( 0, initialCentroid );
-	    continue;
-	  }
-
-    vtkSmartPointer< vtkDoubleArray > nextCentroid = vtkSmartPointer< vtkDoubleArray >::New();
-    this->FindNextCentroid( centroids, nextCentroid );
-    centroids->InsertNextTuple( 0, nextCentroid );
-
-	  // Iterate until there are no more changes in membership and no clusters are empty
-    bool change = true;
-	  while ( change )
-	  {
-	    // Reassign the cluster memberships
-	    std::vector< int > newMembership = this->ReassignMembership( centroids );
-
-	    // Calculate change
-	    change = this->MembershipChanged( membership, newMembership );
-      if ( ! change )
-	    {
-        break;
-	    }
-	    membership = newMembership;
-
-	    // Remove emptiness
-	    std::vector< bool > emptyVector = this->FindEmptyClusters( centroids, membership );
-      if ( this->HasEmptyClusters( emptyVector ) )
-	    {
-        this->MoveEmptyClusters( centroids, emptyVector );
-		    // At the end of this, we are guaranteed no empty clusters
-        continue;
-	    }	  
-
-	    // Recalculate centroids
-	    this->RecalculateCentroids( membership, k + 1, centroids );
-
-	  }
-
-  }
-
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->LegendreTransformation( order, legendreCoefficients );
 }
 
 
-
-
 void vtkMRMLWorkflowSequenceNode
-::FindNextCentroid( vtkDoubleArray* centroids, vtkDoubleArray* nextCentroid )
-{
-  // Initialize
-  nextCentroid->SetNumberOfComponents( centroids->GetNumberOfComponents() );
-  nextCentroid->SetNumberOfTuples( 1 );
-
-
-  // Find the record farthest from any centroid
-  vtkSmartPointer< vtkDoubleArray > centroidDistances = vtkSmartPointer< vtkDoubleArray >::New();
-  this->Distances( centroids, centroidDistances );
-	
-  int candidateItemNumber = 0;
-  double candidateDistance = 0;
-
-  for ( int i = 0; i < centroidDistances->GetNumberOfTuples(); i++ )
-  {
-    double currMinDist = std::numeric_limits< double >::max();
-    // Minimum for each point
-    for ( int c = 0; c < centroidDistances->GetNumberOfComponents(); c++ )
-	  {
-      if ( centroidDistances->GetComponent( i, c ) < currMinDist )
-	    {
-        currMinDist = centroidDistances->GetComponent( i, c );
-	    }
-	  }
-	
-	  // Maximum of the minimums
-    if ( currMinDist > candidateDistance )
-    {
-      candidateDistance = currMinDist;
-      candidateItemNumber = i;
-	  }
-  }
-
-  // Create new centroid for candidate
-  nextCentroid->SetTuple( 0, 0, this->GetNthDoubleArray( candidateItemNumber ) );
-}
-
-
-
-bool vtkMRMLWorkflowSequenceNode
-::MembershipChanged( std::vector< int > oldMembership, std::vector< int > newMembership )
+::GaussianFilter( double width )
 {
-  for ( int i = 0; i < oldMembership.size(); i++ )
-  {
-    if ( oldMembership.at( i ) != newMembership.at( i ) )
-	  {
-      return true;
-	  }
-  }
-
-  return false;
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->GaussianFilter( width );
+  this->FromFeatureMatrix( featureMatrix );
 }
 
 
-
-std::vector< bool > vtkMRMLWorkflowSequenceNode
-::FindEmptyClusters( vtkDoubleArray* centroids, std::vector< int > membership )
+void vtkMRMLWorkflowSequenceNode
+::OrthogonalTransformation( int window, int order )
 {
-  std::vector< bool > emptyVector( centroids->GetNumberOfTuples(), true );
-
-  // Calculate the empty clusters
-  for ( int i = 0; i < membership.size(); i++ )
-  {
-    emptyVector.at( membership.at(i) ) = false;
-  }
-
-  return emptyVector;
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->OrthogonalTransformation( window, order );
+  this->FromFeatureMatrix( featureMatrix );
 }
 
 
-
-bool vtkMRMLWorkflowSequenceNode
-::HasEmptyClusters( std::vector< bool > emptyVector )
+void vtkMRMLWorkflowSequenceNode
+::CovarianceMatrix( vnl_matrix< double >& covariance )
 {
-  for ( int c = 0; c < emptyVector.size(); c++ )
-  {
-    if ( emptyVector.at( c ) )
-	  {
-      return true;
-	  }
-  }
- 
-  return false;
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->CovarianceMatrix( covariance );
 }
 
 
-
 void vtkMRMLWorkflowSequenceNode
-::MoveEmptyClusters( vtkDoubleArray* centroids, std::vector< bool > emptyVector )
+::CalculatePrincipalComponents( int numComp, vtkDoubleArray* prinComps, vtkWorkflowFeatureMatrix::PrincipalComponentsMethod method /* = vtkWorkflowFeatureMatrix::FULL_EIGENSOLVER */ )
 {
-  // Remove any emptyness (does this inline)
-  for ( int c = 0; c < centroids->GetNumberOfTuples(); c++ )
-  {
-    if ( emptyVector.at(c) == false )
-	  {
-	    continue;
-	  }
-
-    vtkSmartPointer< vtkDoubleArray > nextCentroid = vtkSmartPointer< vtkDoubleArray >::New();
-    this->FindNextCentroid( centroids, nextCentroid );
-    centroids->SetTuple( c, 0, nextCentroid ); // Overwrites the tuple current at that item number
-  }
-
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->CalculatePrincipalComponents( numComp, prinComps, method );
 }
 
 
-std::vector< int > vtkMRMLWorkflowSequenceNode
-::ReassignMembership( vtkDoubleArray* centroids )
+void vtkMRMLWorkflowSequenceNode
+::TransformByPrincipalComponents( vtkDoubleArray* prinComps, vtkDoubleArray* meanArray )
 {
-  // Find the record farthest from any centroid
-  vtkSmartPointer< vtkDoubleArray > centroidDistances = vtkSmartPointer< vtkDoubleArray >::New();
-  this->Distances( centroids, centroidDistances );
-  
-  std::vector< int > membership;
-
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
-  {
-    double currMinDist = std::numeric_limits< double >::max();
-	  int currMinCentroid = 0;
-    // Minimum for each point
-    for ( int c = 0; c < centroidDistances->GetNumberOfComponents(); c++ )
-	  {
-      if ( centroidDistances->GetComponent( i, c ) < currMinDist )
-	    {
-        currMinDist = centroidDistances->GetComponent( i, c );
-		    currMinCentroid = c;
-	    }
-	  }
-    
-    membership.push_back( currMinCentroid );
-  }
-
-  return membership;
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->TransformByPrincipalComponents( prinComps, meanArray );
+  this->FromFeatureMatrix( featureMatrix );
 }
 
 
-
 void vtkMRMLWorkflowSequenceNode
-::RecalculateCentroids( std::vector< int > membership, int numClusters, vtkDoubleArray* centroids )
+::fwdkmeans( int numClusters, vtkDoubleArray* centroids )
 {
-  // Initialize (we need to reset everything anyway)
-  centroids->SetNumberOfComponents( this->GetNthNumberOfComponents( 0 ) );
-  centroids->SetNumberOfTuples( numClusters );
-  this->FillDoubleArray( centroids, 0 );
-
-  std::vector< int > memberCount( numClusters, 0 );
-
-  // Iterate over all time
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
-  {
-    vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( i );
-    if ( currDoubleArray == NULL )
-    {
-      return;
-    }
-
-    // For each dimension
-    for ( int d = 0; d < centroids->GetNumberOfComponents(); d++ )
-	  {      
-	    centroids->SetComponent( membership.at( i ), d, centroids->GetComponent( membership.at( i ), d ) + currDoubleArray->GetComponent( 0, d ) );
-	  }
-    
-    memberCount.at( membership.at( i ) )++;
-  }
-
-  // Divide by the number of records in the cluster to get the mean
-  for ( int c = 0; c < centroids->GetNumberOfTuples(); c++ )
-  {
-    // For each dimension
-    for ( int d = 0; d < centroids->GetNumberOfComponents(); d++ )
-	  {
-	    centroids->SetComponent( c, d, centroids->GetComponent( c, d ) / memberCount.at( c ) );
-	  }
-  }
-
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->fwdkmeans( numClusters, centroids );
 }
 
 
-
 void vtkMRMLWorkflowSequenceNode
 ::fwdkmeansTransform( vtkDoubleArray* centroids )
 {
-  // Use the reassign membership function to calculate closest centroids
-  std::vector< int > membership = this->ReassignMembership( centroids );
-
-  // Iterate over all tracking records in the current procedure, and add to new
-  for ( int i = 0; i < this->GetNumberOfDataNodes(); i++ )
-  {
-    vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( i );
-    if ( currDoubleArray == NULL )
-    {
-      continue;
-    }
-    
-    currDoubleArray->SetNumberOfComponents( 1 );
-    currDoubleArray->SetNumberOfTuples( 1 );    
-    currDoubleArray->SetComponent( 0, 0, membership.at( i ) );
-  }
-
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > featureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->ToFeatureMatrix( featureMatrix );
+  featureMatrix->fwdkmeansTransform( centroids );
+  this->FromFeatureMatrix( featureMatrix );
 }
 
 
 
-
-
 void vtkMRMLWorkflowSequenceNode
 ::AddMarkovModelAttributes()
 {
@@ -1349,6 +930,15 @@ void vtkMRMLWorkflowSequenceNode
   vtkNew< vtkMatrix4x4 > transformMatrix;
   transformNode->GetMatrixTransformToParent( transformMatrix.GetPointer() );
 
+  doubleArray->SetNumberOfComponents( type );
+  doubleArray->SetNumberOfTuples( 1 );
+  vtkMRMLWorkflowSequenceNode::LinearTransformToValues( transformMatrix.GetPointer(), doubleArray->GetPointer( 0 ), type );
+}
+
+
+void vtkMRMLWorkflowSequenceNode
+::LinearTransformToValues( vtkMatrix4x4* transformMatrix, double* values, ArrayType type )
+{
   if ( type == QUATERNION_ARRAY ) // If it is in quaternion format
   {
     double matrix[ 3 ][ 3 ];
@@ -1364,39 +954,24 @@ void vtkMRMLWorkflowSequenceNode
     
     double quaternion[ 4 ];
     vtkMath::Matrix3x3ToQuaternion( matrix, quaternion );
-    
-    doubleArray->SetNumberOfComponents( QUATERNION_ARRAY );
-    doubleArray->SetNumberOfTuples( 1 );
-
-    doubleArray->SetComponent( 0, 0, transformMatrix->GetElement( 0, 3 ) );
-    doubleArray->SetComponent( 0, 1, transformMatrix->GetElement( 1, 3 ) );
-    doubleArray->SetComponent( 0, 2, transformMatrix->GetElement( 2, 3 ) );
-    doubleArray->SetComponent( 0, 3, quaternion[ 0 ] );
-    doubleArray->SetComponent( 0, 4, quaternion[ 1 ] );
-    doubleArray->SetComponent( 0, 5, quaternion[ 2 ] );
-    doubleArray->SetComponent( 0, 6, quaternion[ 3 ] );
+
+    values[ 0 ] = transformMatrix->GetElement( 0, 3 );
+    values[ 1 ] = transformMatrix->GetElement( 1, 3 );
+    values[ 2 ] = transformMatrix->GetElement( 2, 3 );
+    values[ 3 ] = quaternion[ 0 ];
+    values[ 4 ] = quaternion[ 1 ];
+    values[ 5 ] = quaternion[ 2 ];
+    values[ 6 ] = quaternion[ 3 ];
   }
   else if ( type == MATRIX_ARRAY ) // If it is in matrix format
   {
-    doubleArray->SetNumberOfComponents( MATRIX_ARRAY );
-    doubleArray->SetNumberOfTuples( 1 );
-
-    doubleArray->SetComponent( 0, 0, transformMatrix->GetElement( 0, 0 ) );
-    doubleArray->SetComponent( 0, 1, transformMatrix->GetElement( 0, 1 ) );
-    doubleArray->SetComponent( 0, 2, transformMatrix->GetElement( 0, 2 ) );
-    doubleArray->SetComponent( 0, 3, transformMatrix->GetElement( 0, 3 ) );
-    doubleArray->SetComponent( 0, 4, transformMatrix->GetElement( 1, 0 ) );
-    doubleArray->SetComponent( 0, 5, transformMatrix->GetElement( 1, 1 ) );
-    doubleArray->SetComponent( 0, 6, transformMatrix->GetElement( 1, 2 ) );
-    doubleArray->SetComponent( 0, 7, transformMatrix->GetElement( 1, 3 ) );
-    doubleArray->SetComponent( 0, 8, transformMatrix->GetElement( 2, 0 ) );
-    doubleArray->SetComponent( 0, 9, transformMatrix->GetElement( 2, 1 ) );
-    doubleArray->SetComponent( 0, 10, transformMatrix->GetElement( 2, 2 ) );
-    doubleArray->SetComponent( 0, 11, transformMatrix->GetElement( 2, 3 ) );
-    doubleArray->SetComponent( 0, 12, transformMatrix->GetElement( 3, 0 ) );
-    doubleArray->SetComponent( 0, 13, transformMatrix->GetElement( 3, 1 ) );
-    doubleArray->SetComponent( 0, 14, transformMatrix->GetElement( 3, 2 ) );
-    doubleArray->SetComponent( 0, 15, transformMatrix->GetElement( 3, 3 ) );
+    for ( int i = 0; i < 4; i++ )
+    {
+      for ( int j = 0; j < 4; j++ )
+      {
+        values[ 4 * i + j ] = transformMatrix->GetElement( i, j );
+      }
+    }
   }
 
 }
@@ -7,7 +7,9 @@
 #include <iostream>
 #include <sstream>
 #include <utility>
+#include <algorithm>
 #include <vector>
+#include <string>
 
 // VTK includes
 #include "vtkObject.h"
@@ -17,6 +19,8 @@
 #include "vtkSmartPointer.h"
 #include "vtkDoubleArray.h"
 #include "vtkMatrix4x4.h"
+#include "vtkCollection.h"
+#include "vtkCollectionIterator.h"
 
 // VNL includes
 #include "vnl/vnl_matrix.h"
@@ -26,6 +30,8 @@
 
 // Workflow Segmentation includes
 #include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
+#include "vtkWorkflowFeatureMatrix.h"
+#include "vtkWorkflowNearestNeighbours.h"
 
 #include "vtkMRMLSequenceNode.h"
 #include "vtkMRMLSequenceBrowserNode.h"
@@ -63,18 +69,31 @@ protected:
 public:
 
   // Conversion to/from transform buffer
-  void FromTrackedSequenceBrowserNode( vtkMRMLSequenceBrowserNode* newTrackedSequenceBrowserNode, std::string proxyNodeID, std::string messagesProxyNodeID, std::vector< std::string > relevantMessages );
+  // Unlabelled transforms (not preceded by a relevant message) are only kept if requested, and they get an empty label
+  void FromTrackedSequenceBrowserNode( vtkMRMLSequenceBrowserNode* newTrackedSequenceBrowserNode, std::string proxyNodeID, std::string messagesProxyNodeID, std::vector< std::string > relevantMessages, bool includeUnlabelled = false );
+  // Same, but straight into a feature matrix (no data nodes are created)
+  static void TrackedSequenceBrowserNodeToFeatureMatrix( vtkMRMLSequenceBrowserNode* trackedSequenceBrowserNode, std::string proxyNodeID, std::string messagesProxyNodeID, std::vector< std::string > relevantMessages, vtkWorkflowFeatureMatrix* featureMatrix, bool includeUnlabelled = false );
 
   // Convenience method to get index value as a double
   double GetNthIndexValueAsDouble( int itemNumber );
+  // All of the index values as doubles (parsed once, and kept in sync with the sequence)
+  const std::vector< double >& GetIndexValuesAsDouble();
   int GetNthNumberOfComponents( int itemNumber = 0 );
   vtkDoubleArray* GetNthDoubleArray( int itemNumber = 0 );
 
+  // Conversion to/from a dense feature matrix (the math is done on the matrix)
+  void ToFeatureMatrix( vtkWorkflowFeatureMatrix* featureMatrix );
+  void FromFeatureMatrix( vtkWorkflowFeatureMatrix* featureMatrix );
+
   // Methods explicitly for workflow segmentation
   void GetSubsequence( int startItemNumber, int endItemNumber, vtkMRMLWorkflowSequenceNode* subsequence );
   void GetLabelledSubsequence( std::vector< std::string > labels, vtkMRMLWorkflowSequenceNode* subsequence );
+  // Views do not copy any data nodes (use these unless a copy is really needed)
+  vtkWorkflowSequenceView GetSubsequenceView( int startItemNumber, int endItemNumber );
+  vtkWorkflowSequenceView GetLabelledSubsequenceView( std::vector< std::string > labels );
   
   void Concatenate( vtkMRMLWorkflowSequenceNode* sequence, bool enforceUniqueIndexValues = false );
+  void Concatenate( vtkCollection* sequences, bool enforceUniqueIndexValues = false );
   void ConcatenateValues( vtkMRMLWorkflowSequenceNode* sequence );
   void ConcatenateValues( vtkDoubleArray* doubleArray );
   void PadStart( int window );
@@ -83,7 +102,10 @@ public:
 
   void Distances( vtkMRMLWorkflowSequenceNode* sequence, vtkDoubleArray* distances );
   void Distances( vtkDoubleArray* testPoints, vtkDoubleArray* distances );
+  void SquaredDistances( vtkDoubleArray* testPoints, vtkDoubleArray* distances );
   void ClosestRecords( vtkDoubleArray* testPoint, vtkDoubleArray* closest );
+  void FindClosestRecords( vtkDoubleArray* testPoints, std::vector< int >& closestRecords, std::vector< double >& squaredDistances );
+  vtkWorkflowNearestNeighbours* GetNearestNeighbours();
 
 
   void Differentiate( int order = 1 );
@@ -96,8 +118,8 @@ public:
   void LegendreTransformation( int order, vtkDoubleArray* legendreCoefficients );
   void OrthogonalTransformation( int window, int order );
 
-  vnl_matrix< double >* CovarianceMatrix();
-  void CalculatePrincipalComponents( int numComp, vtkDoubleArray* prinComps );
+  void CovarianceMatrix( vnl_matrix< double >& covariance );
+  void CalculatePrincipalComponents( int numComp, vtkDoubleArray* prinComps, vtkWorkflowFeatureMatrix::PrincipalComponentsMethod method = vtkWorkflowFeatureMatrix::FULL_EIGENSOLVER );
   void TransformByPrincipalComponents( vtkDoubleArray* prinComps, vtkDoubleArray* mean );
 
   void fwdkmeans( int numClusters, vtkDoubleArray* centroids );
@@ -114,6 +136,9 @@ public:
   // Convert between linear transforms and double arrays
   static void LinearTransformFromDoubleArray( vtkMRMLLinearTransformNode* transformNode, vtkMRMLWorkflowDoubleArrayNode* doubleArrayNode, ArrayType type );
   static void LinearTransformToDoubleArray( vtkMRMLLinearTransformNode* transformNode, vtkMRMLWorkflowDoubleArrayNode* doubleArrayNode, ArrayType type );
+  static void LinearTransformToValues( vtkMatrix4x4* transformMatrix, double* values, ArrayType type ); // The values must have room for the array type's number of components
+
+  static double IndexValueToDouble( std::string indexValue );
 
   // Helper method (since this isn't implemented in the version of VTK that Slicer uses)
   static void FillDoubleArray( vtkDoubleArray* doubleArray, double fillValue );
@@ -122,17 +147,21 @@ public:
 
 protected:
 
-  static const double STDEV_CUTOFF;
+  static void SetMessageAttribute( vtkMRMLNode* dataNode, std::string message );
+
+  void RenumberIndexValues();
+
+  void UpdateIndexValuesAsDouble();
+  // Adds the data node after the last item, without parsing the previous index values again
+  void AppendDataNode( vtkMRMLNode* dataNode, std::string indexValue );
 
-  double LegendrePolynomial( double time, int order );	
+  // Cache of the parsed index values
+  std::vector< double > IndexValuesAsDouble;
+  vtkMTimeType IndexValuesAsDoubleTime;
 
-  void FindNextCentroid( vtkDoubleArray* centroids, vtkDoubleArray* nextCentroid );
-  bool MembershipChanged( std::vector< int > oldMembership, std::vector< int > newMembership );
-  bool HasEmptyClusters( std::vector< bool > emptyVector );
-  std::vector< bool > FindEmptyClusters( vtkDoubleArray* centroids, std::vector< int > membership );
-  std::vector< int > ReassignMembership( vtkDoubleArray* centroids );
-  void MoveEmptyClusters( vtkDoubleArray* centroids, std::vector< bool > emptyVector );
-  void RecalculateCentroids( std::vector< int > membership, int numClusters, vtkDoubleArray* centroids );
+  // Cache of the nearest neighbour index
+  vtkSmartPointer< vtkWorkflowNearestNeighbours > NearestNeighbours;
+  vtkMTimeType NearestNeighboursTime;
 
 };  
 
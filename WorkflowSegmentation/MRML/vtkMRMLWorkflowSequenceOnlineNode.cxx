@@ -14,6 +14,11 @@ void vtkMRMLWorkflowSequenceOnlineNode::PrintSelf( ostream& os, vtkIndent indent
 void vtkMRMLWorkflowSequenceOnlineNode::WriteXML( ostream& of, int nIndent )
 {
   this->vtkMRMLWorkflowSequenceNode::WriteXML(of, nIndent);
+
+  vtkIndent indent(nIndent);
+
+  of << indent << " RetentionTime=\"" << this->RetentionTime << "\"";
+  of << indent << " RetentionFrames=\"" << this->RetentionFrames << "\"";
 }
 
 //----------------------------------------------------------------------------
@@ -30,7 +35,14 @@ void vtkMRMLWorkflowSequenceOnlineNode::ReadXMLAttributes( const char** atts )
     attName  = *(atts++);
     attValue = *(atts++);
 
-    // do something...
+    if ( ! strcmp( attName, "RetentionTime" ) )
+    {
+      this->RetentionTime = atof( attValue );
+    }
+    if ( ! strcmp( attName, "RetentionFrames" ) )
+    {
+      this->RetentionFrames = atoi( attValue );
+    }
   }
 }
 
@@ -39,6 +51,15 @@ void vtkMRMLWorkflowSequenceOnlineNode::Copy( vtkMRMLNode* anode )
 {
   this->vtkMRMLWorkflowSequenceNode::Copy( anode );
   // Copying is already taken care of my the superclass
+
+  // Except for the retention (the archive is not copied, since evicted frames are only ever archived once)
+  vtkMRMLWorkflowSequenceOnlineNode* node = vtkMRMLWorkflowSequenceOnlineNode::SafeDownCast( anode );
+  if ( node == NULL )
+  {
+    return;
+  }
+  this->RetentionTime = node->GetRetentionTime();
+  this->RetentionFrames = node->GetRetentionFrames();
 }
 
 // Constructors and Destructors --------------------------------------------------------------------
@@ -46,6 +67,10 @@ void vtkMRMLWorkflowSequenceOnlineNode::Copy( vtkMRMLNode* anode )
 //----------------------------------------------------------------------------
 vtkMRMLWorkflowSequenceOnlineNode::vtkMRMLWorkflowSequenceOnlineNode()
 {
+  this->OrthogonalKernel = vtkSmartPointer< vtkWorkflowLegendreKernel >::New();
+  this->RetentionTime = 0;
+  this->RetentionFrames = 0;
+  this->ArchiveSequence = NULL;
 }
 
 //----------------------------------------------------------------------------
@@ -53,6 +78,85 @@ vtkMRMLWorkflowSequenceOnlineNode::~vtkMRMLWorkflowSequenceOnlineNode()
 {
 }
 
+// Bounded history ---------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+void vtkMRMLWorkflowSequenceOnlineNode::SetRetention( vtkMRMLWorkflowInputNode* workflowInput )
+{
+  if ( workflowInput == NULL )
+  {
+    return;
+  }
+
+  // The Gaussian filter looks back in time, the derivative and orthogonal transformation look back in frames
+  this->SetRetentionTime( vtkWorkflowFeatureMatrix::STDEV_CUTOFF * workflowInput->GetFilterWidth() );
+  this->SetRetentionFrames( std::max( workflowInput->GetDerivative(), workflowInput->GetOrthogonalWindow() ) + 1 );
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLWorkflowSequenceNode* vtkMRMLWorkflowSequenceOnlineNode::GetArchiveSequence()
+{
+  return this->ArchiveSequence;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLWorkflowSequenceOnlineNode::SetArchiveSequence( vtkMRMLWorkflowSequenceNode* newArchiveSequence )
+{
+  this->ArchiveSequence = newArchiveSequence;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLWorkflowSequenceOnlineNode::AddDataNodeOnline( vtkMRMLNode* node, std::string indexValue )
+{
+  this->AppendDataNode( node, indexValue );
+  this->ApplyRetention();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLWorkflowSequenceOnlineNode::ApplyRetention()
+{
+  if ( this->RetentionTime <= 0 && this->RetentionFrames <= 0 )
+  {
+    return;
+  }
+
+  const std::vector< double >& indexValues = this->GetIndexValuesAsDouble();
+  int numberOfDataNodes = this->GetNumberOfDataNodes();
+  if ( numberOfDataNodes == 0 )
+  {
+    return;
+  }
+
+  // Frames are sorted by time, so the evicted frames are always at the start
+  double latestTime = indexValues[ numberOfDataNodes - 1 ];
+  int numberOfEvictableFrames = numberOfDataNodes - std::max( this->RetentionFrames, 0 );
+  int numberOfEvictedFrames = 0;
+  while ( numberOfEvictedFrames < numberOfEvictableFrames
+    && ( this->RetentionTime <= 0 || latestTime - indexValues[ numberOfEvictedFrames ] > this->RetentionTime ) )
+  {
+    numberOfEvictedFrames++;
+  }
+  if ( numberOfEvictedFrames == 0 )
+  {
+    return;
+  }
+
+  for ( int i = 0; i < numberOfEvictedFrames; i++ )
+  {
+    std::string currIndexValue = this->GetNthIndexValue( 0 );
+    if ( this->ArchiveSequence != NULL )
+    {
+      this->ArchiveSequence->SetDataNodeAtValue( this->GetNthDataNode( 0 ), currIndexValue );
+    }
+    this->RemoveDataNodeAtValue( currIndexValue );
+  }
+
+  // The parsed index values are still valid, they just need to be shifted (otherwise every frame would be parsed again)
+  this->IndexValuesAsDouble.erase( this->IndexValuesAsDouble.begin(), this->IndexValuesAsDouble.begin() + numberOfEvictedFrames );
+  this->IndexValuesAsDoubleTime = this->GetMTime();
+}
+
+
 // Online methods ----------------------------------------------------------------------------------
 
 //----------------------------------------------------------------------------
@@ -110,62 +214,68 @@ void vtkMRMLWorkflowSequenceOnlineNode::DifferentiateOnline( int order, vtkDoubl
     return;
   }
   
-  // Just need the last order + 1 timestamps
-  vtkSmartPointer< vtkMRMLWorkflowSequenceNode > endSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-  this->GetSubsequence( this->GetNumberOfDataNodes() - ( order + 1 ), this->GetNumberOfDataNodes() - 1, endSequence );
-  endSequence->Differentiate( order );
-  
+  // Just need the last order + 1 timestamps (only the values are copied, not the data nodes)
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > endMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  this->GetSubsequenceView( this->GetNumberOfDataNodes() - ( order + 1 ), this->GetNumberOfDataNodes() - 1 ).Materialize( endMatrix );
+  endMatrix->Differentiate( order );
 
-  vtkDoubleArray* endDoubleArray = endSequence->GetNthDoubleArray( endSequence->GetNumberOfDataNodes() - 1 );
-  if ( endDoubleArray == NULL )
+  if ( endMatrix->GetNumberOfFrames() < 1 || endMatrix->GetNumberOfComponents() != derivative->GetNumberOfComponents() )
   {
     return;
   }
-  derivative->SetTuple( 0, 0, endDoubleArray );
+  derivative->SetTypedTuple( 0, endMatrix->GetFrame( endMatrix->GetNumberOfFrames() - 1 ) );
 }
 
 //----------------------------------------------------------------------------
 void vtkMRMLWorkflowSequenceOnlineNode::GaussianFilterOnline( double width, vtkDoubleArray* gauss )
 {
-  gauss->SetNumberOfComponents( this->GetNthNumberOfComponents( this->GetNumberOfDataNodes() - 1 ) );
+  int numberOfComponents = this->GetNthNumberOfComponents( this->GetNumberOfDataNodes() - 1 );
+  gauss->SetNumberOfComponents( numberOfComponents );
   gauss->SetNumberOfTuples( 1 );
-
-  // Iterate over all dimensions
-  for ( int d = 0; d < gauss->GetNumberOfComponents(); d++ )
+  vtkMRMLWorkflowSequenceNode::FillDoubleArray( gauss, 0 );
+  if ( this->GetNumberOfDataNodes() == 0 )
   {
-    double weightSum = 0;
-    double normSum = 0;
+    return;
+  }
 
-    // Iterate over all records nearby
-	  int j = this->GetNumberOfDataNodes() - 1;
-	  while ( j >= 0 ) // Iterate backward
+  // Iterate over all records nearby (backward from the most recent)
+  // With a retention time, the evicted records are all beyond the cutoff anyway
+  const std::vector< double >& indexValues = this->GetIndexValuesAsDouble();
+  double latestTime = indexValues[ this->GetNumberOfDataNodes() - 1 ];
+  double* gaussValues = gauss->GetPointer( 0 );
+  double normSum = 0;
+  for ( int j = this->GetNumberOfDataNodes() - 1; j >= 0; j-- )
+  {
+    // Get the current double array
+    vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( j );
+    if ( currDoubleArray == NULL || currDoubleArray->GetNumberOfComponents() != numberOfComponents )
     {
-      // Get the current double array
-      vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( j );
-      if ( currDoubleArray == NULL )
-      {
-        break;
-      }
+      break;
+    }
+
+	  // If too far from "peak" of distribution, the stop - we're just wasting time
+    double normalizedDistance = ( indexValues[ j ] - latestTime ) / width;
+	  if ( std::abs( normalizedDistance ) > vtkWorkflowFeatureMatrix::STDEV_CUTOFF )
+	  {
+	    break;
+	  }
 
-	    // If too far from "peak" of distribution, the stop - we're just wasting time
-      double normalizedDistance = ( this->GetNthIndexValueAsDouble( j ) - this->GetNthIndexValueAsDouble( this->GetNumberOfDataNodes() - 1 ) ) / width;
-	    if ( abs( normalizedDistance ) > STDEV_CUTOFF )
-	    {
-	      break;
-	    }
-
-      // Calculate the values of the Gaussian distribution at this time
-	    double gaussianWeight = exp( - normalizedDistance * normalizedDistance / 2 );
-	    // Add the product with the values to function sum
-      weightSum = weightSum + currDoubleArray->GetComponent( 0, d ) * gaussianWeight; // Add the product with the values to function sum		
-	    // Add the values to normSum
-	    normSum = normSum + gaussianWeight;
-
-	    j--;
+    // Calculate the values of the Gaussian distribution at this time
+	  double gaussianWeight = exp( - normalizedDistance * normalizedDistance / 2 );
+	  // Add the product with the values to function sum
+    const double* currValues = currDoubleArray->GetPointer( 0 );
+    for ( int d = 0; d < numberOfComponents; d++ )
+    {
+      gaussValues[ d ] = gaussValues[ d ] + currValues[ d ] * gaussianWeight;
     }
+	  // Add the values to normSum
+	  normSum = normSum + gaussianWeight;
+  }
 
-    // Add to the new values
-    gauss->SetComponent( 0, d, weightSum / normSum );
+  // Add to the new values
+  for ( int d = 0; d < numberOfComponents; d++ )
+  {
+    gaussValues[ d ] = gaussValues[ d ] / normSum;
   }
 
 }
@@ -173,39 +283,77 @@ void vtkMRMLWorkflowSequenceOnlineNode::GaussianFilterOnline( double width, vtkD
 //----------------------------------------------------------------------------
 void vtkMRMLWorkflowSequenceOnlineNode::OrthogonalTransformationOnline( int window, int order, vtkDoubleArray* orthogonal )
 {
+  int numberOfComponents = this->GetNthNumberOfComponents( this->GetNumberOfDataNodes() - 1 );
+  this->OrthogonalKernel->Initialize( window + 1, order, numberOfComponents );
+
+  orthogonal->SetNumberOfComponents( this->OrthogonalKernel->GetNumberOfCoefficients() );
+  orthogonal->SetNumberOfTuples( 1 );
+  vtkMRMLWorkflowSequenceNode::FillDoubleArray( orthogonal, 0 );
+  if ( this->GetNumberOfDataNodes() == 0 )
+  {
+    return;
+  }
+
   // Pad the recordlog with values at the beginning only if necessary
-  vtkSmartPointer< vtkMRMLWorkflowSequenceNode > subsequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-  
   if ( this->GetNumberOfDataNodes() <= window )
   {
-    vtkSmartPointer< vtkMRMLWorkflowSequenceNode > paddedSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-    paddedSequence->Copy( this );
-    paddedSequence->PadStart( window );
-    paddedSequence->GetSubsequence( paddedSequence->GetNumberOfDataNodes() - ( window + 1 ), paddedSequence->GetNumberOfDataNodes() - 1, subsequence );
+    vtkSmartPointer< vtkWorkflowFeatureMatrix > paddedMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+    this->ToFeatureMatrix( paddedMatrix );
+    paddedMatrix->PadStart( window );
+
+    int startFrame = paddedMatrix->GetNumberOfFrames() - ( window + 1 );
+    this->OrthogonalKernel->CalculateCoefficients( &paddedMatrix->GetTimes()[ startFrame ], paddedMatrix->GetFrame( startFrame ), orthogonal->GetPointer( 0 ) );
+    this->OrthogonalKernel->ClearFrames();
+    return;
   }
-  else
+
+  // Keep the kernel's ring buffer in sync with the end of the sequence
+  // Usually, only the most recent frame is new, but if the sequence has been reset, then refill the buffer
+  // The buffered frames are only reused if both their start and end times line up with the sequence
+  // (a different window can end at the same time, eg. if the sequence was refilled)
+  const std::vector< double >& indexValues = this->GetIndexValuesAsDouble();
+  int firstWindowFrame = this->GetNumberOfDataNodes() - ( window + 1 );
+  int firstNewFrame = firstWindowFrame;
+  int numberOfBufferedFrames = this->OrthogonalKernel->GetNumberOfBufferedFrames();
+  if ( numberOfBufferedFrames > 0 )
   {
-    this->GetSubsequence( this->GetNumberOfDataNodes() - ( window + 1 ), this->GetNumberOfDataNodes() - 1, subsequence );
+    double latestTime = this->OrthogonalKernel->GetLatestTime();
+    for ( int i = this->GetNumberOfDataNodes() - 1; i >= firstWindowFrame; i-- )
+    {
+      if ( indexValues[ i ] != latestTime )
+      {
+        continue;
+      }
+      int oldestFrame = i - ( numberOfBufferedFrames - 1 );
+      if ( oldestFrame >= 0 && indexValues[ oldestFrame ] == this->OrthogonalKernel->GetOldestTime() )
+      {
+        firstNewFrame = i + 1;
+      }
+      break;
+    }
+  }
+  if ( firstNewFrame == firstWindowFrame )
+  {
+    this->OrthogonalKernel->ClearFrames();
   }
 
-  // Create a new matrix to which the Legendre coefficients will be assigned
-  vtkNew< vtkDoubleArray > legendreCoefficients;
-  subsequence->LegendreTransformation( order, legendreCoefficients.GetPointer() );
-
-  orthogonal->SetNumberOfComponents( legendreCoefficients->GetNumberOfTuples() * legendreCoefficients->GetNumberOfComponents() );
-  orthogonal->SetNumberOfTuples( 1 );
-
-  // Calculate the Legendre coefficients: 2D -> 1D
-  int count = 0;
-  for ( int o = 0; o < legendreCoefficients->GetNumberOfTuples(); o++ )
+  std::vector< double > zeroValues( numberOfComponents, 0.0 );
+  for ( int i = firstNewFrame; i < this->GetNumberOfDataNodes(); i++ )
   {
-    for ( int d = 0; d < legendreCoefficients->GetNumberOfComponents(); d++ )
+    vtkDoubleArray* currDoubleArray = this->GetNthDoubleArray( i );
+    if ( currDoubleArray == NULL || currDoubleArray->GetNumberOfComponents() != numberOfComponents )
     {
-      orthogonal->SetComponent( 0, count, legendreCoefficients->GetComponent( o, d ) );
-      count++;
+      this->OrthogonalKernel->AddFrame( indexValues[ i ], &zeroValues[ 0 ] );
+      continue;
     }
+    this->OrthogonalKernel->AddFrame( indexValues[ i ], currDoubleArray->GetPointer( 0 ) );
   }
 
+  // Calculate the Legendre coefficients: 2D -> 1D
+  if ( ! this->OrthogonalKernel->CalculateCoefficients( orthogonal->GetPointer( 0 ) ) )
+  {
+    vtkWarningMacro( "vtkMRMLWorkflowSequenceOnlineNode::OrthogonalTransformationOnline: Improper time range." );
+  }
 }
 
 //----------------------------------------------------------------------------
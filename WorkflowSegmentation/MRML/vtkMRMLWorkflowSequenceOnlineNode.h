@@ -8,6 +8,7 @@
 #include <sstream>
 #include <utility>
 #include <vector>
+#include <algorithm>
 
 // VTK includes
 #include "vtkObject.h"
@@ -19,6 +20,7 @@
 #include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
 #include "vtkMRMLNode.h"
 #include "vtkMRMLWorkflowSequenceNode.h"
+#include "vtkMRMLWorkflowInputNode.h"
 
 
 class VTK_SLICER_WORKFLOWSEGMENTATION_MODULE_MRML_EXPORT
@@ -48,6 +50,24 @@ public:
 
   // Note: There is no copy function, use the superclass copy function  
 
+  // Bounded history: a frame is evicted once it is older than the retention time (relative to the most recent frame),
+  // unless it is among the retention frames most recent frames
+  // A non-positive value puts no limit of that kind; if both are non-positive, all frames are kept (the default)
+  vtkGetMacro( RetentionTime, double );
+  vtkSetMacro( RetentionTime, double );
+  vtkGetMacro( RetentionFrames, int );
+  vtkSetMacro( RetentionFrames, int );
+  // Retain the widest lookback any of the online methods needs with these parameters
+  void SetRetention( vtkMRMLWorkflowInputNode* workflowInput );
+
+  // Evicted frames are moved here (if set), so nothing is lost
+  vtkMRMLWorkflowSequenceNode* GetArchiveSequence();
+  void SetArchiveSequence( vtkMRMLWorkflowSequenceNode* newArchiveSequence );
+
+  // Add a new most recent frame, and evict any frames which are no longer retained
+  void AddDataNodeOnline( vtkMRMLNode* node, std::string indexValue );
+  void ApplyRetention();
+
   // Methods explicitly for workflow segmentation
   void DistancesOnline( vtkDoubleArray* testPoints, vtkDoubleArray* distances );
 
@@ -63,6 +83,15 @@ public:
 
   void AddMarkovModelAttributesOnline( vtkMRMLNode* node );
 
+protected:
+
+  // Holds the most recent frames for the orthogonal transformation
+  vtkSmartPointer< vtkWorkflowLegendreKernel > OrthogonalKernel;
+
+  double RetentionTime;
+  int RetentionFrames;
+  vtkSmartPointer< vtkMRMLWorkflowSequenceNode > ArchiveSequence;
+
 };
 
 #endif
@@ -72,6 +72,11 @@ vtkMRMLWorkflowToolNode
 {
   this->CurrentTaskNew = false;
   this->ToolName = "";
+  this->TrainingPrepared = false;
+
+  this->OnlinePipeline = vtkSmartPointer< vtkWorkflowOnlinePipeline >::New();
+  this->ToolMatrix = vtkSmartPointer< vtkMatrix4x4 >::New();
+  this->RawValues.assign( vtkMRMLWorkflowSequenceNode::QUATERNION_ARRAY, 0.0 );
   this->ResetWorkflowSequences();
 
   vtkNew< vtkIntArray > events;
@@ -91,12 +96,13 @@ vtkMRMLWorkflowToolNode
 void vtkMRMLWorkflowToolNode
 ::ResetWorkflowSequences()
 {
-  this->RawWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceOnlineNode >::New();
-  this->FilterWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceOnlineNode >::New();
-  this->DerivativeWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceOnlineNode >::New();
-  this->OrthogonalWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceOnlineNode >::New();
-  this->PcaWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceOnlineNode >::New();
-  this->CentroidWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceOnlineNode >::New();
+  // Re-initialize on the next frame, so the pipeline picks up any new parameters
+  this->OnlinePipeline->ClearFrames();
+  this->OnlinePipelineTime = 0;
+  if ( this->IsWorkflowTrainingSet() )
+  {
+    this->GetWorkflowTrainingNode()->GetMarkov()->ResetOnline();
+  }
   
   this->CurrentTask = vtkSmartPointer< vtkWorkflowTask >::New();
 }
@@ -236,35 +242,69 @@ void vtkMRMLWorkflowToolNode
 }
 
 
+// Helper for extracting the features from each procedure in parallel
+// Each procedure writes only to its own output matrix
+class vtkWorkflowProcedureFeaturesFunctor
+{
+public:
+  std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >* WorkflowMatrices;
+  std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >* OrthogonalWorkflowMatrices;
+  vtkMRMLWorkflowInputNode* WorkflowInput;
+
+  void operator()( vtkIdType begin, vtkIdType end )
+  {
+    for ( vtkIdType i = begin; i < end; i++ )
+    {
+      vtkMRMLWorkflowToolNode::ExtractProcedureFeatures( this->WorkflowMatrices->at( i ), this->WorkflowInput, this->OrthogonalWorkflowMatrices->at( i ) );
+    }
+  }
+};
+
+
 // Computational methods
 // Return whether or not training was successful
 bool vtkMRMLWorkflowToolNode
-::Train( vtkCollection* trainingWorkflowSequences )
+::Train( vtkCollection* trainingWorkflowSequences, bool parallelTraining )
 {
-  // Calculate the number of centroids for each task  
-  std::vector< std::string > taskNames = this->GetWorkflowProcedureNode()->GetAllTaskNames();
-  
-  std::map< std::string, int > taskNumCentroids = this->CalculateTaskNumCentroids( trainingWorkflowSequences );
-  std::map< std::string, int > taskCumCentroids;
-  int currSum = 0;
-
-  // Calculate the cumulative number of centroids for cluster numbering
-  std::map< std::string, int > cumulativeCentroids;
-  std::map< std::string, int >::iterator itrInt;
-  for ( itrInt = taskNumCentroids.begin(); itrInt != taskNumCentroids.end(); itrInt++ )
+  if ( ! this->PrepareTraining( trainingWorkflowSequences ) )
   {
-	// Make sure that every task is represented in the procedures
-	  if ( itrInt->second == 0 )
-	  {
-      return false;
-	  }
+    return false;
+  }
+  if ( ! this->ComputeTraining( parallelTraining ) )
+  {
+    return false;
+  }
+  return this->CommitTraining();
+}
 
-	  cumulativeCentroids[ itrInt->first ] = currSum;
-	  currSum += itrInt->second;
+
+bool vtkMRMLWorkflowToolNode
+::Train( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices, bool parallelTraining )
+{
+  return this->Train( trainingMatrices, std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >(), parallelTraining );
+}
+
+
+bool vtkMRMLWorkflowToolNode
+::Train( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices, const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& unlabelledMatrices, bool parallelTraining )
+{
+  if ( ! this->PrepareTraining( trainingMatrices, unlabelledMatrices ) )
+  {
+    return false;
+  }
+  if ( ! this->ComputeTraining( parallelTraining ) )
+  {
+    return false;
   }
+  return this->CommitTraining();
+}
+
 
-  // Apply Gaussian filtering to each record log
-  vtkNew< vtkCollection > filterWorkflowSequences;
+// Pull each procedure into a dense feature matrix, so we do not have to go through the data nodes for every step
+bool vtkMRMLWorkflowToolNode
+::PrepareTraining( vtkCollection* trainingWorkflowSequences )
+{
+  std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > > trainingMatrices;
   vtkNew< vtkCollectionIterator > workflowSequencesIt; workflowSequencesIt->SetCollection( trainingWorkflowSequences );
   for ( workflowSequencesIt->InitTraversal(); ! workflowSequencesIt->IsDoneWithTraversal(); workflowSequencesIt->GoToNextItem() )
   {
@@ -274,253 +314,370 @@ bool vtkMRMLWorkflowToolNode
       continue;
     }
 
-    vtkSmartPointer< vtkMRMLWorkflowSequenceNode > currFilterWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-    currFilterWorkflowSequence->Copy( currWorkflowSequence );
-    currFilterWorkflowSequence->GaussianFilter( this->GetWorkflowInputNode()->GetFilterWidth() );
-    filterWorkflowSequences->AddItem( currFilterWorkflowSequence );
+    vtkSmartPointer< vtkWorkflowFeatureMatrix > currWorkflowMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+    currWorkflowSequence->ToFeatureMatrix( currWorkflowMatrix );
+    trainingMatrices.push_back( currWorkflowMatrix );
   }
 
+  return this->PrepareTraining( trainingMatrices );
+}
+
+
+bool vtkMRMLWorkflowToolNode
+::PrepareTraining( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices )
+{
+  return this->PrepareTraining( trainingMatrices, std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >() );
+}
 
-  // Use velocity and higher order derivatives also
-  vtkNew< vtkCollection > derivativeWorkflowSequences;
-  vtkNew< vtkCollectionIterator > filterWorkflowSequencesIt; filterWorkflowSequencesIt->SetCollection( filterWorkflowSequences.GetPointer() );
-  for ( filterWorkflowSequencesIt->InitTraversal(); ! filterWorkflowSequencesIt->IsDoneWithTraversal(); filterWorkflowSequencesIt->GoToNextItem() )
+
+// Take a snapshot of everything needed from the scene
+// The matrices are only read by the compute step, so they are kept rather than copied (do not change them until training is committed)
+bool vtkMRMLWorkflowToolNode
+::PrepareTraining( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices, const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& unlabelledMatrices )
+{
+  this->TrainingPrepared = false;
+  this->TrainingMatrices.clear();
+  this->UnlabelledTrainingMatrices.clear();
+  if ( ! this->IsWorkflowProcedureSet() || ! this->IsWorkflowInputSet() || ! this->IsWorkflowTrainingSet() )
   {
-    vtkMRMLWorkflowSequenceNode* currFilterWorkflowSequence = vtkMRMLWorkflowSequenceNode::SafeDownCast( filterWorkflowSequencesIt->GetCurrentObject() );
-    if ( currFilterWorkflowSequence == NULL )
+    return false;
+  }
+
+  // Calculate the number of centroids for each task
+  this->TrainingTaskNames = this->GetWorkflowProcedureNode()->GetAllTaskNames();
+  this->TrainingTaskNumCentroids = this->CalculateTaskNumCentroids( trainingMatrices );
+
+  std::map< std::string, int >::iterator itrInt;
+  for ( itrInt = this->TrainingTaskNumCentroids.begin(); itrInt != this->TrainingTaskNumCentroids.end(); itrInt++ )
+  {
+    // Make sure that every task is represented in the procedures
+    if ( itrInt->second == 0 )
     {
-      continue;
+      return false;
     }
-
-    vtkSmartPointer< vtkMRMLWorkflowSequenceNode > currDerivativeWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-    currDerivativeWorkflowSequence->Copy( currFilterWorkflowSequence );
-    
-    for ( int d = 1; d <= this->GetWorkflowInputNode()->GetDerivative(); d++ )
-	  {
-	    vtkSmartPointer< vtkMRMLWorkflowSequenceNode > currOrderWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-      currOrderWorkflowSequence->Copy( currFilterWorkflowSequence );
-      currOrderWorkflowSequence->Differentiate( d );
-      
-      currDerivativeWorkflowSequence->ConcatenateValues( currOrderWorkflowSequence );
-	  }
-    
-    derivativeWorkflowSequences->AddItem( currDerivativeWorkflowSequence );
   }
 
+  this->TrainingInput = vtkSmartPointer< vtkMRMLWorkflowInputNode >::New();
+  this->TrainingInput->Copy( this->GetWorkflowInputNode() );
 
-  // Apply orthogonal transformation
-  vtkNew< vtkCollection > orthogonalWorkflowSequences;
-  vtkNew< vtkCollectionIterator > derivativeWorkflowSequencesIt; derivativeWorkflowSequencesIt->SetCollection( derivativeWorkflowSequences.GetPointer() );
-  for ( derivativeWorkflowSequencesIt->InitTraversal(); ! derivativeWorkflowSequencesIt->IsDoneWithTraversal(); derivativeWorkflowSequencesIt->GoToNextItem() )
+  for ( int i = 0; i < trainingMatrices.size(); i++ )
   {
-    vtkMRMLWorkflowSequenceNode* currDerivativeWorkflowSequence = vtkMRMLWorkflowSequenceNode::SafeDownCast( derivativeWorkflowSequencesIt->GetCurrentObject() );
-    if ( currDerivativeWorkflowSequence == NULL )
+    if ( trainingMatrices.at( i ) == NULL )
     {
       continue;
     }
 
-    vtkSmartPointer< vtkMRMLWorkflowSequenceNode > currOrthogonalWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-    currOrthogonalWorkflowSequence->Copy( currDerivativeWorkflowSequence );
-    currOrthogonalWorkflowSequence->OrthogonalTransformation( this->GetWorkflowInputNode()->GetOrthogonalWindow(), this->GetWorkflowInputNode()->GetOrthogonalOrder() );
-    orthogonalWorkflowSequences->AddItem( currOrthogonalWorkflowSequence );
+    this->TrainingMatrices.push_back( trainingMatrices.at( i ) );
   }
-
-  // Concatenate all of the record logs into one record log
-  // Observe that the concatenated buffers are sorted by time stamp - its order is not maintained by procedure, but this is ok
-  vtkNew< vtkMRMLWorkflowSequenceNode > concatenatedOrthogonalWorkflowSequence;
-  vtkNew< vtkCollectionIterator > orthogonalWorkflowSequencesIt; orthogonalWorkflowSequencesIt->SetCollection( orthogonalWorkflowSequences.GetPointer() );
-  for ( orthogonalWorkflowSequencesIt->InitTraversal(); ! orthogonalWorkflowSequencesIt->IsDoneWithTraversal(); orthogonalWorkflowSequencesIt->GoToNextItem() )
+  for ( int i = 0; i < unlabelledMatrices.size(); i++ )
   {
-    vtkMRMLWorkflowSequenceNode* currOrthogonalWorkflowSequence = vtkMRMLWorkflowSequenceNode::SafeDownCast( orthogonalWorkflowSequencesIt->GetCurrentObject() );
-    if ( currOrthogonalWorkflowSequence == NULL )
+    if ( unlabelledMatrices.at( i ) == NULL )
     {
       continue;
     }
 
-    concatenatedOrthogonalWorkflowSequence->Concatenate( currOrthogonalWorkflowSequence, true );
+    this->UnlabelledTrainingMatrices.push_back( unlabelledMatrices.at( i ) );
+  }
+
+  this->TrainingResult = vtkSmartPointer< vtkMRMLWorkflowTrainingNode >::New();
+  this->TrainingPrepared = true;
+  return true;
+}
+
+
+// Apply Gaussian filtering, use velocity and higher order derivatives also, then apply orthogonal transformation
+void vtkMRMLWorkflowToolNode
+::ExtractProcedureFeatures( vtkWorkflowFeatureMatrix* workflowMatrix, vtkMRMLWorkflowInputNode* workflowInput, vtkWorkflowFeatureMatrix* orthogonalWorkflowMatrix )
+{
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > currFilterWorkflowMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  currFilterWorkflowMatrix->Copy( workflowMatrix );
+  currFilterWorkflowMatrix->GaussianFilter( workflowInput->GetFilterWidth() );
+
+  orthogonalWorkflowMatrix->Copy( currFilterWorkflowMatrix );
+  for ( int d = 1; d <= workflowInput->GetDerivative(); d++ )
+  {
+    vtkSmartPointer< vtkWorkflowFeatureMatrix > currOrderWorkflowMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+    currOrderWorkflowMatrix->Copy( currFilterWorkflowMatrix );
+    currOrderWorkflowMatrix->Differentiate( d );
+
+    orthogonalWorkflowMatrix->ConcatenateValues( currOrderWorkflowMatrix );
   }
 
+  orthogonalWorkflowMatrix->OrthogonalTransformation( workflowInput->GetOrthogonalWindow(), workflowInput->GetOrthogonalOrder() );
+}
+
+
+// This does not touch the scene (only the snapshot from the prepare step), so it can be called from any thread
+bool vtkMRMLWorkflowToolNode
+::ComputeTraining( bool parallelProcedures )
+{
+  if ( ! this->TrainingPrepared )
+  {
+    return false;
+  }
+
+  // The procedures are independent until they are concatenated
+  std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > > orthogonalWorkflowMatrices;
+  for ( int i = 0; i < this->TrainingMatrices.size(); i++ )
+  {
+    orthogonalWorkflowMatrices.push_back( vtkSmartPointer< vtkWorkflowFeatureMatrix >::New() );
+  }
+
+  vtkWorkflowProcedureFeaturesFunctor proceduresFunctor;
+  proceduresFunctor.WorkflowMatrices = &this->TrainingMatrices;
+  proceduresFunctor.OrthogonalWorkflowMatrices = &orthogonalWorkflowMatrices;
+  proceduresFunctor.WorkflowInput = this->TrainingInput;
+  if ( parallelProcedures )
+  {
+    vtkSMPTools::For( 0, this->TrainingMatrices.size(), 1, proceduresFunctor );
+  }
+  else
+  {
+    proceduresFunctor( 0, this->TrainingMatrices.size() );
+  }
+
+  // Concatenate all of the record logs into one record log
+  // Observe that the concatenated buffers are sorted by time stamp - its order is not maintained by procedure, but this is ok
+  vtkNew< vtkWorkflowFeatureMatrix > concatenatedOrthogonalWorkflowMatrix;
+  concatenatedOrthogonalWorkflowMatrix->Concatenate( orthogonalWorkflowMatrices, true );
+
   // Calculate PCA transform
   vtkSmartPointer< vtkDoubleArray > mean = vtkSmartPointer< vtkDoubleArray >::New();
-  concatenatedOrthogonalWorkflowSequence->Mean( mean );
-  this->GetWorkflowTrainingNode()->SetMean( mean );
+  concatenatedOrthogonalWorkflowMatrix->Mean( mean );
+  this->TrainingResult->SetMean( mean );
 
   vtkSmartPointer< vtkDoubleArray > prinComps = vtkSmartPointer< vtkDoubleArray >::New();
-  concatenatedOrthogonalWorkflowSequence->CalculatePrincipalComponents( this->GetWorkflowInputNode()->GetNumPrinComps(), prinComps );
-  this->GetWorkflowTrainingNode()->SetPrinComps( prinComps );
+  vtkWorkflowFeatureMatrix::PrincipalComponentsMethod prinCompsMethod = vtkWorkflowFeatureMatrix::FULL_EIGENSOLVER;
+  if ( this->TrainingInput->GetTruncatedPrinComps() )
+  {
+    prinCompsMethod = vtkWorkflowFeatureMatrix::TRUNCATED_EIGENSOLVER;
+  }
+  concatenatedOrthogonalWorkflowMatrix->CalculatePrincipalComponents( this->TrainingInput->GetNumPrinComps(), prinComps, prinCompsMethod );
+  this->TrainingResult->SetPrinComps( prinComps );
 
   // Apply PCA transformation
-  vtkNew< vtkCollection > pcaWorkflowSequences;
-  for ( orthogonalWorkflowSequencesIt->InitTraversal(); ! orthogonalWorkflowSequencesIt->IsDoneWithTraversal(); orthogonalWorkflowSequencesIt->GoToNextItem() )
+  std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > > pcaWorkflowMatrices;
+  for ( int i = 0; i < orthogonalWorkflowMatrices.size(); i++ )
   {
-    vtkMRMLWorkflowSequenceNode* currOrthogonalWorkflowSequence = vtkMRMLWorkflowSequenceNode::SafeDownCast( orthogonalWorkflowSequencesIt->GetCurrentObject() );
-    if ( currOrthogonalWorkflowSequence == NULL )
-    {
-      continue;
-    }
-
-    vtkSmartPointer< vtkMRMLWorkflowSequenceNode > currPCAWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-    currPCAWorkflowSequence->Copy( currOrthogonalWorkflowSequence );
-    currPCAWorkflowSequence->TransformByPrincipalComponents( this->GetWorkflowTrainingNode()->GetPrinComps(), this->GetWorkflowTrainingNode()->GetMean() );
-    pcaWorkflowSequences->AddItem( currPCAWorkflowSequence );
+    vtkSmartPointer< vtkWorkflowFeatureMatrix > currPCAWorkflowMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+    currPCAWorkflowMatrix->Copy( orthogonalWorkflowMatrices.at( i ) );
+    currPCAWorkflowMatrix->TransformByPrincipalComponents( this->TrainingResult->GetPrinComps(), this->TrainingResult->GetMean() );
+    pcaWorkflowMatrices.push_back( currPCAWorkflowMatrix );
   }
-  vtkSmartPointer< vtkMRMLWorkflowSequenceNode > concatenatedPCAWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-  concatenatedPCAWorkflowSequence->Copy( concatenatedOrthogonalWorkflowSequence.GetPointer() );
-  concatenatedPCAWorkflowSequence->TransformByPrincipalComponents( this->GetWorkflowTrainingNode()->GetPrinComps(), this->GetWorkflowTrainingNode()->GetMean() );
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > concatenatedPCAWorkflowMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  concatenatedPCAWorkflowMatrix->Copy( concatenatedOrthogonalWorkflowMatrix.GetPointer() );
+  concatenatedPCAWorkflowMatrix->TransformByPrincipalComponents( this->TrainingResult->GetPrinComps(), this->TrainingResult->GetMean() );
 
-  // Put together all the tasks together for task by task clustering
-  std::map< std::string, vtkSmartPointer< vtkMRMLWorkflowSequenceNode > > taskwiseWorkflowSequences;
-  for ( int i = 0; i < taskNames.size(); i++ )
+  // Put together all the tasks together for task by task clustering (these are just views, so nothing is copied)
+  std::map< std::string, vtkWorkflowSequenceView > taskwiseWorkflowViews;
+  for ( int i = 0; i < this->TrainingTaskNames.size(); i++ )
   {
     std::vector< std::string > currTask;
-    currTask.push_back( taskNames.at( i ) );
+    currTask.push_back( this->TrainingTaskNames.at( i ) );
 
-    vtkSmartPointer< vtkMRMLWorkflowSequenceNode > currTaskwiseWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-    concatenatedPCAWorkflowSequence->GetLabelledSubsequence( currTask, currTaskwiseWorkflowSequence );
-    taskwiseWorkflowSequences[ taskNames.at( i ) ] = currTaskwiseWorkflowSequence;
+    taskwiseWorkflowViews[ this->TrainingTaskNames.at( i ) ] = concatenatedPCAWorkflowMatrix->GetLabelledSubmatrixView( currTask );
   }
 
   // Calculate and add the centroids from each task
   vtkSmartPointer< vtkDoubleArray > allCentroids = vtkSmartPointer< vtkDoubleArray >::New();
-  allCentroids->SetNumberOfComponents( this->GetWorkflowInputNode()->GetNumPrinComps() );
+  allCentroids->SetNumberOfComponents( this->TrainingInput->GetNumPrinComps() );
   allCentroids->SetNumberOfTuples( 0 ); // We will append tuples
 
-  std::map< std::string, vtkSmartPointer< vtkMRMLWorkflowSequenceNode > >::iterator taskwiseWorfklowSequencesIt;
-  for ( taskwiseWorfklowSequencesIt = taskwiseWorkflowSequences.begin(); taskwiseWorfklowSequencesIt != taskwiseWorkflowSequences.end(); taskwiseWorfklowSequencesIt++ )
+  std::map< std::string, vtkWorkflowSequenceView >::iterator taskwiseWorkflowViewsIt;
+  for ( taskwiseWorkflowViewsIt = taskwiseWorkflowViews.begin(); taskwiseWorkflowViewsIt != taskwiseWorkflowViews.end(); taskwiseWorkflowViewsIt++ )
   {
     vtkNew< vtkDoubleArray > currTaskCentroids;
-	  taskwiseWorfklowSequencesIt->second->fwdkmeans( taskNumCentroids[ taskwiseWorfklowSequencesIt->first ], currTaskCentroids.GetPointer() ); // Second is the workflow sequence node
+    taskwiseWorkflowViewsIt->second.fwdkmeans( this->TrainingTaskNumCentroids[ taskwiseWorkflowViewsIt->first ], currTaskCentroids.GetPointer() ); // Second is the view of the workflow feature matrix
 
     allCentroids->InsertTuples( allCentroids->GetNumberOfTuples(), currTaskCentroids->GetNumberOfTuples(), 0, currTaskCentroids.GetPointer() );
   }
-  this->GetWorkflowTrainingNode()->SetCentroids( allCentroids );
+  this->TrainingResult->SetCentroids( allCentroids );
 
   // Calculate the sequence of centroids for each procedure
-  vtkNew< vtkCollection > centroidWorkflowSequences;
-  vtkNew< vtkCollectionIterator > pcaWorkflowSequencesIt; pcaWorkflowSequencesIt->SetCollection( pcaWorkflowSequences.GetPointer() );
-  for ( pcaWorkflowSequencesIt->InitTraversal(); ! pcaWorkflowSequencesIt->IsDoneWithTraversal(); pcaWorkflowSequencesIt->GoToNextItem() )
+  // The centroid index is the symbol, and the label is the state (these are the same as the Markov model attributes, without going through strings for every frame)
+  std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > > centroidWorkflowMatrices;
+  for ( int i = 0; i < pcaWorkflowMatrices.size(); i++ )
   {
-    vtkMRMLWorkflowSequenceNode* currPCAWorkflowSequence = vtkMRMLWorkflowSequenceNode::SafeDownCast( pcaWorkflowSequencesIt->GetCurrentObject() );
-    if ( currPCAWorkflowSequence == NULL )
-    {
-      continue;
-    }
-
-    vtkSmartPointer< vtkMRMLWorkflowSequenceNode > currCentroidWorkflowSequence = vtkSmartPointer< vtkMRMLWorkflowSequenceNode >::New();
-    currCentroidWorkflowSequence->Copy( currPCAWorkflowSequence );
-    currCentroidWorkflowSequence->fwdkmeansTransform( this->GetWorkflowTrainingNode()->GetCentroids() );
-    centroidWorkflowSequences->AddItem( currCentroidWorkflowSequence );
+    vtkSmartPointer< vtkWorkflowFeatureMatrix > currCentroidWorkflowMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+    currCentroidWorkflowMatrix->Copy( pcaWorkflowMatrices.at( i ) );
+    currCentroidWorkflowMatrix->fwdkmeansTransform( this->TrainingResult->GetCentroids() );
+    centroidWorkflowMatrices.push_back( currCentroidWorkflowMatrix );
   }
 
   // Assume that all the estimation matrices are associated with the pseudo scales
+  int numTasks = this->TrainingTaskNames.size();
   vtkSmartPointer< vtkDoubleArray > PseudoPi = vtkSmartPointer< vtkDoubleArray >::New();
-  PseudoPi->SetNumberOfComponents( this->GetWorkflowProcedureNode()->GetNumTasks() );
+  PseudoPi->SetNumberOfComponents( numTasks );
   PseudoPi->SetNumberOfTuples( 1 );
   for ( int j = 0; j < PseudoPi->GetNumberOfComponents(); j++ )
   {
-    PseudoPi->FillComponent( j, this->GetWorkflowInputNode()->GetMarkovPseudoScalePi() ); // TODO: We want to call the "Fill" function, but it is not yet available in Slicer's VTK
+    PseudoPi->FillComponent( j, this->TrainingInput->GetMarkovPseudoScalePi() );
   }
 
   vtkSmartPointer< vtkDoubleArray > PseudoA = vtkSmartPointer< vtkDoubleArray >::New();
-  PseudoA->SetNumberOfComponents( this->GetWorkflowProcedureNode()->GetNumTasks() );
-  PseudoA->SetNumberOfTuples( this->GetWorkflowProcedureNode()->GetNumTasks() );
+  PseudoA->SetNumberOfComponents( numTasks );
+  PseudoA->SetNumberOfTuples( numTasks );
   for ( int j = 0; j < PseudoA->GetNumberOfComponents(); j++ )
   {
-    PseudoA->FillComponent( j, this->GetWorkflowInputNode()->GetMarkovPseudoScaleA() ); // TODO: We want to call the "Fill" function, but it is not yet available in Slicer's VTK
+    PseudoA->FillComponent( j, this->TrainingInput->GetMarkovPseudoScaleA() );
   }
 
   vtkSmartPointer< vtkDoubleArray > PseudoB = vtkSmartPointer< vtkDoubleArray >::New();
-  PseudoB->SetNumberOfComponents( this->GetWorkflowInputNode()->GetNumCentroids() );
-  PseudoB->SetNumberOfTuples( this->GetWorkflowProcedureNode()->GetNumTasks() );
+  PseudoB->SetNumberOfComponents( this->TrainingInput->GetNumCentroids() );
+  PseudoB->SetNumberOfTuples( numTasks );
   for ( int j = 0; j < PseudoB->GetNumberOfComponents(); j++ )
   {
-    PseudoB->FillComponent( j, this->GetWorkflowInputNode()->GetMarkovPseudoScaleB() ); // TODO: We want to call the "Fill" function, but it is not yet available in Slicer's VTK
+    PseudoB->FillComponent( j, this->TrainingInput->GetMarkovPseudoScaleB() );
   }
 
   // Create a new Markov Model, and estimate its parameters
   vtkSmartPointer< vtkMarkovModel > Markov = vtkSmartPointer< vtkMarkovModel >::New();
-  Markov->SetStates( taskNames );
-  Markov->SetSymbols( this->GetWorkflowInputNode()->GetNumCentroids() );
+  Markov->SetStates( this->TrainingTaskNames );
+  Markov->SetSymbols( this->TrainingInput->GetNumCentroids() );
   Markov->InitializeEstimation();
 
-  vtkNew< vtkCollectionIterator > centroidWorkflowSequencesIt;
-
   Markov->AddPseudoData( PseudoPi, PseudoA, PseudoB );
 
-  // TODO: Dedugging
-  centroidWorkflowSequencesIt->SetCollection( centroidWorkflowSequences.GetPointer() );
-  for ( centroidWorkflowSequencesIt->InitTraversal(); ! centroidWorkflowSequencesIt->IsDoneWithTraversal(); centroidWorkflowSequencesIt->GoToNextItem() )
+  // Empty procedures carry no information at all, so they are skipped
+  for ( int i = 0; i < centroidWorkflowMatrices.size(); i++ )
   {
-    vtkMRMLWorkflowSequenceNode* currCentroidWorkflowSequence = vtkMRMLWorkflowSequenceNode::SafeDownCast( centroidWorkflowSequencesIt->GetCurrentObject() );
-    if ( currCentroidWorkflowSequence == NULL )
+    vtkWorkflowFeatureMatrix* currCentroidWorkflowMatrix = centroidWorkflowMatrices.at( i );
+    if ( currCentroidWorkflowMatrix->GetNumberOfComponents() < 1 || currCentroidWorkflowMatrix->GetNumberOfFrames() < 1 )
     {
       continue;
     }
 
-    currCentroidWorkflowSequence->AddMarkovModelAttributes();
-    Markov->AddEstimationData( currCentroidWorkflowSequence );
+    std::vector< int > states( currCentroidWorkflowMatrix->GetNumberOfFrames(), -1 );
+    std::vector< int > symbols( currCentroidWorkflowMatrix->GetNumberOfFrames(), -1 );
+    for ( int j = 0; j < currCentroidWorkflowMatrix->GetNumberOfFrames(); j++ )
+    {
+      states[ j ] = Markov->LookupState( currCentroidWorkflowMatrix->GetLabel( j ) );
+      symbols[ j ] = int( currCentroidWorkflowMatrix->GetFrame( j )[ 0 ] ); // The symbol names are the centroid indices
+    }
+    Markov->AddEstimationData( states, symbols );
+  }
+
+  // The unlabelled procedures are only projected through the trained principal components and centroids, to get their symbol sequences
+  // They never change the principal components or the centroids, and without Baum-Welch they are not used at all
+  std::vector< std::vector< int > > unlabelledSymbols;
+  if ( this->TrainingInput->GetMarkovBaumWelchIterations() > 0 )
+  {
+    std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > > unlabelledWorkflowMatrices;
+    for ( int i = 0; i < this->UnlabelledTrainingMatrices.size(); i++ )
+    {
+      unlabelledWorkflowMatrices.push_back( vtkSmartPointer< vtkWorkflowFeatureMatrix >::New() );
+    }
+
+    vtkWorkflowProcedureFeaturesFunctor unlabelledFunctor;
+    unlabelledFunctor.WorkflowMatrices = &this->UnlabelledTrainingMatrices;
+    unlabelledFunctor.OrthogonalWorkflowMatrices = &unlabelledWorkflowMatrices;
+    unlabelledFunctor.WorkflowInput = this->TrainingInput;
+    if ( parallelProcedures )
+    {
+      vtkSMPTools::For( 0, this->UnlabelledTrainingMatrices.size(), 1, unlabelledFunctor );
+    }
+    else
+    {
+      unlabelledFunctor( 0, this->UnlabelledTrainingMatrices.size() );
+    }
+
+    for ( int i = 0; i < unlabelledWorkflowMatrices.size(); i++ )
+    {
+      vtkWorkflowFeatureMatrix* currUnlabelledWorkflowMatrix = unlabelledWorkflowMatrices.at( i );
+      if ( currUnlabelledWorkflowMatrix->GetNumberOfComponents() < 1 || currUnlabelledWorkflowMatrix->GetNumberOfFrames() < 1 )
+      {
+        continue;
+      }
+      currUnlabelledWorkflowMatrix->TransformByPrincipalComponents( this->TrainingResult->GetPrinComps(), this->TrainingResult->GetMean() );
+      currUnlabelledWorkflowMatrix->fwdkmeansTransform( this->TrainingResult->GetCentroids() );
+
+      std::vector< int > symbols( currUnlabelledWorkflowMatrix->GetNumberOfFrames(), -1 );
+      for ( int j = 0; j < currUnlabelledWorkflowMatrix->GetNumberOfFrames(); j++ )
+      {
+        symbols[ j ] = int( currUnlabelledWorkflowMatrix->GetFrame( j )[ 0 ] ); // The symbol names are the centroid indices
+      }
+      unlabelledSymbols.push_back( symbols );
+    }
+  }
+
+  if ( ! unlabelledSymbols.empty() )
+  {
+    Markov->EstimateParameters( unlabelledSymbols, this->TrainingInput->GetMarkovBaumWelchIterations(), this->TrainingInput->GetMarkovBaumWelchTolerance() );
+  }
+  else
+  {
+    Markov->EstimateParameters();
   }
-  Markov->EstimateParameters();
 
-  this->GetWorkflowTrainingNode()->GetMarkov()->vtkMarkovModel::Copy( Markov ); // Need to use the superclass copy
+  this->TrainingResult->GetMarkov()->vtkMarkovModel::Copy( Markov ); // Need to use the superclass copy
 
   return true;
 }
 
 
-void vtkMRMLWorkflowToolNode
-::AddAndSegmentTransform( vtkMRMLLinearTransformNode* newTransformNode, std::string newTimeString )
+// Write the results to the training node (this must be on the main thread, because it invokes events in the scene)
+bool vtkMRMLWorkflowToolNode
+::CommitTraining()
 {
-  vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode > rawDoubleArrayNode = vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode >::New();
-  vtkMRMLWorkflowSequenceNode::LinearTransformToDoubleArray( newTransformNode, rawDoubleArrayNode, vtkMRMLWorkflowSequenceNode::QUATERNION_ARRAY );
-  this->RawWorkflowSequence->SetDataNodeAtValue( rawDoubleArrayNode, newTimeString );
+  if ( ! this->TrainingPrepared || this->TrainingResult == NULL || ! this->IsWorkflowTrainingSet() )
+  {
+    return false;
+  }
 
-  // Apply Gaussian filtering to each previous records
-  vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode > gaussDoubleArrayNode = vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode >::New();
-  this->RawWorkflowSequence->GaussianFilterOnline( this->GetWorkflowInputNode()->GetFilterWidth(), gaussDoubleArrayNode->GetArray() );
-  this->FilterWorkflowSequence->SetDataNodeAtValue( gaussDoubleArrayNode, newTimeString );
-  
-  // Concatenate with derivative (velocity, acceleration, etc...)
-  
-  vtkNew< vtkDoubleArray > derivativeDoubleArray;
-  derivativeDoubleArray->DeepCopy( this->FilterWorkflowSequence->GetNthDoubleArray( this->FilterWorkflowSequence->GetNumberOfDataNodes() - 1 ) );
-  for ( int d = 1; d <= this->GetWorkflowInputNode()->GetDerivative(); d++ )
-  {    
-    vtkSmartPointer< vtkDoubleArray > tempDerivativeDoubleArray = vtkSmartPointer< vtkDoubleArray >::New();
-    tempDerivativeDoubleArray->DeepCopy( derivativeDoubleArray.GetPointer() );
+  this->GetWorkflowTrainingNode()->SetMean( this->TrainingResult->GetMean() );
+  this->GetWorkflowTrainingNode()->SetPrinComps( this->TrainingResult->GetPrinComps() );
+  this->GetWorkflowTrainingNode()->SetCentroids( this->TrainingResult->GetCentroids() );
+  this->GetWorkflowTrainingNode()->GetMarkov()->vtkMarkovModel::Copy( this->TrainingResult->GetMarkov() ); // Need to use the superclass copy
 
-    vtkSmartPointer< vtkDoubleArray > currDerivativeDoubleArray = vtkSmartPointer< vtkDoubleArray >::New();
-    this->FilterWorkflowSequence->DifferentiateOnline( d, currDerivativeDoubleArray );
+  // Release the snapshot
+  this->TrainingPrepared = false;
+  this->TrainingMatrices.clear();
+  this->UnlabelledTrainingMatrices.clear();
+  this->TrainingResult = NULL;
 
-    vtkMRMLWorkflowSequenceNode::ConcatenateDoubleArrays( tempDerivativeDoubleArray, currDerivativeDoubleArray, derivativeDoubleArray.GetPointer() );
-  }
-  vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode > derivativeDoubleArrayNode = vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode >::New();
-  derivativeDoubleArrayNode->GetArray()->DeepCopy( derivativeDoubleArray.GetPointer() );
-  this->DerivativeWorkflowSequence->SetDataNodeAtValue( derivativeDoubleArrayNode, newTimeString );
+  return true;
+}
 
-  // Apply orthogonal transformation
-  vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode > orthogonalDoubleArrayNode = vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode >::New();
-  this->DerivativeWorkflowSequence->OrthogonalTransformationOnline( this->GetWorkflowInputNode()->GetOrthogonalWindow(), this->GetWorkflowInputNode()->GetOrthogonalOrder(), orthogonalDoubleArrayNode->GetArray() );
-  this->OrthogonalWorkflowSequence->SetDataNodeAtValue( orthogonalDoubleArrayNode, newTimeString );
 
-  // Apply PCA transformation
-  vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode > pcaDoubleArrayNode = vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode >::New();
-  this->OrthogonalWorkflowSequence->TransformByPrincipalComponentsOnline( this->GetWorkflowTrainingNode()->GetPrinComps(), this->GetWorkflowTrainingNode()->GetMean(), pcaDoubleArrayNode->GetArray() );
-  this->PcaWorkflowSequence->SetDataNodeAtValue( pcaDoubleArrayNode, newTimeString );
+void vtkMRMLWorkflowToolNode
+::AddAndSegmentTransform( vtkMRMLLinearTransformNode* newTransformNode, std::string newTimeString )
+{
+  if ( newTransformNode == NULL || ! this->IsWorkflowProcedureSet() || ! this->IsWorkflowInputSet() || ! this->IsWorkflowTrainingSet() )
+  {
+    return;
+  }
 
-  // Apply centroid transformation
-  vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode > fwdkmeansDoubleArrayNode = vtkSmartPointer< vtkMRMLWorkflowDoubleArrayNode >::New();
-  this->PcaWorkflowSequence->fwdkmeansTransformOnline( this->GetWorkflowTrainingNode()->GetCentroids(), fwdkmeansDoubleArrayNode->GetArray() );
-  this->CentroidWorkflowSequence->SetDataNodeAtValue( fwdkmeansDoubleArrayNode, newTimeString );
+  // Only resize the pipeline if the parameters have changed (this is the only time it allocates)
+  vtkMTimeType parametersTime = std::max( this->GetWorkflowInputNode()->GetMTime(), this->GetWorkflowTrainingNode()->GetMTime() );
+  if ( parametersTime > this->OnlinePipelineTime )
+  {
+    this->OnlinePipeline->Initialize( this->GetWorkflowInputNode(), this->GetWorkflowTrainingNode(), vtkMRMLWorkflowSequenceNode::QUATERNION_ARRAY );
+    // The online Viterbi state was computed with the old parameters, so start decoding over
+    this->GetWorkflowTrainingNode()->GetMarkov()->ResetOnline();
+    this->OnlinePipelineTime = std::max( this->GetWorkflowInputNode()->GetMTime(), this->GetWorkflowTrainingNode()->GetMTime() );
+  }
+
+  // Filter, derivative, orthogonal, PCA and centroid transformations
+  newTransformNode->GetMatrixTransformToParent( this->ToolMatrix );
+  vtkMRMLWorkflowSequenceNode::LinearTransformToValues( this->ToolMatrix, &this->RawValues[ 0 ], vtkMRMLWorkflowSequenceNode::QUATERNION_ARRAY );
+  int centroid = this->OnlinePipeline->AddFrame( vtkMRMLWorkflowSequenceNode::IndexValueToDouble( newTimeString ), &this->RawValues[ 0 ] );
+  if ( centroid < 0 )
+  {
+    return;
+  }
 
   // Use Markov Model calculate states to come up with the current most likely state...
-  // Now, we will keep a recording of the workflow segmentation
-  vtkMRMLNode* currCentroidWorkflowSequenceNode = vtkMRMLNode::SafeDownCast( this->CentroidWorkflowSequence->GetNthDataNode( this->RawWorkflowSequence->GetNumberOfDataNodes() - 1 ) );
-  this->CentroidWorkflowSequence->AddMarkovModelAttributesOnline( currCentroidWorkflowSequenceNode );
-  this->GetWorkflowTrainingNode()->GetMarkov()->CalculateStateOnline( currCentroidWorkflowSequenceNode, newTimeString );
-  currCentroidWorkflowSequenceNode->SetAttribute( "Message", currCentroidWorkflowSequenceNode->GetAttribute( "MarkovState" ) );
+  // The centroid is the symbol
+  // With a fixed lag, the state is for an earlier frame, but it is still the best estimate of the current task
+  vtkMarkovModelOnline* markov = this->GetWorkflowTrainingNode()->GetMarkov();
+  markov->SetFixedLag( this->GetWorkflowInputNode()->GetMarkovFixedLag() ); // Does nothing unless the lag has changed
+  int state = markov->CalculateStateOnline( centroid );
+  if ( state < 0 )
+  {
+    return;
+  }
 
-  this->SetCurrentTask( this->GetWorkflowProcedureNode()->GetTask( currCentroidWorkflowSequenceNode->GetAttribute( "Message" ) ) );
+  this->SetCurrentTask( this->GetWorkflowProcedureNode()->GetTask( markov->GetStateName( state ) ) );
 }
 
 
@@ -549,7 +706,7 @@ void vtkMRMLWorkflowToolNode
 // -----------------------------------------------------------------------------------------
 
 std::map< std::string, double > vtkMRMLWorkflowToolNode
-::CalculateTaskProportions( vtkCollection* trainingWorkflowSequenceNodes )
+::CalculateTaskProportions( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices )
 {
   // Create a vector of counts for each label
   std::map< std::string, double > taskProportions;
@@ -561,33 +718,22 @@ std::map< std::string, double > vtkMRMLWorkflowToolNode
 
   int totalRecords = 0;
   // Iterate over all record logs and count label (task) instances
-  vtkNew< vtkCollectionIterator > workflowSequencesIt; workflowSequencesIt->SetCollection( trainingWorkflowSequenceNodes );
-  for ( workflowSequencesIt->InitTraversal(); ! workflowSequencesIt->IsDoneWithTraversal(); workflowSequencesIt->GoToNextItem() )
+  for ( int i = 0; i < trainingMatrices.size(); i++ )
   {
-    vtkMRMLWorkflowSequenceNode* currWorkflowSequence = vtkMRMLWorkflowSequenceNode::SafeDownCast( workflowSequencesIt->GetCurrentObject() );
-    if ( currWorkflowSequence == NULL )
+    vtkWorkflowFeatureMatrix* currWorkflowMatrix = trainingMatrices.at( i );
+    if ( currWorkflowMatrix == NULL )
     {
       continue;
     }
     
-    for ( int j = 0; j < currWorkflowSequence->GetNumberOfDataNodes(); j++ )
+    for ( int j = 0; j < currWorkflowMatrix->GetNumberOfFrames(); j++ )
 	  {
-      vtkMRMLWorkflowDoubleArrayNode* currDoubleArrayNode = vtkMRMLWorkflowDoubleArrayNode::SafeDownCast( currWorkflowSequence->GetNthDataNode( j ) );
-      if ( currDoubleArrayNode == NULL )
-      {
-        continue;
-      }
-
-      for ( int k = 0; k < taskNames.size(); k++ )
-      {
-        if ( currDoubleArrayNode->GetAttribute( "Message" ) != NULL
-          && taskNames.at( k ).compare( currDoubleArrayNode->GetAttribute( "Message" ) ) == 0 )
-	      {
-	        taskProportions[ taskNames.at( k ) ]++;
-	        totalRecords++;
-	      }
-      }
-
+      std::map< std::string, double >::iterator itrTask = taskProportions.find( currWorkflowMatrix->GetLabel( j ) );
+      if ( itrTask != taskProportions.end() )
+	    {
+	      itrTask->second++;
+	      totalRecords++;
+	    }
 	  }
   }
 
@@ -610,10 +756,10 @@ std::map< std::string, double > vtkMRMLWorkflowToolNode
 
 
 std::map< std::string, double > vtkMRMLWorkflowToolNode
-::EqualizeTaskProportions( vtkCollection* trainingWorkflowSequenceNodes )
+::EqualizeTaskProportions( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices )
 {
   //Find the mean and standard deviation of the task centroids
-  std::map< std::string, double > taskProportions = this->CalculateTaskProportions( trainingWorkflowSequenceNodes );
+  std::map< std::string, double > taskProportions = this->CalculateTaskProportions( trainingMatrices );
 
   double mean = 0;
   std::map< std::string, double >::iterator itrDouble;
@@ -636,10 +782,10 @@ std::map< std::string, double > vtkMRMLWorkflowToolNode
 
 
 std::map< std::string, int > vtkMRMLWorkflowToolNode
-::CalculateTaskNumCentroids( vtkCollection* trainingWorkflowSequenceNodes )
+::CalculateTaskNumCentroids( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices )
 {
   // Create a vector of counts for each label
-  std::map< std::string, double > taskProportions = this->EqualizeTaskProportions( trainingWorkflowSequenceNodes );
+  std::map< std::string, double > taskProportions = this->EqualizeTaskProportions( trainingMatrices );
   std::map< std::string, double > taskRawCentroids;
 
   std::map< std::string, double >::iterator itrDouble;
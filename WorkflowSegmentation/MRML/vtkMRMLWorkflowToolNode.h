@@ -7,6 +7,7 @@
 #include <sstream>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 
 // VTK includes
 #include "vtkObject.h"
@@ -18,6 +19,7 @@
 #include "vtkNew.h"
 #include "vtkCollection.h"
 #include "vtkCollectionIterator.h"
+#include "vtkSMPTools.h"
 
 // Workflow Segmentation includes
 #include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
@@ -26,6 +28,7 @@
 #include "vtkMRMLWorkflowTrainingNode.h"
 #include "vtkMRMLWorkflowSequenceNode.h"
 #include "vtkMRMLWorkflowSequenceOnlineNode.h"
+#include "vtkWorkflowOnlinePipeline.h"
 
 // This class stores a vector of values and a string label
 class VTK_SLICER_WORKFLOWSEGMENTATION_MODULE_MRML_EXPORT 
@@ -87,7 +90,19 @@ public:
   // Computation
   void ResetWorkflowSequences();
   
-  bool Train( vtkCollection* trainingWorkflowSequences );
+  bool Train( vtkCollection* trainingWorkflowSequences, bool parallelTraining = false );
+  // Same, but the procedures are already feature matrices (eg. streamed straight from the tracked sequence browsers)
+  bool Train( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices, bool parallelTraining = false );
+  // The unlabelled procedures are only used to refine the Markov model by Baum-Welch (they do not change the principal components or the centroids)
+  bool Train( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices, const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& unlabelledMatrices, bool parallelTraining = false );
+
+  // Training can also be done in steps, so the computation can be done off the main thread
+  // Only the prepare and commit steps touch the scene; the compute step only works on the prepared snapshot
+  bool PrepareTraining( vtkCollection* trainingWorkflowSequences );
+  bool PrepareTraining( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices );
+  bool PrepareTraining( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices, const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& unlabelledMatrices );
+  bool ComputeTraining( bool parallelProcedures );
+  bool CommitTraining();
   
   void AddAndSegmentTransform( vtkMRMLLinearTransformNode* newTransform, std::string newTimeString );
   
@@ -106,16 +121,31 @@ protected:
 
   std::string ToolName;
   
-  // This will also hold the real-time workflow sequences
-  vtkSmartPointer< vtkMRMLWorkflowSequenceOnlineNode > RawWorkflowSequence, FilterWorkflowSequence, DerivativeWorkflowSequence, OrthogonalWorkflowSequence, PcaWorkflowSequence, CentroidWorkflowSequence;
+  // Real-time segmentation (only the most recent frames are kept, and nothing is allocated per frame)
+  vtkSmartPointer< vtkWorkflowOnlinePipeline > OnlinePipeline;
+  vtkMTimeType OnlinePipelineTime; // The pipeline is resized when the input or training changes
+  vtkSmartPointer< vtkMatrix4x4 > ToolMatrix;
+  std::vector< double > RawValues;
   vtkSmartPointer< vtkWorkflowTask > CurrentTask;
 
   bool CurrentTaskNew;
   
   // Internal helpers for computation
-  std::map< std::string, double > CalculateTaskProportions( vtkCollection* trainingWorkflowSequences );
-  std::map< std::string, double > EqualizeTaskProportions( vtkCollection* trainingWorkflowSequences );
-  std::map< std::string, int > CalculateTaskNumCentroids( vtkCollection* trainingWorkflowSequences );
+  std::map< std::string, double > CalculateTaskProportions( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices );
+  std::map< std::string, double > EqualizeTaskProportions( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices );
+  std::map< std::string, int > CalculateTaskNumCentroids( const std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& trainingMatrices );
+
+  friend class vtkWorkflowProcedureFeaturesFunctor;
+  static void ExtractProcedureFeatures( vtkWorkflowFeatureMatrix* workflowMatrix, vtkMRMLWorkflowInputNode* workflowInput, vtkWorkflowFeatureMatrix* orthogonalWorkflowMatrix );
+
+  // Snapshot of the training inputs, and the results before they are committed
+  bool TrainingPrepared;
+  std::vector< std::string > TrainingTaskNames;
+  std::map< std::string, int > TrainingTaskNumCentroids;
+  vtkSmartPointer< vtkMRMLWorkflowInputNode > TrainingInput;
+  std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > > TrainingMatrices;
+  std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > > UnlabelledTrainingMatrices;
+  vtkSmartPointer< vtkMRMLWorkflowTrainingNode > TrainingResult;
 };
 
 #endif
\ No newline at end of file
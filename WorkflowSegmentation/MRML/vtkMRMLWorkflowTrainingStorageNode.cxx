@@ -15,6 +15,208 @@ Version:   $Revision: 1.2 $
 #include "vtkMRMLWorkflowTrainingStorageNode.h"
 #include "vtkMRMLWorkflowTrainingNode.h"
 
+// VTK includes
+#include "vtkByteSwap.h"
+#include "vtkType.h"
+#include <vtksys/SystemTools.hxx>
+
+// Standard includes
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+// Memory mapping
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// Constants ---------------------------------------------------------------------------------------
+
+const char* vtkMRMLWorkflowTrainingStorageNode::BINARY_MAGIC = "PTWTRAIN";
+const int vtkMRMLWorkflowTrainingStorageNode::BINARY_VERSION = 1;
+const int vtkMRMLWorkflowTrainingStorageNode::BINARY_CHECKSUM_FLAG = 1;
+
+static const int BINARY_HEADER_SIZE = 24;
+static const int BINARY_BLOCK_HEADER_SIZE = 16;
+
+
+// Helpers for binary files ------------------------------------------------------------------------
+
+// Read-only memory mapping of a whole file (unmapped when it goes out of scope)
+class vtkWorkflowTrainingFileMapping
+{
+public:
+  vtkWorkflowTrainingFileMapping()
+  {
+    this->Data = NULL;
+    this->Size = 0;
+#ifdef _WIN32
+    this->File = INVALID_HANDLE_VALUE;
+    this->Mapping = NULL;
+#endif
+  }
+
+  ~vtkWorkflowTrainingFileMapping()
+  {
+#ifdef _WIN32
+    if ( this->Data != NULL )
+    {
+      UnmapViewOfFile( this->Data );
+    }
+    if ( this->Mapping != NULL )
+    {
+      CloseHandle( this->Mapping );
+    }
+    if ( this->File != INVALID_HANDLE_VALUE )
+    {
+      CloseHandle( this->File );
+    }
+#else
+    if ( this->Data != NULL )
+    {
+      munmap( const_cast< char* >( this->Data ), this->Size );
+    }
+#endif
+  }
+
+  bool Open( std::string fileName )
+  {
+#ifdef _WIN32
+    this->File = CreateFileA( fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    LARGE_INTEGER fileSize;
+    if ( this->File == INVALID_HANDLE_VALUE || ! GetFileSizeEx( this->File, &fileSize ) || fileSize.QuadPart == 0 )
+    {
+      return false;
+    }
+    this->Mapping = CreateFileMappingA( this->File, NULL, PAGE_READONLY, 0, 0, NULL );
+    if ( this->Mapping == NULL )
+    {
+      return false;
+    }
+    this->Data = static_cast< const char* >( MapViewOfFile( this->Mapping, FILE_MAP_READ, 0, 0, 0 ) );
+    this->Size = fileSize.QuadPart;
+#else
+    int fileDescriptor = open( fileName.c_str(), O_RDONLY );
+    if ( fileDescriptor < 0 )
+    {
+      return false;
+    }
+    struct stat fileStat;
+    if ( fstat( fileDescriptor, &fileStat ) != 0 || fileStat.st_size == 0 )
+    {
+      close( fileDescriptor );
+      return false;
+    }
+    void* mapping = mmap( NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0 );
+    close( fileDescriptor ); // The mapping stays valid
+    if ( mapping == MAP_FAILED )
+    {
+      return false;
+    }
+    this->Data = static_cast< const char* >( mapping );
+    this->Size = fileStat.st_size;
+#endif
+    return ( this->Data != NULL );
+  }
+
+  const char* Data;
+  size_t Size;
+
+protected:
+#ifdef _WIN32
+  HANDLE File;
+  HANDLE Mapping;
+#endif
+};
+
+
+// 64-bit FNV-1a
+static vtkTypeUInt64 vtkWorkflowTrainingChecksum( const char* data, size_t size )
+{
+  vtkTypeUInt64 hash = 14695981039346656037ULL;
+  for ( size_t i = 0; i < size; i++ )
+  {
+    hash ^= static_cast< unsigned char >( data[ i ] );
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+static void vtkWorkflowTrainingAppendUInt32( std::vector< char >& buffer, vtkTypeUInt32 value )
+{
+  vtkByteSwap::Swap4LE( &value );
+  const char* valueBytes = reinterpret_cast< const char* >( &value );
+  buffer.insert( buffer.end(), valueBytes, valueBytes + sizeof( value ) );
+}
+
+
+static vtkTypeUInt32 vtkWorkflowTrainingReadUInt32( const char* data )
+{
+  vtkTypeUInt32 value;
+  memcpy( &value, data, sizeof( value ) );
+  vtkByteSwap::Swap4LE( &value );
+  return value;
+}
+
+
+static vtkTypeUInt32 vtkWorkflowTrainingSwapUInt32( vtkTypeUInt32 value )
+{
+  return ( ( value & 0x000000FF ) << 24 ) | ( ( value & 0x0000FF00 ) << 8 ) | ( ( value & 0x00FF0000 ) >> 8 ) | ( ( value & 0xFF000000 ) >> 24 );
+}
+
+
+static void vtkWorkflowTrainingAppendPadding( std::vector< char >& buffer )
+{
+  while ( buffer.size() % 8 != 0 )
+  {
+    buffer.push_back( 0 );
+  }
+}
+
+
+static void vtkWorkflowTrainingAppendMatrix( std::vector< char >& buffer, int type, vtkDoubleArray* matrix )
+{
+  vtkTypeUInt32 numberOfValues = ( matrix != NULL ) ? matrix->GetNumberOfTuples() * matrix->GetNumberOfComponents() : 0;
+  vtkWorkflowTrainingAppendUInt32( buffer, type );
+  vtkWorkflowTrainingAppendUInt32( buffer, ( matrix != NULL ) ? matrix->GetNumberOfTuples() : 0 );
+  vtkWorkflowTrainingAppendUInt32( buffer, ( matrix != NULL ) ? matrix->GetNumberOfComponents() : 0 );
+  vtkWorkflowTrainingAppendUInt32( buffer, numberOfValues * sizeof( double ) );
+  if ( numberOfValues == 0 )
+  {
+    return;
+  }
+
+  size_t start = buffer.size();
+  buffer.resize( start + numberOfValues * sizeof( double ) );
+  memcpy( &buffer[ start ], matrix->GetPointer( 0 ), numberOfValues * sizeof( double ) );
+  vtkByteSwap::Swap8LERange( &buffer[ start ], numberOfValues );
+}
+
+
+static void vtkWorkflowTrainingAppendNames( std::vector< char >& buffer, int type, const std::vector< std::string >& names )
+{
+  std::vector< char > nameBytes;
+  for ( int i = 0; i < names.size(); i++ )
+  {
+    nameBytes.insert( nameBytes.end(), names.at( i ).begin(), names.at( i ).end() );
+    nameBytes.push_back( 0 );
+  }
+  vtkWorkflowTrainingAppendPadding( nameBytes );
+
+  vtkWorkflowTrainingAppendUInt32( buffer, type );
+  vtkWorkflowTrainingAppendUInt32( buffer, names.size() );
+  vtkWorkflowTrainingAppendUInt32( buffer, 1 );
+  vtkWorkflowTrainingAppendUInt32( buffer, nameBytes.size() );
+  buffer.insert( buffer.end(), nameBytes.begin(), nameBytes.end() );
+}
+
 
 // Standard MRML Node Methods ------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLWorkflowTrainingStorageNode);
@@ -31,6 +233,7 @@ void vtkMRMLWorkflowTrainingStorageNode
 vtkMRMLWorkflowTrainingStorageNode
 ::vtkMRMLWorkflowTrainingStorageNode()
 {
+  this->BinaryChecksum = true;
 }
 
 
@@ -51,6 +254,7 @@ void vtkMRMLWorkflowTrainingStorageNode
 ::InitializeSupportedWriteFileTypes()
 {
   this->SupportedWriteFileTypes->InsertNextValue( "Workflow Training (.xml)" );
+  this->SupportedWriteFileTypes->InsertNextValue( "Workflow Training Binary (.wtb)" );
 }
 
 
@@ -75,6 +279,11 @@ int vtkMRMLWorkflowTrainingStorageNode
     return 0;
   }
 
+  if ( vtksys::SystemTools::LowerCase( vtksys::SystemTools::GetFilenameLastExtension( fullName ) ).compare( ".wtb" ) == 0 )
+  {
+    return this->ReadBinary( workflowTrainingNode, fullName ) ? 1 : 0;
+  }
+
   vtkNew<vtkXMLDataParser> parser;
   parser->SetFileName( fullName.c_str() );
   parser->Parse();
@@ -97,6 +306,11 @@ int vtkMRMLWorkflowTrainingStorageNode
     return 0;
   }
 
+  if ( vtksys::SystemTools::LowerCase( vtksys::SystemTools::GetFilenameLastExtension( fullName ) ).compare( ".wtb" ) == 0 )
+  {
+    return this->WriteBinary( workflowTrainingNode, fullName ) ? 1 : 0;
+  }
+
   std::ofstream output( fullName.c_str() );
   
   if ( ! output.is_open() )
@@ -113,3 +327,221 @@ int vtkMRMLWorkflowTrainingStorageNode
 }
 
 
+// Binary files ------------------------------------------------------------------------------------
+
+bool vtkMRMLWorkflowTrainingStorageNode
+::WriteBinary( vtkMRMLWorkflowTrainingNode* workflowTrainingNode, std::string fileName )
+{
+  if ( workflowTrainingNode == NULL )
+  {
+    return false;
+  }
+  vtkMarkovModel* markov = workflowTrainingNode->GetMarkov();
+
+  std::vector< std::string > stateNames;
+  for ( int i = 0; i < markov->GetNumStates(); i++ )
+  {
+    stateNames.push_back( markov->GetStateName( i ) );
+  }
+  std::vector< std::string > symbolNames;
+  for ( int i = 0; i < markov->GetNumSymbols(); i++ )
+  {
+    symbolNames.push_back( markov->GetSymbolName( i ) );
+  }
+
+  // Put the whole file together in memory, so it is written all at once
+  std::vector< char > buffer( BINARY_MAGIC, BINARY_MAGIC + 8 );
+  vtkWorkflowTrainingAppendUInt32( buffer, BINARY_VERSION );
+  vtkWorkflowTrainingAppendUInt32( buffer, this->BinaryChecksum ? BINARY_CHECKSUM_FLAG : 0 );
+  vtkWorkflowTrainingAppendUInt32( buffer, 8 ); // Number of blocks
+  vtkWorkflowTrainingAppendUInt32( buffer, 0 ); // Reserved
+
+  vtkWorkflowTrainingAppendMatrix( buffer, MEAN_BLOCK, workflowTrainingNode->GetMean() );
+  vtkWorkflowTrainingAppendMatrix( buffer, PRINCOMPS_BLOCK, workflowTrainingNode->GetPrinComps() );
+  vtkWorkflowTrainingAppendMatrix( buffer, CENTROIDS_BLOCK, workflowTrainingNode->GetCentroids() );
+  vtkWorkflowTrainingAppendNames( buffer, MARKOV_STATES_BLOCK, stateNames );
+  vtkWorkflowTrainingAppendNames( buffer, MARKOV_SYMBOLS_BLOCK, symbolNames );
+  vtkWorkflowTrainingAppendMatrix( buffer, MARKOV_PI_BLOCK, markov->GetPi() );
+  vtkWorkflowTrainingAppendMatrix( buffer, MARKOV_A_BLOCK, markov->GetA() );
+  vtkWorkflowTrainingAppendMatrix( buffer, MARKOV_B_BLOCK, markov->GetB() );
+
+  if ( this->BinaryChecksum )
+  {
+    vtkTypeUInt64 checksum = vtkWorkflowTrainingChecksum( &buffer[ BINARY_HEADER_SIZE ], buffer.size() - BINARY_HEADER_SIZE );
+    vtkByteSwap::Swap8LE( &checksum );
+    const char* checksumBytes = reinterpret_cast< const char* >( &checksum );
+    buffer.insert( buffer.end(), checksumBytes, checksumBytes + sizeof( checksum ) );
+  }
+
+  std::ofstream output( fileName.c_str(), std::ios::binary );
+  if ( ! output.is_open() )
+  {
+    vtkErrorMacro( "Training file could not be opened!" );
+    return false;
+  }
+  output.write( &buffer[ 0 ], buffer.size() );
+  output.close();
+
+  return ! output.fail();
+}
+
+
+bool vtkMRMLWorkflowTrainingStorageNode
+::ReadBinary( vtkMRMLWorkflowTrainingNode* workflowTrainingNode, std::string fileName )
+{
+  if ( workflowTrainingNode == NULL )
+  {
+    return false;
+  }
+
+  vtkWorkflowTrainingFileMapping fileMapping;
+  if ( ! fileMapping.Open( fileName ) )
+  {
+    vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: Could not open " << fileName << "." );
+    return false;
+  }
+  const char* data = fileMapping.Data;
+  size_t size = fileMapping.Size;
+
+  // Check everything before touching the node
+  if ( size < BINARY_HEADER_SIZE || memcmp( data, BINARY_MAGIC, 8 ) != 0 )
+  {
+    vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " is not a binary workflow training file." );
+    return false;
+  }
+  vtkTypeUInt32 version = vtkWorkflowTrainingReadUInt32( data + 8 );
+  vtkTypeUInt32 flags = vtkWorkflowTrainingReadUInt32( data + 12 );
+  vtkTypeUInt32 numberOfBlocks = vtkWorkflowTrainingReadUInt32( data + 16 );
+  // A big-endian file has a small version number once its bytes are swapped
+  vtkTypeUInt32 swappedVersion = vtkWorkflowTrainingSwapUInt32( version );
+  if ( version > BINARY_VERSION && swappedVersion >= 1 && swappedVersion <= BINARY_VERSION )
+  {
+    vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " has the wrong byte order (it must be little-endian)." );
+    return false;
+  }
+  if ( version < 1 || version > BINARY_VERSION )
+  {
+    vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " has version " << version << ", but only up to version " << BINARY_VERSION << " can be read." );
+    return false;
+  }
+
+  size_t blocksEnd = size;
+  if ( flags & BINARY_CHECKSUM_FLAG )
+  {
+    if ( size < BINARY_HEADER_SIZE + sizeof( vtkTypeUInt64 ) )
+    {
+      vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " is truncated." );
+      return false;
+    }
+    blocksEnd = size - sizeof( vtkTypeUInt64 );
+    vtkTypeUInt64 storedChecksum;
+    memcpy( &storedChecksum, data + blocksEnd, sizeof( storedChecksum ) );
+    vtkByteSwap::Swap8LE( &storedChecksum );
+    if ( storedChecksum != vtkWorkflowTrainingChecksum( data + BINARY_HEADER_SIZE, blocksEnd - BINARY_HEADER_SIZE ) )
+    {
+      vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " is corrupt (checksum does not match)." );
+      return false;
+    }
+  }
+
+  vtkSmartPointer< vtkDoubleArray > mean = vtkSmartPointer< vtkDoubleArray >::New();
+  vtkSmartPointer< vtkDoubleArray > prinComps = vtkSmartPointer< vtkDoubleArray >::New();
+  vtkSmartPointer< vtkDoubleArray > centroids = vtkSmartPointer< vtkDoubleArray >::New();
+  vtkSmartPointer< vtkDoubleArray > markovPi = vtkSmartPointer< vtkDoubleArray >::New();
+  vtkSmartPointer< vtkDoubleArray > markovA = vtkSmartPointer< vtkDoubleArray >::New();
+  vtkSmartPointer< vtkDoubleArray > markovB = vtkSmartPointer< vtkDoubleArray >::New();
+  std::vector< std::string > stateNames;
+  std::vector< std::string > symbolNames;
+
+  size_t offset = BINARY_HEADER_SIZE;
+  for ( vtkTypeUInt32 b = 0; b < numberOfBlocks; b++ )
+  {
+    if ( offset + BINARY_BLOCK_HEADER_SIZE > blocksEnd )
+    {
+      vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " is truncated." );
+      return false;
+    }
+    int type = vtkWorkflowTrainingReadUInt32( data + offset );
+    vtkTypeUInt32 numberOfTuples = vtkWorkflowTrainingReadUInt32( data + offset + 4 );
+    vtkTypeUInt32 numberOfComponents = vtkWorkflowTrainingReadUInt32( data + offset + 8 );
+    vtkTypeUInt32 numberOfBytes = vtkWorkflowTrainingReadUInt32( data + offset + 12 );
+    const char* blockData = data + offset + BINARY_BLOCK_HEADER_SIZE;
+    if ( numberOfBytes > blocksEnd - offset - BINARY_BLOCK_HEADER_SIZE )
+    {
+      vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " is truncated." );
+      return false;
+    }
+    offset += BINARY_BLOCK_HEADER_SIZE + numberOfBytes;
+    // Tuples must have at least one component (otherwise the size of the block says nothing about them)
+    if ( numberOfComponents == 0 && numberOfTuples > 0 )
+    {
+      vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " has a block with " << numberOfTuples << " tuples, but no components." );
+      return false;
+    }
+
+    if ( type == MARKOV_STATES_BLOCK || type == MARKOV_SYMBOLS_BLOCK )
+    {
+      std::vector< std::string >& names = ( type == MARKOV_STATES_BLOCK ) ? stateNames : symbolNames;
+      const char* currName = blockData;
+      for ( vtkTypeUInt32 i = 0; i < numberOfTuples; i++ )
+      {
+        const char* currNameEnd = static_cast< const char* >( memchr( currName, 0, blockData + numberOfBytes - currName ) );
+        if ( currNameEnd == NULL )
+        {
+          vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " has a bad name block." );
+          return false;
+        }
+        names.push_back( std::string( currName, currNameEnd ) );
+        currName = currNameEnd + 1;
+      }
+      continue;
+    }
+
+    vtkDoubleArray* matrix = NULL;
+    switch ( type )
+    {
+      case MEAN_BLOCK: matrix = mean; break;
+      case PRINCOMPS_BLOCK: matrix = prinComps; break;
+      case CENTROIDS_BLOCK: matrix = centroids; break;
+      case MARKOV_PI_BLOCK: matrix = markovPi; break;
+      case MARKOV_A_BLOCK: matrix = markovA; break;
+      case MARKOV_B_BLOCK: matrix = markovB; break;
+    }
+    if ( matrix == NULL )
+    {
+      continue; // Blocks from newer versions can be skipped
+    }
+    if ( vtkTypeUInt64( numberOfTuples ) * numberOfComponents * sizeof( double ) != numberOfBytes )
+    {
+      vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " has a bad matrix block." );
+      return false;
+    }
+    matrix->SetNumberOfComponents( std::max< vtkTypeUInt32 >( numberOfComponents, 1 ) );
+    matrix->SetNumberOfTuples( numberOfTuples );
+    if ( numberOfBytes > 0 )
+    {
+      memcpy( matrix->GetPointer( 0 ), blockData, numberOfBytes );
+      vtkByteSwap::Swap8LERange( matrix->GetPointer( 0 ), numberOfBytes / sizeof( double ) );
+    }
+  }
+  if ( offset != blocksEnd )
+  {
+    vtkErrorMacro( "vtkMRMLWorkflowTrainingStorageNode::ReadBinary: " << fileName << " has unexpected data after its last block." );
+    return false;
+  }
+
+  int startModifyState = workflowTrainingNode->StartModify();
+  workflowTrainingNode->SetMean( mean );
+  workflowTrainingNode->SetPrinComps( prinComps );
+  workflowTrainingNode->SetCentroids( centroids );
+  vtkMarkovModel* markov = workflowTrainingNode->GetMarkov();
+  markov->SetStates( stateNames );
+  markov->SetSymbols( symbolNames );
+  markov->GetPi()->DeepCopy( markovPi ); // Same as reading from xml, the sizes are not checked against the names
+  markov->GetA()->DeepCopy( markovA );
+  markov->GetB()->DeepCopy( markovB );
+  markov->Modified();
+  workflowTrainingNode->EndModify( startModifyState );
+
+  return true;
+}
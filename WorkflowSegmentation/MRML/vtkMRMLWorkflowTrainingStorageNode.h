@@ -21,6 +21,7 @@
 #include <sstream>
 #include <utility>
 #include <vector>
+#include <string>
 
 //VTK includes
 #include "vtkMRMLStorageNode.h"
@@ -31,6 +32,8 @@
 // TransformRecorder includes
 #include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
 
+class vtkMRMLWorkflowTrainingNode;
+
 
 /// Storage nodes has methods to read/write workflow input to/from disk.
 class VTK_SLICER_WORKFLOWSEGMENTATION_MODULE_MRML_EXPORT
@@ -54,6 +57,35 @@ public:
   /// Support only transform buffer nodes
   bool CanReadInReferenceNode(vtkMRMLNode* refNode) override;
 
+  /// Binary training files (.wtb) hold the same matrices as the xml files, but are exact and much faster to load
+  /// Layout (all little-endian): 24 byte header (magic, version, flags, number of blocks, reserved), then blocks
+  /// Each block has a 16 byte header (type, number of tuples, number of components, number of bytes), then its data padded to 8 bytes
+  /// Matrices are float64 tuple by tuple; names are null-terminated strings (one per tuple)
+  /// If the checksum flag is set, the file ends with the 64-bit FNV-1a hash of everything after the header
+  enum BinaryBlockType
+  {
+    MEAN_BLOCK = 1,
+    PRINCOMPS_BLOCK = 2,
+    CENTROIDS_BLOCK = 3,
+    MARKOV_STATES_BLOCK = 4,
+    MARKOV_SYMBOLS_BLOCK = 5,
+    MARKOV_PI_BLOCK = 6,
+    MARKOV_A_BLOCK = 7,
+    MARKOV_B_BLOCK = 8
+  };
+  static const char* BINARY_MAGIC; // 8 characters
+  static const int BINARY_VERSION;
+  static const int BINARY_CHECKSUM_FLAG;
+
+  /// Whether or not to write a checksum to binary files (reading always checks it if it is there)
+  vtkGetMacro( BinaryChecksum, bool );
+  vtkSetMacro( BinaryChecksum, bool );
+  vtkBooleanMacro( BinaryChecksum, bool );
+
+  /// The file is memory mapped, and the values are copied straight out of the mapping
+  bool ReadBinary( vtkMRMLWorkflowTrainingNode* workflowTrainingNode, std::string fileName );
+  bool WriteBinary( vtkMRMLWorkflowTrainingNode* workflowTrainingNode, std::string fileName );
+
 protected:
   // Constructor/deconstructor
   vtkMRMLWorkflowTrainingStorageNode();
@@ -67,6 +99,8 @@ protected:
 
   /// Write data from a referenced node
   int WriteDataInternal(vtkMRMLNode *refNode) override;
+
+  bool BinaryChecksum;
   
 };
 
@@ -7,6 +7,7 @@
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
 
 
 vtkStandardNewMacro( vtkMarkovModel );
@@ -25,6 +26,7 @@ vtkMarkovModel
   this->GetZeroPi( this->Pi );
   this->GetZeroA( this->A );
   this->GetZeroB( this->B );
+  this->LogParametersTime = 0;
 }
 
 
@@ -34,6 +36,8 @@ vtkMarkovModel
   // Smart pointers take care of themselves
   this->StateNames.clear();
   this->SymbolNames.clear();
+  this->StateIndices.clear();
+  this->SymbolIndices.clear();
 }
 
 
@@ -46,6 +50,7 @@ void vtkMarkovModel
   this->Pi->DeepCopy( otherMarkov->GetPi() );
   this->A->DeepCopy( otherMarkov->GetA() );
   this->B->DeepCopy( otherMarkov->GetB() );
+  this->Modified();
 }
 
 
@@ -69,6 +74,8 @@ void vtkMarkovModel
 ::SetStates( std::vector< std::string > newStateNames )
 {
   this->StateNames = newStateNames;
+  this->UpdateNameIndices();
+  this->Modified();
 }
 
 
@@ -91,6 +98,8 @@ void vtkMarkovModel
 ::SetSymbols( std::vector< std::string > newSymbolNames )
 {
   this->SymbolNames = newSymbolNames;
+  this->UpdateNameIndices();
+  this->Modified();
 }
 
 
@@ -113,6 +122,8 @@ void vtkMarkovModel
 ::AddState( std::string newStateName )
 {
   this->StateNames.push_back( newStateName );
+  this->StateIndices.insert( std::make_pair( newStateName, int( this->StateNames.size() ) - 1 ) );
+  this->Modified();
 }
 
 
@@ -120,34 +131,71 @@ void vtkMarkovModel
 ::AddSymbol( std::string newSymbolName )
 {
   this->SymbolNames.push_back( newSymbolName );
+  this->SymbolIndices.insert( std::make_pair( newSymbolName, int( this->SymbolNames.size() ) - 1 ) );
+  this->Modified();
 }
 
 
 int vtkMarkovModel
-::LookupState( std::string newStateName )
+::LookupState( const std::string& newStateName )
 {
-  for ( int i = 0; i < this->GetNumStates(); i++ )
+  std::unordered_map< std::string, int >::const_iterator itr = this->StateIndices.find( newStateName );
+  if ( itr == this->StateIndices.end() )
   {
-    if ( newStateName.compare( this->StateNames.at(i) ) == 0 )
-	  {
-      return i;
-	  }
+    return -1;
   }
-  return -1;
+  return itr->second;
 }
 
 
 int vtkMarkovModel
-::LookupSymbol( std::string newSymbolName )
+::LookupSymbol( const std::string& newSymbolName )
 {
-  for ( int i = 0; i < this->GetNumSymbols(); i++ )
+  std::unordered_map< std::string, int >::const_iterator itr = this->SymbolIndices.find( newSymbolName );
+  if ( itr == this->SymbolIndices.end() )
   {
-    if ( newSymbolName.compare( this->SymbolNames.at(i) ) == 0 )
-	  {
-      return i;
-	  }
+    return -1;
+  }
+  return itr->second;
+}
+
+
+void vtkMarkovModel
+::UpdateNameIndices()
+{
+  // Insert does not overwrite, so repeated names keep their first index
+  this->StateIndices.clear();
+  for ( int i = 0; i < this->StateNames.size(); i++ )
+  {
+    this->StateIndices.insert( std::make_pair( this->StateNames.at( i ), i ) );
+  }
+  this->SymbolIndices.clear();
+  for ( int i = 0; i < this->SymbolNames.size(); i++ )
+  {
+    this->SymbolIndices.insert( std::make_pair( this->SymbolNames.at( i ), i ) );
   }
-  return -1;
+}
+
+
+std::string vtkMarkovModel
+::GetStateName( int stateIndex )
+{
+  if ( stateIndex < 0 || stateIndex >= this->GetNumStates() )
+  {
+    return "";
+  }
+  return this->StateNames.at( stateIndex );
+}
+
+
+std::string vtkMarkovModel
+::GetSymbolName( int symbolIndex )
+{
+  if ( symbolIndex < 0 || symbolIndex >= this->GetNumSymbols() )
+  {
+    return "";
+  }
+  return this->SymbolNames.at( symbolIndex );
 }
 
 
@@ -162,6 +210,7 @@ void vtkMarkovModel
     return;
   }
   this->Pi = newPi;
+  this->Modified();
 }
 
 vtkDoubleArray* vtkMarkovModel
@@ -174,15 +223,12 @@ vtkDoubleArray* vtkMarkovModel
 void vtkMarkovModel
 ::GetLogPi( vtkDoubleArray* logPi )
 {
+  this->UpdateLogParameters();
   logPi->SetNumberOfComponents( this->Pi->GetNumberOfComponents() );
-  logPi->SetNumberOfTuples( this->Pi->GetNumberOfTuples() );  
-
-  for ( int i = 0; i < this->Pi->GetNumberOfTuples(); i++ )
+  logPi->SetNumberOfTuples( this->Pi->GetNumberOfTuples() );
+  if ( ! this->LogPi.empty() )
   {
-	  for ( int j = 0; j < this->Pi->GetNumberOfComponents(); j++ )
-	  {
-      logPi->SetComponent( i, j, log( this->Pi->GetComponent( i, j ) ) );
-	  }
+    std::copy( this->LogPi.begin(), this->LogPi.end(), logPi->GetPointer( 0 ) );
   }
 }
 
@@ -205,6 +251,7 @@ void vtkMarkovModel
     return;
   }
   this->A = newA;
+  this->Modified();
 }
 
 vtkDoubleArray* vtkMarkovModel
@@ -217,15 +264,12 @@ vtkDoubleArray* vtkMarkovModel
 void vtkMarkovModel
 ::GetLogA( vtkDoubleArray* logA )
 {
+  this->UpdateLogParameters();
   logA->SetNumberOfComponents( this->A->GetNumberOfComponents() );
-  logA->SetNumberOfTuples( this->A->GetNumberOfTuples() );  
-
-  for ( int i = 0; i < this->A->GetNumberOfTuples(); i++ )
+  logA->SetNumberOfTuples( this->A->GetNumberOfTuples() );
+  if ( ! this->LogA.empty() )
   {
-	  for ( int j = 0; j < this->A->GetNumberOfComponents(); j++ )
-	  {
-      logA->SetComponent( i, j, log( this->A->GetComponent( i, j ) ) );
-	  }
+    std::copy( this->LogA.begin(), this->LogA.end(), logA->GetPointer( 0 ) );
   }
 }
 
@@ -248,6 +292,7 @@ void vtkMarkovModel
     return;
   }
   this->B = newB;
+  this->Modified();
 }
 
 vtkDoubleArray* vtkMarkovModel
@@ -260,15 +305,12 @@ vtkDoubleArray* vtkMarkovModel
 void vtkMarkovModel
 ::GetLogB( vtkDoubleArray* logB )
 {
+  this->UpdateLogParameters();
   logB->SetNumberOfComponents( this->B->GetNumberOfComponents() );
-  logB->SetNumberOfTuples( this->B->GetNumberOfTuples() );  
-
-  for ( int i = 0; i < this->B->GetNumberOfTuples(); i++ )
+  logB->SetNumberOfTuples( this->B->GetNumberOfTuples() );
+  if ( ! this->LogB.empty() )
   {
-	  for ( int j = 0; j < this->B->GetNumberOfComponents(); j++ )
-	  {
-      logB->SetComponent( i, j, log( this->B->GetComponent( i, j ) ) );
-	  }
+    std::copy( this->LogB.begin(), this->LogB.end(), logB->GetPointer( 0 ) );
   }
 }
 
@@ -286,6 +328,51 @@ void vtkMarkovModel
 
 
 
+vtkMTimeType vtkMarkovModel
+::GetParametersMTime()
+{
+  vtkMTimeType parametersMTime = this->GetMTime();
+  parametersMTime = std::max( parametersMTime, this->Pi->GetMTime() );
+  parametersMTime = std::max( parametersMTime, this->A->GetMTime() );
+  parametersMTime = std::max( parametersMTime, this->B->GetMTime() );
+  return parametersMTime;
+}
+
+
+void vtkMarkovModel
+::UpdateLogParameters()
+{
+  vtkMTimeType parametersMTime = this->GetParametersMTime();
+  if ( parametersMTime <= this->LogParametersTime
+    && this->LogPi.size() == this->Pi->GetNumberOfTuples() * this->Pi->GetNumberOfComponents()
+    && this->LogA.size() == this->A->GetNumberOfTuples() * this->A->GetNumberOfComponents()
+    && this->LogB.size() == this->B->GetNumberOfTuples() * this->B->GetNumberOfComponents() )
+  {
+    return;
+  }
+
+  // Take the log of all the parameters, so we avoid rounding errors
+  this->LogPi.resize( this->Pi->GetNumberOfTuples() * this->Pi->GetNumberOfComponents() );
+  for ( int i = 0; i < this->LogPi.size(); i++ )
+  {
+    this->LogPi[ i ] = log( this->Pi->GetValue( i ) );
+  }
+  this->LogA.resize( this->A->GetNumberOfTuples() * this->A->GetNumberOfComponents() );
+  for ( int i = 0; i < this->LogA.size(); i++ )
+  {
+    this->LogA[ i ] = log( this->A->GetValue( i ) );
+  }
+  this->LogB.resize( this->B->GetNumberOfTuples() * this->B->GetNumberOfComponents() );
+  for ( int i = 0; i < this->LogB.size(); i++ )
+  {
+    this->LogB[ i ] = log( this->B->GetValue( i ) );
+  }
+
+  this->LogParametersTime = parametersMTime;
+}
+
+
+
 // File input and output ----------------------------------------------------
 
 std::string vtkMarkovModel
@@ -393,6 +480,8 @@ void vtkMarkovModel
 
   }
 
+  this->UpdateNameIndices();
+  this->Modified();
 }
 
 
@@ -456,44 +545,82 @@ void vtkMarkovModel
   this->GetZeroPi( this->Pi );
   this->GetZeroA( this->A );
   this->GetZeroB( this->B );
+  this->Modified();
 }
 
 
 void vtkMarkovModel
 ::AddEstimationData( vtkMRMLSequenceNode* sequence )
 {
-  // Add the data from the current sequence
-  int prevStateIndex = -1;
+  if ( sequence == NULL )
+  {
+    return;
+  }
 
+  // Look up the names once per frame, then count with the indices
+  std::vector< int > states( sequence->GetNumberOfDataNodes(), -1 );
+  std::vector< int > symbols( sequence->GetNumberOfDataNodes(), -1 );
   for ( int i = 0; i < sequence->GetNumberOfDataNodes(); i++ )
   {
     vtkMRMLNode* currDataNode = sequence->GetNthDataNode( i );
-    if ( currDataNode == NULL )
+    if ( currDataNode == NULL || currDataNode->GetAttribute( "MarkovState" ) == NULL || currDataNode->GetAttribute( "MarkovSymbol" ) == NULL )
     {
       continue;
     }
+    states[ i ] = this->LookupState( currDataNode->GetAttribute( "MarkovState" ) );
+    symbols[ i ] = this->LookupSymbol( currDataNode->GetAttribute( "MarkovSymbol" ) );
+  }
 
-    int stateIndex = this->LookupState( currDataNode->GetAttribute( "MarkovState" ) );
-	  int symbolIndex =  this->LookupSymbol( currDataNode->GetAttribute( "MarkovSymbol" ) );
-	  if ( stateIndex < 0 || symbolIndex < 0 )
-	  {
+  this->AddEstimationData( states, symbols );
+}
+
+
+void vtkMarkovModel
+::AddEstimationData( const std::vector< int >& states, const std::vector< int >& symbols )
+{
+  int numStates = this->GetNumStates();
+  int numSymbols = this->GetNumSymbols();
+  if ( states.size() != symbols.size() )
+  {
+    vtkWarningMacro( "vtkMarkovModel::AddEstimationData: The number of states and symbols are different." );
+    return;
+  }
+  if ( this->Pi->GetNumberOfValues() != numStates || this->A->GetNumberOfValues() != numStates * numStates || this->B->GetNumberOfValues() != numStates * numSymbols )
+  {
+    vtkWarningMacro( "vtkMarkovModel::AddEstimationData: Parameters not consistent with number of states and symbols. Call InitializeEstimation first." );
+    return;
+  }
+  double* pi = this->Pi->GetPointer( 0 );
+  double* a = this->A->GetPointer( 0 );
+  double* b = this->B->GetPointer( 0 );
+
+  // Add the data from the current sequence
+  int prevStateIndex = -1;
+
+  for ( int i = 0; i < states.size(); i++ )
+  {
+    int stateIndex = states[ i ];
+    int symbolIndex = symbols[ i ];
+    if ( stateIndex < 0 || stateIndex >= numStates || symbolIndex < 0 || symbolIndex >= numSymbols )
+    {
       continue;
-	  }
+    }
 
     if ( i == 0 ) // Initial observation
     {
-      this->Pi->SetComponent( 0, stateIndex, this->Pi->GetComponent( 0, stateIndex ) + 1 );
+      pi[ stateIndex ] += 1;
     }
     else if ( prevStateIndex >= 0 ) // Subsequent observations
     {
-      this->A->SetComponent( prevStateIndex, stateIndex, this->A->GetComponent( prevStateIndex, stateIndex ) + 1 );
+      a[ prevStateIndex * numStates + stateIndex ] += 1;
     }
 
-    this->B->SetComponent( stateIndex, symbolIndex, this->B->GetComponent( stateIndex, symbolIndex ) + 1 );
+    b[ stateIndex * numSymbols + symbolIndex ] += 1;
 
     prevStateIndex = stateIndex;
   }
 
+  this->Modified();
 }
 
 
@@ -516,6 +643,7 @@ void vtkMarkovModel
 	  }
   }
 
+  this->Modified();
 }
 
 
@@ -524,124 +652,462 @@ void vtkMarkovModel
 {
   // Normalize the parameters so probabilities add to one
   this->NormalizeParameters();
+  this->Modified();
 }
 
 
-void vtkMarkovModel
-::CalculateStates( vtkMRMLSequenceNode* sequence )
+// Helper for the E-step: each sequence has its own statistics, so the threads never write to the same place
+class vtkMarkovModelForwardBackwardFunctor
 {
-  // Take the log of all the parameters, so we avoid rounding errors
-  vtkNew< vtkDoubleArray > logPi;
-  this->GetLogPi( logPi.GetPointer() );
-  vtkNew< vtkDoubleArray > logA;
-  this->GetLogA( logA.GetPointer() );
-  vtkNew< vtkDoubleArray > logB;
-  this->GetLogB( logB.GetPointer() );
-
-  // Initialize delta and psi using the initial state distributions
-  vtkNew< vtkDoubleArray > delta;
-  delta->SetNumberOfComponents( this->GetNumStates() );
-  delta->SetNumberOfTuples( sequence->GetNumberOfDataNodes() );
-  
-  vtkNew< vtkDoubleArray > psi;
-  psi->SetNumberOfComponents( this->GetNumStates() );
-  psi->SetNumberOfTuples( sequence->GetNumberOfDataNodes() );
-  
+public:
+  vtkMarkovModel* Markov;
+  const std::vector< std::vector< int > >* Symbols;
+  std::vector< double >* Statistics; // Pi, A, B counts for each sequence
+  std::vector< double >* LogLikelihoods;
+  int StatisticsSize;
+
+  void operator()( vtkIdType begin, vtkIdType end )
+  {
+    int numStates = this->Markov->GetNumStates();
+    for ( vtkIdType i = begin; i < end; i++ )
+    {
+      double* currStatistics = &this->Statistics->at( i * this->StatisticsSize );
+      this->LogLikelihoods->at( i ) = this->Markov->ForwardBackward( this->Symbols->at( i ), currStatistics, currStatistics + numStates, currStatistics + numStates + numStates * numStates );
+    }
+  }
+};
 
-  // Initializing for the first symbol
-  vtkMRMLNode* currDataNode = sequence->GetNthDataNode( 0 );
-  if( currDataNode == NULL )
+
+double vtkMarkovModel
+::EstimateParameters( const std::vector< std::vector< int > >& unlabelledSymbols, int maxIterations, double tolerance )
+{
+  int numStates = this->GetNumStates();
+  int numSymbols = this->GetNumSymbols();
+  if ( this->Pi->GetNumberOfValues() != numStates || this->A->GetNumberOfValues() != numStates * numStates || this->B->GetNumberOfValues() != numStates * numSymbols )
   {
-    return;
+    vtkWarningMacro( "vtkMarkovModel::EstimateParameters: Parameters not consistent with number of states and symbols." );
+    return - std::numeric_limits< double >::max();
   }
-  int symbolIndex = this->LookupSymbol( currDataNode->GetAttribute( "MarkovSymbol" ) );
-  if ( symbolIndex < 0 )
+
+  // The current counts are kept, and the seed is the supervised model
+  std::vector< double > priorPi( this->Pi->GetPointer( 0 ), this->Pi->GetPointer( 0 ) + numStates );
+  std::vector< double > priorA( this->A->GetPointer( 0 ), this->A->GetPointer( 0 ) + numStates * numStates );
+  std::vector< double > priorB( this->B->GetPointer( 0 ), this->B->GetPointer( 0 ) + numStates * numSymbols );
+  this->EstimateParameters();
+
+  int statisticsSize = numStates + numStates * numStates + numStates * numSymbols;
+  std::vector< double > statistics( unlabelledSymbols.size() * statisticsSize );
+  std::vector< double > logLikelihoods( unlabelledSymbols.size() );
+
+  vtkMarkovModelForwardBackwardFunctor forwardBackwardFunctor;
+  forwardBackwardFunctor.Markov = this;
+  forwardBackwardFunctor.Symbols = &unlabelledSymbols;
+  forwardBackwardFunctor.Statistics = &statistics;
+  forwardBackwardFunctor.LogLikelihoods = &logLikelihoods;
+  forwardBackwardFunctor.StatisticsSize = statisticsSize;
+
+  double logLikelihood = - std::numeric_limits< double >::max();
+  for ( int iteration = 0; iteration < maxIterations; iteration++ )
   {
-    return;
+    // E-step, in parallel over the sequences
+    std::fill( statistics.begin(), statistics.end(), 0.0 );
+    vtkSMPTools::For( 0, unlabelledSymbols.size(), 1, forwardBackwardFunctor );
+
+    // Sum in sequence order, so the result is the same regardless of how the work was split (invalid sequences add nothing)
+    std::vector< double > totalStatistics( statisticsSize, 0.0 );
+    std::copy( priorPi.begin(), priorPi.end(), totalStatistics.begin() );
+    std::copy( priorA.begin(), priorA.end(), totalStatistics.begin() + numStates );
+    std::copy( priorB.begin(), priorB.end(), totalStatistics.begin() + numStates + numStates * numStates );
+    double currLogLikelihood = 0.0;
+    for ( int s = 0; s < unlabelledSymbols.size(); s++ )
+    {
+      if ( logLikelihoods[ s ] == - std::numeric_limits< double >::max() )
+      {
+        continue;
+      }
+      currLogLikelihood += logLikelihoods[ s ];
+      const double* currStatistics = &statistics[ s * statisticsSize ];
+      for ( int k = 0; k < statisticsSize; k++ )
+      {
+        totalStatistics[ k ] += currStatistics[ k ];
+      }
+    }
+
+    // The parameters are not changed once they have converged
+    bool converged = ( iteration > 0 && currLogLikelihood - logLikelihood < tolerance );
+    logLikelihood = currLogLikelihood;
+    if ( converged )
+    {
+      break;
+    }
+
+    // M-step
+    std::copy( totalStatistics.begin(), totalStatistics.begin() + numStates, this->Pi->GetPointer( 0 ) );
+    std::copy( totalStatistics.begin() + numStates, totalStatistics.begin() + numStates + numStates * numStates, this->A->GetPointer( 0 ) );
+    std::copy( totalStatistics.begin() + numStates + numStates * numStates, totalStatistics.end(), this->B->GetPointer( 0 ) );
+    this->EstimateParameters();
   }
 
-  for ( int j = 0; j < this->GetNumStates(); j++ )
+  return logLikelihood;
+}
+
+
+// Alpha is scaled to sum to one at every observation (the log-likelihood is the sum of the logs of the scales)
+// Beta is scaled by the same factors, and only kept for the next observation
+double vtkMarkovModel
+::ForwardBackward( const std::vector< int >& symbols, double* expectedPi, double* expectedA, double* expectedB )
+{
+  int numStates = this->GetNumStates();
+  int numSymbols = this->GetNumSymbols();
+  int numObservations = symbols.size();
+  if ( numStates == 0 || numObservations == 0 )
+  {
+    return - std::numeric_limits< double >::max();
+  }
+  for ( int i = 0; i < numObservations; i++ )
+  {
+    if ( symbols[ i ] < 0 || symbols[ i ] >= numSymbols )
+    {
+      return - std::numeric_limits< double >::max();
+    }
+  }
+  const double* pi = this->Pi->GetPointer( 0 );
+  const double* a = this->A->GetPointer( 0 );
+  const double* b = this->B->GetPointer( 0 );
+
+  // Forward
+  std::vector< double > alpha( numObservations * numStates );
+  std::vector< double > scales( numObservations );
+  for ( int i = 0; i < numObservations; i++ )
   {
-    delta->SetComponent( 0, j, logPi->GetComponent( 0, j ) + logB->GetComponent( j, symbolIndex ) );
+    double* currAlpha = &alpha[ i * numStates ];
+    if ( i == 0 )
+    {
+      for ( int j = 0; j < numStates; j++ )
+      {
+        currAlpha[ j ] = pi[ j ] * b[ j * numSymbols + symbols[ 0 ] ];
+      }
+    }
+    else
+    {
+      // k outer, so the inner loop is over contiguous rows of A
+      const double* prevAlpha = &alpha[ ( i - 1 ) * numStates ];
+      std::fill( currAlpha, currAlpha + numStates, 0.0 );
+      for ( int k = 0; k < numStates; k++ )
+      {
+        const double* currA = a + k * numStates;
+        for ( int j = 0; j < numStates; j++ )
+        {
+          currAlpha[ j ] += prevAlpha[ k ] * currA[ j ];
+        }
+      }
+      for ( int j = 0; j < numStates; j++ )
+      {
+        currAlpha[ j ] *= b[ j * numSymbols + symbols[ i ] ];
+      }
+    }
+
+    double currScale = 0.0;
+    for ( int j = 0; j < numStates; j++ )
+    {
+      currScale += currAlpha[ j ];
+    }
+    if ( currScale <= 0.0 )
+    {
+      return - std::numeric_limits< double >::max(); // The sequence is impossible under the model
+    }
+    for ( int j = 0; j < numStates; j++ )
+    {
+      currAlpha[ j ] /= currScale;
+    }
+    scales[ i ] = currScale;
   }
 
-  vtkNew< vtkDoubleArray > initialPsi;
-  this->GetZeroPi( initialPsi.GetPointer() );
-  psi->SetTuple( 0, 0, initialPsi.GetPointer() );
+  // Backward, accumulating the expected counts as we go
+  std::vector< double > beta( numStates, 1.0 );
+  std::vector< double > nextBeta( numStates );
+  std::vector< double > weightedBeta( numStates ); // b_j( o_i+1 ) * beta_i+1( j ) / c_i+1
+  for ( int i = numObservations - 1; i >= 0; i-- )
+  {
+    const double* currAlpha = &alpha[ i * numStates ];
 
-  // Already calculated for i = 0 (initially)
-  for ( int i = 1; i < sequence->GetNumberOfDataNodes(); i++ )
+    // Gamma is already normalized, because of the scaling
+    for ( int j = 0; j < numStates; j++ )
+    {
+      double currGamma = currAlpha[ j ] * beta[ j ];
+      expectedB[ j * numSymbols + symbols[ i ] ] += currGamma;
+      if ( i == 0 )
+      {
+        expectedPi[ j ] += currGamma;
+      }
+    }
+    if ( i == 0 )
+    {
+      break;
+    }
+
+    // Xi for the transitions into this observation, and the previous beta
+    const double* prevAlpha = &alpha[ ( i - 1 ) * numStates ];
+    for ( int j = 0; j < numStates; j++ )
+    {
+      weightedBeta[ j ] = b[ j * numSymbols + symbols[ i ] ] * beta[ j ] / scales[ i ];
+    }
+    for ( int k = 0; k < numStates; k++ )
+    {
+      const double* currA = a + k * numStates;
+      double* currExpectedA = expectedA + k * numStates;
+      double currBeta = 0.0;
+      for ( int j = 0; j < numStates; j++ )
+      {
+        double currTransition = currA[ j ] * weightedBeta[ j ];
+        currExpectedA[ j ] += prevAlpha[ k ] * currTransition;
+        currBeta += currTransition;
+      }
+      nextBeta[ k ] = currBeta;
+    }
+    beta.swap( nextBeta );
+  }
+
+  double logLikelihood = 0.0;
+  for ( int i = 0; i < numObservations; i++ )
+  {
+    logLikelihood += log( scales[ i ] );
+  }
+  return logLikelihood;
+}
+
+
+void vtkMarkovModel
+::CalculateStates( vtkMRMLSequenceNode* sequence )
+{
+  if ( sequence == NULL || sequence->GetNumberOfDataNodes() == 0 )
+  {
+    return;
+  }
+
+  // Get the symbol indices up front, so the decoding does not touch the nodes
+  std::vector< int > symbols( sequence->GetNumberOfDataNodes(), -1 );
+  for ( int i = 0; i < sequence->GetNumberOfDataNodes(); i++ )
   {
     vtkMRMLNode* currDataNode = sequence->GetNthDataNode( i );
-    if( currDataNode == NULL )
+    if( currDataNode == NULL || currDataNode->GetAttribute( "MarkovSymbol" ) == NULL )
     {
       return;
     }
-    int symbolIndex = this->LookupSymbol( currDataNode->GetAttribute( "MarkovSymbol" ) );
-    if ( symbolIndex < 0 )
+    symbols[ i ] = this->LookupSymbol( currDataNode->GetAttribute( "MarkovSymbol" ) );
+  }
+
+  std::vector< int > states;
+  if ( ! this->CalculateStates( symbols, states ) )
+  {
+    return;
+  }
+
+  // The states are set in the original nodes in the original sequence
+  for ( int i = 0; i < sequence->GetNumberOfDataNodes(); i++ )
+  {
+    sequence->GetNthDataNode( i )->SetAttribute( "MarkovState", this->StateNames.at( states[ i ] ).c_str() );
+  }
+}
+
+
+bool vtkMarkovModel
+::CalculateStates( const std::vector< int >& symbols, std::vector< int >& states )
+{
+  double logProbability;
+  return this->CalculateStates( symbols, states, logProbability );
+}
+
+
+bool vtkMarkovModel
+::CalculateStates( const std::vector< int >& symbols, std::vector< int >& states, double& logProbability )
+{
+  // Take the log of all the parameters, so we avoid rounding errors (these are cached)
+  this->UpdateLogParameters();
+  return this->DecodeStates( symbols, states, logProbability );
+}
+
+
+// Delta (the log probability of the most likely path ending in each state) is only kept for the previous observation
+// Psi (the previous state on that path) is kept for every observation, as short, since there are never many states
+bool vtkMarkovModel
+::DecodeStates( const std::vector< int >& symbols, std::vector< int >& states, double& logProbability )
+{
+  states.clear();
+  logProbability = - std::numeric_limits< double >::max();
+
+  int numStates = this->GetNumStates();
+  int numSymbols = this->GetNumSymbols();
+  int numObservations = symbols.size();
+  if ( numStates == 0 || numObservations == 0 )
+  {
+    return false;
+  }
+  if ( numStates > std::numeric_limits< short >::max() )
+  {
+    vtkWarningMacro( "vtkMarkovModel::CalculateStates: Too many states." );
+    return false;
+  }
+  for ( int i = 0; i < numObservations; i++ )
+  {
+    if ( symbols[ i ] < 0 || symbols[ i ] >= numSymbols )
     {
-      return;
+      return false;
     }
+  }
 
-    // Iterate over all states, and check which transition would have been the most likely
-    for ( int j = 0; j < this->GetNumStates(); j++ )
-	  {
+  if ( this->LogPi.size() != numStates || this->LogA.size() != numStates * numStates || this->LogB.size() != numStates * numSymbols )
+  {
+    return false;
+  }
+  const double* logPi = &this->LogPi[ 0 ];
+  const double* logA = &this->LogA[ 0 ];
+  const double* logB = &this->LogB[ 0 ];
 
-	    int maxIndex = 0;
-	    double maxProb = - std::numeric_limits< double >::max();
+  std::vector< double > prevDelta( numStates );
+  std::vector< double > delta( numStates );
+  std::vector< short > psi( numObservations * numStates, 0 );
 
-	    for ( int k = 0; k < this->GetNumStates(); k++ )
-	    {
-        double currProb = delta->GetComponent( i - 1, k ) + logA->GetComponent( k, j );
-        if ( currProb > maxProb ) // Note: A[k].get(j) == A[k][j]
-		    {
-          maxProb = currProb;
-		      maxIndex = k;
-		    }
-	    }
+  // Initializing for the first symbol
+  for ( int j = 0; j < numStates; j++ )
+  {
+    delta[ j ] = logPi[ j ] + logB[ j * numSymbols + symbols[ 0 ] ];
+  }
 
-	    // Account for observation probability
-	    delta->SetComponent( i, j, maxProb + logB->GetComponent( j, symbolIndex ) );
-      psi->SetComponent( i, j, maxIndex );
+  // Already calculated for i = 0 (initially)
+  for ( int i = 1; i < numObservations; i++ )
+  {
+    delta.swap( prevDelta );
+    short* currPsi = &psi[ i * numStates ];
+    double* currDelta = &delta[ 0 ];
+
+    // Check which transition would have been the most likely for all states at once (k outer, so the inner loop is over contiguous rows of A)
+    // Ties go to the lowest previous state
+    std::fill( delta.begin(), delta.end(), - std::numeric_limits< double >::max() );
+    for ( int k = 0; k < numStates; k++ )
+    {
+      double prevProb = prevDelta[ k ];
+      const double* currLogA = logA + k * numStates;
+      for ( int j = 0; j < numStates; j++ )
+      {
+        double currProb = prevProb + currLogA[ j ];
+        bool greater = ( currProb > currDelta[ j ] );
+        currDelta[ j ] = greater ? currProb : currDelta[ j ];
+        currPsi[ j ] = greater ? k : currPsi[ j ];
+      }
+    }
 
-	  }
+    // Account for observation probability
+    const double* currLogB = logB + symbols[ i ];
+    for ( int j = 0; j < numStates; j++ )
+    {
+      currDelta[ j ] += currLogB[ j * numSymbols ];
+    }
   }
 
   // Calculate end state
   int endState = 0;
-  for ( int k = 0; k < this->GetNumStates(); k++ )
+  for ( int k = 0; k < numStates; k++ )
   {
-    if ( delta->GetComponent( sequence->GetNumberOfDataNodes() - 1, k ) > delta->GetComponent( sequence->GetNumberOfDataNodes() - 1, endState ) )
+    if ( delta[ k ] > delta[ endState ] )
 	  {
       endState = k;
 	  }
   }
-  vtkMRMLNode* endDataNode = sequence->GetNthDataNode( sequence->GetNumberOfDataNodes() - 1 );
-  if( endDataNode == NULL )
+  logProbability = delta[ endState ];
+
+  // Calculate prior states from subsequent states
+  states.resize( numObservations );
+  states[ numObservations - 1 ] = endState;
+  for ( int i = numObservations - 2; i >= 0; i-- )
+  {
+    states[ i ] = psi[ ( i + 1 ) * numStates + states[ i + 1 ] ];
+  }
+
+  return true;
+}
+
+
+// Helper for decoding sequences in parallel
+class vtkMarkovModelViterbiFunctor
+{
+public:
+  vtkMarkovModel* Markov;
+  const std::vector< std::vector< int > >* Symbols;
+  std::vector< std::vector< int > >* States;
+  std::vector< double >* LogProbabilities;
+
+  void operator()( vtkIdType begin, vtkIdType end )
+  {
+    for ( vtkIdType i = begin; i < end; i++ )
+    {
+      this->Markov->DecodeStates( this->Symbols->at( i ), this->States->at( i ), this->LogProbabilities->at( i ) );
+    }
+  }
+};
+
+
+void vtkMarkovModel
+::CalculateStates( const std::vector< std::vector< int > >& symbols, std::vector< std::vector< int > >& states, std::vector< double >& logProbabilities )
+{
+  states.assign( symbols.size(), std::vector< int >() );
+  logProbabilities.assign( symbols.size(), - std::numeric_limits< double >::max() );
+
+  // Update the cached logs before splitting up the work, so the threads only read them
+  this->UpdateLogParameters();
+
+  vtkMarkovModelViterbiFunctor viterbiFunctor;
+  viterbiFunctor.Markov = this;
+  viterbiFunctor.Symbols = &symbols;
+  viterbiFunctor.States = &states;
+  viterbiFunctor.LogProbabilities = &logProbabilities;
+  vtkSMPTools::For( 0, symbols.size(), 1, viterbiFunctor );
+}
+
+
+// The nodes are only read and written on this thread, only the decoding is parallel
+void vtkMarkovModel
+::CalculateStates( vtkCollection* sequences )
+{
+  if ( sequences == NULL )
   {
     return;
   }
-  endDataNode->SetAttribute( "MarkovState", this->StateNames.at( endState ).c_str() );
 
-  // Calculate prior states from previous states
-  for ( int i = sequence->GetNumberOfDataNodes() - 2; i <= 0; i-- )
+  std::vector< vtkMRMLSequenceNode* > sequenceNodes;
+  std::vector< std::vector< int > > symbols;
+  vtkNew< vtkCollectionIterator > sequencesIt; sequencesIt->SetCollection( sequences );
+  for ( sequencesIt->InitTraversal(); ! sequencesIt->IsDoneWithTraversal(); sequencesIt->GoToNextItem() )
   {
-    vtkMRMLNode* currDataNode = sequence->GetNthDataNode( i );
-    vtkMRMLNode* prevDataNode = sequence->GetNthDataNode( i + 1 );
-    if( currDataNode == NULL )
+    vtkMRMLSequenceNode* currSequence = vtkMRMLSequenceNode::SafeDownCast( sequencesIt->GetCurrentObject() );
+    if ( currSequence == NULL )
     {
-      return;
+      continue;
     }
-    int prevStateIndex = this->LookupState( prevDataNode->GetAttribute( "MarkovState" ) );
-    if ( prevStateIndex < 0 )
+
+    // Sequences with missing symbols are skipped (same as decoding them one at a time)
+    std::vector< int > currSymbols( currSequence->GetNumberOfDataNodes(), -1 );
+    for ( int i = 0; i < currSequence->GetNumberOfDataNodes(); i++ )
     {
-      return;
+      vtkMRMLNode* currDataNode = currSequence->GetNthDataNode( i );
+      if ( currDataNode != NULL && currDataNode->GetAttribute( "MarkovSymbol" ) != NULL )
+      {
+        currSymbols[ i ] = this->LookupSymbol( currDataNode->GetAttribute( "MarkovSymbol" ) );
+      }
     }
+    sequenceNodes.push_back( currSequence );
+    symbols.push_back( currSymbols );
+  }
 
+  std::vector< std::vector< int > > states;
+  std::vector< double > logProbabilities;
+  this->CalculateStates( symbols, states, logProbabilities );
 
-    int currState = psi->GetComponent( i + 1, prevStateIndex );
-    currDataNode->SetAttribute( "MarkovState", this->StateNames.at( currState ).c_str() );
+  for ( int s = 0; s < sequenceNodes.size(); s++ )
+  {
+    for ( int i = 0; i < states[ s ].size(); i++ )
+    {
+      sequenceNodes[ s ]->GetNthDataNode( i )->SetAttribute( "MarkovState", this->StateNames.at( states[ s ][ i ] ).c_str() );
+    }
   }
-
-  // The states are set in the original nodes in the original sequence
 }
\ No newline at end of file
@@ -9,6 +9,8 @@
 #include <utility>
 #include <vector>
 #include <limits>
+#include <string>
+#include <unordered_map>
 
 // VTK includes
 #include "vtkObject.h"
@@ -18,6 +20,9 @@
 #include "vtkSmartPointer.h"
 #include "vtkDoubleArray.h"
 #include "vtkNew.h"
+#include "vtkCollection.h"
+#include "vtkCollectionIterator.h"
+#include "vtkSMPTools.h"
 
 // Workflow Segmentation includes
 #include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
@@ -52,8 +57,13 @@ public:
   void AddState( std::string newStateName );
   void AddSymbol( std::string newSymbolName );
 
-  int LookupState( std::string newStateName );
-  int LookupSymbol( std::string newSymbolName );
+  // Constant time (the names are hashed), -1 if there is no such name
+  int LookupState( const std::string& newStateName );
+  int LookupSymbol( const std::string& newSymbolName );
+
+  // Empty if the index is out of range
+  std::string GetStateName( int stateIndex );
+  std::string GetSymbolName( int symbolIndex );
 
   int GetNumStates();
   int GetNumSymbols();
@@ -73,12 +83,30 @@ public:
   void GetZeroB( vtkDoubleArray* zeroB );
   void GetLogB( vtkDoubleArray* logB );
 
+  // Note: Call Modified() after changing any of the parameter arrays in place, so the cached logs are recomputed
+
   void InitializeEstimation();
   void AddEstimationData( vtkMRMLSequenceNode* sequence );
+  // Same, but with state and symbol indices (one of each per observation, observations with a negative index are skipped)
+  void AddEstimationData( const std::vector< int >& states, const std::vector< int >& symbols );
   void AddPseudoData( vtkDoubleArray* pseudoPi, vtkDoubleArray* pseudoA, vtkDoubleArray* pseudoB );
   void EstimateParameters();
+  // Baum-Welch (expectation maximization) with unlabelled symbol sequences, instead of EstimateParameters()
+  // The counts added so far (labelled and pseudo data) seed the model, and are added to the expected counts at every iteration
+  // Stops when the log-likelihood of the unlabelled sequences improves by less than the tolerance (returns the last log-likelihood)
+  double EstimateParameters( const std::vector< std::vector< int > >& unlabelledSymbols, int maxIterations, double tolerance );
   void CalculateStates( vtkMRMLSequenceNode* sequence );
 
+  // Batch Viterbi decoding: the most likely state for every symbol (returns false if any symbol is invalid)
+  // Optionally, get the log probability of the decoded path
+  bool CalculateStates( const std::vector< int >& symbols, std::vector< int >& states );
+  bool CalculateStates( const std::vector< int >& symbols, std::vector< int >& states, double& logProbability );
+
+  // Decode many sequences at once, in parallel over the sequences
+  // Each sequence gets its own path and log probability (empty path and lowest log probability if any of its symbols are invalid)
+  void CalculateStates( const std::vector< std::vector< int > >& symbols, std::vector< std::vector< int > >& states, std::vector< double >& logProbabilities );
+  void CalculateStates( vtkCollection* sequences );
+
   std::string ToXMLString( vtkIndent indent );
   void FromXMLElement( vtkXMLDataElement* element );
 
@@ -89,6 +117,24 @@ private:
 
 protected:
 
+  // The logs of the parameters are cached (row-major), and only recomputed when the parameters have been modified
+  void UpdateLogParameters();
+  vtkMTimeType GetParametersMTime();
+
+  // Viterbi decoding, assuming the cached logs are up to date (so this is safe to call from several threads)
+  friend class vtkMarkovModelViterbiFunctor;
+  bool DecodeStates( const std::vector< int >& symbols, std::vector< int >& states, double& logProbability );
+
+  // Scaled forward-backward pass for one sequence, adding the expected counts to the (row-major) arrays
+  // This only reads the parameters (so it is safe to call from several threads); returns the log-likelihood (lowest value if any symbol is invalid)
+  friend class vtkMarkovModelForwardBackwardFunctor;
+  double ForwardBackward( const std::vector< int >& symbols, double* expectedPi, double* expectedA, double* expectedB );
+
+  std::vector< double > LogPi;
+  std::vector< double > LogA;
+  std::vector< double > LogB;
+  vtkMTimeType LogParametersTime;
+
   vtkSmartPointer< vtkDoubleArray > Pi;	// Initial state vector
   vtkSmartPointer< vtkDoubleArray > A; // State transition matrix
   vtkSmartPointer< vtkDoubleArray > B; // Observation matrix
@@ -98,6 +144,11 @@ protected:
   std::vector< std::string > StateNames;
   std::vector< std::string > SymbolNames;
 
+  // Name -> index, rebuilt whenever the names change (if a name is repeated, it maps to its first index)
+  void UpdateNameIndices();
+  std::unordered_map< std::string, int > StateIndices;
+  std::unordered_map< std::string, int > SymbolIndices;
+
 };
 
 #endif
\ No newline at end of file
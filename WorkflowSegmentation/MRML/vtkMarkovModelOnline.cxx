@@ -6,6 +6,7 @@
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
 
 
 vtkStandardNewMacro( vtkMarkovModelOnline );
@@ -14,10 +15,11 @@ vtkStandardNewMacro( vtkMarkovModelOnline );
 vtkMarkovModelOnline
 ::vtkMarkovModelOnline()
 {
+  this->RecordHistory = false;
   this->Sequence = vtkSmartPointer< vtkMRMLSequenceNode >::New();
 
-  this->CurrDelta = vtkSmartPointer< vtkDoubleArray >::New();
-  this->CurrPsi = vtkSmartPointer< vtkDoubleArray >::New();
+  this->NumberOfOnlineObservations = 0;
+  this->FixedLag = 0;
 }
 
 
@@ -33,62 +35,111 @@ void vtkMarkovModelOnline
 {
   this->vtkMarkovModel::Copy( otherMarkov );
 
-  // Must update the collected sequence. Psi and Delta will update automatically as we add sequence
+  // Copy the current state of the Viterbi algorithm (no need to replay the sequence)
+  this->CurrDelta = otherMarkov->CurrDelta;
+  this->NextDelta = otherMarkov->NextDelta;
+  this->CurrPsi = otherMarkov->CurrPsi;
+  this->NumberOfOnlineObservations = otherMarkov->NumberOfOnlineObservations;
+  this->FixedLag = otherMarkov->FixedLag;
+  this->LagPsi = otherMarkov->LagPsi;
+
+  this->RecordHistory = otherMarkov->RecordHistory;
+  this->Sequence->RemoveAllDataNodes();
   for ( int i = 0; i < otherMarkov->Sequence->GetNumberOfDataNodes(); i++ )
   {
-    vtkMRMLNode* currDataNode = otherMarkov->Sequence->GetNthDataNode( i );
-    std::string currIndexValue = otherMarkov->Sequence->GetNthIndexValue( i );
-    this->CalculateStateOnline( currDataNode, currIndexValue );
+    this->Sequence->SetDataNodeAtValue( otherMarkov->Sequence->GetNthDataNode( i ), otherMarkov->Sequence->GetNthIndexValue( i ) );
   }
 }
 
 
 void vtkMarkovModelOnline
-::CalculateStateOnline( vtkMRMLNode* node, std::string indexValue )
+::ResetOnline()
 {
-  // Take the log of all the parameters, so we avoid rounding errors
-  vtkNew< vtkDoubleArray > logPi;
-  this->GetLogPi( logPi.GetPointer() );
-  vtkNew< vtkDoubleArray > logA;
-  this->GetLogA( logA.GetPointer() );
-  vtkNew< vtkDoubleArray > logB;
-  this->GetLogB( logB.GetPointer() );
+  this->NumberOfOnlineObservations = 0;
+  this->Sequence->RemoveAllDataNodes();
+}
 
-  // Get the symbol index for the node currently being added
-  int symbolIndex = this->LookupSymbol( node->GetAttribute( "MarkovSymbol" ) );
-  if ( symbolIndex < 0 )
+
+void vtkMarkovModelOnline
+::SetFixedLag( int newFixedLag )
+{
+  newFixedLag = std::max( newFixedLag, 0 );
+  if ( newFixedLag == this->FixedLag )
   {
     return;
   }
 
-  // This must both calculate the current state and update pi and delta
-  // Case there are no previous elements in the sequence
-  if ( this->Sequence->GetNumberOfDataNodes() == 0 )
+  // The ring is resized on the next observation
+  this->FixedLag = newFixedLag;
+  this->ResetOnline();
+  this->Modified();
+}
+
+
+vtkMRMLSequenceNode* vtkMarkovModelOnline
+::GetHistory()
+{
+  return this->Sequence;
+}
+
+
+int vtkMarkovModelOnline
+::CalculateStateOnline( int symbolIndex )
+{
+  int numStates = this->GetNumStates();
+  if ( symbolIndex < 0 || symbolIndex >= this->GetNumSymbols() || numStates == 0 )
   {
-    this->CurrDelta = vtkSmartPointer< vtkDoubleArray >::New();
-    this->CurrDelta->SetNumberOfComponents( this->GetNumStates() );
-    this->CurrDelta->SetNumberOfTuples( 1 );    
+    return -1;
+  }
 
-    for ( int j = 0; j < this->GetNumStates(); j++ )
+  // The logs are only recomputed if the parameters have changed
+  this->UpdateLogParameters();
+  if ( this->LogPi.size() != numStates || this->LogA.size() != numStates * numStates || this->LogB.size() != numStates * this->GetNumSymbols() )
+  {
+    return -1;
+  }
+  const double* logPi = &this->LogPi[ 0 ];
+  const double* logA = &this->LogA[ 0 ];
+  const double* logB = &this->LogB[ 0 ];
+  int numSymbols = this->GetNumSymbols();
+
+  // If the model has changed size, the previous observations are meaningless
+  if ( this->CurrDelta.size() != numStates )
+  {
+    this->CurrDelta.assign( numStates, 0.0 );
+    this->NextDelta.assign( numStates, 0.0 );
+    this->CurrPsi.assign( numStates, 0 );
+    this->NumberOfOnlineObservations = 0;
+  }
+  if ( this->LagPsi.size() != this->FixedLag * numStates )
+  {
+    this->LagPsi.assign( this->FixedLag * numStates, 0 );
+    this->NumberOfOnlineObservations = 0;
+  }
+
+  // This must both calculate the current state and update psi and delta
+  // Case there are no previous observations
+  if ( this->NumberOfOnlineObservations == 0 )
+  {
+    for ( int j = 0; j < numStates; j++ )
 	  {
-      this->CurrDelta->SetComponent( 0, j, logPi->GetComponent( 0, j ) + logB->GetComponent( j, symbolIndex ) );
+      this->CurrDelta[ j ] = logPi[ j ] + logB[ j * numSymbols + symbolIndex ];
+      this->CurrPsi[ j ] = 0;
 	  }
-
-    this->GetZeroPi( this->CurrPsi );
   }
 
-  // Case there are previous elements in the sequence
-  if ( this->Sequence->GetNumberOfDataNodes() != 0 )
+  // Case there are previous observations
+  else
   {
-	  for ( int j = 0; j < this->GetNumStates(); j++ )
+	  for ( int j = 0; j < numStates; j++ )
 	  {
 
 	    int maxIndex = 0;
 	    double maxProb = - std::numeric_limits< double >::max();
 
-	    for ( int k = 0; k < this->GetNumStates(); k++ )
+	    for ( int k = 0; k < numStates; k++ )
 	    {
-        double currProb = this->CurrDelta->GetComponent( 0, k ) + logA->GetComponent( k, j );
+        double currProb = this->CurrDelta[ k ] + logA[ k * numStates + j ];
         if ( currProb > maxProb )
 		    {
           maxProb = currProb;
@@ -97,24 +148,64 @@ void vtkMarkovModelOnline
 	    }
 
 	    // Account for observation probability
-	    this->CurrDelta->SetComponent( 0, j, maxProb + logB->GetComponent( j, symbolIndex ) );
-      this->CurrPsi->SetComponent( 0, j, maxIndex );
+	    this->NextDelta[ j ] = maxProb + logB[ j * numSymbols + symbolIndex ];
+      this->CurrPsi[ j ] = maxIndex;
 	  }
-
+    this->CurrDelta.swap( this->NextDelta );
   }
+  this->NumberOfOnlineObservations++;
 
   // Calculate end state
   int endState = 0;
-  for ( int k = 0; k < this->GetNumStates(); k++ )
+  for ( int k = 0; k < numStates; k++ )
   {
-    if ( this->CurrDelta->GetComponent( 0, k ) > this->CurrDelta->GetComponent( 0, endState ) )
+    if ( this->CurrDelta[ k ] > this->CurrDelta[ endState ] )
 	  {
       endState = k;
 	  }
   }
 
+  if ( this->FixedLag == 0 )
+  {
+    return endState;
+  }
+
+  // Remember this observation's psi, then follow the most likely path back to the observation the lag ago
+  int currObservation = this->NumberOfOnlineObservations - 1;
+  std::copy( this->CurrPsi.begin(), this->CurrPsi.end(), this->LagPsi.begin() + ( currObservation % this->FixedLag ) * numStates );
+  if ( currObservation < this->FixedLag )
+  {
+    return -1;
+  }
+  for ( int l = 0; l < this->FixedLag; l++ )
+  {
+    endState = this->LagPsi[ ( ( currObservation - l ) % this->FixedLag ) * numStates + endState ];
+  }
+
+  return endState;
+}
+
+
+void vtkMarkovModelOnline
+::CalculateStateOnline( vtkMRMLNode* node, std::string indexValue )
+{
+  if ( node == NULL || node->GetAttribute( "MarkovSymbol" ) == NULL )
+  {
+    return;
+  }
+
+  // Get the symbol index for the node currently being added
+  int endState = this->CalculateStateOnline( this->LookupSymbol( node->GetAttribute( "MarkovSymbol" ) ) );
+  if ( endState < 0 )
+  {
+    return;
+  }
+
   // Subsitute the calculated state into the inputted MarkovRecord (since the state originally won't make sense anyway)
   node->SetAttribute( "MarkovState", this->StateNames.at( endState ).c_str() );
 
-  this->Sequence->SetDataNodeAtValue( node, indexValue );
-}
\ No newline at end of file
+  if ( this->RecordHistory )
+  {
+    this->Sequence->SetDataNodeAtValue( node, indexValue );
+  }
+}
@@ -40,13 +40,43 @@ public:
   //
   void Copy( vtkMarkovModelOnline* otherMarkov );
 
+  // Forget all of the previous observations
+  void ResetOnline();
+  int GetNumberOfOnlineObservations() { return this->NumberOfOnlineObservations; };
+
+  // One Viterbi step: returns the index of the most likely current state (-1 if the symbol is invalid)
+  // This is O( states^2 ), and does not allocate (unless the number of states or the lag has changed)
+  // With a fixed lag, this is instead the state of the observation that many frames ago, on the most likely path to the current observation
+  // (-1 until there have been more observations than the lag)
+  int CalculateStateOnline( int symbolIndex );
+  // Same, but the symbol is the node's "MarkovSymbol" attribute, and the state is put in the node's "MarkovState" attribute
   void CalculateStateOnline( vtkMRMLNode* node, std::string indexValue );
 
+  // Fixed-lag smoothing: wait this many frames before deciding the state of a frame, so later frames can correct it (zero for no lag)
+  // This costs O( states + lag ) more per frame; changing the lag forgets all of the previous observations
+  vtkGetMacro( FixedLag, int );
+  void SetFixedLag( int newFixedLag );
+
+  // Keep a copy of every node passed in (off by default)
+  vtkGetMacro( RecordHistory, bool );
+  vtkSetMacro( RecordHistory, bool );
+  vtkBooleanMacro( RecordHistory, bool );
+  vtkMRMLSequenceNode* GetHistory();
+
 protected:
 
+  bool RecordHistory;
   vtkSmartPointer< vtkMRMLSequenceNode > Sequence;
-  vtkSmartPointer< vtkDoubleArray > CurrDelta;
-  vtkSmartPointer< vtkDoubleArray > CurrPsi;
+
+  // Log probabilities of the most likely path ending in each state (double-buffered, so each step reads only the previous step)
+  std::vector< double > CurrDelta;
+  std::vector< double > NextDelta;
+  std::vector< int > CurrPsi;
+  int NumberOfOnlineObservations;
+
+  // The psi of the most recent observations (one row per observation, in a ring of FixedLag rows)
+  int FixedLag;
+  std::vector< int > LagPsi;
 
 };
 
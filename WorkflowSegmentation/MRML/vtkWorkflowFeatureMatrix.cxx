@@ -0,0 +1,1157 @@
+
+#include "vtkWorkflowFeatureMatrix.h"
+
+// Constants ---------------------------------------------------------------------------------------
+
+const double vtkWorkflowFeatureMatrix::STDEV_CUTOFF = 5.0;
+const int vtkWorkflowFeatureMatrix::PCA_OVERSAMPLING = 8;
+
+vtkStandardNewMacro( vtkWorkflowFeatureMatrix );
+
+
+// Helper for sorting frames by time
+class vtkWorkflowFeatureMatrixTimeCompare
+{
+public:
+  vtkWorkflowFeatureMatrixTimeCompare( const std::vector< double >& times ) : Times( times ) {};
+  bool operator()( int frame1, int frame2 ) const { return this->Times[ frame1 ] < this->Times[ frame2 ]; };
+  const std::vector< double >& Times;
+};
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkWorkflowFeatureMatrix
+::vtkWorkflowFeatureMatrix()
+{
+  this->NumberOfComponents = 0;
+}
+
+
+vtkWorkflowFeatureMatrix
+::~vtkWorkflowFeatureMatrix()
+{
+  // Vectors take care of themselves
+}
+
+
+void vtkWorkflowFeatureMatrix
+::Copy( vtkWorkflowFeatureMatrix* otherMatrix )
+{
+  if ( otherMatrix == NULL || otherMatrix == this )
+  {
+    return;
+  }
+
+  this->NumberOfComponents = otherMatrix->NumberOfComponents;
+  this->Values = otherMatrix->Values;
+  this->Times = otherMatrix->Times;
+  this->Labels = otherMatrix->Labels;
+}
+
+
+// Size and access ---------------------------------------------------------------------------------
+
+void vtkWorkflowFeatureMatrix
+::Initialize( int numberOfFrames, int numberOfComponents )
+{
+  this->NumberOfComponents = numberOfComponents;
+  this->Values.assign( numberOfFrames * numberOfComponents, 0.0 );
+  this->Times.assign( numberOfFrames, 0.0 );
+  this->Labels.assign( numberOfFrames, "" );
+}
+
+
+void vtkWorkflowFeatureMatrix
+::Reserve( int numberOfFrames )
+{
+  this->Values.reserve( numberOfFrames * this->NumberOfComponents );
+  this->Times.reserve( numberOfFrames );
+  this->Labels.reserve( numberOfFrames );
+}
+
+
+int vtkWorkflowFeatureMatrix
+::GetNumberOfFrames()
+{
+  return this->Times.size();
+}
+
+
+int vtkWorkflowFeatureMatrix
+::GetNumberOfComponents()
+{
+  return this->NumberOfComponents;
+}
+
+
+void vtkWorkflowFeatureMatrix
+::AppendFrame( double time, const double* values, std::string label )
+{
+  this->Values.insert( this->Values.end(), values, values + this->NumberOfComponents );
+  this->Times.push_back( time );
+  this->Labels.push_back( label );
+}
+
+
+void vtkWorkflowFeatureMatrix
+::GetFrameAsDoubleArray( int frame, vtkDoubleArray* doubleArray )
+{
+  doubleArray->SetNumberOfComponents( this->NumberOfComponents );
+  doubleArray->SetNumberOfTuples( 1 );
+  for ( int d = 0; d < this->NumberOfComponents; d++ )
+  {
+    doubleArray->SetComponent( 0, d, this->GetValue( frame, d ) );
+  }
+}
+
+
+// Methods specific for workflow segmentation -------------------------------------------------------------
+
+// Note: This is inclusive (end points will appear in the result)
+void vtkWorkflowFeatureMatrix
+::GetSubmatrix( int startFrame, int endFrame, vtkWorkflowFeatureMatrix* submatrix )
+{
+  this->GetSubmatrixView( startFrame, endFrame ).Materialize( submatrix );
+}
+
+
+void vtkWorkflowFeatureMatrix
+::GetLabelledSubmatrix( std::vector< std::string > labels, vtkWorkflowFeatureMatrix* submatrix )
+{
+  this->GetLabelledSubmatrixView( labels ).Materialize( submatrix );
+}
+
+
+vtkWorkflowSequenceView vtkWorkflowFeatureMatrix
+::GetSubmatrixView( int startFrame, int endFrame )
+{
+  vtkWorkflowSequenceView submatrixView( this );
+  submatrixView.SetRange( startFrame, endFrame );
+  return submatrixView;
+}
+
+
+vtkWorkflowSequenceView vtkWorkflowFeatureMatrix
+::GetLabelledSubmatrixView( std::vector< std::string > labels )
+{
+  vtkWorkflowSequenceView submatrixView( this );
+  submatrixView.SetLabelledFrames( labels );
+  return submatrixView;
+}
+
+
+void vtkWorkflowFeatureMatrix
+::Concatenate( vtkWorkflowFeatureMatrix* otherMatrix, bool enforceUniqueTimes /* = false */ )
+{
+  std::vector< vtkWorkflowFeatureMatrix* > otherMatrices( 1, otherMatrix );
+  this->Concatenate( otherMatrices, enforceUniqueTimes );
+}
+
+
+// This appends all of the frames in place (reserving once), so it is linear in the total number of frames
+void vtkWorkflowFeatureMatrix
+::Concatenate( std::vector< vtkWorkflowFeatureMatrix* > otherMatrices, bool enforceUniqueTimes /* = false */ )
+{
+  int startFrames = this->GetNumberOfFrames();
+  int totalFrames = startFrames;
+  for ( int m = 0; m < otherMatrices.size(); m++ )
+  {
+    if ( otherMatrices.at( m ) == NULL || otherMatrices.at( m )->GetNumberOfFrames() == 0 )
+    {
+      continue;
+    }
+
+    // The first non-empty matrix decides the size if there are no frames yet
+    if ( totalFrames == 0 )
+    {
+      this->NumberOfComponents = otherMatrices.at( m )->GetNumberOfComponents();
+    }
+    if ( this->NumberOfComponents != otherMatrices.at( m )->GetNumberOfComponents() )
+    {
+      vtkWarningMacro( "vtkWorkflowFeatureMatrix::Concatenate: Matrices are incompatible, could not concatenate." );
+      otherMatrices.at( m ) = NULL;
+      continue;
+    }
+    totalFrames += otherMatrices.at( m )->GetNumberOfFrames();
+  }
+  if ( totalFrames == startFrames )
+  {
+    return;
+  }
+
+  // Just stack the frames
+  this->Reserve( totalFrames );
+  bool timesIncreasing = true;
+  for ( int m = 0; m < otherMatrices.size(); m++ )
+  {
+    vtkWorkflowFeatureMatrix* currMatrix = otherMatrices.at( m );
+    if ( currMatrix == NULL || currMatrix->GetNumberOfFrames() == 0 )
+    {
+      continue;
+    }
+
+    if ( ! this->Times.empty() && ! ( currMatrix->Times.front() > this->Times.back() ) )
+    {
+      timesIncreasing = false;
+    }
+    this->Values.insert( this->Values.end(), currMatrix->Values.begin(), currMatrix->Values.end() );
+    this->Times.insert( this->Times.end(), currMatrix->Times.begin(), currMatrix->Times.end() );
+    this->Labels.insert( this->Labels.end(), currMatrix->Labels.begin(), currMatrix->Labels.end() );
+  }
+
+  // Renumber the frames (the frames that were already consecutive do not need to be touched)
+  if ( enforceUniqueTimes )
+  {
+    int firstFrame = 0;
+    while ( firstFrame < startFrames && this->Times[ firstFrame ] == firstFrame )
+    {
+      firstFrame++;
+    }
+    for ( int i = firstFrame; i < totalFrames; i++ )
+    {
+      this->Times[ i ] = i;
+    }
+    return;
+  }
+
+  // Otherwise, merge by time (same as inserting into a sequence)
+  // If there are identical times, there will only be one instance in the result, and it will be the later matrix's frame
+  // Nothing to do if every matrix came after the previous ones (the usual case for procedures recorded one after another)
+  if ( timesIncreasing )
+  {
+    return;
+  }
+
+  std::vector< int > frameOrder( totalFrames );
+  for ( int i = 0; i < totalFrames; i++ )
+  {
+    frameOrder[ i ] = i;
+  }
+  std::stable_sort( frameOrder.begin(), frameOrder.end(), vtkWorkflowFeatureMatrixTimeCompare( this->Times ) );
+
+  std::vector< double > mergedValues; mergedValues.reserve( this->Values.size() );
+  std::vector< double > mergedTimes; mergedTimes.reserve( totalFrames );
+  std::vector< std::string > mergedLabels; mergedLabels.reserve( totalFrames );
+  for ( int i = 0; i < totalFrames; i++ )
+  {
+    int currFrame = frameOrder[ i ];
+    if ( i + 1 < totalFrames && this->Times[ frameOrder[ i + 1 ] ] == this->Times[ currFrame ] )
+    {
+      continue; // Replaced by the later frame
+    }
+    mergedValues.insert( mergedValues.end(), this->GetFrame( currFrame ), this->GetFrame( currFrame ) + this->NumberOfComponents );
+    mergedTimes.push_back( this->Times[ currFrame ] );
+    mergedLabels.push_back( this->Labels[ currFrame ] );
+  }
+
+  this->Values.swap( mergedValues );
+  this->Times.swap( mergedTimes );
+  this->Labels.swap( mergedLabels );
+}
+
+
+void vtkWorkflowFeatureMatrix
+::Concatenate( std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& otherMatrices, bool enforceUniqueTimes /* = false */ )
+{
+  std::vector< vtkWorkflowFeatureMatrix* > otherMatrixPointers;
+  for ( int m = 0; m < otherMatrices.size(); m++ )
+  {
+    otherMatrixPointers.push_back( otherMatrices.at( m ) );
+  }
+  this->Concatenate( otherMatrixPointers, enforceUniqueTimes );
+}
+
+
+void vtkWorkflowFeatureMatrix
+::ConcatenateValues( vtkWorkflowFeatureMatrix* otherMatrix )
+{
+  // Only works if the number of frames are the same for both matrices
+  if ( this->GetNumberOfFrames() != otherMatrix->GetNumberOfFrames() )
+  {
+    return;
+  }
+
+  int numberOfFrames = this->GetNumberOfFrames();
+  int concatenatedComponents = this->NumberOfComponents + otherMatrix->GetNumberOfComponents();
+  std::vector< double > concatenatedValues( numberOfFrames * concatenatedComponents );
+  for ( int i = 0; i < numberOfFrames; i++ )
+  {
+    double* concatenatedFrame = &concatenatedValues[ i * concatenatedComponents ];
+    std::copy( this->GetFrame( i ), this->GetFrame( i ) + this->NumberOfComponents, concatenatedFrame );
+    std::copy( otherMatrix->GetFrame( i ), otherMatrix->GetFrame( i ) + otherMatrix->GetNumberOfComponents(), concatenatedFrame + this->NumberOfComponents );
+  }
+
+  this->Values.swap( concatenatedValues );
+  this->NumberOfComponents = concatenatedComponents;
+}
+
+
+void vtkWorkflowFeatureMatrix
+::ConcatenateValues( vtkDoubleArray* doubleArray )
+{
+  if ( doubleArray == NULL )
+  {
+    return;
+  }
+
+  // Stick the array onto each frame
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > arrayMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  arrayMatrix->Initialize( this->GetNumberOfFrames(), doubleArray->GetNumberOfComponents() );
+  for ( int i = 0; i < this->GetNumberOfFrames(); i++ )
+  {
+    for ( int d = 0; d < doubleArray->GetNumberOfComponents(); d++ )
+    {
+      arrayMatrix->SetValue( i, d, doubleArray->GetComponent( 0, d ) );
+    }
+  }
+
+  this->ConcatenateValues( arrayMatrix );
+}
+
+
+// Note: This adds the padding to the start of the current matrix
+void vtkWorkflowFeatureMatrix
+::PadStart( int window )
+{
+  int numberOfFrames = this->GetNumberOfFrames();
+  if ( numberOfFrames == 0 || window <= 0 )
+  {
+    return;
+  }
+
+  // Find the average time stamp
+  // Divide by one less than the number of frames because there are one fewer differences than there are stamps
+  double deltaTime = 1.0;
+  if ( numberOfFrames > 1 )
+  {
+    deltaTime = ( this->Times[ numberOfFrames - 1 ] - this->Times[ 0 ] ) / ( numberOfFrames - 1 );
+  }
+
+  // Repeat the initial frame, going back in time
+  std::vector< double > paddedValues( window * this->NumberOfComponents );
+  std::vector< double > paddedTimes( window );
+  for ( int i = 0; i < window; i++ )
+  {
+    std::copy( this->GetFrame( 0 ), this->GetFrame( 0 ) + this->NumberOfComponents, &paddedValues[ i * this->NumberOfComponents ] );
+    paddedTimes[ i ] = this->Times[ 0 ] - ( window - i ) * deltaTime;
+  }
+
+  this->Values.insert( this->Values.begin(), paddedValues.begin(), paddedValues.end() );
+  this->Times.insert( this->Times.begin(), paddedTimes.begin(), paddedTimes.end() );
+  this->Labels.insert( this->Labels.begin(), window, this->Labels[ 0 ] );
+}
+
+
+void vtkWorkflowFeatureMatrix
+::Mean( vtkDoubleArray* meanArray )
+{
+  if ( meanArray == NULL )
+  {
+    return;
+  }
+
+  std::vector< double > meanValues( this->NumberOfComponents, 0.0 );
+  for ( int i = 0; i < this->GetNumberOfFrames(); i++ )
+  {
+    const double* currFrame = this->GetFrame( i );
+    for ( int d = 0; d < this->NumberOfComponents; d++ )
+    {
+      meanValues[ d ] += currFrame[ d ];
+    }
+  }
+
+  meanArray->SetNumberOfComponents( this->NumberOfComponents );
+  meanArray->SetNumberOfTuples( 1 );
+  for ( int d = 0; d < this->NumberOfComponents; d++ )
+  {
+    meanArray->SetComponent( 0, d, ( this->GetNumberOfFrames() > 0 ) ? ( meanValues[ d ] / this->GetNumberOfFrames() ) : 0.0 );
+  }
+}
+
+
+void vtkWorkflowFeatureMatrix
+::Distances( vtkDoubleArray* testPoints, vtkDoubleArray* distances )
+{
+  this->SquaredDistances( testPoints, distances );
+
+  double* distanceValues = distances->GetPointer( 0 );
+  for ( vtkIdType i = 0; i < distances->GetNumberOfValues(); i++ )
+  {
+    distanceValues[ i ] = sqrt( distanceValues[ i ] );
+  }
+}
+
+
+// One tuple per frame, one component per test point
+void vtkWorkflowFeatureMatrix
+::SquaredDistances( vtkDoubleArray* testPoints, vtkDoubleArray* distances )
+{
+  // Create a vector of vectors
+  distances->SetNumberOfComponents( testPoints->GetNumberOfTuples() );
+  distances->SetNumberOfTuples( this->GetNumberOfFrames() );
+
+  if ( testPoints->GetNumberOfComponents() != this->NumberOfComponents )
+  {
+    return;
+  }
+
+  int numberOfTestPoints = testPoints->GetNumberOfTuples();
+  const double* testPointValues = testPoints->GetPointer( 0 );
+  double* distanceValues = distances->GetPointer( 0 );
+  for ( int i = 0; i < this->GetNumberOfFrames(); i++ )
+  {
+    const double* currFrame = this->GetFrame( i );
+    for ( int j = 0; j < numberOfTestPoints; j++ )
+    {
+      const double* currTestPoint = testPointValues + j * this->NumberOfComponents;
+      double currSum = 0;
+      for ( int d = 0; d < this->NumberOfComponents; d++ )
+      {
+        double currDiff = currFrame[ d ] - currTestPoint[ d ];
+        currSum += currDiff * currDiff;
+      }
+      distanceValues[ i * numberOfTestPoints + j ] = currSum;
+    }
+  }
+}
+
+
+void vtkWorkflowFeatureMatrix
+::Differentiate( int order )
+{
+  int numberOfFrames = this->GetNumberOfFrames();
+  if ( numberOfFrames < 2 )
+  {
+    return;
+  }
+
+  // Use a centred difference formula (except at the endpoints, use a forward/backward difference formula)
+  std::vector< double > derivativeValues( this->Values.size() );
+  for ( int o = 0; o < order; o++ )
+  {
+    for ( int i = 0; i < numberOfFrames; i++ )
+    {
+      int lowerFrame = std::max( i - 1, 0 );
+      int upperFrame = std::min( i + 1, numberOfFrames - 1 );
+
+      const double* lowerValues = this->GetFrame( lowerFrame );
+      const double* upperValues = this->GetFrame( upperFrame );
+      double* derivativeFrame = &derivativeValues[ i * this->NumberOfComponents ];
+
+      double deltaTime = this->Times[ upperFrame ] - this->Times[ lowerFrame ];
+      for ( int d = 0; d < this->NumberOfComponents; d++ )
+      {
+        derivativeFrame[ d ] = ( upperValues[ d ] - lowerValues[ d ] ) / deltaTime;
+      }
+    }
+    this->Values.swap( derivativeValues );
+  }
+}
+
+
+void vtkWorkflowFeatureMatrix
+::Integrate( vtkDoubleArray* integration )
+{
+  integration->SetNumberOfComponents( this->NumberOfComponents );
+  integration->SetNumberOfTuples( 1 );
+
+  // Use the trapezoidal rule
+  std::vector< double > integrationValues( this->NumberOfComponents, 0.0 );
+  for ( int i = 1; i < this->GetNumberOfFrames(); i++ )
+  {
+    const double* lowerValues = this->GetFrame( i - 1 );
+    const double* upperValues = this->GetFrame( i );
+    double deltaTime = this->Times[ i ] - this->Times[ i - 1 ];
+    for ( int d = 0; d < this->NumberOfComponents; d++ )
+    {
+      integrationValues[ d ] += deltaTime * ( lowerValues[ d ] + upperValues[ d ] ) / 2;
+    }
+  }
+
+  for ( int d = 0; d < this->NumberOfComponents; d++ )
+  {
+    integration->SetComponent( 0, d, integrationValues[ d ] );
+  }
+}
+
+
+void vtkWorkflowFeatureMatrix
+::GaussianFilter( double width, GaussianFilterMode mode /* = SLIDING_WINDOW_FILTER */ )
+{
+  if ( mode == DIRECT_FILTER )
+  {
+    this->GaussianFilterDirect( width );
+  }
+  else
+  {
+    this->GaussianFilterSlidingWindow( width );
+  }
+}
+
+
+// Note: This is the reference implementation (it recomputes the weights for every component)
+void vtkWorkflowFeatureMatrix
+::GaussianFilterDirect( double width )
+{
+  int numberOfFrames = this->GetNumberOfFrames();
+  std::vector< double > gaussValues( this->Values.size() );
+
+  // For each frame
+  for ( int i = 0; i < numberOfFrames; i++ )
+  {
+    // Iterate over all dimensions
+    for ( int d = 0; d < this->NumberOfComponents; d++ )
+    {
+      double weightSum = 0.0;
+      double normSum = 0.0;
+
+      // Iterate over all frames nearby to the left
+      for ( int j = i; j >= 0; j-- )
+      {
+        // If too far from "peak" of distribution, the stop - we're just wasting time
+        double normalizedDistance = ( this->Times[ j ] - this->Times[ i ] ) / width;
+        if ( std::abs( normalizedDistance ) > STDEV_CUTOFF )
+        {
+          break;
+        }
+
+        // Calculate the values of the Gaussian distribution at this time
+        double gaussianWeight = exp( - normalizedDistance * normalizedDistance / 2 );
+        weightSum = weightSum + this->GetValue( j, d ) * gaussianWeight;
+        normSum = normSum + gaussianWeight;
+      }
+
+      // Iterate over all frames nearby to the right
+      for ( int j = i + 1; j < numberOfFrames; j++ )
+      {
+        double normalizedDistance = ( this->Times[ j ] - this->Times[ i ] ) / width;
+        if ( std::abs( normalizedDistance ) > STDEV_CUTOFF )
+        {
+          break;
+        }
+
+        double gaussianWeight = exp( - normalizedDistance * normalizedDistance / 2 );
+        weightSum = weightSum + this->GetValue( j, d ) * gaussianWeight;
+        normSum = normSum + gaussianWeight;
+      }
+
+      gaussValues[ i * this->NumberOfComponents + d ] = weightSum / normSum;
+    }
+  }
+
+  this->Values.swap( gaussValues );
+}
+
+
+// Note: This assumes the times are increasing (as they are in a sequence)
+// The frames within the cutoff of the current frame form a window, whose ends only ever move forward
+// The weights and sums are accumulated in the same order as the direct filter, so the result is the same
+void vtkWorkflowFeatureMatrix
+::GaussianFilterSlidingWindow( double width )
+{
+  int numberOfFrames = this->GetNumberOfFrames();
+  std::vector< double > gaussValues( this->Values.size() );
+
+  // If the sampling is uniform, then the weights only depend on how many frames away the neighbour is
+  // So the kernel is computed once, up to the cutoff (with a frame to spare for round-off)
+  double deltaTime = 0.0;
+  bool uniform = this->IsUniformlySampled( deltaTime );
+  std::vector< double > kernel;
+  if ( uniform )
+  {
+    int kernelSize = int( std::min( double( numberOfFrames ), STDEV_CUTOFF * std::abs( width ) / deltaTime + 2 ) );
+    kernel.resize( kernelSize );
+    for ( int k = 0; k < kernelSize; k++ )
+    {
+      double normalizedDistance = k * deltaTime / width;
+      kernel[ k ] = exp( - normalizedDistance * normalizedDistance / 2 );
+    }
+  }
+
+  // The window can never be bigger than the whole matrix, so the buffers are allocated once
+  // The window weights are ordered like the direct filter: the current frame, to the left, then to the right
+  std::vector< double > windowWeights( numberOfFrames );
+  std::vector< double > weightSums( this->NumberOfComponents );
+
+  int lowerFrame = 0;
+  int upperFrame = 0;
+  for ( int i = 0; i < numberOfFrames; i++ )
+  {
+    // Slide the window
+    while ( std::abs( ( this->Times[ lowerFrame ] - this->Times[ i ] ) / width ) > STDEV_CUTOFF )
+    {
+      lowerFrame++;
+    }
+    upperFrame = std::max( upperFrame, i );
+    while ( upperFrame + 1 < numberOfFrames && std::abs( ( this->Times[ upperFrame + 1 ] - this->Times[ i ] ) / width ) <= STDEV_CUTOFF )
+    {
+      upperFrame++;
+    }
+
+    // Calculate the values of the Gaussian distribution for each frame in the window
+    int numberOfLeftFrames = i - lowerFrame + 1;
+    int windowSize = upperFrame - lowerFrame + 1;
+    double normSum = 0.0;
+    for ( int k = 0; k < windowSize; k++ )
+    {
+      int j = ( k < numberOfLeftFrames ) ? ( i - k ) : ( i + k - numberOfLeftFrames + 1 );
+      int offset = std::abs( j - i );
+
+      double gaussianWeight = 0.0;
+      if ( offset < kernel.size() )
+      {
+        gaussianWeight = kernel[ offset ];
+      }
+      else
+      {
+        double normalizedDistance = ( this->Times[ j ] - this->Times[ i ] ) / width;
+        gaussianWeight = exp( - normalizedDistance * normalizedDistance / 2 );
+      }
+      windowWeights[ k ] = gaussianWeight;
+      normSum = normSum + gaussianWeight;
+    }
+
+    // Apply the weights to all components at once
+    std::fill( weightSums.begin(), weightSums.end(), 0.0 );
+    for ( int k = 0; k < windowSize; k++ )
+    {
+      int j = ( k < numberOfLeftFrames ) ? ( i - k ) : ( i + k - numberOfLeftFrames + 1 );
+      const double* currFrame = this->GetFrame( j );
+      for ( int d = 0; d < this->NumberOfComponents; d++ )
+      {
+        weightSums[ d ] = weightSums[ d ] + currFrame[ d ] * windowWeights[ k ];
+      }
+    }
+
+    for ( int d = 0; d < this->NumberOfComponents; d++ )
+    {
+      gaussValues[ i * this->NumberOfComponents + d ] = weightSums[ d ] / normSum;
+    }
+  }
+
+  this->Values.swap( gaussValues );
+}
+
+
+// Uniform if every time step is the same as the average time step (up to round-off)
+bool vtkWorkflowFeatureMatrix
+::IsUniformlySampled( double& deltaTime )
+{
+  int numberOfFrames = this->GetNumberOfFrames();
+  if ( numberOfFrames < 2 )
+  {
+    return false;
+  }
+
+  deltaTime = ( this->Times[ numberOfFrames - 1 ] - this->Times[ 0 ] ) / ( numberOfFrames - 1 );
+  if ( deltaTime <= 0 )
+  {
+    return false;
+  }
+
+  const double UNIFORM_TOLERANCE = 1e-9;
+  for ( int i = 1; i < numberOfFrames; i++ )
+  {
+    if ( std::abs( ( this->Times[ i ] - this->Times[ i - 1 ] ) - deltaTime ) > UNIFORM_TOLERANCE * deltaTime )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+void vtkWorkflowFeatureMatrix
+::LegendreTransformation( int order, vtkDoubleArray* legendreCoefficients )
+{
+  legendreCoefficients->SetNumberOfComponents( this->NumberOfComponents );
+  legendreCoefficients->SetNumberOfTuples( order + 1 );
+
+  int numberOfFrames = this->GetNumberOfFrames();
+  if ( numberOfFrames == 0 || this->Times[ numberOfFrames - 1 ] - this->Times[ 0 ] <= 0 )
+  {
+    vtkWarningMacro( "vtkWorkflowFeatureMatrix::LegendreTransformation: Improper time range." );
+    return;
+  }
+
+  std::vector< double > coefficients( ( order + 1 ) * this->NumberOfComponents );
+  vtkWorkflowFeatureMatrix::LegendreCoefficients( &this->Times[ 0 ], this->GetFrame( 0 ), numberOfFrames, this->NumberOfComponents, order, &coefficients[ 0 ] );
+
+  for ( int o = 0; o <= order; o++ )
+  {
+    for ( int d = 0; d < this->NumberOfComponents; d++ )
+    {
+      legendreCoefficients->SetComponent( o, d, coefficients[ o * this->NumberOfComponents + d ] );
+    }
+  }
+}
+
+
+// The coefficients are ordered by order, then by component
+void vtkWorkflowFeatureMatrix
+::LegendreCoefficients( const double* times, const double* values, int numberOfFrames, int numberOfComponents, int order, double* coefficients )
+{
+  std::fill( coefficients, coefficients + ( order + 1 ) * numberOfComponents, 0.0 );
+
+  // Calculate the time adjustment (need range -1 to 1)
+  double startTime = times[ 0 ];
+  double timeRange = times[ numberOfFrames - 1 ] - startTime;
+  if ( timeRange <= 0 )
+  {
+    return;
+  }
+
+  std::vector< double > adjustedTimes( numberOfFrames );
+  for ( int i = 0; i < numberOfFrames; i++ )
+  {
+    adjustedTimes[ i ] = 2 * ( times[ i ] - startTime ) / timeRange - 1;
+  }
+
+  // Multiply the values by the Legendre polynomials, and integrate with the trapezoidal rule
+  std::vector< double > legendrePolynomials( numberOfFrames );
+  for ( int o = 0; o <= order; o++ )
+  {
+    for ( int i = 0; i < numberOfFrames; i++ )
+    {
+      legendrePolynomials[ i ] = vtkWorkflowFeatureMatrix::LegendrePolynomial( adjustedTimes[ i ], o );
+    }
+
+    double* currCoefficients = coefficients + o * numberOfComponents;
+    for ( int i = 1; i < numberOfFrames; i++ )
+    {
+      const double* lowerValues = values + ( i - 1 ) * numberOfComponents;
+      const double* upperValues = values + i * numberOfComponents;
+      double deltaTime = adjustedTimes[ i ] - adjustedTimes[ i - 1 ];
+      for ( int d = 0; d < numberOfComponents; d++ )
+      {
+        currCoefficients[ d ] += deltaTime * ( lowerValues[ d ] * legendrePolynomials[ i - 1 ] + upperValues[ d ] * legendrePolynomials[ i ] ) / 2;
+      }
+    }
+  }
+}
+
+
+double vtkWorkflowFeatureMatrix
+::LegendrePolynomial( double time, int order )
+{
+  if ( order == 0 )
+  {
+    return 1;
+  }
+  if ( order == 1 )
+  {
+    return time;
+  }
+  if ( order == 2 )
+  {
+    return 3.0 / 2.0 * pow( time, 2.0 ) - 1.0 / 2.0;
+  }
+  if ( order == 3 )
+  {
+    return 5.0 / 2.0 * pow( time, 3.0 ) - 3.0 / 2.0 * time;
+  }
+  if ( order == 4 )
+  {
+    return 35.0 / 8.0 * pow( time, 4.0 ) - 15.0 / 4.0 * pow( time, 2.0 ) + 3.0 / 8.0;
+  }
+  if ( order == 5 )
+  {
+    return 63.0 / 8.0 * pow( time, 5.0 ) - 35.0 / 4.0 * pow( time, 3.0 ) + 15.0 / 8.0 * time;
+  }
+  if ( order == 6 )
+  {
+    return 231.0 / 16.0 * pow( time, 6.0 ) - 315.0 / 16.0 * pow( time, 4.0 ) + 105.0 / 16.0 * pow( time, 2.0 ) - 5.0 / 16.0;
+  }
+
+  return 0.0;
+}
+
+
+void vtkWorkflowFeatureMatrix
+::OrthogonalTransformation( int window, int order )
+{
+  int numberOfFrames = this->GetNumberOfFrames();
+
+  // Pad the matrix with values at the beginning
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > paddedMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  paddedMatrix->Copy( this );
+  paddedMatrix->PadStart( window );
+
+  // Iterate over all frames, and calculate Legendre expansion coefficients over the window ending at that frame
+  // Calculate the Legendre coefficients: 2D -> 1D
+  vtkSmartPointer< vtkWorkflowLegendreKernel > legendreKernel = vtkSmartPointer< vtkWorkflowLegendreKernel >::New();
+  legendreKernel->Initialize( window + 1, order, this->NumberOfComponents );
+
+  int orthogonalComponents = legendreKernel->GetNumberOfCoefficients();
+  std::vector< double > orthogonalValues( numberOfFrames * orthogonalComponents );
+  for ( int i = 0; i < numberOfFrames; i++ )
+  {
+    if ( ! legendreKernel->CalculateCoefficients( &paddedMatrix->GetTimes()[ i ], paddedMatrix->GetFrame( i ), &orthogonalValues[ i * orthogonalComponents ] ) )
+    {
+      vtkWarningMacro( "vtkWorkflowFeatureMatrix::OrthogonalTransformation: Improper time range." );
+    }
+  }
+
+  this->Values.swap( orthogonalValues );
+  this->NumberOfComponents = orthogonalComponents;
+}
+
+
+// Helper for the covariance matrix
+// Each chunk of frames accumulates its own partial sums (upper triangle only), so the result does not depend on the threading
+class vtkWorkflowCovarianceFunctor
+{
+public:
+  const double* Values;
+  const double* Mean;
+  int NumberOfFrames;
+  int NumberOfComponents;
+  int ChunkSize;
+  std::vector< double >* PartialSums;
+
+  void operator()( vtkIdType beginChunk, vtkIdType endChunk )
+  {
+    int triangleSize = this->NumberOfComponents * ( this->NumberOfComponents + 1 ) / 2;
+    std::vector< double > meanSubtracted( this->NumberOfComponents );
+    for ( vtkIdType c = beginChunk; c < endChunk; c++ )
+    {
+      double* currSums = &( *this->PartialSums )[ c * triangleSize ];
+      int endFrame = std::min( ( int ) ( c + 1 ) * this->ChunkSize, this->NumberOfFrames );
+      for ( int i = c * this->ChunkSize; i < endFrame; i++ )
+      {
+        const double* currFrame = this->Values + i * this->NumberOfComponents;
+        for ( int d = 0; d < this->NumberOfComponents; d++ )
+        {
+          meanSubtracted[ d ] = currFrame[ d ] - this->Mean[ d ];
+        }
+
+        int triangleIndex = 0;
+        for ( int d1 = 0; d1 < this->NumberOfComponents; d1++ )
+        {
+          double currValue = meanSubtracted[ d1 ];
+          for ( int d2 = d1; d2 < this->NumberOfComponents; d2++ )
+          {
+            currSums[ triangleIndex ] += currValue * meanSubtracted[ d2 ];
+            triangleIndex++;
+          }
+        }
+      }
+    }
+  }
+};
+
+
+void vtkWorkflowFeatureMatrix
+::CovarianceMatrix( vnl_matrix< double >& covariance )
+{
+  // Construct a recordSize by recordSize vnl matrix
+  covariance.set_size( this->NumberOfComponents, this->NumberOfComponents );
+  covariance.fill( 0.0 );
+
+  int numberOfFrames = this->GetNumberOfFrames();
+  if ( numberOfFrames == 0 )
+  {
+    return;
+  }
+
+  // Determine the mean, to subtract from each frame
+  vtkSmartPointer< vtkDoubleArray > meanArray = vtkSmartPointer< vtkDoubleArray >::New();
+  this->Mean( meanArray );
+
+  // Compute the partial sums for each chunk of frames in parallel
+  const int COVARIANCE_CHUNK_SIZE = 256;
+  int numberOfChunks = ( numberOfFrames + COVARIANCE_CHUNK_SIZE - 1 ) / COVARIANCE_CHUNK_SIZE;
+  int triangleSize = this->NumberOfComponents * ( this->NumberOfComponents + 1 ) / 2;
+  std::vector< double > partialSums( numberOfChunks * triangleSize, 0.0 );
+
+  vtkWorkflowCovarianceFunctor covarianceFunctor;
+  covarianceFunctor.Values = this->GetValues();
+  covarianceFunctor.Mean = meanArray->GetPointer( 0 );
+  covarianceFunctor.NumberOfFrames = numberOfFrames;
+  covarianceFunctor.NumberOfComponents = this->NumberOfComponents;
+  covarianceFunctor.ChunkSize = COVARIANCE_CHUNK_SIZE;
+  covarianceFunctor.PartialSums = &partialSums;
+  vtkSMPTools::For( 0, numberOfChunks, 1, covarianceFunctor );
+
+  // Reduce the chunks in order, so the result is deterministic
+  std::vector< double > sums( triangleSize, 0.0 );
+  for ( int c = 0; c < numberOfChunks; c++ )
+  {
+    const double* currSums = &partialSums[ c * triangleSize ];
+    for ( int t = 0; t < triangleSize; t++ )
+    {
+      sums[ t ] += currSums[ t ];
+    }
+  }
+
+  // Divide by the number of frames, and fill in the symmetric matrix
+  int triangleIndex = 0;
+  for ( int d1 = 0; d1 < this->NumberOfComponents; d1++ )
+  {
+    for ( int d2 = d1; d2 < this->NumberOfComponents; d2++ )
+    {
+      covariance( d1, d2 ) = sums[ triangleIndex ] / numberOfFrames;
+      covariance( d2, d1 ) = covariance( d1, d2 );
+      triangleIndex++;
+    }
+  }
+}
+
+
+void vtkWorkflowFeatureMatrix
+::CalculatePrincipalComponents( int numComp, vtkDoubleArray* prinComps, PrincipalComponentsMethod method /* = FULL_EIGENSOLVER */ )
+{
+  // Calculate the covariance matrix
+  vnl_matrix< double > covariance;
+  this->CovarianceMatrix( covariance );
+
+  // Prevent more prinicipal components than original dimensions
+  int numEigenvectors = covariance.cols();
+  if ( numComp > numEigenvectors )
+  {
+    numComp = numEigenvectors;
+  }
+
+  prinComps->SetNumberOfComponents( covariance.rows() );
+  prinComps->SetNumberOfTuples( numComp );
+
+  // Only worth using the truncated solver if a few components are required
+  if ( method == TRUNCATED_EIGENSOLVER && numComp + PCA_OVERSAMPLING < numEigenvectors )
+  {
+    vnl_matrix< double > topEigenvectors;
+    this->TruncatedEigenvectors( covariance, numComp, topEigenvectors );
+    for ( int o = 0; o < numComp; o++ )
+    {
+      for ( int d = 0; d < topEigenvectors.rows(); d++ )
+      {
+        prinComps->SetComponent( o, d, topEigenvectors( d, o ) );
+      }
+    }
+    return;
+  }
+
+  //Calculate the eigenvectors of the covariance matrix
+  vnl_matrix< double > eigenvectors( covariance.rows(), covariance.cols(), 0.0 );
+  vnl_vector< double > eigenvalues( covariance.rows(), 0.0 );
+  vnl_symmetric_eigensystem_compute( covariance, eigenvectors, eigenvalues );
+  // Note: eigenvectors are ordered in increasing eigenvalue ( 0 = smallest, end = biggest )
+
+  for ( int i = numEigenvectors - 1; i > numEigenvectors - 1 - numComp; i-- )
+  {
+    for ( int d = 0; d < eigenvectors.rows(); d++ )
+    {
+      prinComps->SetComponent( numEigenvectors - 1 - i, d, eigenvectors.get( d, i ) );
+    }
+  }
+}
+
+
+// Randomized subspace iteration, with a fixed seed so the result is reproducible
+// The columns of the result are the top eigenvectors, in decreasing eigenvalue
+void vtkWorkflowFeatureMatrix
+::TruncatedEigenvectors( vnl_matrix< double >& covariance, int numComp, vnl_matrix< double >& topEigenvectors )
+{
+  const int MAX_ITERATIONS = 200;
+  const double CONVERGENCE_TOLERANCE = 1e-12;
+
+  int dimension = covariance.rows();
+  int subspaceSize = std::min( numComp + PCA_OVERSAMPLING, dimension );
+
+  // Random starting subspace
+  unsigned int seed = 1;
+  vnl_matrix< double > subspace( dimension, subspaceSize, 0.0 );
+  for ( int d = 0; d < dimension; d++ )
+  {
+    for ( int j = 0; j < subspaceSize; j++ )
+    {
+      seed = seed * 1103515245 + 12345;
+      subspace( d, j ) = ( ( seed >> 16 ) & 0x7fff ) / 16383.5 - 1.0;
+    }
+  }
+  vtkWorkflowFeatureMatrix::Orthonormalize( subspace );
+
+  vnl_matrix< double > product( dimension, subspaceSize, 0.0 );
+  vnl_matrix< double > projected( subspaceSize, subspaceSize, 0.0 );
+  vnl_matrix< double > ritzVectors( subspaceSize, subspaceSize, 0.0 );
+  vnl_vector< double > ritzValues( subspaceSize, 0.0 );
+  std::vector< double > previousRitzValues( numComp, 0.0 );
+  for ( int iteration = 0; iteration < MAX_ITERATIONS; iteration++ )
+  {
+    // Power step
+    vtkWorkflowFeatureMatrix::MultiplyMatrices( covariance, subspace, product );
+    for ( int d = 0; d < dimension; d++ )
+    {
+      for ( int j = 0; j < subspaceSize; j++ )
+      {
+        subspace( d, j ) = product( d, j );
+      }
+    }
+    vtkWorkflowFeatureMatrix::Orthonormalize( subspace );
+
+    // Rayleigh-Ritz on the subspace
+    vtkWorkflowFeatureMatrix::MultiplyMatrices( covariance, subspace, product );
+    for ( int i = 0; i < subspaceSize; i++ )
+    {
+      for ( int j = 0; j < subspaceSize; j++ )
+      {
+        double currSum = 0.0;
+        for ( int d = 0; d < dimension; d++ )
+        {
+          currSum += subspace( d, i ) * product( d, j );
+        }
+        projected( i, j ) = currSum;
+      }
+    }
+    vnl_symmetric_eigensystem_compute( projected, ritzVectors, ritzValues );
+
+    // Converged when the top Ritz values stop changing
+    double maxChange = 0.0;
+    double scale = std::abs( ritzValues( subspaceSize - 1 ) );
+    for ( int o = 0; o < numComp; o++ )
+    {
+      double currRitzValue = ritzValues( subspaceSize - 1 - o );
+      maxChange = std::max( maxChange, std::abs( currRitzValue - previousRitzValues[ o ] ) );
+      previousRitzValues[ o ] = currRitzValue;
+    }
+    if ( iteration > 0 && maxChange <= CONVERGENCE_TOLERANCE * scale )
+    {
+      break;
+    }
+  }
+
+  // Rotate the subspace onto the Ritz vectors (ascending order, so reverse)
+  topEigenvectors.set_size( dimension, numComp );
+  for ( int o = 0; o < numComp; o++ )
+  {
+    int ritzIndex = subspaceSize - 1 - o;
+    for ( int d = 0; d < dimension; d++ )
+    {
+      double currSum = 0.0;
+      for ( int j = 0; j < subspaceSize; j++ )
+      {
+        currSum += subspace( d, j ) * ritzVectors( j, ritzIndex );
+      }
+      topEigenvectors( d, o ) = currSum;
+    }
+  }
+}
+
+
+void vtkWorkflowFeatureMatrix
+::MultiplyMatrices( vnl_matrix< double >& left, vnl_matrix< double >& right, vnl_matrix< double >& product )
+{
+  for ( int i = 0; i < left.rows(); i++ )
+  {
+    for ( int j = 0; j < right.cols(); j++ )
+    {
+      product( i, j ) = 0.0;
+    }
+    for ( int k = 0; k < left.cols(); k++ )
+    {
+      double currLeft = left( i, k );
+      for ( int j = 0; j < right.cols(); j++ )
+      {
+        product( i, j ) += currLeft * right( k, j );
+      }
+    }
+  }
+}
+
+
+// Modified Gram-Schmidt on the columns
+void vtkWorkflowFeatureMatrix
+::Orthonormalize( vnl_matrix< double >& columns )
+{
+  for ( int j = 0; j < columns.cols(); j++ )
+  {
+    for ( int k = 0; k < j; k++ )
+    {
+      double currDot = 0.0;
+      for ( int d = 0; d < columns.rows(); d++ )
+      {
+        currDot += columns( d, j ) * columns( d, k );
+      }
+      for ( int d = 0; d < columns.rows(); d++ )
+      {
+        columns( d, j ) -= currDot * columns( d, k );
+      }
+    }
+
+    double currNorm = 0.0;
+    for ( int d = 0; d < columns.rows(); d++ )
+    {
+      currNorm += columns( d, j ) * columns( d, j );
+    }
+    currNorm = sqrt( currNorm );
+
+    // If the column has collapsed (i.e. rank deficient), just leave it as zero
+    for ( int d = 0; d < columns.rows(); d++ )
+    {
+      columns( d, j ) = ( currNorm > 0 ) ? ( columns( d, j ) / currNorm ) : 0.0;
+    }
+  }
+}
+
+
+void vtkWorkflowFeatureMatrix
+::TransformByPrincipalComponents( vtkDoubleArray* prinComps, vtkDoubleArray* meanArray )
+{
+  int numberOfFrames = this->GetNumberOfFrames();
+  int numPrinComps = prinComps->GetNumberOfTuples();
+  if ( prinComps->GetNumberOfComponents() != this->NumberOfComponents || meanArray->GetNumberOfComponents() != this->NumberOfComponents )
+  {
+    vtkWarningMacro( "vtkWorkflowFeatureMatrix::TransformByPrincipalComponents: Principal components are incompatible with the features." );
+    return;
+  }
+
+  std::vector< double > meanSubtracted( this->NumberOfComponents );
+  std::vector< double > transformedValues( numberOfFrames * numPrinComps, 0.0 );
+  for ( int i = 0; i < numberOfFrames; i++ )
+  {
+    const double* currFrame = this->GetFrame( i );
+    for ( int d = 0; d < this->NumberOfComponents; d++ )
+    {
+      meanSubtracted[ d ] = currFrame[ d ] - meanArray->GetComponent( 0, d );
+    }
+
+    // Iterate over all dimensions, and perform the transformation (i.e. vector multiplication)
+    for ( int o = 0; o < numPrinComps; o++ )
+    {
+      const double* currPrinComp = prinComps->GetPointer( o * this->NumberOfComponents );
+      double currSum = 0.0;
+      for ( int d = 0; d < this->NumberOfComponents; d++ )
+      {
+        currSum += meanSubtracted[ d ] * currPrinComp[ d ];
+      }
+      transformedValues[ i * numPrinComps + o ] = currSum;
+    }
+  }
+
+  this->Values.swap( transformedValues );
+  this->NumberOfComponents = numPrinComps;
+}
+
+
+void vtkWorkflowFeatureMatrix
+::fwdkmeans( int numClusters, vtkDoubleArray* centroids )
+{
+  vtkSmartPointer< vtkWorkflowKMeans > kmeans = vtkSmartPointer< vtkWorkflowKMeans >::New();
+  kmeans->SetPoints( this->GetValues(), this->GetNumberOfFrames(), this->NumberOfComponents );
+  kmeans->fwdkmeans( numClusters, centroids );
+}
+
+
+void vtkWorkflowFeatureMatrix
+::fwdkmeansTransform( vtkDoubleArray* centroids )
+{
+  // Calculate closest centroids
+  std::vector< int > membership;
+  vtkSmartPointer< vtkWorkflowKMeans > kmeans = vtkSmartPointer< vtkWorkflowKMeans >::New();
+  kmeans->SetPoints( this->GetValues(), this->GetNumberOfFrames(), this->NumberOfComponents );
+  kmeans->AssignNearest( centroids, membership );
+
+  this->NumberOfComponents = 1;
+  this->Values.assign( membership.begin(), membership.end() );
+}
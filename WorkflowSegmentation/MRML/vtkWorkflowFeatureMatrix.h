@@ -0,0 +1,155 @@
+#ifndef __vtkWorkflowFeatureMatrix_h
+#define __vtkWorkflowFeatureMatrix_h
+
+// Standard includes
+#include <string>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+#include "vtkSmartPointer.h"
+#include "vtkDoubleArray.h"
+#include "vtkSMPTools.h"
+
+// VNL includes
+#include "vnl/vnl_matrix.h"
+#include "vnl/algo/vnl_symmetric_eigensystem.h"
+
+// Workflow Segmentation includes
+#include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
+#include "vtkWorkflowLegendreKernel.h"
+#include "vtkWorkflowKMeans.h"
+#include "vtkWorkflowSequenceView.h"
+
+
+// This class stores a dense frames-by-components matrix of feature values, row-major
+// Each frame also has a numeric time stamp and a (message) label
+// All of the workflow segmentation math is done on this, so we do not have to go through one MRML node per frame
+class VTK_SLICER_WORKFLOWSEGMENTATION_MODULE_MRML_EXPORT
+vtkWorkflowFeatureMatrix : public vtkObject
+{
+public:
+  vtkTypeMacro( vtkWorkflowFeatureMatrix, vtkObject );
+
+  // Standard VTK methods
+  static vtkWorkflowFeatureMatrix* New();
+
+protected:
+
+  // Constructor/destructor
+  vtkWorkflowFeatureMatrix();
+  virtual ~vtkWorkflowFeatureMatrix();
+
+public:
+
+  void Copy( vtkWorkflowFeatureMatrix* otherMatrix );
+
+  // Size of the matrix (this discards the current values)
+  void Initialize( int numberOfFrames, int numberOfComponents );
+  void Reserve( int numberOfFrames );
+  int GetNumberOfFrames();
+  int GetNumberOfComponents();
+
+  // Access to the frames
+  double* GetFrame( int frame ) { return &this->Values[ frame * this->NumberOfComponents ]; };
+  double GetValue( int frame, int component ) { return this->Values[ frame * this->NumberOfComponents + component ]; };
+  void SetValue( int frame, int component, double value ) { this->Values[ frame * this->NumberOfComponents + component ] = value; };
+  double* GetValues() { return this->Values.empty() ? NULL : &this->Values[ 0 ]; };
+
+  double GetTime( int frame ) { return this->Times[ frame ]; };
+  void SetTime( int frame, double time ) { this->Times[ frame ] = time; };
+  std::vector< double >& GetTimes() { return this->Times; };
+
+  std::string GetLabel( int frame ) { return this->Labels[ frame ]; };
+  void SetLabel( int frame, std::string label ) { this->Labels[ frame ] = label; };
+
+  void AppendFrame( double time, const double* values, std::string label );
+
+  void GetFrameAsDoubleArray( int frame, vtkDoubleArray* doubleArray );
+
+  // Methods explicitly for workflow segmentation
+  void GetSubmatrix( int startFrame, int endFrame, vtkWorkflowFeatureMatrix* submatrix );
+  void GetLabelledSubmatrix( std::vector< std::string > labels, vtkWorkflowFeatureMatrix* submatrix );
+  // Views do not copy anything (use these unless a copy is really needed)
+  vtkWorkflowSequenceView GetSubmatrixView( int startFrame, int endFrame );
+  vtkWorkflowSequenceView GetLabelledSubmatrixView( std::vector< std::string > labels );
+
+  void Concatenate( vtkWorkflowFeatureMatrix* otherMatrix, bool enforceUniqueTimes = false );
+  // Concatenating many matrices at once only copies each frame once
+  void Concatenate( std::vector< vtkWorkflowFeatureMatrix* > otherMatrices, bool enforceUniqueTimes = false );
+  void Concatenate( std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > >& otherMatrices, bool enforceUniqueTimes = false );
+  void ConcatenateValues( vtkWorkflowFeatureMatrix* otherMatrix );
+  void ConcatenateValues( vtkDoubleArray* doubleArray );
+  void PadStart( int window );
+
+  void Mean( vtkDoubleArray* meanArray );
+
+  void Distances( vtkDoubleArray* testPoints, vtkDoubleArray* distances );
+  void SquaredDistances( vtkDoubleArray* testPoints, vtkDoubleArray* distances );
+
+  void Differentiate( int order = 1 );
+  void Integrate( vtkDoubleArray* integration );
+
+  // These are the main steps in the workflow segmentation method
+  enum GaussianFilterMode
+  {
+    DIRECT_FILTER,
+    SLIDING_WINDOW_FILTER,
+  };
+
+  // The sliding window filter gives the same result as the direct filter, but only computes each weight once per frame
+  void GaussianFilter( double width, GaussianFilterMode mode = SLIDING_WINDOW_FILTER );
+
+  void LegendreTransformation( int order, vtkDoubleArray* legendreCoefficients );
+  void OrthogonalTransformation( int window, int order );
+
+  // Only the upper triangle is accumulated, over chunks of frames in parallel
+  void CovarianceMatrix( vnl_matrix< double >& covariance );
+
+  enum PrincipalComponentsMethod
+  {
+    FULL_EIGENSOLVER,
+    TRUNCATED_EIGENSOLVER,
+  };
+
+  // The truncated eigensolver only finds the top eigenvectors (faster if there are many fewer components than dimensions)
+  void CalculatePrincipalComponents( int numComp, vtkDoubleArray* prinComps, PrincipalComponentsMethod method = FULL_EIGENSOLVER );
+  void TransformByPrincipalComponents( vtkDoubleArray* prinComps, vtkDoubleArray* meanArray );
+
+  void fwdkmeans( int numClusters, vtkDoubleArray* centroids );
+  void fwdkmeansTransform( vtkDoubleArray* centroids );
+
+  // Legendre coefficients for an arbitrary (contiguous) block of frames
+  static void LegendreCoefficients( const double* times, const double* values, int numberOfFrames, int numberOfComponents, int order, double* coefficients );
+  static double LegendrePolynomial( double time, int order );
+
+  // Gaussian cutoff (in standard deviations) used by the filters
+  static const double STDEV_CUTOFF;
+  // Number of extra vectors in the subspace for the truncated eigensolver
+  static const int PCA_OVERSAMPLING;
+
+protected:
+
+  void GaussianFilterDirect( double width );
+  void GaussianFilterSlidingWindow( double width );
+  bool IsUniformlySampled( double& deltaTime );
+
+  void TruncatedEigenvectors( vnl_matrix< double >& covariance, int numComp, vnl_matrix< double >& topEigenvectors );
+  static void MultiplyMatrices( vnl_matrix< double >& left, vnl_matrix< double >& right, vnl_matrix< double >& product );
+  static void Orthonormalize( vnl_matrix< double >& columns );
+
+protected:
+
+  int NumberOfComponents;
+  std::vector< double > Values; // NumberOfFrames * NumberOfComponents
+  std::vector< double > Times;
+  std::vector< std::string > Labels;
+
+};
+
+#endif
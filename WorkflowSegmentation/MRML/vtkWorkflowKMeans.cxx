@@ -0,0 +1,469 @@
+
+#include "vtkWorkflowKMeans.h"
+
+// Number of points per chunk for the threaded steps
+static const int KMEANS_CHUNK_SIZE = 1024;
+// Relative slack on the bounds, so round-off can never cause a point to be wrongly skipped
+static const double BOUND_TOLERANCE = 1e-9;
+
+vtkStandardNewMacro( vtkWorkflowKMeans );
+
+
+// Helper for running the chunks in parallel
+class vtkWorkflowKMeansFunctor
+{
+public:
+  vtkWorkflowKMeans* KMeans;
+  vtkWorkflowKMeans::ChunkTask Task;
+
+  void operator()( vtkIdType beginChunk, vtkIdType endChunk )
+  {
+    for ( vtkIdType c = beginChunk; c < endChunk; c++ )
+    {
+      if ( this->Task == vtkWorkflowKMeans::UPDATE_MEMBERSHIP_TASK )
+      {
+        this->KMeans->UpdateMembershipChunk( c );
+      }
+      if ( this->Task == vtkWorkflowKMeans::MINIMUM_DISTANCES_TASK )
+      {
+        this->KMeans->MinimumDistancesChunk( c );
+      }
+    }
+  }
+};
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkWorkflowKMeans
+::vtkWorkflowKMeans()
+{
+  this->NumberOfPoints = 0;
+  this->NumberOfComponents = 0;
+  this->NumberOfCentroids = 0;
+  this->BoundsValid = false;
+}
+
+
+vtkWorkflowKMeans
+::~vtkWorkflowKMeans()
+{
+  // Vectors take care of themselves
+}
+
+
+void vtkWorkflowKMeans
+::SetPoints( const double* points, int numberOfPoints, int numberOfComponents )
+{
+  this->PointPointers.resize( numberOfPoints );
+  for ( int i = 0; i < numberOfPoints; i++ )
+  {
+    this->PointPointers[ i ] = points + i * numberOfComponents;
+  }
+  this->InitializePoints( numberOfComponents );
+}
+
+
+void vtkWorkflowKMeans
+::SetPoints( vtkWorkflowSequenceView& view )
+{
+  int numberOfComponents = view.GetNumberOfComponents();
+  this->PointPointers.resize( view.GetNumberOfFrames() );
+  for ( int i = 0; i < view.GetNumberOfFrames(); i++ )
+  {
+    this->PointPointers[ i ] = view.GetFrame( i );
+    if ( this->PointPointers[ i ] == NULL )
+    {
+      vtkWarningMacro( "vtkWorkflowKMeans::SetPoints: Frame " << i << " of the view is not a double array. Cannot cluster." );
+      this->PointPointers.clear();
+      break;
+    }
+  }
+  this->InitializePoints( numberOfComponents );
+}
+
+
+void vtkWorkflowKMeans
+::InitializePoints( int numberOfComponents )
+{
+  int numberOfPoints = this->PointPointers.size();
+  this->NumberOfPoints = numberOfPoints;
+  this->NumberOfComponents = numberOfComponents;
+
+  this->Membership.assign( numberOfPoints, 0 );
+  this->UpperBounds.assign( numberOfPoints, 0.0 );
+  this->LowerBounds.assign( numberOfPoints, 0.0 );
+  this->MinimumDistances.assign( numberOfPoints, 0.0 );
+  this->ChunkChanges.assign( ( numberOfPoints + KMEANS_CHUNK_SIZE - 1 ) / KMEANS_CHUNK_SIZE, 0 );
+  this->BoundsValid = false;
+}
+
+
+// Clustering --------------------------------------------------------------------------------------
+
+void vtkWorkflowKMeans
+::fwdkmeans( int numClusters, vtkDoubleArray* centroids )
+{
+  this->NumberOfCentroids = 0;
+  this->Centroids.clear();
+  this->Membership.assign( this->NumberOfPoints, 0 );
+  this->BoundsValid = false;
+
+  // Iterate until all of the clusters have been added
+  for ( int k = 0; k < numClusters; k++ )
+  {
+    // Use the mean of all points for the first centroid
+    if ( k == 0 )
+    {
+      std::vector< double > initialCentroid( this->NumberOfComponents, 0.0 );
+      for ( int i = 0; i < this->NumberOfPoints; i++ )
+      {
+        const double* currPoint = this->PointPointers[ i ];
+        for ( int d = 0; d < this->NumberOfComponents; d++ )
+        {
+          initialCentroid[ d ] += currPoint[ d ];
+        }
+      }
+      for ( int d = 0; d < this->NumberOfComponents && this->NumberOfPoints > 0; d++ )
+      {
+        initialCentroid[ d ] = initialCentroid[ d ] / this->NumberOfPoints;
+      }
+      this->Centroids.insert( this->Centroids.end(), initialCentroid.begin(), initialCentroid.end() );
+      this->NumberOfCentroids++;
+      continue;
+    }
+
+    std::vector< double > nextCentroid;
+    this->FindNextCentroid( nextCentroid );
+    this->Centroids.insert( this->Centroids.end(), nextCentroid.begin(), nextCentroid.end() );
+    this->NumberOfCentroids++;
+    this->BoundsValid = false;
+
+    // Iterate until there are no more changes in membership and no clusters are empty
+    while ( true )
+    {
+      // Reassign the cluster memberships, and calculate change
+      if ( ! this->UpdateMembership() )
+      {
+        break;
+      }
+
+      // Remove emptiness
+      std::vector< bool > emptyVector = this->FindEmptyClusters();
+      bool hasEmptyClusters = false;
+      for ( int c = 0; c < emptyVector.size(); c++ )
+      {
+        hasEmptyClusters = hasEmptyClusters || emptyVector.at( c );
+      }
+      if ( hasEmptyClusters )
+      {
+        this->MoveEmptyClusters( emptyVector );
+        // At the end of this, we are guaranteed no empty clusters
+        continue;
+      }
+
+      // Recalculate centroids
+      this->RecalculateCentroids();
+    }
+  }
+
+  centroids->SetNumberOfComponents( this->NumberOfComponents );
+  centroids->SetNumberOfTuples( this->NumberOfCentroids );
+  for ( int c = 0; c < this->NumberOfCentroids; c++ )
+  {
+    centroids->SetTypedTuple( c, &this->Centroids[ c * this->NumberOfComponents ] );
+  }
+}
+
+
+void vtkWorkflowKMeans
+::AssignNearest( vtkDoubleArray* centroids, std::vector< int >& membership )
+{
+  this->NumberOfCentroids = 0;
+  this->Centroids.clear();
+  if ( centroids != NULL && centroids->GetNumberOfComponents() == this->NumberOfComponents )
+  {
+    this->NumberOfCentroids = centroids->GetNumberOfTuples();
+    this->Centroids.assign( centroids->GetPointer( 0 ), centroids->GetPointer( 0 ) + this->NumberOfCentroids * this->NumberOfComponents );
+  }
+
+  this->Membership.assign( this->NumberOfPoints, 0 );
+  this->BoundsValid = false;
+  this->UpdateMembership();
+
+  membership = this->Membership;
+}
+
+
+// Helpers -----------------------------------------------------------------------------------------
+
+double vtkWorkflowKMeans
+::SquaredDistance( const double* point1, const double* point2 )
+{
+  double currSum = 0.0;
+  for ( int d = 0; d < this->NumberOfComponents; d++ )
+  {
+    double currDiff = point1[ d ] - point2[ d ];
+    currSum += currDiff * currDiff;
+  }
+  return currSum;
+}
+
+
+void vtkWorkflowKMeans
+::RunChunks( ChunkTask task )
+{
+  vtkWorkflowKMeansFunctor kmeansFunctor;
+  kmeansFunctor.KMeans = this;
+  kmeansFunctor.Task = task;
+  vtkSMPTools::For( 0, this->ChunkChanges.size(), 1, kmeansFunctor );
+}
+
+
+// The point farthest from any centroid (the first such point if there are ties)
+void vtkWorkflowKMeans
+::FindNextCentroid( std::vector< double >& nextCentroid )
+{
+  nextCentroid.assign( this->NumberOfComponents, 0.0 );
+  if ( this->NumberOfPoints == 0 )
+  {
+    return;
+  }
+
+  this->RunChunks( MINIMUM_DISTANCES_TASK );
+
+  int candidatePoint = 0;
+  double candidateDistance = 0;
+  for ( int i = 0; i < this->NumberOfPoints; i++ )
+  {
+    // Maximum of the minimums
+    if ( this->MinimumDistances[ i ] > candidateDistance )
+    {
+      candidateDistance = this->MinimumDistances[ i ];
+      candidatePoint = i;
+    }
+  }
+
+  const double* candidate = this->PointPointers[ candidatePoint ];
+  nextCentroid.assign( candidate, candidate + this->NumberOfComponents );
+}
+
+
+void vtkWorkflowKMeans
+::MinimumDistancesChunk( int chunk )
+{
+  int endPoint = std::min( ( chunk + 1 ) * KMEANS_CHUNK_SIZE, this->NumberOfPoints );
+  for ( int i = chunk * KMEANS_CHUNK_SIZE; i < endPoint; i++ )
+  {
+    const double* currPoint = this->PointPointers[ i ];
+    double currMinDist = std::numeric_limits< double >::max();
+    for ( int c = 0; c < this->NumberOfCentroids; c++ )
+    {
+      double currDist = this->SquaredDistance( currPoint, &this->Centroids[ c * this->NumberOfComponents ] );
+      if ( currDist < currMinDist )
+      {
+        currMinDist = currDist;
+      }
+    }
+    this->MinimumDistances[ i ] = currMinDist;
+  }
+}
+
+
+// Half the distance from each centroid to its closest other centroid
+void vtkWorkflowKMeans
+::UpdateSeparations()
+{
+  this->CentroidSeparations.assign( this->NumberOfCentroids, std::numeric_limits< double >::max() );
+  for ( int c1 = 0; c1 < this->NumberOfCentroids; c1++ )
+  {
+    for ( int c2 = c1 + 1; c2 < this->NumberOfCentroids; c2++ )
+    {
+      double currSeparation = sqrt( this->SquaredDistance( &this->Centroids[ c1 * this->NumberOfComponents ], &this->Centroids[ c2 * this->NumberOfComponents ] ) ) / 2;
+      this->CentroidSeparations[ c1 ] = std::min( this->CentroidSeparations[ c1 ], currSeparation );
+      this->CentroidSeparations[ c2 ] = std::min( this->CentroidSeparations[ c2 ], currSeparation );
+    }
+  }
+}
+
+
+// Returns whether any membership has changed
+bool vtkWorkflowKMeans
+::UpdateMembership()
+{
+  if ( this->NumberOfCentroids == 0 )
+  {
+    return false;
+  }
+
+  if ( this->BoundsValid )
+  {
+    this->UpdateSeparations();
+  }
+
+  this->RunChunks( UPDATE_MEMBERSHIP_TASK );
+  this->BoundsValid = true; // Every point's bounds are now with respect to the current centroids
+
+  int numberOfChanges = 0;
+  for ( int c = 0; c < this->ChunkChanges.size(); c++ )
+  {
+    numberOfChanges += this->ChunkChanges[ c ];
+  }
+  return ( numberOfChanges > 0 );
+}
+
+
+void vtkWorkflowKMeans
+::UpdateMembershipChunk( int chunk )
+{
+  int numberOfChanges = 0;
+  int endPoint = std::min( ( chunk + 1 ) * KMEANS_CHUNK_SIZE, this->NumberOfPoints );
+  for ( int i = chunk * KMEANS_CHUNK_SIZE; i < endPoint; i++ )
+  {
+    const double* currPoint = this->PointPointers[ i ];
+    int currCentroid = this->Membership[ i ];
+
+    // The assigned centroid is strictly closest if it is closer than the second closest bound, or half way to any other centroid
+    if ( this->BoundsValid )
+    {
+      double bound = std::max( this->LowerBounds[ i ], this->CentroidSeparations[ currCentroid ] ) * ( 1 - BOUND_TOLERANCE );
+      if ( this->UpperBounds[ i ] * ( 1 + BOUND_TOLERANCE ) < bound )
+      {
+        continue;
+      }
+
+      // Tighten the upper bound, and try again
+      this->UpperBounds[ i ] = sqrt( this->SquaredDistance( currPoint, &this->Centroids[ currCentroid * this->NumberOfComponents ] ) );
+      if ( this->UpperBounds[ i ] * ( 1 + BOUND_TOLERANCE ) < bound )
+      {
+        continue;
+      }
+    }
+
+    // Otherwise, check all centroids
+    double currMinDist = std::numeric_limits< double >::max();
+    double currSecondDist = std::numeric_limits< double >::max();
+    int currMinCentroid = 0;
+    for ( int c = 0; c < this->NumberOfCentroids; c++ )
+    {
+      double currDist = this->SquaredDistance( currPoint, &this->Centroids[ c * this->NumberOfComponents ] );
+      if ( currDist < currMinDist )
+      {
+        currSecondDist = currMinDist;
+        currMinDist = currDist;
+        currMinCentroid = c;
+      }
+      else if ( currDist < currSecondDist )
+      {
+        currSecondDist = currDist;
+      }
+    }
+
+    this->UpperBounds[ i ] = sqrt( currMinDist );
+    this->LowerBounds[ i ] = sqrt( currSecondDist );
+    if ( currMinCentroid != currCentroid )
+    {
+      this->Membership[ i ] = currMinCentroid;
+      numberOfChanges++;
+    }
+  }
+
+  this->ChunkChanges[ chunk ] = numberOfChanges;
+}
+
+
+std::vector< bool > vtkWorkflowKMeans
+::FindEmptyClusters()
+{
+  std::vector< bool > emptyVector( this->NumberOfCentroids, true );
+
+  // Calculate the empty clusters
+  for ( int i = 0; i < this->NumberOfPoints; i++ )
+  {
+    emptyVector.at( this->Membership[ i ] ) = false;
+  }
+
+  return emptyVector;
+}
+
+
+void vtkWorkflowKMeans
+::MoveEmptyClusters( std::vector< bool >& emptyVector )
+{
+  // Remove any emptyness (does this inline)
+  for ( int c = 0; c < this->NumberOfCentroids; c++ )
+  {
+    if ( emptyVector.at( c ) == false )
+    {
+      continue;
+    }
+
+    std::vector< double > nextCentroid;
+    this->FindNextCentroid( nextCentroid );
+    std::copy( nextCentroid.begin(), nextCentroid.end(), &this->Centroids[ c * this->NumberOfComponents ] ); // Overwrites the centroid at that cluster number
+  }
+
+  // The centroids have jumped, so the bounds are no good
+  this->BoundsValid = false;
+}
+
+
+void vtkWorkflowKMeans
+::RecalculateCentroids()
+{
+  // Initialize (we need to reset everything anyway)
+  std::vector< double > centroidSums( this->NumberOfCentroids * this->NumberOfComponents, 0.0 );
+  std::vector< int > memberCount( this->NumberOfCentroids, 0 );
+
+  // Iterate over all points (in order, so the sums are deterministic)
+  for ( int i = 0; i < this->NumberOfPoints; i++ )
+  {
+    const double* currPoint = this->PointPointers[ i ];
+    double* currCentroidSum = &centroidSums[ this->Membership[ i ] * this->NumberOfComponents ];
+    for ( int d = 0; d < this->NumberOfComponents; d++ )
+    {
+      currCentroidSum[ d ] += currPoint[ d ];
+    }
+
+    memberCount.at( this->Membership[ i ] )++;
+  }
+
+  // Divide by the number of points in the cluster to get the mean, and keep track of how far each centroid moved
+  this->CentroidShifts.assign( this->NumberOfCentroids, 0.0 );
+  int maxShiftCentroid = 0;
+  double maxShift = 0.0;
+  double secondMaxShift = 0.0;
+  for ( int c = 0; c < this->NumberOfCentroids; c++ )
+  {
+    double* currCentroid = &this->Centroids[ c * this->NumberOfComponents ];
+    for ( int d = 0; d < this->NumberOfComponents; d++ )
+    {
+      centroidSums[ c * this->NumberOfComponents + d ] = centroidSums[ c * this->NumberOfComponents + d ] / memberCount.at( c );
+    }
+    this->CentroidShifts[ c ] = sqrt( this->SquaredDistance( currCentroid, &centroidSums[ c * this->NumberOfComponents ] ) );
+    std::copy( &centroidSums[ c * this->NumberOfComponents ], &centroidSums[ c * this->NumberOfComponents ] + this->NumberOfComponents, currCentroid );
+
+    if ( this->CentroidShifts[ c ] > maxShift )
+    {
+      secondMaxShift = maxShift;
+      maxShift = this->CentroidShifts[ c ];
+      maxShiftCentroid = c;
+    }
+    else if ( this->CentroidShifts[ c ] > secondMaxShift )
+    {
+      secondMaxShift = this->CentroidShifts[ c ];
+    }
+  }
+
+  // Loosen the bounds by how far the centroids moved
+  if ( ! this->BoundsValid )
+  {
+    return;
+  }
+  for ( int i = 0; i < this->NumberOfPoints; i++ )
+  {
+    int currCentroid = this->Membership[ i ];
+    this->UpperBounds[ i ] += this->CentroidShifts[ currCentroid ];
+    this->LowerBounds[ i ] -= ( currCentroid == maxShiftCentroid ) ? secondMaxShift : maxShift;
+  }
+}
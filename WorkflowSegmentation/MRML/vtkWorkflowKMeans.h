@@ -0,0 +1,99 @@
+#ifndef __vtkWorkflowKMeans_h
+#define __vtkWorkflowKMeans_h
+
+// Standard includes
+#include <vector>
+#include <cmath>
+#include <limits>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+#include "vtkDoubleArray.h"
+#include "vtkSMPTools.h"
+
+// Workflow Segmentation includes
+#include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
+#include "vtkWorkflowSequenceView.h"
+
+
+// This class does the k-means clustering for workflow segmentation on a contiguous (row-major) matrix of points, or a view of the frames of a sequence
+// It uses the same deterministic "forward" k-means as before: start at the mean, add the farthest point as each new centroid
+// The assignment step is multi-threaded, and Hamerly's bounds are used to skip most of the distance calculations
+// The results are the same as the brute-force assignment, because points are only skipped when their centroid is strictly closest
+class VTK_SLICER_WORKFLOWSEGMENTATION_MODULE_MRML_EXPORT
+vtkWorkflowKMeans : public vtkObject
+{
+public:
+  vtkTypeMacro( vtkWorkflowKMeans, vtkObject );
+
+  // Standard VTK methods
+  static vtkWorkflowKMeans* New();
+
+protected:
+
+  // Constructor/destructor
+  vtkWorkflowKMeans();
+  virtual ~vtkWorkflowKMeans();
+
+public:
+
+  // The points are not copied, so they must outlive the clustering
+  void SetPoints( const double* points, int numberOfPoints, int numberOfComponents );
+  void SetPoints( vtkWorkflowSequenceView& view );
+
+  void fwdkmeans( int numClusters, vtkDoubleArray* centroids );
+
+  // Brute-force assignment of each point to its closest centroid (ties go to the lowest centroid)
+  void AssignNearest( vtkDoubleArray* centroids, std::vector< int >& membership );
+
+protected:
+
+  // The threaded steps work on chunks of points
+  friend class vtkWorkflowKMeansFunctor;
+  enum ChunkTask
+  {
+    UPDATE_MEMBERSHIP_TASK,
+    MINIMUM_DISTANCES_TASK,
+  };
+  void RunChunks( ChunkTask task );
+  void UpdateMembershipChunk( int chunk );
+  void MinimumDistancesChunk( int chunk );
+
+  void InitializePoints( int numberOfComponents );
+
+  double SquaredDistance( const double* point1, const double* point2 );
+
+  void FindNextCentroid( std::vector< double >& nextCentroid );
+  void UpdateSeparations();
+  bool UpdateMembership();
+  std::vector< bool > FindEmptyClusters();
+  void MoveEmptyClusters( std::vector< bool >& emptyVector );
+  void RecalculateCentroids();
+
+protected:
+
+  std::vector< const double* > PointPointers; // One per point, so the points do not need to be contiguous
+  int NumberOfPoints;
+  int NumberOfComponents;
+
+  // Current state
+  int NumberOfCentroids;
+  std::vector< double > Centroids;
+  std::vector< int > Membership;
+
+  // Hamerly's bounds
+  bool BoundsValid;
+  std::vector< double > UpperBounds; // Distance to the assigned centroid
+  std::vector< double > LowerBounds; // Distance to the second closest centroid
+  std::vector< double > CentroidShifts;
+  std::vector< double > CentroidSeparations; // Half the distance to the closest other centroid
+
+  // Per-chunk results from the threaded functors (reduced in order)
+  std::vector< int > ChunkChanges;
+  std::vector< double > MinimumDistances;
+
+};
+
+#endif
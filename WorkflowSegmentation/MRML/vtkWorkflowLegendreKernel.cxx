@@ -0,0 +1,232 @@
+
+#include "vtkWorkflowLegendreKernel.h"
+#include "vtkWorkflowFeatureMatrix.h"
+
+// Two windows are considered to have the same geometry if their adjusted times (range -1 to 1) agree to this
+static const double GEOMETRY_TOLERANCE = 1e-12;
+
+vtkStandardNewMacro( vtkWorkflowLegendreKernel );
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkWorkflowLegendreKernel
+::vtkWorkflowLegendreKernel()
+{
+  this->NumberOfFrames = 0;
+  this->Order = 0;
+  this->NumberOfComponents = 0;
+  this->WeightsValid = false;
+  this->BufferStart = 0;
+  this->NumberOfBufferedFrames = 0;
+}
+
+
+vtkWorkflowLegendreKernel
+::~vtkWorkflowLegendreKernel()
+{
+  // Vectors take care of themselves
+}
+
+
+void vtkWorkflowLegendreKernel
+::Initialize( int numberOfFrames, int order, int numberOfComponents )
+{
+  if ( numberOfFrames == this->NumberOfFrames && order == this->Order && numberOfComponents == this->NumberOfComponents )
+  {
+    return;
+  }
+
+  this->NumberOfFrames = numberOfFrames;
+  this->Order = order;
+  this->NumberOfComponents = numberOfComponents;
+
+  this->Weights.assign( ( order + 1 ) * numberOfFrames, 0.0 );
+  this->AdjustedTimes.assign( numberOfFrames, 0.0 );
+  this->WeightsValid = false;
+
+  this->BufferTimes.assign( numberOfFrames, 0.0 );
+  this->BufferValues.assign( numberOfFrames * numberOfComponents, 0.0 );
+  this->OrderedTimes.assign( numberOfFrames, 0.0 );
+  this->ScratchAdjustedTimes.assign( numberOfFrames, 0.0 );
+  this->ClearFrames();
+}
+
+
+// Coefficients ------------------------------------------------------------------------------------
+
+// The trapezoidal rule on ( x * P )( s ) is sum_k w_k * P( s_k ) * x_k, where w_k is half the sum of the intervals adjacent to s_k
+bool vtkWorkflowLegendreKernel
+::UpdateWeights( const double* times )
+{
+  if ( this->NumberOfFrames < 1 )
+  {
+    return false;
+  }
+
+  // Calculate the time adjustment (need range -1 to 1)
+  double startTime = times[ 0 ];
+  double timeRange = times[ this->NumberOfFrames - 1 ] - startTime;
+  if ( timeRange <= 0 )
+  {
+    return false;
+  }
+
+  bool sameGeometry = this->WeightsValid;
+  for ( int k = 0; k < this->NumberOfFrames; k++ )
+  {
+    this->ScratchAdjustedTimes[ k ] = 2 * ( times[ k ] - startTime ) / timeRange - 1;
+    if ( std::abs( this->ScratchAdjustedTimes[ k ] - this->AdjustedTimes[ k ] ) > GEOMETRY_TOLERANCE )
+    {
+      sameGeometry = false;
+    }
+  }
+  if ( sameGeometry )
+  {
+    return true;
+  }
+
+  this->AdjustedTimes.swap( this->ScratchAdjustedTimes );
+  for ( int k = 0; k < this->NumberOfFrames; k++ )
+  {
+    double trapezoidWeight = 0.0;
+    if ( k > 0 )
+    {
+      trapezoidWeight += ( this->AdjustedTimes[ k ] - this->AdjustedTimes[ k - 1 ] ) / 2;
+    }
+    if ( k < this->NumberOfFrames - 1 )
+    {
+      trapezoidWeight += ( this->AdjustedTimes[ k + 1 ] - this->AdjustedTimes[ k ] ) / 2;
+    }
+
+    for ( int o = 0; o <= this->Order; o++ )
+    {
+      this->Weights[ o * this->NumberOfFrames + k ] = trapezoidWeight * vtkWorkflowFeatureMatrix::LegendrePolynomial( this->AdjustedTimes[ k ], o );
+    }
+  }
+  this->WeightsValid = true;
+
+  return true;
+}
+
+
+bool vtkWorkflowLegendreKernel
+::CalculateCoefficients( const double* times, const double* values, double* coefficients )
+{
+  std::fill( coefficients, coefficients + this->GetNumberOfCoefficients(), 0.0 );
+  if ( ! this->UpdateWeights( times ) )
+  {
+    return false;
+  }
+
+  for ( int o = 0; o <= this->Order; o++ )
+  {
+    const double* currWeights = &this->Weights[ o * this->NumberOfFrames ];
+    double* currCoefficients = coefficients + o * this->NumberOfComponents;
+    for ( int k = 0; k < this->NumberOfFrames; k++ )
+    {
+      const double* currValues = values + k * this->NumberOfComponents;
+      for ( int d = 0; d < this->NumberOfComponents; d++ )
+      {
+        currCoefficients[ d ] += currWeights[ k ] * currValues[ d ];
+      }
+    }
+  }
+
+  return true;
+}
+
+
+// Ring buffer -------------------------------------------------------------------------------------
+
+void vtkWorkflowLegendreKernel
+::ClearFrames()
+{
+  this->BufferStart = 0;
+  this->NumberOfBufferedFrames = 0;
+}
+
+
+// Overwrites the oldest frame once the buffer is full
+void vtkWorkflowLegendreKernel
+::AddFrame( double time, const double* values )
+{
+  if ( this->NumberOfFrames < 1 )
+  {
+    return;
+  }
+
+  int bufferFrame = ( this->BufferStart + this->NumberOfBufferedFrames ) % this->NumberOfFrames;
+  if ( this->NumberOfBufferedFrames == this->NumberOfFrames )
+  {
+    this->BufferStart = ( this->BufferStart + 1 ) % this->NumberOfFrames;
+  }
+  else
+  {
+    this->NumberOfBufferedFrames++;
+  }
+
+  this->BufferTimes[ bufferFrame ] = time;
+  std::copy( values, values + this->NumberOfComponents, &this->BufferValues[ bufferFrame * this->NumberOfComponents ] );
+}
+
+
+double vtkWorkflowLegendreKernel
+::GetOldestTime()
+{
+  if ( this->NumberOfBufferedFrames == 0 )
+  {
+    return 0.0;
+  }
+
+  return this->BufferTimes[ this->BufferStart ];
+}
+
+
+double vtkWorkflowLegendreKernel
+::GetLatestTime()
+{
+  if ( this->NumberOfBufferedFrames == 0 )
+  {
+    return 0.0;
+  }
+
+  return this->BufferTimes[ ( this->BufferStart + this->NumberOfBufferedFrames - 1 ) % this->NumberOfFrames ];
+}
+
+
+// Only works when the buffer is full
+bool vtkWorkflowLegendreKernel
+::CalculateCoefficients( double* coefficients )
+{
+  std::fill( coefficients, coefficients + this->GetNumberOfCoefficients(), 0.0 );
+  if ( this->NumberOfBufferedFrames < this->NumberOfFrames )
+  {
+    return false;
+  }
+
+  for ( int k = 0; k < this->NumberOfFrames; k++ )
+  {
+    this->OrderedTimes[ k ] = this->BufferTimes[ ( this->BufferStart + k ) % this->NumberOfFrames ];
+  }
+  if ( ! this->UpdateWeights( &this->OrderedTimes[ 0 ] ) )
+  {
+    return false;
+  }
+
+  for ( int k = 0; k < this->NumberOfFrames; k++ )
+  {
+    const double* currValues = &this->BufferValues[ ( ( this->BufferStart + k ) % this->NumberOfFrames ) * this->NumberOfComponents ];
+    for ( int o = 0; o <= this->Order; o++ )
+    {
+      double currWeight = this->Weights[ o * this->NumberOfFrames + k ];
+      double* currCoefficients = coefficients + o * this->NumberOfComponents;
+      for ( int d = 0; d < this->NumberOfComponents; d++ )
+      {
+        currCoefficients[ d ] += currWeight * currValues[ d ];
+      }
+    }
+  }
+
+  return true;
+}
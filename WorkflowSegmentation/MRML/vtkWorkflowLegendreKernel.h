@@ -0,0 +1,86 @@
+#ifndef __vtkWorkflowLegendreKernel_h
+#define __vtkWorkflowLegendreKernel_h
+
+// Standard includes
+#include <vector>
+#include <cmath>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+
+// Workflow Segmentation includes
+#include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
+
+
+// This class calculates the Legendre coefficients over a window of frames
+// The Legendre polynomials times the trapezoidal rule weights are precomputed for the window's geometry (i.e. relative time stamps),
+// so the coefficients for each window are just a small matrix product (order + 1 by window + 1 times window + 1 by components)
+// The frames can either be passed in contiguously, or added one at a time to the kernel's ring buffer
+class VTK_SLICER_WORKFLOWSEGMENTATION_MODULE_MRML_EXPORT
+vtkWorkflowLegendreKernel : public vtkObject
+{
+public:
+  vtkTypeMacro( vtkWorkflowLegendreKernel, vtkObject );
+
+  // Standard VTK methods
+  static vtkWorkflowLegendreKernel* New();
+
+protected:
+
+  // Constructor/destructor
+  vtkWorkflowLegendreKernel();
+  virtual ~vtkWorkflowLegendreKernel();
+
+public:
+
+  // This clears the ring buffer (nothing happens if the sizes are unchanged)
+  void Initialize( int numberOfFrames, int order, int numberOfComponents );
+
+  int GetNumberOfFrames() { return this->NumberOfFrames; };
+  int GetOrder() { return this->Order; };
+  int GetNumberOfComponents() { return this->NumberOfComponents; };
+  int GetNumberOfCoefficients() { return ( this->Order + 1 ) * this->NumberOfComponents; };
+
+  // The coefficients are ordered by order, then by component
+  // Returns false if the time range is improper (and the coefficients will be zero)
+  bool CalculateCoefficients( const double* times, const double* values, double* coefficients );
+
+  // Ring buffer of the most recent frames
+  void ClearFrames();
+  void AddFrame( double time, const double* values );
+  int GetNumberOfBufferedFrames() { return this->NumberOfBufferedFrames; };
+  double GetOldestTime();
+  double GetLatestTime();
+  bool CalculateCoefficients( double* coefficients );
+
+protected:
+
+  // Recomputes the weights only if the geometry has changed
+  bool UpdateWeights( const double* times );
+
+protected:
+
+  int NumberOfFrames;
+  int Order;
+  int NumberOfComponents;
+
+  // Kernel: ( Order + 1 ) by NumberOfFrames
+  std::vector< double > Weights;
+  std::vector< double > AdjustedTimes;
+  bool WeightsValid;
+
+  // Ring buffer
+  std::vector< double > BufferTimes;
+  std::vector< double > BufferValues;
+  int BufferStart;
+  int NumberOfBufferedFrames;
+
+  // Scratch space, so nothing is allocated per window
+  std::vector< double > OrderedTimes;
+  std::vector< double > ScratchAdjustedTimes;
+
+};
+
+#endif
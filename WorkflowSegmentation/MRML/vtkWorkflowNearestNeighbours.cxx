@@ -0,0 +1,227 @@
+
+#include "vtkWorkflowNearestNeighbours.h"
+
+// Standard includes
+#include <algorithm>
+
+// Constants ---------------------------------------------------------------------------------------
+
+const int vtkWorkflowNearestNeighbours::KDTREE_MIN_POINTS = 256;
+const int vtkWorkflowNearestNeighbours::KDTREE_MAX_COMPONENTS = 16; // KD-trees do not prune well in higher dimensions
+const int vtkWorkflowNearestNeighbours::KDTREE_LEAF_SIZE = 16;
+
+vtkStandardNewMacro( vtkWorkflowNearestNeighbours );
+
+
+// Helper for ordering points by one component
+class vtkWorkflowNearestNeighboursCompare
+{
+public:
+  vtkWorkflowNearestNeighboursCompare( const std::vector< double >& points, int numberOfComponents, int component ) : Points( points ), NumberOfComponents( numberOfComponents ), Component( component ) {};
+  bool operator()( int point1, int point2 ) const { return this->Points[ point1 * this->NumberOfComponents + this->Component ] < this->Points[ point2 * this->NumberOfComponents + this->Component ]; };
+  const std::vector< double >& Points;
+  int NumberOfComponents;
+  int Component;
+};
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkWorkflowNearestNeighbours
+::vtkWorkflowNearestNeighbours()
+{
+  this->NumberOfPoints = 0;
+  this->NumberOfComponents = 0;
+}
+
+
+vtkWorkflowNearestNeighbours
+::~vtkWorkflowNearestNeighbours()
+{
+  // Vectors take care of themselves
+}
+
+
+void vtkWorkflowNearestNeighbours
+::SetPoints( const double* points, int numberOfPoints, int numberOfComponents )
+{
+  this->NumberOfPoints = ( points != NULL ) ? numberOfPoints : 0;
+  this->NumberOfComponents = numberOfComponents;
+  this->Points.assign( points, points + this->NumberOfPoints * numberOfComponents );
+  this->PointIds.resize( this->NumberOfPoints );
+  for ( int i = 0; i < this->NumberOfPoints; i++ )
+  {
+    this->PointIds[ i ] = i;
+  }
+  this->Nodes.clear();
+
+  if ( this->NumberOfPoints < KDTREE_MIN_POINTS || this->NumberOfComponents > KDTREE_MAX_COMPONENTS || this->NumberOfComponents < 1 )
+  {
+    return;
+  }
+
+  // Build the tree on the point ids, then put the points in tree order so each leaf is contiguous
+  this->BuildKDTree( 0, this->NumberOfPoints );
+
+  std::vector< double > treePoints( this->Points.size() );
+  for ( int i = 0; i < this->NumberOfPoints; i++ )
+  {
+    const double* currPoint = &this->Points[ this->PointIds[ i ] * this->NumberOfComponents ];
+    std::copy( currPoint, currPoint + this->NumberOfComponents, &treePoints[ i * this->NumberOfComponents ] );
+  }
+  this->Points.swap( treePoints );
+}
+
+
+// Split on the component with the largest spread, at the median
+int vtkWorkflowNearestNeighbours
+::BuildKDTree( int startPoint, int endPoint )
+{
+  int node = this->Nodes.size();
+  KDTreeNode currNode;
+  currNode.StartPoint = startPoint;
+  currNode.EndPoint = endPoint;
+  currNode.SplitComponent = -1;
+  currNode.SplitValue = 0.0;
+  currNode.LeftChild = -1;
+  currNode.RightChild = -1;
+  this->Nodes.push_back( currNode );
+
+  if ( endPoint - startPoint <= KDTREE_LEAF_SIZE )
+  {
+    return node;
+  }
+
+  int splitComponent = 0;
+  double maxSpread = -1.0;
+  for ( int d = 0; d < this->NumberOfComponents; d++ )
+  {
+    double minValue = std::numeric_limits< double >::max();
+    double maxValue = - std::numeric_limits< double >::max();
+    for ( int i = startPoint; i < endPoint; i++ )
+    {
+      double currValue = this->Points[ this->PointIds[ i ] * this->NumberOfComponents + d ];
+      minValue = std::min( minValue, currValue );
+      maxValue = std::max( maxValue, currValue );
+    }
+    if ( maxValue - minValue > maxSpread )
+    {
+      maxSpread = maxValue - minValue;
+      splitComponent = d;
+    }
+  }
+
+  int middlePoint = ( startPoint + endPoint ) / 2;
+  std::nth_element( this->PointIds.begin() + startPoint, this->PointIds.begin() + middlePoint, this->PointIds.begin() + endPoint,
+    vtkWorkflowNearestNeighboursCompare( this->Points, this->NumberOfComponents, splitComponent ) );
+
+  // Everything left of the middle is no larger than the split value, everything from the middle on is no smaller
+  double splitValue = this->Points[ this->PointIds[ middlePoint ] * this->NumberOfComponents + splitComponent ];
+  int leftChild = this->BuildKDTree( startPoint, middlePoint );
+  int rightChild = this->BuildKDTree( middlePoint, endPoint );
+
+  // Note: The vector may have been reallocated by the children
+  this->Nodes[ node ].SplitComponent = splitComponent;
+  this->Nodes[ node ].SplitValue = splitValue;
+  this->Nodes[ node ].LeftChild = leftChild;
+  this->Nodes[ node ].RightChild = rightChild;
+  return node;
+}
+
+
+// Queries -----------------------------------------------------------------------------------------
+
+int vtkWorkflowNearestNeighbours
+::FindClosestPoint( const double* queryPoint, double& squaredDistance )
+{
+  int closestPoint = -1;
+  squaredDistance = std::numeric_limits< double >::max();
+  if ( this->NumberOfPoints == 0 || queryPoint == NULL )
+  {
+    return closestPoint;
+  }
+
+  if ( this->Nodes.empty() )
+  {
+    this->SearchRange( 0, this->NumberOfPoints, queryPoint, closestPoint, squaredDistance );
+  }
+  else
+  {
+    this->SearchKDTree( 0, queryPoint, closestPoint, squaredDistance );
+  }
+
+  return closestPoint;
+}
+
+
+void vtkWorkflowNearestNeighbours
+::FindClosestPoints( vtkDoubleArray* queryPoints, std::vector< int >& closestPoints, std::vector< double >& squaredDistances )
+{
+  closestPoints.clear();
+  squaredDistances.clear();
+  if ( queryPoints == NULL )
+  {
+    return;
+  }
+  if ( queryPoints->GetNumberOfComponents() != this->NumberOfComponents )
+  {
+    vtkWarningMacro( "vtkWorkflowNearestNeighbours::FindClosestPoints: Query points have the wrong number of components." );
+    return;
+  }
+
+  closestPoints.resize( queryPoints->GetNumberOfTuples(), -1 );
+  squaredDistances.resize( queryPoints->GetNumberOfTuples(), 0.0 );
+  for ( int j = 0; j < queryPoints->GetNumberOfTuples(); j++ )
+  {
+    closestPoints[ j ] = this->FindClosestPoint( queryPoints->GetPointer( j * this->NumberOfComponents ), squaredDistances[ j ] );
+  }
+}
+
+
+// Brute force over a contiguous range of points (in the stored order)
+void vtkWorkflowNearestNeighbours
+::SearchRange( int startPoint, int endPoint, const double* queryPoint, int& closestPoint, double& closestDistance )
+{
+  const int numberOfComponents = this->NumberOfComponents;
+  const double* points = &this->Points[ 0 ];
+  for ( int i = startPoint; i < endPoint; i++ )
+  {
+    const double* currPoint = points + i * numberOfComponents;
+    double currDistance = 0.0;
+    for ( int d = 0; d < numberOfComponents; d++ )
+    {
+      double currDiff = currPoint[ d ] - queryPoint[ d ];
+      currDistance += currDiff * currDiff;
+    }
+
+    // Lowest index on ties
+    if ( currDistance < closestDistance || ( currDistance == closestDistance && this->PointIds[ i ] < closestPoint ) )
+    {
+      closestDistance = currDistance;
+      closestPoint = this->PointIds[ i ];
+    }
+  }
+}
+
+
+void vtkWorkflowNearestNeighbours
+::SearchKDTree( int node, const double* queryPoint, int& closestPoint, double& closestDistance )
+{
+  const KDTreeNode& currNode = this->Nodes[ node ];
+  if ( currNode.SplitComponent < 0 )
+  {
+    this->SearchRange( currNode.StartPoint, currNode.EndPoint, queryPoint, closestPoint, closestDistance );
+    return;
+  }
+
+  double splitDiff = queryPoint[ currNode.SplitComponent ] - currNode.SplitValue;
+  int nearChild = ( splitDiff <= 0 ) ? currNode.LeftChild : currNode.RightChild;
+  int farChild = ( splitDiff <= 0 ) ? currNode.RightChild : currNode.LeftChild;
+
+  this->SearchKDTree( nearChild, queryPoint, closestPoint, closestDistance );
+  // Every point on the far side is at least this far away (equal is still searched, because of ties)
+  if ( splitDiff * splitDiff <= closestDistance )
+  {
+    this->SearchKDTree( farChild, queryPoint, closestPoint, closestDistance );
+  }
+}
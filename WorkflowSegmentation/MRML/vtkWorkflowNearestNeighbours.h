@@ -0,0 +1,86 @@
+#ifndef __vtkWorkflowNearestNeighbours_h
+#define __vtkWorkflowNearestNeighbours_h
+
+// Standard includes
+#include <vector>
+#include <cmath>
+#include <limits>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+#include "vtkDoubleArray.h"
+
+// Workflow Segmentation includes
+#include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
+
+
+// This class is a reusable index for finding the closest point (frame) to query points, by squared Euclidean distance
+// Small sets of points are searched by brute force over a contiguous copy of the points (which the compiler can vectorize)
+// Larger sets of points in low dimensions are searched with a KD-tree
+// If several points are equally close, the one with the lowest index is always returned
+class VTK_SLICER_WORKFLOWSEGMENTATION_MODULE_MRML_EXPORT
+vtkWorkflowNearestNeighbours : public vtkObject
+{
+public:
+  vtkTypeMacro( vtkWorkflowNearestNeighbours, vtkObject );
+
+  // Standard VTK methods
+  static vtkWorkflowNearestNeighbours* New();
+
+protected:
+
+  // Constructor/destructor
+  vtkWorkflowNearestNeighbours();
+  virtual ~vtkWorkflowNearestNeighbours();
+
+public:
+
+  // The points are copied (row-major), so they do not need to outlive the index
+  void SetPoints( const double* points, int numberOfPoints, int numberOfComponents );
+
+  int GetNumberOfPoints() { return this->NumberOfPoints; };
+  int GetNumberOfComponents() { return this->NumberOfComponents; };
+  bool GetUsingKDTree() { return ! this->Nodes.empty(); };
+
+  // Returns the index of the closest point (-1 if there are no points)
+  int FindClosestPoint( const double* queryPoint, double& squaredDistance );
+  // One query point per tuple of the array
+  void FindClosestPoints( vtkDoubleArray* queryPoints, std::vector< int >& closestPoints, std::vector< double >& squaredDistances );
+
+  // Use brute force below this number of points, or above this number of dimensions
+  static const int KDTREE_MIN_POINTS;
+  static const int KDTREE_MAX_COMPONENTS;
+  static const int KDTREE_LEAF_SIZE;
+
+protected:
+
+  struct KDTreeNode
+  {
+    int StartPoint; // Range of points (in tree order) under the node
+    int EndPoint;
+    int SplitComponent; // -1 for leaves
+    double SplitValue;
+    int LeftChild;
+    int RightChild;
+  };
+
+  int BuildKDTree( int startPoint, int endPoint );
+  void SearchKDTree( int node, const double* queryPoint, int& closestPoint, double& closestDistance );
+  void SearchRange( int startPoint, int endPoint, const double* queryPoint, int& closestPoint, double& closestDistance );
+
+protected:
+
+  int NumberOfPoints;
+  int NumberOfComponents;
+
+  // Points in tree order (just the input order for brute force), and the original index of each
+  std::vector< double > Points;
+  std::vector< int > PointIds;
+
+  std::vector< KDTreeNode > Nodes;
+
+};
+
+#endif
@@ -0,0 +1,393 @@
+
+#include "vtkWorkflowOnlinePipeline.h"
+#include "vtkWorkflowFeatureMatrix.h"
+
+// Standard includes
+#include <algorithm>
+
+// Constants ---------------------------------------------------------------------------------------
+
+const int vtkWorkflowOnlinePipeline::FILTER_BUFFER_INITIAL_FRAMES = 64;
+
+vtkStandardNewMacro( vtkWorkflowOnlinePipeline );
+
+
+// Frame buffer ------------------------------------------------------------------------------------
+
+vtkWorkflowOnlinePipeline::FrameBuffer
+::FrameBuffer()
+{
+  this->Capacity = 0;
+  this->NumberOfComponents = 0;
+  this->Start = 0;
+  this->NumberOfFrames = 0;
+}
+
+
+void vtkWorkflowOnlinePipeline::FrameBuffer
+::Initialize( int capacity, int numberOfComponents )
+{
+  this->Capacity = std::max( capacity, 1 );
+  this->NumberOfComponents = numberOfComponents;
+  this->Times.assign( this->Capacity, 0.0 );
+  this->Values.assign( this->Capacity * numberOfComponents, 0.0 );
+  this->Clear();
+}
+
+
+void vtkWorkflowOnlinePipeline::FrameBuffer
+::Clear()
+{
+  this->Start = 0;
+  this->NumberOfFrames = 0;
+}
+
+
+// Double the capacity, keeping the frames (this is the only place a buffer allocates after initialization)
+void vtkWorkflowOnlinePipeline::FrameBuffer
+::Grow()
+{
+  std::vector< double > grownTimes( 2 * this->Capacity, 0.0 );
+  std::vector< double > grownValues( 2 * this->Capacity * this->NumberOfComponents, 0.0 );
+  for ( int i = 0; i < this->NumberOfFrames; i++ )
+  {
+    grownTimes[ i ] = this->GetTime( i );
+    std::copy( this->GetFrame( i ), this->GetFrame( i ) + this->NumberOfComponents, &grownValues[ i * this->NumberOfComponents ] );
+  }
+
+  this->Times.swap( grownTimes );
+  this->Values.swap( grownValues );
+  this->Capacity = 2 * this->Capacity;
+  this->Start = 0;
+}
+
+
+double* vtkWorkflowOnlinePipeline::FrameBuffer
+::Add( double time )
+{
+  int bufferFrame = ( this->Start + this->NumberOfFrames ) % this->Capacity;
+  if ( this->NumberOfFrames == this->Capacity )
+  {
+    this->Start = ( this->Start + 1 ) % this->Capacity;
+  }
+  else
+  {
+    this->NumberOfFrames++;
+  }
+
+  this->Times[ bufferFrame ] = time;
+  return &this->Values[ bufferFrame * this->NumberOfComponents ];
+}
+
+
+// Constructors and Destructors --------------------------------------------------------------------
+
+vtkWorkflowOnlinePipeline
+::vtkWorkflowOnlinePipeline()
+{
+  this->Initialized = false;
+  this->NumberOfFrames = 0;
+  this->OutOfOrderWarned = false;
+
+  this->FilterWidth = 1.0;
+  this->Derivative = 0;
+  this->OrthogonalWindow = 0;
+  this->OrthogonalOrder = 0;
+
+  this->NumberOfRawComponents = 0;
+  this->NumberOfDerivativeComponents = 0;
+  this->NumberOfOrthogonalComponents = 0;
+  this->NumberOfPcaComponents = 0;
+
+  this->Centroids = vtkSmartPointer< vtkWorkflowNearestNeighbours >::New();
+  this->OrthogonalKernel = vtkSmartPointer< vtkWorkflowLegendreKernel >::New();
+  this->Centroid = -1;
+
+  // So the frame getters are always valid
+  this->FilterFrame.assign( 1, 0.0 );
+  this->DerivativeFrame.assign( 1, 0.0 );
+  this->OrthogonalFrame.assign( 1, 0.0 );
+  this->PcaFrame.assign( 1, 0.0 );
+}
+
+
+vtkWorkflowOnlinePipeline
+::~vtkWorkflowOnlinePipeline()
+{
+  // Vectors take care of themselves
+}
+
+
+void vtkWorkflowOnlinePipeline
+::Initialize( vtkMRMLWorkflowInputNode* workflowInput, vtkMRMLWorkflowTrainingNode* workflowTraining, int numberOfRawComponents )
+{
+  this->Initialized = false;
+  if ( workflowInput == NULL || workflowTraining == NULL || numberOfRawComponents < 1 )
+  {
+    return;
+  }
+
+  this->FilterWidth = workflowInput->GetFilterWidth();
+  this->Derivative = std::max( workflowInput->GetDerivative(), 0 );
+  this->OrthogonalWindow = std::max( workflowInput->GetOrthogonalWindow(), 0 );
+  this->OrthogonalOrder = std::max( workflowInput->GetOrthogonalOrder(), 0 );
+
+  this->NumberOfRawComponents = numberOfRawComponents;
+  this->NumberOfDerivativeComponents = numberOfRawComponents * ( this->Derivative + 1 );
+  this->OrthogonalKernel->Initialize( this->OrthogonalWindow + 1, this->OrthogonalOrder, this->NumberOfDerivativeComponents );
+  this->NumberOfOrthogonalComponents = this->OrthogonalKernel->GetNumberOfCoefficients();
+
+  // The derivative of order d needs the d + 1 most recent filtered frames
+  // The orthogonal transformation needs the window + 1 most recent derivative frames
+  this->RawBuffer.Initialize( FILTER_BUFFER_INITIAL_FRAMES, this->NumberOfRawComponents );
+  this->FilterBuffer.Initialize( this->Derivative + 1, this->NumberOfRawComponents );
+  this->DerivativeBuffer.Initialize( this->OrthogonalWindow + 1, this->NumberOfDerivativeComponents );
+
+  this->FilterFrame.assign( this->NumberOfRawComponents, 0.0 );
+  this->DerivativeFrame.assign( this->NumberOfDerivativeComponents, 0.0 );
+  this->OrthogonalFrame.assign( this->NumberOfOrthogonalComponents, 0.0 );
+  this->DifferentiateValues.assign( ( this->Derivative + 1 ) * this->NumberOfRawComponents, 0.0 );
+  this->DifferentiateScratch.assign( ( this->Derivative + 1 ) * this->NumberOfRawComponents, 0.0 );
+  this->WindowTimes.assign( this->OrthogonalWindow + 1, 0.0 );
+  this->WindowValues.assign( ( this->OrthogonalWindow + 1 ) * this->NumberOfDerivativeComponents, 0.0 );
+
+  // Copy the trained transformations, so they are contiguous
+  vtkDoubleArray* prinComps = workflowTraining->GetPrinComps();
+  vtkDoubleArray* mean = workflowTraining->GetMean();
+  vtkDoubleArray* centroids = workflowTraining->GetCentroids();
+  if ( prinComps == NULL || mean == NULL || centroids == NULL )
+  {
+    return;
+  }
+  if ( prinComps->GetNumberOfComponents() != this->NumberOfOrthogonalComponents || mean->GetNumberOfComponents() != this->NumberOfOrthogonalComponents )
+  {
+    vtkWarningMacro( "vtkWorkflowOnlinePipeline::Initialize: Principal components are incompatible with the input parameters." );
+    return;
+  }
+  this->NumberOfPcaComponents = prinComps->GetNumberOfTuples();
+  if ( centroids->GetNumberOfComponents() != this->NumberOfPcaComponents )
+  {
+    vtkWarningMacro( "vtkWorkflowOnlinePipeline::Initialize: Centroids are incompatible with the principal components." );
+    return;
+  }
+
+  this->Mean.assign( mean->GetPointer( 0 ), mean->GetPointer( 0 ) + this->NumberOfOrthogonalComponents );
+  this->PrinComps.assign( prinComps->GetPointer( 0 ), prinComps->GetPointer( 0 ) + this->NumberOfPcaComponents * this->NumberOfOrthogonalComponents );
+  this->Centroids->SetPoints( centroids->GetPointer( 0 ), centroids->GetNumberOfTuples(), this->NumberOfPcaComponents );
+  this->PcaFrame.assign( std::max( this->NumberOfPcaComponents, 1 ), 0.0 );
+
+  this->ClearFrames();
+  this->OutOfOrderWarned = false;
+  this->Initialized = true;
+}
+
+
+void vtkWorkflowOnlinePipeline
+::ClearFrames()
+{
+  this->NumberOfFrames = 0;
+  this->RawBuffer.Clear();
+  this->FilterBuffer.Clear();
+  this->DerivativeBuffer.Clear();
+  this->Centroid = -1;
+}
+
+
+// Stages ------------------------------------------------------------------------------------------
+
+int vtkWorkflowOnlinePipeline
+::AddFrame( double time, const double* rawValues )
+{
+  if ( ! this->Initialized || rawValues == NULL )
+  {
+    return -1;
+  }
+
+  // Tracked streams often re-send an unchanged transform with the same time, so that is not worth a warning (at the tracking rate)
+  if ( this->NumberOfFrames > 0 && time <= this->RawBuffer.GetTime( this->RawBuffer.GetNumberOfFrames() - 1 ) )
+  {
+    if ( time < this->RawBuffer.GetTime( this->RawBuffer.GetNumberOfFrames() - 1 ) && ! this->OutOfOrderWarned )
+    {
+      vtkWarningMacro( "vtkWorkflowOnlinePipeline::AddFrame: Frames must be added in increasing time order. Earlier frames are dropped." );
+      this->OutOfOrderWarned = true;
+    }
+    return -1;
+  }
+
+  // Only grow if the oldest frame would still be needed by the filter
+  if ( this->RawBuffer.GetNumberOfFrames() == this->RawBuffer.GetCapacity()
+    && std::abs( ( this->RawBuffer.GetTime( 0 ) - time ) / this->FilterWidth ) <= vtkWorkflowFeatureMatrix::STDEV_CUTOFF )
+  {
+    this->RawBuffer.Grow();
+  }
+  double* rawFrame = this->RawBuffer.Add( time );
+  std::copy( rawValues, rawValues + this->NumberOfRawComponents, rawFrame );
+  this->NumberOfFrames++;
+
+  this->Filter( time );
+  std::copy( this->FilterFrame.begin(), this->FilterFrame.end(), this->FilterBuffer.Add( time ) );
+
+  this->Differentiate();
+  std::copy( this->DerivativeFrame.begin(), this->DerivativeFrame.end(), this->DerivativeBuffer.Add( time ) );
+
+  this->Centroid = -1;
+  if ( this->OrthogonalTransformation() && this->TransformByPrincipalComponents() )
+  {
+    this->fwdkmeansTransform();
+  }
+  return this->Centroid;
+}
+
+
+// Gaussian filter of the most recent raw frame, looking back until the Gaussian is negligible
+void vtkWorkflowOnlinePipeline
+::Filter( double time )
+{
+  std::fill( this->FilterFrame.begin(), this->FilterFrame.end(), 0.0 );
+  double normSum = 0;
+  for ( int j = this->RawBuffer.GetNumberOfFrames() - 1; j >= 0; j-- )
+  {
+    double normalizedDistance = ( this->RawBuffer.GetTime( j ) - time ) / this->FilterWidth;
+    if ( std::abs( normalizedDistance ) > vtkWorkflowFeatureMatrix::STDEV_CUTOFF )
+    {
+      break;
+    }
+
+    double gaussianWeight = exp( - normalizedDistance * normalizedDistance / 2 );
+    const double* currFrame = this->RawBuffer.GetFrame( j );
+    for ( int d = 0; d < this->NumberOfRawComponents; d++ )
+    {
+      this->FilterFrame[ d ] += currFrame[ d ] * gaussianWeight;
+    }
+    normSum += gaussianWeight;
+  }
+
+  for ( int d = 0; d < this->NumberOfRawComponents; d++ )
+  {
+    this->FilterFrame[ d ] = this->FilterFrame[ d ] / normSum;
+  }
+}
+
+
+// Concatenate the filtered frame with its derivatives (velocity, acceleration, etc...)
+// Same as differentiating the most recent order + 1 frames, and taking the last
+void vtkWorkflowOnlinePipeline
+::Differentiate()
+{
+  int numberOfComponents = this->NumberOfRawComponents;
+  int numberOfBufferedFrames = this->FilterBuffer.GetNumberOfFrames();
+  const double* latestFrame = this->FilterBuffer.GetFrame( numberOfBufferedFrames - 1 );
+  std::copy( latestFrame, latestFrame + numberOfComponents, this->DerivativeFrame.begin() );
+
+  for ( int order = 1; order <= this->Derivative; order++ )
+  {
+    double* derivativeFrame = &this->DerivativeFrame[ order * numberOfComponents ];
+
+    // Not enough frames yet, so just use the most recent values
+    if ( numberOfBufferedFrames < order + 1 )
+    {
+      std::copy( latestFrame, latestFrame + numberOfComponents, derivativeFrame );
+      continue;
+    }
+
+    // Centred difference formula (except at the endpoints, use a forward/backward difference formula)
+    int firstFrame = numberOfBufferedFrames - ( order + 1 );
+    int numberOfFrames = order + 1;
+    for ( int i = 0; i < numberOfFrames; i++ )
+    {
+      const double* currFrame = this->FilterBuffer.GetFrame( firstFrame + i );
+      std::copy( currFrame, currFrame + numberOfComponents, &this->DifferentiateValues[ i * numberOfComponents ] );
+    }
+    for ( int o = 0; o < order; o++ )
+    {
+      for ( int i = 0; i < numberOfFrames; i++ )
+      {
+        int lowerFrame = std::max( i - 1, 0 );
+        int upperFrame = std::min( i + 1, numberOfFrames - 1 );
+        double deltaTime = this->FilterBuffer.GetTime( firstFrame + upperFrame ) - this->FilterBuffer.GetTime( firstFrame + lowerFrame );
+        for ( int d = 0; d < numberOfComponents; d++ )
+        {
+          this->DifferentiateScratch[ i * numberOfComponents + d ] = ( this->DifferentiateValues[ upperFrame * numberOfComponents + d ] - this->DifferentiateValues[ lowerFrame * numberOfComponents + d ] ) / deltaTime;
+        }
+      }
+      this->DifferentiateValues.swap( this->DifferentiateScratch );
+    }
+
+    std::copy( &this->DifferentiateValues[ order * numberOfComponents ], &this->DifferentiateValues[ order * numberOfComponents ] + numberOfComponents, derivativeFrame );
+  }
+}
+
+
+// Legendre coefficients over the most recent window + 1 frames
+// Until there are enough frames, the start is padded by repeating the first frame at the average frame interval
+bool vtkWorkflowOnlinePipeline
+::OrthogonalTransformation()
+{
+  int window = this->OrthogonalWindow;
+  int numberOfComponents = this->NumberOfDerivativeComponents;
+  int numberOfBufferedFrames = this->DerivativeBuffer.GetNumberOfFrames();
+
+  if ( this->NumberOfFrames <= window )
+  {
+    double deltaTime = 1.0;
+    if ( numberOfBufferedFrames > 1 )
+    {
+      deltaTime = ( this->DerivativeBuffer.GetTime( numberOfBufferedFrames - 1 ) - this->DerivativeBuffer.GetTime( 0 ) ) / ( numberOfBufferedFrames - 1 );
+    }
+
+    // The padded sequence has window + numberOfBufferedFrames frames, and the window is the last window + 1 of those
+    for ( int k = 0; k <= window; k++ )
+    {
+      int paddedFrame = numberOfBufferedFrames - 1 + k;
+      if ( paddedFrame < window )
+      {
+        this->WindowTimes[ k ] = this->DerivativeBuffer.GetTime( 0 ) - ( window - paddedFrame ) * deltaTime;
+        std::copy( this->DerivativeBuffer.GetFrame( 0 ), this->DerivativeBuffer.GetFrame( 0 ) + numberOfComponents, &this->WindowValues[ k * numberOfComponents ] );
+      }
+      else
+      {
+        this->WindowTimes[ k ] = this->DerivativeBuffer.GetTime( paddedFrame - window );
+        std::copy( this->DerivativeBuffer.GetFrame( paddedFrame - window ), this->DerivativeBuffer.GetFrame( paddedFrame - window ) + numberOfComponents, &this->WindowValues[ k * numberOfComponents ] );
+      }
+    }
+    this->OrthogonalKernel->CalculateCoefficients( &this->WindowTimes[ 0 ], &this->WindowValues[ 0 ], &this->OrthogonalFrame[ 0 ] );
+    return true;
+  }
+
+  for ( int k = 0; k <= window; k++ )
+  {
+    this->WindowTimes[ k ] = this->DerivativeBuffer.GetTime( k );
+    std::copy( this->DerivativeBuffer.GetFrame( k ), this->DerivativeBuffer.GetFrame( k ) + numberOfComponents, &this->WindowValues[ k * numberOfComponents ] );
+  }
+  if ( ! this->OrthogonalKernel->CalculateCoefficients( &this->WindowTimes[ 0 ], &this->WindowValues[ 0 ], &this->OrthogonalFrame[ 0 ] ) )
+  {
+    vtkWarningMacro( "vtkWorkflowOnlinePipeline::OrthogonalTransformation: Improper time range." );
+  }
+  return true;
+}
+
+
+bool vtkWorkflowOnlinePipeline
+::TransformByPrincipalComponents()
+{
+  for ( int o = 0; o < this->NumberOfPcaComponents; o++ )
+  {
+    const double* currPrinComp = &this->PrinComps[ o * this->NumberOfOrthogonalComponents ];
+    double currValue = 0;
+    for ( int d = 0; d < this->NumberOfOrthogonalComponents; d++ )
+    {
+      currValue += ( this->OrthogonalFrame[ d ] - this->Mean[ d ] ) * currPrinComp[ d ];
+    }
+    this->PcaFrame[ o ] = currValue;
+  }
+  return true;
+}
+
+
+bool vtkWorkflowOnlinePipeline
+::fwdkmeansTransform()
+{
+  double squaredDistance;
+  this->Centroid = this->Centroids->FindClosestPoint( &this->PcaFrame[ 0 ], squaredDistance );
+  return ( this->Centroid >= 0 );
+}
@@ -0,0 +1,146 @@
+#ifndef __vtkWorkflowOnlinePipeline_h
+#define __vtkWorkflowOnlinePipeline_h
+
+// Standard includes
+#include <vector>
+#include <cmath>
+
+// VTK includes
+#include "vtkObject.h"
+#include "vtkObjectBase.h"
+#include "vtkObjectFactory.h"
+#include "vtkSmartPointer.h"
+#include "vtkDoubleArray.h"
+
+// Workflow Segmentation includes
+#include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
+#include "vtkMRMLWorkflowInputNode.h"
+#include "vtkMRMLWorkflowTrainingNode.h"
+#include "vtkWorkflowLegendreKernel.h"
+#include "vtkWorkflowNearestNeighbours.h"
+
+
+// This class does the real-time feature extraction for one tool: filter -> derivative -> orthogonal -> PCA -> centroid
+// Each stage only keeps the frames it needs in a fixed-size ring buffer, sized from the input parameters
+// All of the buffers and scratch space are allocated when the pipeline is initialized, so adding a frame does not allocate
+// (the exception is the filter's buffer, whose lookback is in time rather than frames, so it grows until it covers the lookback at the tracking rate)
+// Note: Frames must be added in increasing time order
+// (a frame with the same time as the previous frame is dropped, eg. a transform that is re-sent unchanged; an earlier frame is dropped with a warning, once per initialization)
+class VTK_SLICER_WORKFLOWSEGMENTATION_MODULE_MRML_EXPORT
+vtkWorkflowOnlinePipeline : public vtkObject
+{
+public:
+  vtkTypeMacro( vtkWorkflowOnlinePipeline, vtkObject );
+
+  // Standard VTK methods
+  static vtkWorkflowOnlinePipeline* New();
+
+protected:
+
+  // Constructor/destructor
+  vtkWorkflowOnlinePipeline();
+  virtual ~vtkWorkflowOnlinePipeline();
+
+public:
+
+  // Sizes the buffers and copies the trained transformations (this also clears the frames)
+  void Initialize( vtkMRMLWorkflowInputNode* workflowInput, vtkMRMLWorkflowTrainingNode* workflowTraining, int numberOfRawComponents );
+  bool IsInitialized() { return this->Initialized; };
+  int GetNumberOfRawComponents() { return this->NumberOfRawComponents; };
+
+  // Forget all previous frames, but keep the sizes
+  void ClearFrames();
+  int GetNumberOfFrames() { return this->NumberOfFrames; };
+
+  // Returns the closest centroid to the new frame (-1 if the frame could not be transformed, or was dropped)
+  int AddFrame( double time, const double* rawValues );
+
+  // Results of each stage for the most recent frame
+  int GetNumberOfFilterComponents() { return this->NumberOfRawComponents; };
+  const double* GetFilterFrame() { return &this->FilterFrame[ 0 ]; };
+  int GetNumberOfDerivativeComponents() { return this->NumberOfDerivativeComponents; };
+  const double* GetDerivativeFrame() { return &this->DerivativeFrame[ 0 ]; };
+  int GetNumberOfOrthogonalComponents() { return this->NumberOfOrthogonalComponents; };
+  const double* GetOrthogonalFrame() { return &this->OrthogonalFrame[ 0 ]; };
+  int GetNumberOfPcaComponents() { return this->NumberOfPcaComponents; };
+  const double* GetPcaFrame() { return &this->PcaFrame[ 0 ]; };
+  int GetCentroid() { return this->Centroid; };
+
+  // The filter's buffer starts at this size
+  static const int FILTER_BUFFER_INITIAL_FRAMES;
+
+protected:
+
+  // Fixed-size buffer of the most recent frames (the oldest frame is overwritten once the buffer is full)
+  class FrameBuffer
+  {
+  public:
+    FrameBuffer();
+    void Initialize( int capacity, int numberOfComponents );
+    void Clear();
+    void Grow();
+    double* Add( double time ); // Returns where to put the new values
+    int GetCapacity() { return this->Capacity; };
+    int GetNumberOfFrames() { return this->NumberOfFrames; };
+    // These are oldest first
+    double GetTime( int frame ) { return this->Times[ ( this->Start + frame ) % this->Capacity ]; };
+    const double* GetFrame( int frame ) { return &this->Values[ ( ( this->Start + frame ) % this->Capacity ) * this->NumberOfComponents ]; };
+  protected:
+    std::vector< double > Times;
+    std::vector< double > Values;
+    int Capacity;
+    int NumberOfComponents;
+    int Start;
+    int NumberOfFrames;
+  };
+
+  void Filter( double time );
+  void Differentiate();
+  bool OrthogonalTransformation();
+  bool TransformByPrincipalComponents();
+  bool fwdkmeansTransform();
+
+protected:
+
+  bool Initialized;
+  int NumberOfFrames;
+  bool OutOfOrderWarned;
+
+  // Input parameters
+  double FilterWidth;
+  int Derivative;
+  int OrthogonalWindow;
+  int OrthogonalOrder;
+
+  int NumberOfRawComponents;
+  int NumberOfDerivativeComponents;
+  int NumberOfOrthogonalComponents;
+  int NumberOfPcaComponents;
+
+  // Buffers for the stages which look back
+  FrameBuffer RawBuffer;
+  FrameBuffer FilterBuffer;
+  FrameBuffer DerivativeBuffer;
+
+  // Trained transformations
+  std::vector< double > Mean;
+  std::vector< double > PrinComps;
+  vtkSmartPointer< vtkWorkflowNearestNeighbours > Centroids;
+  vtkSmartPointer< vtkWorkflowLegendreKernel > OrthogonalKernel;
+
+  // Most recent results
+  std::vector< double > FilterFrame;
+  std::vector< double > DerivativeFrame;
+  std::vector< double > OrthogonalFrame;
+  std::vector< double > PcaFrame;
+  int Centroid;
+
+  // Scratch space
+  std::vector< double > DifferentiateValues;
+  std::vector< double > DifferentiateScratch;
+  std::vector< double > WindowTimes;
+  std::vector< double > WindowValues;
+
+};
+
+#endif
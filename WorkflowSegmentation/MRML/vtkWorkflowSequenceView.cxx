@@ -0,0 +1,309 @@
+
+#include "vtkWorkflowSequenceView.h"
+#include "vtkMRMLWorkflowSequenceNode.h"
+#include "vtkWorkflowFeatureMatrix.h"
+#include "vtkWorkflowKMeans.h"
+
+
+// Constructors ------------------------------------------------------------------------------------
+
+vtkWorkflowSequenceView
+::vtkWorkflowSequenceView()
+{
+  this->Sequence = NULL;
+  this->Matrix = NULL;
+  this->Contiguous = true;
+  this->StartFrame = 0;
+  this->NumberOfFrames = 0;
+  this->NumberOfComponents = 0;
+}
+
+
+// By default, view the whole sequence
+vtkWorkflowSequenceView
+::vtkWorkflowSequenceView( vtkMRMLWorkflowSequenceNode* sequence )
+{
+  this->Sequence = sequence;
+  this->Matrix = NULL;
+  this->Contiguous = true;
+  this->StartFrame = 0;
+  this->NumberOfFrames = this->GetNumberOfViewableFrames();
+  this->UpdateNumberOfComponents();
+}
+
+
+vtkWorkflowSequenceView
+::vtkWorkflowSequenceView( vtkWorkflowFeatureMatrix* matrix )
+{
+  this->Sequence = NULL;
+  this->Matrix = matrix;
+  this->Contiguous = true;
+  this->StartFrame = 0;
+  this->NumberOfFrames = this->GetNumberOfViewableFrames();
+  this->UpdateNumberOfComponents();
+}
+
+
+int vtkWorkflowSequenceView
+::GetNumberOfViewableFrames()
+{
+  if ( this->Sequence != NULL )
+  {
+    return this->Sequence->GetNumberOfDataNodes();
+  }
+  if ( this->Matrix != NULL )
+  {
+    return this->Matrix->GetNumberOfFrames();
+  }
+  return 0;
+}
+
+
+// Restricting the view ----------------------------------------------------------------------------
+
+void vtkWorkflowSequenceView
+::SetRange( int startFrame, int endFrame )
+{
+  startFrame = std::max( startFrame, 0 );
+  endFrame = std::min( endFrame, this->GetNumberOfViewableFrames() - 1 );
+
+  this->Contiguous = true;
+  this->Frames.clear();
+  this->StartFrame = startFrame;
+  this->NumberOfFrames = std::max( endFrame - startFrame + 1, 0 );
+  this->UpdateNumberOfComponents();
+}
+
+
+void vtkWorkflowSequenceView
+::SetFrames( const std::vector< int >& frames )
+{
+  this->Contiguous = false;
+  this->Frames = frames;
+  this->StartFrame = 0;
+  this->NumberOfFrames = frames.size();
+  this->UpdateNumberOfComponents();
+}
+
+
+// Only frames with one of the labels are in the view (unlabelled frames are never in the view)
+void vtkWorkflowSequenceView
+::SetLabelledFrames( const std::vector< std::string >& labels )
+{
+  std::vector< int > labelledFrames;
+  int numberOfViewableFrames = this->GetNumberOfViewableFrames();
+  for ( int i = 0; i < numberOfViewableFrames; i++ )
+  {
+    std::string currLabel;
+    if ( this->Sequence != NULL )
+    {
+      vtkMRMLNode* currDataNode = this->Sequence->GetNthDataNode( i );
+      if ( currDataNode == NULL || currDataNode->GetAttribute( "Message" ) == NULL )
+      {
+        continue;
+      }
+      currLabel = currDataNode->GetAttribute( "Message" );
+    }
+    if ( this->Matrix != NULL )
+    {
+      currLabel = this->Matrix->GetLabel( i );
+    }
+    if ( currLabel.empty() )
+    {
+      continue;
+    }
+
+    // Check if the current frame satisfies one of the labels
+    for ( int j = 0; j < labels.size(); j++ )
+    {
+      if ( labels.at( j ).compare( currLabel ) == 0 )
+      {
+        labelledFrames.push_back( i );
+        break;
+      }
+    }
+  }
+
+  this->SetFrames( labelledFrames );
+}
+
+
+// Access ------------------------------------------------------------------------------------------
+
+int vtkWorkflowSequenceView
+::GetNumberOfFrames()
+{
+  return this->NumberOfFrames;
+}
+
+
+int vtkWorkflowSequenceView
+::GetNumberOfComponents()
+{
+  return this->NumberOfComponents;
+}
+
+
+// All frames must have the same number of components as the first viewed frame
+void vtkWorkflowSequenceView
+::UpdateNumberOfComponents()
+{
+  this->NumberOfComponents = 0;
+  if ( this->Sequence != NULL )
+  {
+    this->NumberOfComponents = this->Sequence->GetNthNumberOfComponents( this->NumberOfFrames > 0 ? this->GetViewedFrame( 0 ) : 0 );
+  }
+  if ( this->Matrix != NULL )
+  {
+    this->NumberOfComponents = this->Matrix->GetNumberOfComponents();
+  }
+}
+
+
+// Note: This is NULL if the frame is not a double array of the right size
+const double* vtkWorkflowSequenceView
+::GetFrame( int frame )
+{
+  if ( this->Sequence != NULL )
+  {
+    vtkDoubleArray* currDoubleArray = this->Sequence->GetNthDoubleArray( this->GetViewedFrame( frame ) );
+    if ( currDoubleArray == NULL || currDoubleArray->GetNumberOfComponents() != this->NumberOfComponents || currDoubleArray->GetNumberOfTuples() < 1 )
+    {
+      return NULL;
+    }
+    return currDoubleArray->GetPointer( 0 );
+  }
+  if ( this->Matrix != NULL )
+  {
+    return this->Matrix->GetFrame( this->GetViewedFrame( frame ) );
+  }
+  return NULL;
+}
+
+
+double vtkWorkflowSequenceView
+::GetTime( int frame )
+{
+  if ( this->Sequence != NULL )
+  {
+    return this->Sequence->GetNthIndexValueAsDouble( this->GetViewedFrame( frame ) );
+  }
+  if ( this->Matrix != NULL )
+  {
+    return this->Matrix->GetTime( this->GetViewedFrame( frame ) );
+  }
+  return 0;
+}
+
+
+std::string vtkWorkflowSequenceView
+::GetLabel( int frame )
+{
+  if ( this->Sequence != NULL )
+  {
+    vtkMRMLNode* currDataNode = this->Sequence->GetNthDataNode( this->GetViewedFrame( frame ) );
+    if ( currDataNode == NULL || currDataNode->GetAttribute( "Message" ) == NULL )
+    {
+      return "";
+    }
+    return currDataNode->GetAttribute( "Message" );
+  }
+  if ( this->Matrix != NULL )
+  {
+    return this->Matrix->GetLabel( this->GetViewedFrame( frame ) );
+  }
+  return "";
+}
+
+
+// Materializing -----------------------------------------------------------------------------------
+
+void vtkWorkflowSequenceView
+::Materialize( vtkMRMLWorkflowSequenceNode* subsequence )
+{
+  if ( subsequence == NULL )
+  {
+    return;
+  }
+
+  // Matrices have no data nodes, so go through a matrix
+  if ( this->Sequence == NULL )
+  {
+    vtkSmartPointer< vtkWorkflowFeatureMatrix > submatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+    this->Materialize( submatrix );
+    subsequence->FromFeatureMatrix( submatrix );
+    return;
+  }
+
+  subsequence->RemoveAllDataNodes();
+  for ( int i = 0; i < this->NumberOfFrames; i++ )
+  {
+    int currFrame = this->GetViewedFrame( i );
+    subsequence->SetDataNodeAtValue( this->Sequence->GetNthDataNode( currFrame ), this->Sequence->GetNthIndexValue( currFrame ) ); // OK because the data node is always deep copied
+  }
+}
+
+
+// Note: Any frame that is not a double array of the right size will be treated as zeros
+void vtkWorkflowSequenceView
+::Materialize( vtkWorkflowFeatureMatrix* submatrix )
+{
+  if ( submatrix == NULL )
+  {
+    return;
+  }
+
+  int numberOfComponents = this->GetNumberOfComponents();
+  submatrix->Initialize( 0, numberOfComponents );
+  submatrix->Reserve( this->NumberOfFrames );
+
+  std::vector< double > zeroFrame( std::max( numberOfComponents, 1 ), 0.0 );
+  for ( int i = 0; i < this->NumberOfFrames; i++ )
+  {
+    const double* currFrame = this->GetFrame( i );
+    submatrix->AppendFrame( this->GetTime( i ), ( currFrame != NULL ) ? currFrame : &zeroFrame[ 0 ], this->GetLabel( i ) );
+  }
+}
+
+
+// Math --------------------------------------------------------------------------------------------
+
+void vtkWorkflowSequenceView
+::Mean( vtkDoubleArray* meanArray )
+{
+  if ( meanArray == NULL )
+  {
+    return;
+  }
+
+  int numberOfComponents = this->GetNumberOfComponents();
+  std::vector< double > meanValues( numberOfComponents, 0.0 );
+  for ( int i = 0; i < this->NumberOfFrames; i++ )
+  {
+    const double* currFrame = this->GetFrame( i );
+    if ( currFrame == NULL )
+    {
+      continue;
+    }
+    for ( int d = 0; d < numberOfComponents; d++ )
+    {
+      meanValues[ d ] += currFrame[ d ];
+    }
+  }
+
+  meanArray->SetNumberOfComponents( numberOfComponents );
+  meanArray->SetNumberOfTuples( 1 );
+  for ( int d = 0; d < numberOfComponents; d++ )
+  {
+    meanArray->SetComponent( 0, d, ( this->NumberOfFrames > 0 ) ? ( meanValues[ d ] / this->NumberOfFrames ) : 0.0 );
+  }
+}
+
+
+void vtkWorkflowSequenceView
+::fwdkmeans( int numClusters, vtkDoubleArray* centroids )
+{
+  vtkSmartPointer< vtkWorkflowKMeans > kmeans = vtkSmartPointer< vtkWorkflowKMeans >::New();
+  kmeans->SetPoints( *this );
+  kmeans->fwdkmeans( numClusters, centroids );
+}
@@ -0,0 +1,70 @@
+#ifndef __vtkWorkflowSequenceView_h
+#define __vtkWorkflowSequenceView_h
+
+// Standard includes
+#include <string>
+#include <vector>
+
+// VTK includes
+#include "vtkDoubleArray.h"
+
+// Workflow Segmentation includes
+#include "vtkSlicerWorkflowSegmentationModuleMRMLExport.h"
+
+class vtkMRMLWorkflowSequenceNode;
+class vtkWorkflowFeatureMatrix;
+
+
+// This class is a lightweight, non-owning view of some of the frames of a workflow sequence (or a feature matrix)
+// The view is either a contiguous range of frames or a list of frames; nothing is copied until the view is materialized
+// Note: The view is only valid as long as the viewed sequence is not modified
+class VTK_SLICER_WORKFLOWSEGMENTATION_MODULE_MRML_EXPORT
+vtkWorkflowSequenceView
+{
+public:
+
+  vtkWorkflowSequenceView();
+  vtkWorkflowSequenceView( vtkMRMLWorkflowSequenceNode* sequence );
+  vtkWorkflowSequenceView( vtkWorkflowFeatureMatrix* matrix );
+
+  // Restrict the view (these are in terms of the underlying sequence's frames)
+  // Note: The range is inclusive (end points will appear in the view), same as GetSubsequence
+  void SetRange( int startFrame, int endFrame );
+  void SetFrames( const std::vector< int >& frames );
+  void SetLabelledFrames( const std::vector< std::string >& labels );
+
+  int GetNumberOfFrames();
+  int GetNumberOfComponents();
+  bool IsContiguous() { return this->Contiguous; };
+
+  // These are in terms of the view's frames
+  int GetViewedFrame( int frame ) { return this->Contiguous ? ( this->StartFrame + frame ) : this->Frames[ frame ]; };
+  const double* GetFrame( int frame );
+  double GetTime( int frame );
+  std::string GetLabel( int frame );
+
+  // Copying only happens here
+  void Materialize( vtkMRMLWorkflowSequenceNode* subsequence );
+  void Materialize( vtkWorkflowFeatureMatrix* submatrix );
+
+  // Math directly on the viewed frames
+  void Mean( vtkDoubleArray* meanArray );
+  void fwdkmeans( int numClusters, vtkDoubleArray* centroids );
+
+protected:
+
+  vtkMRMLWorkflowSequenceNode* Sequence;
+  vtkWorkflowFeatureMatrix* Matrix;
+
+  bool Contiguous;
+  int StartFrame;
+  int NumberOfFrames;
+  std::vector< int > Frames;
+  int NumberOfComponents;
+
+  int GetNumberOfViewableFrames();
+  void UpdateNumberOfComponents();
+
+};
+
+#endif
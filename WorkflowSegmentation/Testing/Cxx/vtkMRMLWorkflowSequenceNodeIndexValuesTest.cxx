@@ -0,0 +1,127 @@
+
+// Workflow Segmentation includes
+#include "vtkMRMLWorkflowDoubleArrayNode.h"
+#include "vtkMRMLWorkflowSequenceNode.h"
+
+// VTK includes
+#include "vtkDoubleArray.h"
+#include "vtkNew.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+std::string TimeToString( double time )
+{
+  std::stringstream timeStream;
+  timeStream << time;
+  return timeStream.str();
+}
+
+
+void FillSequence( vtkMRMLWorkflowSequenceNode* sequence, int numberOfItems, double firstTime, double deltaTime )
+{
+  sequence->SetIndexType( vtkMRMLSequenceNode::NumericIndex );
+  vtkNew< vtkMRMLWorkflowDoubleArrayNode > doubleArrayNode;
+  doubleArrayNode->GetArray()->SetNumberOfComponents( 2 );
+  doubleArrayNode->GetArray()->SetNumberOfTuples( 1 );
+  for ( int i = 0; i < numberOfItems; i++ )
+  {
+    doubleArrayNode->GetArray()->SetComponent( 0, 0, i );
+    doubleArrayNode->GetArray()->SetComponent( 0, 1, -i );
+    sequence->SetDataNodeAtValue( doubleArrayNode.GetPointer(), TimeToString( firstTime + i * deltaTime ) ); // Automatically deep copies
+  }
+}
+
+
+// The cached values must be the same as parsing the index values right now
+bool CheckIndexValues( vtkMRMLWorkflowSequenceNode* sequence, std::string description )
+{
+  const std::vector< double >& indexValues = sequence->GetIndexValuesAsDouble();
+  if ( indexValues.size() != sequence->GetNumberOfDataNodes() )
+  {
+    std::cerr << "There are " << indexValues.size() << " index values for " << sequence->GetNumberOfDataNodes() << " items after " << description << "." << std::endl;
+    return false;
+  }
+  for ( int i = 0; i < sequence->GetNumberOfDataNodes(); i++ )
+  {
+    double expectedValue = vtkMRMLWorkflowSequenceNode::IndexValueToDouble( sequence->GetNthIndexValue( i ) );
+    if ( indexValues[ i ] != expectedValue || sequence->GetNthIndexValueAsDouble( i ) != expectedValue )
+    {
+      std::cerr << "Index value " << i << " is " << indexValues[ i ] << ", expected " << expectedValue << " after " << description << "." << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+
+int vtkMRMLWorkflowSequenceNodeIndexValuesTest( int vtkNotUsed( argc ), char* vtkNotUsed( argv )[] )
+{
+  vtkNew< vtkMRMLWorkflowSequenceNode > sequence;
+  FillSequence( sequence.GetPointer(), 10, 1.0, 0.5 );
+  if ( ! CheckIndexValues( sequence.GetPointer(), "filling the sequence" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Editing a middle item keeps the number of items, and the first and last index values
+  sequence->UpdateIndexValue( TimeToString( 3.5 ), TimeToString( 3.75 ) );
+  if ( ! CheckIndexValues( sequence.GetPointer(), "editing a middle index value" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Same, but by removing one item and inserting another
+  vtkNew< vtkMRMLWorkflowDoubleArrayNode > doubleArrayNode;
+  doubleArrayNode->GetArray()->SetNumberOfComponents( 2 );
+  doubleArrayNode->GetArray()->SetNumberOfTuples( 1 );
+  sequence->RemoveDataNodeAtValue( TimeToString( 2.0 ) );
+  sequence->SetDataNodeAtValue( doubleArrayNode.GetPointer(), TimeToString( 4.25 ) );
+  if ( ! CheckIndexValues( sequence.GetPointer(), "removing and inserting an item" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Items inserted and appended at the same time
+  sequence->SetDataNodeAtValue( doubleArrayNode.GetPointer(), TimeToString( 1.25 ) );
+  sequence->SetDataNodeAtValue( doubleArrayNode.GetPointer(), TimeToString( 10.0 ) );
+  if ( ! CheckIndexValues( sequence.GetPointer(), "inserting and appending items" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Concatenating with unique index values appends (after renumbering the first time)
+  vtkNew< vtkMRMLWorkflowSequenceNode > otherSequence;
+  FillSequence( otherSequence.GetPointer(), 5, 0.0, 0.1 );
+  int numberOfItems = sequence->GetNumberOfDataNodes();
+  sequence->Concatenate( otherSequence.GetPointer(), true );
+  sequence->Concatenate( otherSequence.GetPointer(), true );
+  if ( ! CheckIndexValues( sequence.GetPointer(), "concatenating" ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if ( sequence->GetNumberOfDataNodes() != numberOfItems + 10 || sequence->GetNthIndexValueAsDouble( numberOfItems + 9 ) != numberOfItems + 9 )
+  {
+    std::cerr << "Concatenated sequence is not numbered 0 to " << numberOfItems + 9 << "." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Editing the concatenated sequence after the appends
+  sequence->UpdateIndexValue( "5", "5.5" );
+  if ( ! CheckIndexValues( sequence.GetPointer(), "editing after concatenating" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
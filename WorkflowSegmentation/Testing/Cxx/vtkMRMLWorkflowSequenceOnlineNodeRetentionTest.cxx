@@ -0,0 +1,196 @@
+
+// Workflow Segmentation includes
+#include "vtkMRMLWorkflowDoubleArrayNode.h"
+#include "vtkMRMLWorkflowInputNode.h"
+#include "vtkMRMLWorkflowSequenceOnlineNode.h"
+
+// VTK includes
+#include "vtkDoubleArray.h"
+#include "vtkNew.h"
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+
+namespace
+{
+
+const int NUMBER_OF_FRAMES = 300;
+const int NUMBER_OF_COMPONENTS = 3;
+const double DELTA_TIME = 0.1;
+const double RESULT_TOLERANCE = 1e-12;
+
+// No frame is near the filter cutoff (5 widths = 1.65s), so rounding cannot decide whether a frame is filtered
+const double FILTER_WIDTH = 0.33;
+const int ORTHOGONAL_WINDOW = 7;
+const int ORTHOGONAL_ORDER = 2;
+const int DERIVATIVE = 1;
+
+
+void AddFrame( vtkMRMLWorkflowSequenceOnlineNode* sequence, int frame )
+{
+  vtkNew< vtkMRMLWorkflowDoubleArrayNode > doubleArrayNode;
+  doubleArrayNode->GetArray()->SetNumberOfComponents( NUMBER_OF_COMPONENTS );
+  doubleArrayNode->GetArray()->SetNumberOfTuples( 1 );
+  for ( int d = 0; d < NUMBER_OF_COMPONENTS; d++ )
+  {
+    doubleArrayNode->GetArray()->SetComponent( 0, d, std::sin( 0.2 * frame + d ) + d );
+  }
+
+  std::stringstream timeStream;
+  timeStream << frame * DELTA_TIME;
+  sequence->AddDataNodeOnline( doubleArrayNode.GetPointer(), timeStream.str() );
+}
+
+
+bool CompareArrays( vtkDoubleArray* expected, vtkDoubleArray* actual, std::string name, int frame )
+{
+  if ( expected->GetNumberOfComponents() != actual->GetNumberOfComponents() )
+  {
+    std::cerr << name << " has " << actual->GetNumberOfComponents() << " components, expected " << expected->GetNumberOfComponents() << " at frame " << frame << "." << std::endl;
+    return false;
+  }
+  for ( int d = 0; d < expected->GetNumberOfComponents(); d++ )
+  {
+    if ( std::abs( expected->GetComponent( 0, d ) - actual->GetComponent( 0, d ) ) > RESULT_TOLERANCE )
+    {
+      std::cerr << name << " component " << d << " is " << actual->GetComponent( 0, d ) << ", expected " << expected->GetComponent( 0, d ) << " at frame " << frame << "." << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// The retained frames must be the most recent frames, with index values matching the sequence
+bool CheckRetainedFrames( vtkMRMLWorkflowSequenceOnlineNode* sequence, int numberOfAddedFrames, int expectedNumberOfFrames, std::string description )
+{
+  if ( sequence->GetNumberOfDataNodes() != expectedNumberOfFrames )
+  {
+    std::cerr << "Retained " << sequence->GetNumberOfDataNodes() << " frames, expected " << expectedNumberOfFrames << " with " << description << "." << std::endl;
+    return false;
+  }
+
+  const std::vector< double >& indexValues = sequence->GetIndexValuesAsDouble();
+  for ( int i = 0; i < sequence->GetNumberOfDataNodes(); i++ )
+  {
+    int frame = numberOfAddedFrames - expectedNumberOfFrames + i;
+    if ( indexValues[ i ] != vtkMRMLWorkflowSequenceNode::IndexValueToDouble( sequence->GetNthIndexValue( i ) )
+      || std::abs( indexValues[ i ] - frame * DELTA_TIME ) > RESULT_TOLERANCE )
+    {
+      std::cerr << "Retained frame " << i << " has index value " << indexValues[ i ] << ", expected " << frame * DELTA_TIME << " with " << description << "." << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+
+int vtkMRMLWorkflowSequenceOnlineNodeRetentionTest( int vtkNotUsed( argc ), char* vtkNotUsed( argv )[] )
+{
+  vtkNew< vtkMRMLWorkflowInputNode > workflowInput;
+  workflowInput->SetFilterWidth( FILTER_WIDTH );
+  workflowInput->SetDerivative( DERIVATIVE );
+  workflowInput->SetOrthogonalWindow( ORTHOGONAL_WINDOW );
+  workflowInput->SetOrthogonalOrder( ORTHOGONAL_ORDER );
+
+  // Retention from the input parameters: the filter lookback (1.65s = 16 frames back) is wider than the window
+  vtkNew< vtkMRMLWorkflowSequenceOnlineNode > fullSequence;
+  fullSequence->SetIndexType( vtkMRMLSequenceNode::NumericIndex );
+  vtkNew< vtkMRMLWorkflowSequenceOnlineNode > retainedSequence;
+  retainedSequence->SetIndexType( vtkMRMLSequenceNode::NumericIndex );
+  retainedSequence->SetRetention( workflowInput.GetPointer() );
+  vtkNew< vtkMRMLWorkflowSequenceNode > archiveSequence;
+  archiveSequence->SetIndexType( vtkMRMLSequenceNode::NumericIndex );
+  retainedSequence->SetArchiveSequence( archiveSequence.GetPointer() );
+
+  const int RETAINED_FRAMES = 17;
+  for ( int i = 0; i < NUMBER_OF_FRAMES; i++ )
+  {
+    AddFrame( fullSequence.GetPointer(), i );
+    AddFrame( retainedSequence.GetPointer(), i );
+
+    // Evicting frames must not change the results of the online methods
+    vtkNew< vtkDoubleArray > fullGauss;
+    fullSequence->GaussianFilterOnline( FILTER_WIDTH, fullGauss.GetPointer() );
+    vtkNew< vtkDoubleArray > retainedGauss;
+    retainedSequence->GaussianFilterOnline( FILTER_WIDTH, retainedGauss.GetPointer() );
+    if ( ! CompareArrays( fullGauss.GetPointer(), retainedGauss.GetPointer(), "Filtered frame", i ) )
+    {
+      return EXIT_FAILURE;
+    }
+
+    vtkNew< vtkDoubleArray > fullDerivative;
+    fullSequence->DifferentiateOnline( DERIVATIVE, fullDerivative.GetPointer() );
+    vtkNew< vtkDoubleArray > retainedDerivative;
+    retainedSequence->DifferentiateOnline( DERIVATIVE, retainedDerivative.GetPointer() );
+    if ( ! CompareArrays( fullDerivative.GetPointer(), retainedDerivative.GetPointer(), "Derivative", i ) )
+    {
+      return EXIT_FAILURE;
+    }
+
+    vtkNew< vtkDoubleArray > fullOrthogonal;
+    fullSequence->OrthogonalTransformationOnline( ORTHOGONAL_WINDOW, ORTHOGONAL_ORDER, fullOrthogonal.GetPointer() );
+    vtkNew< vtkDoubleArray > retainedOrthogonal;
+    retainedSequence->OrthogonalTransformationOnline( ORTHOGONAL_WINDOW, ORTHOGONAL_ORDER, retainedOrthogonal.GetPointer() );
+    if ( ! CompareArrays( fullOrthogonal.GetPointer(), retainedOrthogonal.GetPointer(), "Orthogonal frame", i ) )
+    {
+      return EXIT_FAILURE;
+    }
+
+    if ( ! CheckRetainedFrames( retainedSequence.GetPointer(), i + 1, std::min( i + 1, RETAINED_FRAMES ), "the input retention" ) )
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Nothing is lost: every evicted frame is in the archive
+  if ( archiveSequence->GetNumberOfDataNodes() != NUMBER_OF_FRAMES - RETAINED_FRAMES
+    || std::abs( archiveSequence->GetNthIndexValueAsDouble( archiveSequence->GetNumberOfDataNodes() - 1 ) - ( retainedSequence->GetNthIndexValueAsDouble( 0 ) - DELTA_TIME ) ) > RESULT_TOLERANCE )
+  {
+    std::cerr << "Archived " << archiveSequence->GetNumberOfDataNodes() << " frames, expected " << NUMBER_OF_FRAMES - RETAINED_FRAMES << "." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Only a frame limit
+  vtkNew< vtkMRMLWorkflowSequenceOnlineNode > framesSequence;
+  framesSequence->SetIndexType( vtkMRMLSequenceNode::NumericIndex );
+  framesSequence->SetRetentionFrames( 5 );
+  for ( int i = 0; i < 20; i++ )
+  {
+    AddFrame( framesSequence.GetPointer(), i );
+  }
+  if ( ! CheckRetainedFrames( framesSequence.GetPointer(), 20, 5, "only a frame limit" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Only a time limit (frames more than 0.45s older than the most recent are evicted)
+  vtkNew< vtkMRMLWorkflowSequenceOnlineNode > timeSequence;
+  timeSequence->SetIndexType( vtkMRMLSequenceNode::NumericIndex );
+  timeSequence->SetRetentionTime( 0.45 );
+  for ( int i = 0; i < 20; i++ )
+  {
+    AddFrame( timeSequence.GetPointer(), i );
+  }
+  if ( ! CheckRetainedFrames( timeSequence.GetPointer(), 20, 5, "only a time limit" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // No limit keeps everything
+  if ( fullSequence->GetNumberOfDataNodes() != NUMBER_OF_FRAMES )
+  {
+    std::cerr << "Sequence without retention has " << fullSequence->GetNumberOfDataNodes() << " frames, expected " << NUMBER_OF_FRAMES << "." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
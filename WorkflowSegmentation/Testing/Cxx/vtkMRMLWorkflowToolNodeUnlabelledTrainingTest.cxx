@@ -0,0 +1,206 @@
+
+// Workflow Segmentation includes
+#include "vtkMRMLWorkflowInputNode.h"
+#include "vtkMRMLWorkflowProcedureNode.h"
+#include "vtkMRMLWorkflowToolNode.h"
+#include "vtkMRMLWorkflowTrainingNode.h"
+#include "vtkWorkflowFeatureMatrix.h"
+#include "vtkWorkflowTask.h"
+
+// MRML includes
+#include "vtkMRMLScene.h"
+
+// VTK includes
+#include "vtkDoubleArray.h"
+#include "vtkNew.h"
+#include "vtkSmartPointer.h"
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+const int NUMBER_OF_COMPONENTS = 3;
+const int NUMBER_OF_FRAMES = 80;
+const double DELTA_TIME = 0.02;
+
+typedef std::vector< vtkSmartPointer< vtkWorkflowFeatureMatrix > > MatrixVector;
+
+
+// Smooth motion: the first half of each procedure is "Approach", the second half is "Insert"
+// The unlabelled procedures move differently, so they would change the principal components if they were used for them
+vtkSmartPointer< vtkWorkflowFeatureMatrix > CreateProcedure( int procedure, bool labelled )
+{
+  vtkSmartPointer< vtkWorkflowFeatureMatrix > procedureMatrix = vtkSmartPointer< vtkWorkflowFeatureMatrix >::New();
+  procedureMatrix->Initialize( NUMBER_OF_FRAMES, NUMBER_OF_COMPONENTS );
+  double speed = labelled ? 1.0 + 0.1 * procedure : 3.0 + 0.5 * procedure;
+  for ( int i = 0; i < NUMBER_OF_FRAMES; i++ )
+  {
+    double time = i * DELTA_TIME;
+    procedureMatrix->SetTime( i, time );
+    procedureMatrix->SetValue( i, 0, std::sin( speed * time ) );
+    procedureMatrix->SetValue( i, 1, ( i < NUMBER_OF_FRAMES / 2 ) ? speed * time : speed * time * time );
+    procedureMatrix->SetValue( i, 2, std::cos( 2.0 * speed * time + procedure ) );
+
+    if ( ! labelled )
+    {
+      procedureMatrix->SetLabel( i, "" );
+      continue;
+    }
+    procedureMatrix->SetLabel( i, ( i < NUMBER_OF_FRAMES / 2 ) ? "Approach" : "Insert" );
+  }
+  return procedureMatrix;
+}
+
+
+// Copy of the trained model (the training node's arrays are replaced by the next training)
+class TrainedModel
+{
+public:
+  TrainedModel( vtkMRMLWorkflowTrainingNode* trainingNode )
+  {
+    vtkDoubleArray* arrays[ 6 ] = { trainingNode->GetMean(), trainingNode->GetPrinComps(), trainingNode->GetCentroids(),
+      trainingNode->GetMarkov()->GetPi(), trainingNode->GetMarkov()->GetA(), trainingNode->GetMarkov()->GetB() };
+    for ( int i = 0; i < 6; i++ )
+    {
+      this->Arrays[ i ] = vtkSmartPointer< vtkDoubleArray >::New();
+      this->Arrays[ i ]->DeepCopy( arrays[ i ] );
+    }
+  }
+
+  static const char* GetArrayName( int array )
+  {
+    const char* names[ 6 ] = { "Mean", "PrinComps", "Centroids", "Pi", "A", "B" };
+    return names[ array ];
+  }
+
+  // Byte-identical (not just close)
+  bool IsArrayIdentical( TrainedModel& otherModel, int array )
+  {
+    vtkDoubleArray* thisArray = this->Arrays[ array ];
+    vtkDoubleArray* otherArray = otherModel.Arrays[ array ];
+    if ( thisArray->GetNumberOfTuples() != otherArray->GetNumberOfTuples() || thisArray->GetNumberOfComponents() != otherArray->GetNumberOfComponents() )
+    {
+      return false;
+    }
+    return ( thisArray->GetNumberOfValues() == 0 || memcmp( thisArray->GetPointer( 0 ), otherArray->GetPointer( 0 ), thisArray->GetNumberOfValues() * sizeof( double ) ) == 0 );
+  }
+
+  vtkSmartPointer< vtkDoubleArray > Arrays[ 6 ];
+};
+
+
+bool CheckIdentical( TrainedModel& expectedModel, TrainedModel& actualModel, int firstArray, int lastArray, std::string description )
+{
+  for ( int i = firstArray; i <= lastArray; i++ )
+  {
+    if ( ! expectedModel.IsArrayIdentical( actualModel, i ) )
+    {
+      std::cerr << TrainedModel::GetArrayName( i ) << " changed " << description << "." << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+
+int vtkMRMLWorkflowToolNodeUnlabelledTrainingTest( int vtkNotUsed( argc ), char* vtkNotUsed( argv )[] )
+{
+  vtkNew< vtkMRMLScene > scene;
+
+  vtkNew< vtkMRMLWorkflowProcedureNode > procedureNode;
+  const char* taskNames[ 2 ] = { "Approach", "Insert" };
+  for ( int i = 0; i < 2; i++ )
+  {
+    vtkNew< vtkWorkflowTask > task;
+    task->SetName( taskNames[ i ] );
+    procedureNode->AddTask( task.GetPointer() );
+  }
+  scene->AddNode( procedureNode.GetPointer() );
+
+  vtkNew< vtkMRMLWorkflowInputNode > inputNode;
+  inputNode->SetOrthogonalWindow( 3 );
+  inputNode->SetOrthogonalOrder( 1 );
+  inputNode->SetNumCentroids( 6 );
+  inputNode->SetNumPrinComps( 3 );
+  inputNode->SetMarkovBaumWelchIterations( 0 );
+  scene->AddNode( inputNode.GetPointer() );
+
+  vtkNew< vtkMRMLWorkflowTrainingNode > trainingNode;
+  scene->AddNode( trainingNode.GetPointer() );
+
+  vtkNew< vtkMRMLWorkflowToolNode > toolNode;
+  scene->AddNode( toolNode.GetPointer() );
+  toolNode->SetWorkflowProcedureID( procedureNode->GetID() );
+  toolNode->SetWorkflowInputID( inputNode->GetID() );
+  toolNode->SetWorkflowTrainingID( trainingNode->GetID() );
+
+  MatrixVector labelledMatrices;
+  MatrixVector unlabelledMatrices;
+  for ( int i = 0; i < 3; i++ )
+  {
+    labelledMatrices.push_back( CreateProcedure( i, true ) );
+    unlabelledMatrices.push_back( CreateProcedure( i, false ) );
+  }
+
+  // Labelled procedures only
+  if ( ! toolNode->Train( labelledMatrices ) )
+  {
+    std::cerr << "Could not train with the labelled procedures." << std::endl;
+    return EXIT_FAILURE;
+  }
+  TrainedModel labelledModel( trainingNode.GetPointer() );
+
+  // Without Baum-Welch, the unlabelled procedures are not used at all
+  if ( ! toolNode->Train( labelledMatrices, unlabelledMatrices ) )
+  {
+    std::cerr << "Could not train with the unlabelled procedures." << std::endl;
+    return EXIT_FAILURE;
+  }
+  TrainedModel unusedModel( trainingNode.GetPointer() );
+  if ( ! CheckIdentical( labelledModel, unusedModel, 0, 5, "when adding unlabelled procedures without Baum-Welch" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // With Baum-Welch, they only refine the Markov model
+  inputNode->SetMarkovBaumWelchIterations( 5 );
+  if ( ! toolNode->Train( labelledMatrices, unlabelledMatrices ) )
+  {
+    std::cerr << "Could not train with Baum-Welch." << std::endl;
+    return EXIT_FAILURE;
+  }
+  TrainedModel refinedModel( trainingNode.GetPointer() );
+  if ( ! CheckIdentical( labelledModel, refinedModel, 0, 2, "when refining with unlabelled procedures" ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if ( labelledModel.IsArrayIdentical( refinedModel, 5 ) )
+  {
+    std::cerr << "Unlabelled procedures did not refine the Markov model." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Training the procedures in parallel gives the same model
+  if ( ! toolNode->Train( labelledMatrices, unlabelledMatrices, true ) )
+  {
+    std::cerr << "Could not train in parallel." << std::endl;
+    return EXIT_FAILURE;
+  }
+  TrainedModel parallelModel( trainingNode.GetPointer() );
+  if ( ! CheckIdentical( refinedModel, parallelModel, 0, 5, "when training in parallel" ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,309 @@
+
+// Workflow Segmentation includes
+#include "vtkMRMLWorkflowTrainingNode.h"
+#include "vtkMRMLWorkflowTrainingStorageNode.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include "vtkDoubleArray.h"
+#include "vtkNew.h"
+#include "vtkSmartPointer.h"
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+const int HEADER_SIZE = 24;
+const int BLOCK_HEADER_SIZE = 16;
+
+
+vtkSmartPointer< vtkDoubleArray > CreateMatrix( int numberOfTuples, int numberOfComponents, double offset )
+{
+  vtkSmartPointer< vtkDoubleArray > matrix = vtkSmartPointer< vtkDoubleArray >::New();
+  matrix->SetNumberOfComponents( numberOfComponents );
+  matrix->SetNumberOfTuples( numberOfTuples );
+  for ( int i = 0; i < numberOfTuples; i++ )
+  {
+    for ( int j = 0; j < numberOfComponents; j++ )
+    {
+      // Values that are not exact in decimal, so the binary file has to be bit exact to match
+      matrix->SetComponent( i, j, offset + ( i + 1 ) / 3.0 - j * 1e-7 );
+    }
+  }
+  return matrix;
+}
+
+
+// Fills the node like a trained tool (3 tasks, 4 principal components, 5 centroids)
+void FillTrainingNode( vtkMRMLWorkflowTrainingNode* trainingNode )
+{
+  trainingNode->SetMean( CreateMatrix( 1, 8, 0.5 ) );
+  trainingNode->SetPrinComps( CreateMatrix( 4, 8, -2.0 ) );
+  trainingNode->SetCentroids( CreateMatrix( 5, 4, 10.0 ) );
+
+  std::vector< std::string > stateNames;
+  stateNames.push_back( "Approach" );
+  stateNames.push_back( "Insert" );
+  stateNames.push_back( "Retract" );
+  vtkMarkovModel* markov = trainingNode->GetMarkov();
+  markov->SetStates( stateNames );
+  markov->SetSymbols( 5 );
+  markov->SetPi( CreateMatrix( 1, 3, 0.1 ) );
+  markov->SetA( CreateMatrix( 3, 3, 0.2 ) );
+  markov->SetB( CreateMatrix( 3, 5, 0.3 ) );
+}
+
+
+bool CompareMatrices( vtkDoubleArray* expected, vtkDoubleArray* actual, std::string name )
+{
+  if ( expected->GetNumberOfTuples() != actual->GetNumberOfTuples() || expected->GetNumberOfComponents() != actual->GetNumberOfComponents() )
+  {
+    std::cerr << name << " has size " << actual->GetNumberOfTuples() << "x" << actual->GetNumberOfComponents()
+              << ", expected " << expected->GetNumberOfTuples() << "x" << expected->GetNumberOfComponents() << "." << std::endl;
+    return false;
+  }
+  if ( expected->GetNumberOfValues() > 0 && memcmp( expected->GetPointer( 0 ), actual->GetPointer( 0 ), expected->GetNumberOfValues() * sizeof( double ) ) != 0 )
+  {
+    std::cerr << name << " values do not match." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+
+bool CompareTrainingNodes( vtkMRMLWorkflowTrainingNode* expected, vtkMRMLWorkflowTrainingNode* actual )
+{
+  if ( ! CompareMatrices( expected->GetMean(), actual->GetMean(), "Mean" )
+    || ! CompareMatrices( expected->GetPrinComps(), actual->GetPrinComps(), "PrinComps" )
+    || ! CompareMatrices( expected->GetCentroids(), actual->GetCentroids(), "Centroids" )
+    || ! CompareMatrices( expected->GetMarkov()->GetPi(), actual->GetMarkov()->GetPi(), "Pi" )
+    || ! CompareMatrices( expected->GetMarkov()->GetA(), actual->GetMarkov()->GetA(), "A" )
+    || ! CompareMatrices( expected->GetMarkov()->GetB(), actual->GetMarkov()->GetB(), "B" ) )
+  {
+    return false;
+  }
+
+  vtkMarkovModel* expectedMarkov = expected->GetMarkov();
+  vtkMarkovModel* actualMarkov = actual->GetMarkov();
+  if ( expectedMarkov->GetNumStates() != actualMarkov->GetNumStates() || expectedMarkov->GetNumSymbols() != actualMarkov->GetNumSymbols() )
+  {
+    std::cerr << "Number of states or symbols does not match." << std::endl;
+    return false;
+  }
+  for ( int i = 0; i < expectedMarkov->GetNumStates(); i++ )
+  {
+    if ( expectedMarkov->GetStateName( i ) != actualMarkov->GetStateName( i ) )
+    {
+      std::cerr << "State " << i << " is " << actualMarkov->GetStateName( i ) << ", expected " << expectedMarkov->GetStateName( i ) << "." << std::endl;
+      return false;
+    }
+  }
+  for ( int i = 0; i < expectedMarkov->GetNumSymbols(); i++ )
+  {
+    if ( expectedMarkov->GetSymbolName( i ) != actualMarkov->GetSymbolName( i ) )
+    {
+      std::cerr << "Symbol " << i << " is " << actualMarkov->GetSymbolName( i ) << ", expected " << expectedMarkov->GetSymbolName( i ) << "." << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+
+bool ReadFileBytes( std::string fileName, std::vector< char >& bytes )
+{
+  std::ifstream input( fileName.c_str(), std::ios::binary );
+  if ( ! input.is_open() )
+  {
+    return false;
+  }
+  bytes.assign( std::istreambuf_iterator< char >( input ), std::istreambuf_iterator< char >() );
+  return true;
+}
+
+
+bool WriteFileBytes( std::string fileName, const std::vector< char >& bytes )
+{
+  std::ofstream output( fileName.c_str(), std::ios::binary );
+  if ( ! output.is_open() )
+  {
+    return false;
+  }
+  if ( ! bytes.empty() )
+  {
+    output.write( &bytes[ 0 ], bytes.size() );
+  }
+  output.close();
+  return ! output.fail();
+}
+
+
+void SetUInt32LE( std::vector< char >& bytes, size_t offset, unsigned int value )
+{
+  for ( int i = 0; i < 4; i++ )
+  {
+    bytes[ offset + i ] = static_cast< char >( ( value >> ( 8 * i ) ) & 0xFF );
+  }
+}
+
+
+void SwapBytes( std::vector< char >& bytes, size_t offset, int size )
+{
+  for ( int i = 0; i < size / 2; i++ )
+  {
+    std::swap( bytes[ offset + i ], bytes[ offset + size - 1 - i ] );
+  }
+}
+
+
+// The file must be rejected, and the node must be left as it was
+int CheckRejected( vtkMRMLWorkflowTrainingStorageNode* storageNode, std::string fileName, const std::vector< char >& bytes, std::string description )
+{
+  if ( ! WriteFileBytes( fileName, bytes ) )
+  {
+    std::cerr << "Could not write " << fileName << "." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkNew< vtkMRMLWorkflowTrainingNode > expectedNode;
+  FillTrainingNode( expectedNode.GetPointer() );
+  vtkNew< vtkMRMLWorkflowTrainingNode > readNode;
+  FillTrainingNode( readNode.GetPointer() );
+
+  bool success = true;
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  success = storageNode->ReadBinary( readNode.GetPointer(), fileName );
+  TESTING_OUTPUT_ASSERT_ERRORS_END();
+
+  if ( success )
+  {
+    std::cerr << "File was read, but it is " << description << "." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if ( ! CompareTrainingNodes( expectedNode.GetPointer(), readNode.GetPointer() ) )
+  {
+    std::cerr << "Node was changed by a file that is " << description << "." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+
+int vtkMRMLWorkflowTrainingStorageNodeBinaryTest( int argc, char* argv[] )
+{
+  if ( argc < 2 )
+  {
+    std::cerr << "Usage: vtkMRMLWorkflowTrainingStorageNodeBinaryTest <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::string fileName = std::string( argv[ 1 ] ) + "/vtkMRMLWorkflowTrainingStorageNodeBinaryTest.wtb";
+  std::string corruptFileName = std::string( argv[ 1 ] ) + "/vtkMRMLWorkflowTrainingStorageNodeBinaryTestCorrupt.wtb";
+
+  vtkNew< vtkMRMLWorkflowTrainingNode > trainingNode;
+  FillTrainingNode( trainingNode.GetPointer() );
+  vtkNew< vtkMRMLWorkflowTrainingStorageNode > storageNode;
+
+  // Round trip, with and without the checksum
+  std::vector< char > checksumBytes;
+  std::vector< char > noChecksumBytes;
+  for ( int checksum = 1; checksum >= 0; checksum-- )
+  {
+    storageNode->SetBinaryChecksum( checksum != 0 );
+    if ( ! storageNode->WriteBinary( trainingNode.GetPointer(), fileName ) )
+    {
+      std::cerr << "Could not write " << fileName << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+    vtkNew< vtkMRMLWorkflowTrainingNode > readNode;
+    if ( ! storageNode->ReadBinary( readNode.GetPointer(), fileName ) )
+    {
+      std::cerr << "Could not read " << fileName << " (checksum " << checksum << ")." << std::endl;
+      return EXIT_FAILURE;
+    }
+    if ( ! CompareTrainingNodes( trainingNode.GetPointer(), readNode.GetPointer() ) )
+    {
+      std::cerr << "Round trip changed the training (checksum " << checksum << ")." << std::endl;
+      return EXIT_FAILURE;
+    }
+    if ( ! ReadFileBytes( fileName, checksum ? checksumBytes : noChecksumBytes ) )
+    {
+      std::cerr << "Could not read back " << fileName << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ( checksumBytes.size() != noChecksumBytes.size() + 8 )
+  {
+    std::cerr << "Checksum should add 8 bytes to the file." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Checksum mismatch (one bit of the mean is flipped)
+  std::vector< char > corruptBytes = checksumBytes;
+  corruptBytes[ HEADER_SIZE + BLOCK_HEADER_SIZE + 3 ] ^= 0x10;
+  if ( CheckRejected( storageNode.GetPointer(), corruptFileName, corruptBytes, "corrupt" ) != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Truncated, with and without the checksum (including cuts inside the header, a block header, block data, and the checksum)
+  for ( int checksum = 1; checksum >= 0; checksum-- )
+  {
+    const std::vector< char >& bytes = checksum ? checksumBytes : noChecksumBytes;
+    size_t truncatedSizes[] = { 0, 7, HEADER_SIZE - 1, HEADER_SIZE, HEADER_SIZE + BLOCK_HEADER_SIZE / 2, HEADER_SIZE + BLOCK_HEADER_SIZE + 5, bytes.size() / 2, bytes.size() - 8, bytes.size() - 1 };
+    for ( int i = 0; i < sizeof( truncatedSizes ) / sizeof( truncatedSizes[ 0 ] ); i++ )
+    {
+      std::vector< char > truncatedBytes( bytes.begin(), bytes.begin() + truncatedSizes[ i ] );
+      if ( CheckRejected( storageNode.GetPointer(), corruptFileName, truncatedBytes, "truncated" ) != EXIT_SUCCESS )
+      {
+        std::cerr << "Truncated to " << truncatedSizes[ i ] << " bytes (checksum " << checksum << ")." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  // Wrong endianness (the header fields as a big-endian machine would write them)
+  std::vector< char > bigEndianBytes = noChecksumBytes;
+  for ( int offset = 8; offset < HEADER_SIZE; offset += 4 )
+  {
+    SwapBytes( bigEndianBytes, offset, 4 );
+  }
+  if ( CheckRejected( storageNode.GetPointer(), corruptFileName, bigEndianBytes, "big-endian" ) != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Block with tuples but no components (so it has no data, and its size cannot catch it)
+  std::vector< char > noComponentsBytes( noChecksumBytes.begin(), noChecksumBytes.begin() + HEADER_SIZE + BLOCK_HEADER_SIZE );
+  SetUInt32LE( noComponentsBytes, 16, 1 ); // Number of blocks
+  SetUInt32LE( noComponentsBytes, HEADER_SIZE + 4, 3 ); // Number of tuples
+  SetUInt32LE( noComponentsBytes, HEADER_SIZE + 8, 0 ); // Number of components
+  SetUInt32LE( noComponentsBytes, HEADER_SIZE + 12, 0 ); // Number of bytes
+  if ( CheckRejected( storageNode.GetPointer(), corruptFileName, noComponentsBytes, "a block without components" ) != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Blocks that claim more data than the file has
+  std::vector< char > oversizedBytes = noChecksumBytes;
+  SetUInt32LE( oversizedBytes, HEADER_SIZE + 12, 0xFFFFFFF8 );
+  if ( CheckRejected( storageNode.GetPointer(), corruptFileName, oversizedBytes, "an oversized block" ) != EXIT_SUCCESS )
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,262 @@
+
+// Workflow Segmentation includes
+#include "vtkMarkovModel.h"
+
+// VTK includes
+#include "vtkDoubleArray.h"
+#include "vtkNew.h"
+#include "vtkSmartPointer.h"
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+
+namespace
+{
+
+const int NUMBER_OF_STATES = 2;
+const int NUMBER_OF_SYMBOLS = 3;
+const int MAX_ITERATIONS = 25;
+const double PSEUDO_COUNT = 0.5;
+const double LOG_LIKELIHOOD_TOLERANCE = 1e-9; // Relative, for round-off only
+const double PROBABILITY_TOLERANCE = 1e-9;
+
+// The model the sequences are generated from
+const double TRUE_PI[ NUMBER_OF_STATES ] = { 0.8, 0.2 };
+const double TRUE_A[ NUMBER_OF_STATES ][ NUMBER_OF_STATES ] = { { 0.9, 0.1 }, { 0.2, 0.8 } };
+const double TRUE_B[ NUMBER_OF_STATES ][ NUMBER_OF_SYMBOLS ] = { { 0.7, 0.2, 0.1 }, { 0.1, 0.3, 0.6 } };
+
+
+// Deterministic (linear congruential) generator, so the test is the same on every platform
+class TestRandom
+{
+public:
+  TestRandom() : Seed( 12345 ) {}
+
+  double Uniform()
+  {
+    this->Seed = ( 1103515245u * this->Seed + 12345u ) % 2147483648u;
+    return double( this->Seed ) / 2147483648.0;
+  }
+
+  int Sample( const double* probabilities, int size )
+  {
+    double value = this->Uniform();
+    for ( int i = 0; i < size - 1; i++ )
+    {
+      value -= probabilities[ i ];
+      if ( value < 0 )
+      {
+        return i;
+      }
+    }
+    return size - 1;
+  }
+
+private:
+  unsigned long Seed;
+};
+
+
+void GenerateSequence( TestRandom& random, int numberOfObservations, std::vector< int >& states, std::vector< int >& symbols )
+{
+  states.assign( numberOfObservations, -1 );
+  symbols.assign( numberOfObservations, -1 );
+  for ( int i = 0; i < numberOfObservations; i++ )
+  {
+    states[ i ] = ( i == 0 ) ? random.Sample( TRUE_PI, NUMBER_OF_STATES ) : random.Sample( TRUE_A[ states[ i - 1 ] ], NUMBER_OF_STATES );
+    symbols[ i ] = random.Sample( TRUE_B[ states[ i ] ], NUMBER_OF_SYMBOLS );
+  }
+}
+
+
+void FillPseudoArray( vtkDoubleArray* pseudoArray, int numberOfTuples, int numberOfComponents )
+{
+  pseudoArray->SetNumberOfComponents( numberOfComponents );
+  pseudoArray->SetNumberOfTuples( numberOfTuples );
+  for ( int j = 0; j < numberOfComponents; j++ )
+  {
+    pseudoArray->FillComponent( j, PSEUDO_COUNT );
+  }
+}
+
+
+// The model only holds counts until the parameters are estimated
+void SeedModel( vtkMarkovModel* markov, const std::vector< int >& labelledStates, const std::vector< int >& labelledSymbols )
+{
+  markov->SetStates( NUMBER_OF_STATES );
+  markov->SetSymbols( NUMBER_OF_SYMBOLS );
+  markov->InitializeEstimation();
+
+  vtkNew< vtkDoubleArray > pseudoPi;
+  FillPseudoArray( pseudoPi.GetPointer(), 1, NUMBER_OF_STATES );
+  vtkNew< vtkDoubleArray > pseudoA;
+  FillPseudoArray( pseudoA.GetPointer(), NUMBER_OF_STATES, NUMBER_OF_STATES );
+  vtkNew< vtkDoubleArray > pseudoB;
+  FillPseudoArray( pseudoB.GetPointer(), NUMBER_OF_STATES, NUMBER_OF_SYMBOLS );
+  markov->AddPseudoData( pseudoPi.GetPointer(), pseudoA.GetPointer(), pseudoB.GetPointer() );
+
+  markov->AddEstimationData( labelledStates, labelledSymbols );
+}
+
+
+void GetParameters( vtkMarkovModel* markov, std::vector< double >& parameters )
+{
+  parameters.clear();
+  vtkDoubleArray* arrays[ 3 ] = { markov->GetPi(), markov->GetA(), markov->GetB() };
+  for ( int i = 0; i < 3; i++ )
+  {
+    parameters.insert( parameters.end(), arrays[ i ]->GetPointer( 0 ), arrays[ i ]->GetPointer( 0 ) + arrays[ i ]->GetNumberOfValues() );
+  }
+}
+
+
+// Log-likelihood of the labelled and pseudo counts (with the counts from the seed and the parameters from the model)
+double CountsLogLikelihood( const std::vector< double >& counts, const std::vector< double >& parameters )
+{
+  double logLikelihood = 0.0;
+  for ( int i = 0; i < counts.size(); i++ )
+  {
+    if ( counts[ i ] > 0 )
+    {
+      logLikelihood += counts[ i ] * std::log( parameters[ i ] );
+    }
+  }
+  return logLikelihood;
+}
+
+
+bool IsNormalized( vtkDoubleArray* parameters )
+{
+  for ( int i = 0; i < parameters->GetNumberOfTuples(); i++ )
+  {
+    double sum = 0.0;
+    for ( int j = 0; j < parameters->GetNumberOfComponents(); j++ )
+    {
+      if ( ! ( parameters->GetComponent( i, j ) >= 0 ) )
+      {
+        return false;
+      }
+      sum += parameters->GetComponent( i, j );
+    }
+    if ( std::abs( sum - 1.0 ) > PROBABILITY_TOLERANCE )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+
+int vtkMarkovModelBaumWelchTest( int vtkNotUsed( argc ), char* vtkNotUsed( argv )[] )
+{
+  TestRandom random;
+
+  // A short labelled sequence only gives a rough seed, so the unlabelled sequences have something to refine
+  std::vector< int > labelledStates;
+  std::vector< int > labelledSymbols;
+  GenerateSequence( random, 30, labelledStates, labelledSymbols );
+
+  std::vector< std::vector< int > > unlabelledSymbols( 20 );
+  for ( int i = 0; i < unlabelledSymbols.size(); i++ )
+  {
+    std::vector< int > unusedStates;
+    GenerateSequence( random, 100, unusedStates, unlabelledSymbols[ i ] );
+  }
+
+  vtkNew< vtkMarkovModel > countsMarkov;
+  SeedModel( countsMarkov.GetPointer(), labelledStates, labelledSymbols );
+  std::vector< double > counts;
+  GetParameters( countsMarkov.GetPointer(), counts );
+
+  // Run with an increasing number of iterations (the tolerance never stops it early)
+  // The run with k + 1 iterations returns the log-likelihood of the unlabelled sequences under the parameters after k iterations
+  std::vector< double > unlabelledLogLikelihoods( MAX_ITERATIONS + 1 );
+  std::vector< double > countsLogLikelihoods( MAX_ITERATIONS + 1 );
+  for ( int k = 0; k <= MAX_ITERATIONS + 1; k++ )
+  {
+    vtkNew< vtkMarkovModel > markov;
+    SeedModel( markov.GetPointer(), labelledStates, labelledSymbols );
+    double logLikelihood = 0.0;
+    if ( k == 0 )
+    {
+      markov->EstimateParameters();
+    }
+    else
+    {
+      logLikelihood = markov->EstimateParameters( unlabelledSymbols, k, - std::numeric_limits< double >::max() );
+    }
+
+    if ( ! IsNormalized( markov->GetPi() ) || ! IsNormalized( markov->GetA() ) || ! IsNormalized( markov->GetB() ) )
+    {
+      std::cerr << "Parameters are not probability distributions after " << k << " iterations." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if ( k > 0 )
+    {
+      if ( logLikelihood == - std::numeric_limits< double >::max() || logLikelihood != logLikelihood )
+      {
+        std::cerr << "Invalid log-likelihood after " << k << " iterations." << std::endl;
+        return EXIT_FAILURE;
+      }
+      unlabelledLogLikelihoods[ k - 1 ] = logLikelihood;
+    }
+    if ( k <= MAX_ITERATIONS )
+    {
+      std::vector< double > parameters;
+      GetParameters( markov.GetPointer(), parameters );
+      countsLogLikelihoods[ k ] = CountsLogLikelihood( counts, parameters );
+    }
+  }
+
+  // The labelled and pseudo counts are kept at every iteration, so Baum-Welch maximizes the log-likelihood of all of the training data
+  // (the unlabelled sequences plus the counts), and this can never decrease from one iteration to the next
+  for ( int k = 1; k <= MAX_ITERATIONS; k++ )
+  {
+    double prevLogLikelihood = unlabelledLogLikelihoods[ k - 1 ] + countsLogLikelihoods[ k - 1 ];
+    double currLogLikelihood = unlabelledLogLikelihoods[ k ] + countsLogLikelihoods[ k ];
+    if ( currLogLikelihood < prevLogLikelihood - LOG_LIKELIHOOD_TOLERANCE * std::abs( prevLogLikelihood ) )
+    {
+      std::cerr << "Log-likelihood decreased at iteration " << k << ": " << prevLogLikelihood << " to " << currLogLikelihood << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // The refined model should explain the unlabelled sequences better than the seed did
+  if ( ! ( unlabelledLogLikelihoods[ MAX_ITERATIONS ] > unlabelledLogLikelihoods[ 0 ] ) )
+  {
+    std::cerr << "Baum-Welch did not refine the model: " << unlabelledLogLikelihoods[ 0 ] << " to " << unlabelledLogLikelihoods[ MAX_ITERATIONS ] << "." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // With a tolerance, it stops by itself (and does no worse than the seed)
+  vtkNew< vtkMarkovModel > convergedMarkov;
+  SeedModel( convergedMarkov.GetPointer(), labelledStates, labelledSymbols );
+  double convergedLogLikelihood = convergedMarkov->EstimateParameters( unlabelledSymbols, 1000, 1e-6 );
+  if ( ! ( convergedLogLikelihood >= unlabelledLogLikelihoods[ 0 ] ) )
+  {
+    std::cerr << "Converged log-likelihood " << convergedLogLikelihood << " is below the seed " << unlabelledLogLikelihoods[ 0 ] << "." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Invalid symbols are ignored (the sequence adds nothing), rather than breaking the estimate
+  std::vector< std::vector< int > > invalidSymbols = unlabelledSymbols;
+  invalidSymbols.push_back( std::vector< int >( 10, NUMBER_OF_SYMBOLS ) );
+  vtkNew< vtkMarkovModel > invalidMarkov;
+  SeedModel( invalidMarkov.GetPointer(), labelledStates, labelledSymbols );
+  double invalidLogLikelihood = invalidMarkov->EstimateParameters( invalidSymbols, 1, - std::numeric_limits< double >::max() );
+  if ( std::abs( invalidLogLikelihood - unlabelledLogLikelihoods[ 0 ] ) > LOG_LIKELIHOOD_TOLERANCE * std::abs( unlabelledLogLikelihoods[ 0 ] ) )
+  {
+    std::cerr << "Sequence with invalid symbols changed the log-likelihood." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+
+// Workflow Segmentation includes
+#include "vtkWorkflowFeatureMatrix.h"
+
+// VTK includes
+#include "vtkNew.h"
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+
+namespace
+{
+
+const double FILTER_TOLERANCE = 1e-9;
+
+
+// Smooth, but not polynomial, so the filter actually changes the values
+void FillFeatureMatrix( vtkWorkflowFeatureMatrix* featureMatrix, int numberOfFrames, bool irregular )
+{
+  const int NUMBER_OF_COMPONENTS = 3;
+  featureMatrix->Initialize( numberOfFrames, NUMBER_OF_COMPONENTS );
+
+  double time = 0.0;
+  for ( int i = 0; i < numberOfFrames; i++ )
+  {
+    featureMatrix->SetTime( i, time );
+    // Deterministic irregular steps (between 0.01s and 0.21s)
+    time += irregular ? ( 0.01 + 0.2 * std::abs( std::sin( 12.9898 * i ) ) ) : 0.1;
+
+    for ( int d = 0; d < NUMBER_OF_COMPONENTS; d++ )
+    {
+      featureMatrix->SetValue( i, d, std::sin( 0.3 * i + d ) + d );
+    }
+  }
+}
+
+
+bool CompareFilterModes( int numberOfFrames, bool irregular, double width )
+{
+  vtkNew< vtkWorkflowFeatureMatrix > directMatrix;
+  FillFeatureMatrix( directMatrix.GetPointer(), numberOfFrames, irregular );
+  vtkNew< vtkWorkflowFeatureMatrix > slidingWindowMatrix;
+  slidingWindowMatrix->Copy( directMatrix.GetPointer() );
+
+  directMatrix->GaussianFilter( width, vtkWorkflowFeatureMatrix::DIRECT_FILTER );
+  slidingWindowMatrix->GaussianFilter( width, vtkWorkflowFeatureMatrix::SLIDING_WINDOW_FILTER );
+
+  if ( slidingWindowMatrix->GetNumberOfFrames() != numberOfFrames || slidingWindowMatrix->GetNumberOfComponents() != directMatrix->GetNumberOfComponents() )
+  {
+    std::cerr << "Sliding window filter changed the matrix size (" << numberOfFrames << " frames)." << std::endl;
+    return false;
+  }
+
+  // Every frame is checked, so the edge frames (with the window cut off by the start or end) are included
+  for ( int i = 0; i < numberOfFrames; i++ )
+  {
+    for ( int d = 0; d < directMatrix->GetNumberOfComponents(); d++ )
+    {
+      double directValue = directMatrix->GetValue( i, d );
+      double slidingWindowValue = slidingWindowMatrix->GetValue( i, d );
+      if ( std::abs( directValue - slidingWindowValue ) > FILTER_TOLERANCE * std::max( 1.0, std::abs( directValue ) ) )
+      {
+        std::cerr << "Filter modes disagree (" << ( irregular ? "irregular" : "uniform" ) << " times, "
+          << numberOfFrames << " frames, width " << width << ") at frame " << i << ", component " << d << ": "
+          << directValue << " vs. " << slidingWindowValue << std::endl;
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+}
+
+
+// The sliding window filter must give the same result as the direct (reference) filter
+int vtkWorkflowFeatureMatrixGaussianFilterTest( int vtkNotUsed( argc ), char* vtkNotUsed( argv )[] )
+{
+  const int NUMBER_OF_FRAMES[] = { 1, 2, 7, 200 };
+  // Narrower than the sampling, a few frames wide, and wider than the whole recording
+  const double WIDTHS[] = { 0.05, 0.3, 2.0, 100.0 };
+
+  bool success = true;
+  for ( int irregular = 0; irregular <= 1; irregular++ )
+  {
+    for ( int n = 0; n < sizeof( NUMBER_OF_FRAMES ) / sizeof( int ); n++ )
+    {
+      for ( int w = 0; w < sizeof( WIDTHS ) / sizeof( double ); w++ )
+      {
+        success = CompareFilterModes( NUMBER_OF_FRAMES[ n ], irregular != 0, WIDTHS[ w ] ) && success;
+      }
+    }
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -162,7 +162,15 @@ void qSlicerWorkflowToolSummaryWidget
     trainingTrackedSequenceBrowserNodeCollection->AddItem( *itr );
   }
 
-  this->WorkflowSegmentationLogic->TrainAllTools( this->WorkflowSegmentationNode, trainingTrackedSequenceBrowserNodeCollection.GetPointer() );
+  vtkNew< vtkCollection > unlabelledTrackedSequenceBrowserNodeCollection;
+
+  QList< vtkMRMLNode* > unlabelledTrackedSequenceBrowserNodeItr = d->UnlabelledTrackedSequenceBrowserComboBox->checkedNodes();
+  for ( itr = unlabelledTrackedSequenceBrowserNodeItr.begin(); itr != unlabelledTrackedSequenceBrowserNodeItr.end(); itr++ )
+  {
+    unlabelledTrackedSequenceBrowserNodeCollection->AddItem( *itr );
+  }
+
+  this->WorkflowSegmentationLogic->TrainAllTools( this->WorkflowSegmentationNode, trainingTrackedSequenceBrowserNodeCollection.GetPointer(), unlabelledTrackedSequenceBrowserNodeCollection.GetPointer() );
 
   trainingProgressDialog->close(); // automatically deleted
 }
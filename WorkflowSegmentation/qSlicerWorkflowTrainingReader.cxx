@@ -28,6 +28,7 @@
 #include "vtkSlicerWorkflowSegmentationLogic.h"
 
 // MRML includes
+#include "vtkMRMLWorkflowTrainingStorageNode.h"
 
 // VTK includes
 #include <vtkSmartPointer.h>
@@ -81,7 +82,7 @@ qSlicerIO::IOFileType qSlicerWorkflowTrainingReader::fileType() const
 //-----------------------------------------------------------------------------
 QStringList qSlicerWorkflowTrainingReader::extensions() const
 {
-  return QStringList() << "Workflow Training (*.xml)";
+  return QStringList() << "Workflow Training (*.xml *.wtb)";
 }
 
 //-----------------------------------------------------------------------------
@@ -108,6 +109,15 @@ bool qSlicerWorkflowTrainingReader::load(const IOProperties& properties)
     
     importTrainingNode->FromXMLElement( parser->GetRootElement() );
   }  
+  if ( extension.toStdString().compare( "wtb" ) == 0 )
+  {
+    vtkSmartPointer< vtkMRMLWorkflowTrainingStorageNode > storageNode = vtkSmartPointer< vtkMRMLWorkflowTrainingStorageNode >::New();
+    if ( ! storageNode->ReadBinary( importTrainingNode, fileName.toStdString() ) )
+    {
+      this->mrmlScene()->RemoveNode( importTrainingNode );
+      return false;
+    }
+  }
   
   importTrainingNode->SetName( baseName.toStdString().c_str() );
   importTrainingNode->Modified();